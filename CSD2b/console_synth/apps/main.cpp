@@ -4,6 +4,7 @@
 #include <console_synth/console_interface/console_interface.h>
 #include <console_synth/engine.h>
 #include <console_synth/utility/scoped_message_thread_enabler.h>
+#include <thread>
 
 int main()
 {
@@ -14,7 +15,14 @@ int main()
     auto engine = Engine {};
     auto consoleInterface = ConsoleInterface { engine };
 
-    consoleInterface.run();
+    // the console waits for input on a thread of its own, so the message thread is free to run the timers
+    auto consoleThread = std::thread { [&consoleInterface] {
+        consoleInterface.run();
+        juce::MessageManager::getInstance()->stopDispatchLoop();
+    } };
+
+    juce::MessageManager::getInstance()->runDispatchLoop();
+    consoleThread.join();
 
     return 0;
 }
@@ -21,4 +21,18 @@ public:
     virtual void prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock) {}
 
     virtual void releaseResources() {}
-};
\ No newline at end of file
+
+    // should return true if processing a block without any midi would only produce silence
+    // (e.g. a synth without active voices), so the caller can skip rendering altogether
+    [[nodiscard]] virtual bool isIdle() const { return false; }
+
+    // the time it takes for the output of the processor to decay below the silence threshold
+    // after its input went silent (e.g. the reverb tail). Can be infinite (e.g. a frozen reverb).
+    [[nodiscard]] virtual double getTailLengthSeconds() const { return 0.0; }
+
+    // the number of samples the output of the processor is delayed compared to its input (e.g. lookahead)
+    [[nodiscard]] virtual int getLatencySamples() const { return 0; }
+
+    // anything below this level (about -100 dB) is considered silence
+    static constexpr auto silenceThreshold = 1.0e-5f;
+};
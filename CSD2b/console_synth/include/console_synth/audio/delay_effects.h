@@ -0,0 +1,353 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include "audio_processor_base.h"
+#include "delay_line.h"
+#include <console_synth/sequencer/play_head.h>
+#include <utility>
+#include <vector>
+
+/* Delay based effects whose timing follows the tempo of the sequencer: the delay time of the delay and
+ * the lfo period of the chorus and flanger are set in beats. At the start of every block they read the tempo
+ * at the play head from the tempo map, so they follow the tempo changes of the song as it plays.
+ * */
+
+class TempoSyncedEffect : public AudioProcessorBase
+{
+public:
+    explicit TempoSyncedEffect (const PlayHead& sequencerPlayHead) : playHead { sequencerPlayHead } {}
+
+    void prepareToPlay (double newSampleRate, int) override
+    {
+        sampleRate = newSampleRate;
+    }
+
+protected:
+    double sampleRate = 44100.0;
+
+    // the play head only has a tempo map during a block, so this should be called from processBlock
+    void updateTempo() noexcept
+    {
+        if (auto bpm = playHead.getTempoBpm(); bpm > 0.0)
+            currentTempoBpm = bpm;
+    }
+
+    [[nodiscard]] double beatsToSeconds (double beats) const noexcept
+    {
+        return beats * 60.0 / currentTempoBpm;
+    }
+
+    [[nodiscard]] double beatsToSamples (double beats) const noexcept
+    {
+        return beatsToSeconds (beats) * sampleRate;
+    }
+
+    // number of seconds it takes for a signal in a feedback loop to decay below the silence threshold
+    [[nodiscard]] static double feedbackDecaySeconds (double loopSeconds, float feedback)
+    {
+        if (feedback <= 0.0f)
+            return loopSeconds;
+
+        return loopSeconds * (1.0 + std::log (silenceThreshold) / std::log ((double) feedback));
+    }
+
+private:
+    const PlayHead& playHead;
+
+    // the tempo of the last block (only used until the first block is processed)
+    double currentTempoBpm = 120.0;
+};
+
+// ===================================================================================================
+
+// Feedback delay with the delay time in beats. The delay time is smoothed, so a tempo change doesn't click.
+// The loop is rendered per sample and uses allpass interpolation, which doesn't dull the repeats.
+class TempoSyncedDelay : public TempoSyncedEffect
+{
+public:
+    struct Parameters
+    {
+        double delayBeats = 0.75;  // dotted eighth
+        float feedback = 0.45f;
+        float wetLevel = 0.35f;
+        float dryLevel = 1.0f;
+    };
+
+    explicit TempoSyncedDelay (const PlayHead& playHead) : TempoSyncedDelay { playHead, Parameters {} } {}
+
+    TempoSyncedDelay (const PlayHead& playHead, const Parameters& params)
+        : TempoSyncedEffect { playHead }, parameters { params }
+    {}
+
+    void prepareToPlay (double newSampleRate, int maximumExpectedSamplesPerBlock) override
+    {
+        TempoSyncedEffect::prepareToPlay (newSampleRate, maximumExpectedSamplesPerBlock);
+
+        for (auto& channel : channels)
+        {
+            channel.delayLine.setMaximumDelaySamples ((int) std::ceil (maxDelaySeconds * sampleRate));
+            channel.allpassState = {};
+        }
+
+        shouldJumpToTargetDelay = true;
+        smoothingCoefficient = 1.0 - std::exp (-1.0 / (0.05 * sampleRate));
+    }
+
+    void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
+    {
+        const auto numSamples = buffer.getNumSamples();
+        const auto numChannels = std::min (buffer.getNumChannels(), maxNumChannels);
+
+        updateTempo();
+        const auto targetDelay = getTargetDelaySamples();
+
+        // after preparing, the delay starts at the delay time of the tempo of the first block
+        if (std::exchange (shouldJumpToTargetDelay, false))
+            smoothedDelaySamples = targetDelay;
+
+        const auto startDelay = smoothedDelaySamples;
+
+        for (auto channel = 0; channel < numChannels; ++channel)
+        {
+            auto& [delayLine, allpassState] = channels[(size_t) channel];
+            auto* samples = buffer.getWritePointer (channel);
+            auto delay = startDelay;
+
+            for (auto i = 0; i < numSamples; ++i)
+            {
+                delay += (targetDelay - delay) * smoothingCoefficient;
+
+                // the sample that is written now is read back one sample later, hence the - 1
+                auto delayed = delayLine.readAllpass ((float) (delay - 1.0), allpassState);
+                delayLine.write (samples[i] + delayed * parameters.feedback);
+                samples[i] = samples[i] * parameters.dryLevel + delayed * parameters.wetLevel;
+            }
+
+            smoothedDelaySamples = delay;
+        }
+    }
+
+    void releaseResources() override
+    {
+        for (auto& channel : channels)
+            channel.delayLine.reset();
+    }
+
+    [[nodiscard]] double getTailLengthSeconds() const override
+    {
+        return feedbackDecaySeconds (std::min (beatsToSeconds (parameters.delayBeats), maxDelaySeconds), parameters.feedback);
+    }
+
+private:
+    static constexpr auto maxNumChannels = 2;
+    static constexpr auto maxDelaySeconds = 4.0;
+
+    struct Channel
+    {
+        DelayLine<float> delayLine;
+        DelayLine<float>::AllpassState allpassState;
+    };
+
+    Parameters parameters;
+    std::array<Channel, maxNumChannels> channels;
+    // in double precision, a float gets stuck a few samples before the target (the steps get smaller than its precision)
+    double smoothedDelaySamples = 1.0;
+    double smoothingCoefficient = 1.0;
+    bool shouldJumpToTargetDelay = true;
+
+
+    [[nodiscard]] double getTargetDelaySamples() const noexcept
+    {
+        auto maxDelaySamples = maxDelaySeconds * sampleRate;
+        return juce::jlimit (1.0, maxDelaySamples, beatsToSamples (parameters.delayBeats));
+    }
+};
+
+// ===================================================================================================
+
+// Base for the chorus and flanger: a delay that is modulated by a sine lfo, with the lfo period in beats.
+// The right channel gets a quarter cycle phase offset, which widens the stereo image.
+class ModulatedDelay : public TempoSyncedEffect
+{
+public:
+    struct Parameters
+    {
+        double lfoPeriodBeats;
+        float centreDelayMs;
+        float depthMs;
+        float feedback;
+        float wetLevel;
+        float dryLevel;
+    };
+
+    ModulatedDelay (const PlayHead& playHead, const Parameters& params)
+        : TempoSyncedEffect { playHead }, parameters { params }
+    {}
+
+    void prepareToPlay (double newSampleRate, int maximumExpectedSamplesPerBlock) override
+    {
+        TempoSyncedEffect::prepareToPlay (newSampleRate, maximumExpectedSamplesPerBlock);
+        allocateBuffers (maximumExpectedSamplesPerBlock);
+        lfoPhase = 0.0;
+    }
+
+    void releaseResources() override
+    {
+        for (auto& delayLine : delayLines)
+            delayLine.reset();
+    }
+
+protected:
+    static constexpr auto maxNumChannels = 2;
+
+    Parameters parameters;
+    std::array<DelayLine<float>, maxNumChannels> delayLines;
+    std::vector<float> delays;
+    int maxBlockSize = 0;
+
+
+    void allocateBuffers (int blockSize)
+    {
+        maxBlockSize = blockSize;
+        delays.resize ((size_t) blockSize);
+
+        auto maxDelayMs = parameters.centreDelayMs + parameters.depthMs;
+        auto maxDelaySamples = (int) std::ceil (maxDelayMs * sampleRate / 1000.0) + 1;
+
+        for (auto& delayLine : delayLines)
+            delayLine.setMaximumDelaySamples (maxDelaySamples, blockSize);
+    }
+
+    // fills the delays (in samples) for every sample of the block, for the given channel
+    void computeDelays (int channel, int numSamples)
+    {
+        const auto msToSamples = sampleRate / 1000.0;
+        const auto centre = parameters.centreDelayMs * msToSamples;
+        const auto depth = parameters.depthMs * msToSamples;
+        const auto phaseIncrement = 1.0 / beatsToSamples (parameters.lfoPeriodBeats);
+        const auto startPhase = lfoPhase + channel * 0.25;
+
+        for (auto i = 0; i < numSamples; ++i)
+        {
+            auto phase = startPhase + i * phaseIncrement;
+            delays[(size_t) i] = (float) (centre + depth * std::sin (juce::MathConstants<double>::twoPi * phase));
+        }
+    }
+
+    void advanceLfo (int numSamples)
+    {
+        lfoPhase += numSamples / beatsToSamples (parameters.lfoPeriodBeats);
+        lfoPhase -= std::floor (lfoPhase);
+    }
+
+    void ensureBlockSize (int numSamples)
+    {
+        // should be prepared with a big enough block size, otherwise this allocates on the audio thread
+        jassert (numSamples <= maxBlockSize);
+
+        if (numSamples > maxBlockSize)
+            allocateBuffers (numSamples);
+    }
+
+private:
+    double lfoPhase = 0.0;
+};
+
+// ===================================================================================================
+
+// Chorus has no feedback, so a whole block is written to the delay line at once and read back
+// with the (vectorisable) block read, using Lagrange interpolation since the delay is always moving.
+class Chorus : public ModulatedDelay
+{
+public:
+    static constexpr auto defaultParameters = Parameters { 2.0, 15.0f, 5.0f, 0.0f, 0.5f, 1.0f };
+
+    explicit Chorus (const PlayHead& playHead, const Parameters& params = defaultParameters)
+        : ModulatedDelay { playHead, params }
+    {}
+
+    void prepareToPlay (double newSampleRate, int maximumExpectedSamplesPerBlock) override
+    {
+        ModulatedDelay::prepareToPlay (newSampleRate, maximumExpectedSamplesPerBlock);
+        wetBuffer.resize ((size_t) maxBlockSize);
+    }
+
+    void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
+    {
+        const auto numSamples = buffer.getNumSamples();
+        const auto numChannels = std::min (buffer.getNumChannels(), maxNumChannels);
+
+        ensureBlockSize (numSamples);
+        updateTempo();
+        wetBuffer.resize ((size_t) maxBlockSize);
+
+        for (auto channel = 0; channel < numChannels; ++channel)
+        {
+            auto* samples = buffer.getWritePointer (channel);
+            auto& delayLine = delayLines[(size_t) channel];
+
+            computeDelays (channel, numSamples);
+            delayLine.writeBlock (samples, numSamples);
+            delayLine.readLagrangeBlock (delays.data(), wetBuffer.data(), numSamples);
+
+            juce::FloatVectorOperations::multiply (samples, parameters.dryLevel, numSamples);
+            juce::FloatVectorOperations::addWithMultiply (samples, wetBuffer.data(), parameters.wetLevel, numSamples);
+        }
+
+        advanceLfo (numSamples);
+    }
+
+    [[nodiscard]] double getTailLengthSeconds() const override
+    {
+        return (parameters.centreDelayMs + parameters.depthMs) / 1000.0;
+    }
+
+private:
+    std::vector<float> wetBuffer;
+};
+
+// ===================================================================================================
+
+// Flanger has feedback, so it's rendered per sample. The delays are short (a few ms),
+// which is what gives the comb filter sweep.
+class Flanger : public ModulatedDelay
+{
+public:
+    static constexpr auto defaultParameters = Parameters { 8.0, 2.5f, 2.0f, 0.5f, 0.7f, 0.7f };
+
+    explicit Flanger (const PlayHead& playHead, const Parameters& params = defaultParameters)
+        : ModulatedDelay { playHead, params }
+    {}
+
+    void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
+    {
+        const auto numSamples = buffer.getNumSamples();
+        const auto numChannels = std::min (buffer.getNumChannels(), maxNumChannels);
+
+        ensureBlockSize (numSamples);
+        updateTempo();
+
+        for (auto channel = 0; channel < numChannels; ++channel)
+        {
+            auto* samples = buffer.getWritePointer (channel);
+            auto& delayLine = delayLines[(size_t) channel];
+
+            computeDelays (channel, numSamples);
+
+            for (auto i = 0; i < numSamples; ++i)
+            {
+                auto delayed = delayLine.readLinear (delays[(size_t) i] - 1.0f);
+                delayLine.write (samples[i] + delayed * parameters.feedback);
+                samples[i] = samples[i] * parameters.dryLevel + delayed * parameters.wetLevel;
+            }
+        }
+
+        advanceLfo (numSamples);
+    }
+
+    [[nodiscard]] double getTailLengthSeconds() const override
+    {
+        return feedbackDecaySeconds ((parameters.centreDelayMs + parameters.depthMs) / 1000.0, parameters.feedback);
+    }
+};
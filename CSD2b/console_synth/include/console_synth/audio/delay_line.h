@@ -0,0 +1,181 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <juce_core/juce_core.h>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/* Circular buffer for delay based effects. The size is always a power of two, so wrapping an index is a single
+ * bitwise and (index & mask) instead of a branch or modulo. The storage starts at a cache line boundary.
+ *
+ * Delays are in samples and are always relative to the most recently written sample: a delay of 0 reads the sample
+ * that was written last. There are two ways of using it:
+ *  - per sample: write() a sample, then read it back with any of the read functions (needed for feedback loops)
+ *  - per block: writeBlock() a whole block, then read it back with the block read functions, where delay[i]
+ *    is relative to sample i of that block. These are simple branchless loops, so the compiler can vectorise them.
+ *    This only works without feedback, since the whole input block has to be known in advance.
+ *
+ * For fractional delays there is linear and (3rd order) Lagrange interpolation, which can both be modulated,
+ * and allpass interpolation, which has a flat frequency response, but has state and should only be used
+ * for (nearly) constant delays, like in a feedback loop.
+ * */
+
+template <typename FloatType>
+class DelayLine
+{
+public:
+    static_assert (std::is_floating_point_v<FloatType>, "delay line requires a floating point type");
+
+    // the state of an allpass interpolated read, every read position needs its own
+    struct AllpassState
+    {
+        FloatType previousOutput = 0;
+    };
+
+    // allocates memory, so don't call from the audio thread
+    void setMaximumDelaySamples (int maximumDelaySamples, int maximumBlockSize = 1)
+    {
+        // 3 extra samples for the interpolation taps
+        auto size = juce::nextPowerOfTwo (maximumDelaySamples + maximumBlockSize + 3);
+        mask = (uint64_t) size - 1;
+        maxDelay = maximumDelaySamples;
+
+        storage.assign ((size_t) size + cacheLineSize / sizeof (FloatType), FloatType (0));
+
+        void* start = storage.data();
+        auto space = storage.size() * sizeof (FloatType);
+        buffer = static_cast<FloatType*> (std::align (cacheLineSize, (size_t) size * sizeof (FloatType), start, space));
+
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill (storage.begin(), storage.end(), FloatType (0));
+        writePosition = 0;
+    }
+
+    [[nodiscard]] int getMaximumDelaySamples() const noexcept { return maxDelay; }
+
+    // ===============================================================================================
+
+    void write (FloatType sample) noexcept
+    {
+        buffer[writePosition & mask] = sample;
+        ++writePosition;
+    }
+
+    void writeBlock (const FloatType* samples, int numSamples) noexcept
+    {
+        for (auto i = 0; i < numSamples; ++i)
+            buffer[(writePosition + (uint64_t) i) & mask] = samples[i];
+
+        writePosition += (uint64_t) numSamples;
+    }
+
+    // ===============================================================================================
+
+    [[nodiscard]] FloatType read (int delay) const noexcept
+    {
+        return sampleAt (writePosition - 1 - (uint64_t) delay);
+    }
+
+    [[nodiscard]] FloatType readLinear (FloatType delay) const noexcept
+    {
+        return interpolateLinear (writePosition - 1, delay);
+    }
+
+    // needs a delay of at least 1 sample, since it uses one tap on each side of the read position
+    [[nodiscard]] FloatType readLagrange (FloatType delay) const noexcept
+    {
+        return interpolateLagrange (writePosition - 1, delay);
+    }
+
+    [[nodiscard]] FloatType readAllpass (FloatType delay, AllpassState& state) const noexcept
+    {
+        auto wholeDelay = (uint64_t) delay;
+        auto fraction = delay - (FloatType) wholeDelay;
+        auto position = writePosition - 1 - wholeDelay;
+
+        auto newer = sampleAt (position);
+        auto older = sampleAt (position - 1);
+        auto coefficient = (1 - fraction) / (1 + fraction);
+
+        state.previousOutput = older + coefficient * (newer - state.previousOutput);
+        return state.previousOutput;
+    }
+
+    // ===============================================================================================
+
+    // reads back the last written block, output[i] is read with a delay of delays[i] relative to sample i
+    void readLinearBlock (const FloatType* delays, FloatType* output, int numSamples) const noexcept
+    {
+        auto blockStart = writePosition - (uint64_t) numSamples;
+
+        for (auto i = 0; i < numSamples; ++i)
+            output[i] = interpolateLinear (blockStart + (uint64_t) i, delays[i]);
+    }
+
+    void readLagrangeBlock (const FloatType* delays, FloatType* output, int numSamples) const noexcept
+    {
+        auto blockStart = writePosition - (uint64_t) numSamples;
+
+        for (auto i = 0; i < numSamples; ++i)
+            output[i] = interpolateLagrange (blockStart + (uint64_t) i, delays[i]);
+    }
+
+private:
+    static constexpr size_t cacheLineSize = 64;
+
+    std::vector<FloatType> storage;
+    FloatType* buffer = nullptr;
+    uint64_t mask = 0;
+    uint64_t writePosition = 0;
+    int maxDelay = 0;
+
+
+    [[nodiscard]] FloatType sampleAt (uint64_t position) const noexcept
+    {
+        return buffer[position & mask];
+    }
+
+    [[nodiscard]] FloatType interpolateLinear (uint64_t position, FloatType delay) const noexcept
+    {
+        auto wholeDelay = (uint64_t) delay;
+        auto fraction = delay - (FloatType) wholeDelay;
+        position -= wholeDelay;
+
+        auto newer = sampleAt (position);
+        auto older = sampleAt (position - 1);
+        return newer + fraction * (older - newer);
+    }
+
+    // 3rd order Lagrange through 4 taps, one newer and two older than the read position.
+    // t is the position between the taps (counted from the newest one) and lies in [1, 2)
+    [[nodiscard]] FloatType interpolateLagrange (uint64_t position, FloatType delay) const noexcept
+    {
+        auto wholeDelay = (uint64_t) delay;
+        auto t = delay - (FloatType) wholeDelay + 1;
+        position -= wholeDelay - 1;
+
+        auto y0 = sampleAt (position);
+        auto y1 = sampleAt (position - 1);
+        auto y2 = sampleAt (position - 2);
+        auto y3 = sampleAt (position - 3);
+
+        auto d1 = t - 1;
+        auto d2 = t - 2;
+        auto d3 = t - 3;
+
+        auto c0 = -d1 * d2 * d3 / 6;
+        auto c1 = d2 * d3 / 2;
+        auto c2 = -d1 * d3 / 2;
+        auto c3 = d1 * d2 / 6;
+
+        return y0 * c0 + t * (y1 * c1 + y2 * c2 + y3 * c3);
+    }
+};
@@ -0,0 +1,210 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include "audio_processor_base.h"
+#include <numeric>
+#include <vector>
+
+// ===================================================================================================
+
+// Maximum of the last N values that were pushed, using a monotonic deque: values that are smaller than a newer
+// value can never become the maximum anymore, so they are dropped. This makes it O(1) (amortised) per value.
+// The deque is a fixed size ring buffer, so it never allocates after setWindowSize().
+class SlidingWindowMax
+{
+public:
+    void setWindowSize (int size)
+    {
+        windowSize = (uint64_t) std::max (size, 1);
+        auto capacity = (size_t) juce::nextPowerOfTwo ((int) windowSize + 1);
+        values.resize (capacity);
+        positions.resize (capacity);
+        mask = capacity - 1;
+        reset();
+    }
+
+    void reset()
+    {
+        head = tail = numPushed = 0;
+    }
+
+    // adds the value to the window and returns the maximum of the window
+    float push (float value) noexcept
+    {
+        while (tail != head && values[(tail - 1) & mask] <= value)
+            --tail;
+
+        values[tail & mask] = value;
+        positions[tail & mask] = numPushed;
+        ++tail;
+
+        if (positions[head & mask] + windowSize <= numPushed)
+            ++head;
+
+        ++numPushed;
+        return values[head & mask];
+    }
+
+private:
+    std::vector<float> values;
+    std::vector<uint64_t> positions;
+    uint64_t windowSize = 1;
+    uint64_t mask = 0;
+    uint64_t head = 0;
+    uint64_t tail = 0;
+    uint64_t numPushed = 0;
+};
+
+// ===================================================================================================
+
+/* Brickwall limiter with lookahead, meant for the master bus. The signal is delayed by the lookahead time,
+ * so the gain can already go down before a peak comes out. The gain computation goes as follows:
+ *  - the peak of all channels is taken per sample and the maximum over the lookahead window is
+ *    found with the SlidingWindowMax, this gives the gain needed to keep every sample in the window under the ceiling
+ *  - the gain is allowed to drop instantly, but it can only recover with the release time
+ *  - that gain is smoothed with a moving average over the lookahead window, since every gain within that
+ *    window is low enough for the peak that's about to come out, the average is low enough as well
+ * After that, the gain is applied to the delayed signal with vector operations.
+ * */
+
+class Limiter : public AudioProcessorBase
+{
+public:
+    explicit Limiter (double lookaheadMs = 5.0, float ceilingDecibels = -0.3f, double releaseMs = 100.0)
+        : lookaheadMs { lookaheadMs }, releaseMs { releaseMs }
+    {
+        setCeilingDecibels (ceilingDecibels);
+    }
+
+    void prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock) override
+    {
+        lookaheadSamples = std::max (1, (int) std::round (lookaheadMs * sampleRate / 1000.0));
+        releaseCoefficient = (float) (1.0 - std::exp (-1.0 / (releaseMs * sampleRate / 1000.0)));
+
+        allocateBuffers (maximumExpectedSamplesPerBlock);
+        reset();
+    }
+
+    void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
+    {
+        const auto numSamples = buffer.getNumSamples();
+        const auto numChannels = std::min (buffer.getNumChannels(), maxNumChannels);
+
+        // should be prepared with a big enough block size, otherwise this allocates on the audio thread
+        jassert (numSamples <= maxBlockSize);
+
+        if (numSamples > maxBlockSize)
+            allocateBuffers (numSamples);
+
+        computeGains (buffer, numChannels, numSamples);
+
+        for (auto channel = 0; channel < numChannels; ++channel)
+        {
+            auto* delayed = delayBuffers[channel].data();
+            auto* samples = buffer.getWritePointer (channel);
+
+            // the delay buffer holds the last lookahead samples of the previous block, followed by the new block
+            juce::FloatVectorOperations::copy (delayed + lookaheadSamples, samples, numSamples);
+            juce::FloatVectorOperations::multiply (samples, delayed, gains.data(), numSamples);
+            std::memmove (delayed, delayed + numSamples, sizeof (float) * (size_t) lookaheadSamples);
+        }
+    }
+
+    void releaseResources() override
+    {
+        reset();
+    }
+
+    [[nodiscard]] int getLatencySamples() const override
+    {
+        return lookaheadSamples;
+    }
+
+    [[nodiscard]] double getTailLengthSeconds() const override
+    {
+        return lookaheadMs / 1000.0;
+    }
+
+    void setCeilingDecibels (float decibels)
+    {
+        ceiling = juce::Decibels::decibelsToGain (decibels);
+    }
+
+    // takes effect at the next prepareToPlay(), since the latency changes with it
+    void setLookaheadMs (double newLookaheadMs)
+    {
+        lookaheadMs = newLookaheadMs;
+    }
+
+private:
+    static constexpr auto maxNumChannels = 2;
+
+    double lookaheadMs;
+    double releaseMs;
+    float ceiling = 1.0f;
+    float releaseCoefficient = 0.0f;
+    int lookaheadSamples = 0;
+    int maxBlockSize = 0;
+
+    SlidingWindowMax peakWindow;
+    std::vector<float> gainHistory;
+    double gainHistorySum = 0;
+    int gainHistoryIndex = 0;
+    float releasedGain = 1.0f;
+
+    std::vector<float> gains;
+    std::array<std::vector<float>, maxNumChannels> delayBuffers;
+
+
+    void allocateBuffers (int blockSize)
+    {
+        maxBlockSize = blockSize;
+        gains.resize ((size_t) blockSize);
+
+        for (auto& delayBuffer : delayBuffers)
+            delayBuffer.resize ((size_t) (blockSize + lookaheadSamples));
+    }
+
+    void reset()
+    {
+        peakWindow.setWindowSize (lookaheadSamples + 1);
+        gainHistory.assign ((size_t) lookaheadSamples + 1, 1.0f);
+        gainHistorySum = (double) gainHistory.size();
+        gainHistoryIndex = 0;
+        releasedGain = 1.0f;
+
+        for (auto& delayBuffer : delayBuffers)
+            std::fill (delayBuffer.begin(), delayBuffer.end(), 0.0f);
+    }
+
+    void computeGains (const juce::AudioBuffer<float>& buffer, int numChannels, int numSamples)
+    {
+        for (auto i = 0; i < numSamples; ++i)
+        {
+            auto peak = 0.0f;
+
+            for (auto channel = 0; channel < numChannels; ++channel)
+                peak = std::max (peak, std::abs (buffer.getReadPointer (channel)[i]));
+
+            auto windowPeak = peakWindow.push (peak);
+            auto targetGain = windowPeak > ceiling ? ceiling / windowPeak : 1.0f;
+
+            if (targetGain < releasedGain)
+                releasedGain = targetGain;
+            else
+                releasedGain += (targetGain - releasedGain) * releaseCoefficient;
+
+            // moving average over the lookahead window
+            gainHistorySum += releasedGain - gainHistory[(size_t) gainHistoryIndex];
+            gainHistory[(size_t) gainHistoryIndex] = releasedGain;
+            gainHistoryIndex = (gainHistoryIndex + 1) % (int) gainHistory.size();
+
+            // recalculate the sum once per window, so rounding errors can't build up
+            if (gainHistoryIndex == 0)
+                gainHistorySum = std::accumulate (gainHistory.begin(), gainHistory.end(), 0.0);
+
+            gains[(size_t) i] = (float) (gainHistorySum / (double) gainHistory.size());
+        }
+    }
+};
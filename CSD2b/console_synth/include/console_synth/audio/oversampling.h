@@ -0,0 +1,294 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include "audio_processor_base.h"
+#include "delay_line.h"
+#include <array>
+#include <cmath>
+#include <vector>
+
+/* Block based oversampling for nonlinear effects. The signal is upsampled by zero stuffing followed by a
+ * windowed sinc low pass filter, and downsampled by filtering with that same low pass and keeping every
+ * Factor'th sample. Both are done in polyphase form: when upsampling, all the zeros are skipped, so every output
+ * sample only needs TapsPerPhase multiplications, and when downsampling only the samples that are kept are computed.
+ *
+ * The filter is linear phase with an order of Factor * TapsPerPhase, so the latency of the up and down
+ * filter together is exactly TapsPerPhase samples (at the original rate). It's a Kaiser windowed sinc that rejects
+ * everything from the original nyquist frequency on by 80 dB (so the images of the upsampling and the harmonics
+ * the effect creates don't alias back), the more taps, the shorter the transition band below nyquist.
+ * With the default 96 taps per phase, the transition band starts a little below 0.45 times the original sample rate
+ * (at 44.1 kHz, up and down together take off less than 0.2 dB at 20 kHz).
+ *
+ * The filters keep their history in a linear buffer in front of the block, so every output sample is
+ * a dot product over contiguous memory, which the compiler can vectorise.
+ * */
+
+template <int Factor, int TapsPerPhase = 96>
+class PolyphaseOversampler
+{
+public:
+    static_assert (Factor >= 2, "oversampling factor should be at least 2");
+
+    PolyphaseOversampler()
+    {
+        designFilter();
+    }
+
+    // allocates, so don't call from the audio thread
+    void prepare (int maximumBlockSize)
+    {
+        maxBlockSize = maximumBlockSize;
+        upsamplerInput.assign ((size_t) (upsamplerHistorySize + maximumBlockSize), 0.0f);
+        downsamplerInput.assign ((size_t) (downsamplerHistorySize + maximumBlockSize * Factor), 0.0f);
+    }
+
+    void reset()
+    {
+        std::fill (upsamplerInput.begin(), upsamplerInput.end(), 0.0f);
+        std::fill (downsamplerInput.begin(), downsamplerInput.end(), 0.0f);
+    }
+
+    // output should have room for numSamples * Factor samples
+    void upsample (const float* input, float* output, int numSamples) noexcept
+    {
+        jassert (numSamples <= maxBlockSize);
+
+        auto* history = upsamplerInput.data();
+        std::copy (input, input + numSamples, history + upsamplerHistorySize);
+
+        for (auto n = 0; n < numSamples; ++n)
+            for (auto phase = 0; phase < Factor; ++phase)
+                output[n * Factor + phase] = dotProduct (history + n, upsamplerPhases[(size_t) phase].data(), tapsPerPhase);
+
+        std::copy (history + numSamples, history + numSamples + upsamplerHistorySize, history);
+    }
+
+    // input should contain numSamples * Factor samples
+    void downsample (const float* input, float* output, int numSamples) noexcept
+    {
+        jassert (numSamples <= maxBlockSize);
+
+        auto* history = downsamplerInput.data();
+        auto numOversampledSamples = numSamples * Factor;
+        std::copy (input, input + numOversampledSamples, history + downsamplerHistorySize);
+
+        for (auto n = 0; n < numSamples; ++n)
+            output[n] = dotProduct (history + n * Factor + (Factor - 1), downsamplerCoefficients.data(), numTaps - Factor + 1);
+
+        std::copy (history + numOversampledSamples, history + numOversampledSamples + downsamplerHistorySize, history);
+    }
+
+    [[nodiscard]] static constexpr int getLatencySamples() noexcept
+    {
+        return TapsPerPhase;
+    }
+
+private:
+    // one extra tap per phase, since the filter has an odd length (an even order), so it has an integer delay
+    static constexpr auto tapsPerPhase = TapsPerPhase + 1;
+    static constexpr auto numTaps = Factor * tapsPerPhase;
+    static constexpr auto filterOrder = Factor * TapsPerPhase;
+    static constexpr auto upsamplerHistorySize = tapsPerPhase - 1;
+    static constexpr auto downsamplerHistorySize = numTaps - 1;
+
+    // the coefficients are stored reversed, so they can be multiplied with the input in memory order
+    std::array<std::array<float, tapsPerPhase>, Factor> upsamplerPhases {};
+    std::array<float, numTaps> downsamplerCoefficients {};
+
+    std::vector<float> upsamplerInput;
+    std::vector<float> downsamplerInput;
+    int maxBlockSize = 0;
+
+
+    static float dotProduct (const float* a, const float* b, int size) noexcept
+    {
+        auto sum = 0.0f;
+
+        for (auto i = 0; i < size; ++i)
+            sum += a[i] * b[i];
+
+        return sum;
+    }
+
+    // the zeroth order modified bessel function of the first kind (its power series), for the kaiser window
+    static double besselI0 (double x)
+    {
+        auto sum = 1.0;
+        auto term = 1.0;
+
+        for (auto k = 1; k < 50 && term > sum * 1.0e-12; ++k)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+
+        return sum;
+    }
+
+    // kaiser windowed sinc, the stop band starts at the original nyquist frequency (the design formulas of Kaiser)
+    void designFilter()
+    {
+        constexpr auto stopBandDecibels = 80.0;
+        const auto beta = 0.1102 * (stopBandDecibels - 8.7);
+        const auto pi = juce::MathConstants<double>::pi;
+
+        // the width of the transition band (as a fraction of the oversampled rate) the order allows for
+        const auto transitionWidth = (stopBandDecibels - 7.95) / (14.36 * filterOrder);
+        const auto cutoff = 0.5 / Factor - transitionWidth / 2.0;
+
+        auto coefficients = std::array<double, numTaps> {};
+        const auto centre = filterOrder / 2.0;
+        auto sum = 0.0;
+
+        for (auto i = 0; i <= filterOrder; ++i)
+        {
+            auto x = i - centre;
+            auto sinc = x == 0.0 ? 2.0 * cutoff : std::sin (2.0 * pi * cutoff * x) / (pi * x);
+            auto ratio = x / centre;
+            auto window = besselI0 (beta * std::sqrt (1.0 - ratio * ratio)) / besselI0 (beta);
+            coefficients[(size_t) i] = sinc * window;
+            sum += coefficients[(size_t) i];
+        }
+
+        for (auto& c : coefficients)
+            c /= sum;
+
+        // downsampling: y[n] = sum h[i] * x[n * Factor - i], only the first filterOrder + 1 taps are non zero
+        for (auto i = 0; i <= filterOrder; ++i)
+            downsamplerCoefficients[(size_t) (filterOrder - i)] = (float) coefficients[(size_t) i];
+
+        // upsampling: phase p uses the taps p, p + Factor, p + 2 * Factor etc. and a gain of Factor to
+        // make up for the energy lost to the zeros
+        for (auto phase = 0; phase < Factor; ++phase)
+            for (auto j = 0; j < tapsPerPhase; ++j)
+                upsamplerPhases[(size_t) phase][(size_t) (tapsPerPhase - 1 - j)] = (float) (Factor * coefficients[(size_t) (j * Factor + phase)]);
+    }
+};
+
+// ===================================================================================================
+
+/* Runs the wrapped processor at Factor times the sample rate. This is meant for nonlinear effects
+ * (saturation, waveshaping etc.), which create harmonics above nyquist that would otherwise alias back.
+ * Unlike AntiAliased (which runs a whole filter per output sample of an oscillator), this works on whole blocks
+ * in preallocated buffers. The wrapped processor gets an empty midi buffer, since the timestamps wouldn't match.
+ * When it's bypassed, the signal isn't filtered at all, it's only delayed by the latency (so the latency never changes).
+ * */
+
+template <typename Processor, int Factor = 4>
+class Oversampled : public AudioProcessorBase
+{
+public:
+    template <typename... Args>
+    explicit Oversampled (Args&&... args) : processor (std::forward<Args> (args)...)
+    {}
+
+    void prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock) override
+    {
+        maxBlockSize = maximumExpectedSamplesPerBlock;
+        processor.prepareToPlay (sampleRate * Factor, maximumExpectedSamplesPerBlock * Factor);
+        oversampledBuffer.setSize (maxNumChannels, maximumExpectedSamplesPerBlock * Factor);
+
+        for (auto& oversampler : oversamplers)
+            oversampler.prepare (maximumExpectedSamplesPerBlock);
+
+        for (auto& delayLine : bypassDelayLines)
+            delayLine.setMaximumDelaySamples (getLatencySamples());
+    }
+
+    void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
+    {
+        const auto numSamples = buffer.getNumSamples();
+        const auto numChannels = std::min (buffer.getNumChannels(), maxNumChannels);
+
+        // should be prepared with a big enough block size, the oversampling buffers can't grow on the audio thread
+        jassert (numSamples <= maxBlockSize);
+
+        // the input always goes through the delay lines, so they're up to date when the bypass is turned on
+        for (auto channel = 0; channel < numChannels; ++channel)
+        {
+            auto* samples = buffer.getWritePointer (channel);
+            auto& delayLine = bypassDelayLines[(size_t) channel];
+            const auto latency = getLatencySamples();
+
+            for (auto i = 0; i < numSamples; ++i)
+            {
+                delayLine.write (samples[i]);
+
+                if (isBypassed)
+                    samples[i] = delayLine.read (latency);
+            }
+        }
+
+        if (isBypassed)
+            return;
+
+        oversampledBuffer.setSize (numChannels, numSamples * Factor, false, false, true);
+
+        for (auto channel = 0; channel < numChannels; ++channel)
+            oversamplers[(size_t) channel].upsample (buffer.getReadPointer (channel),
+                                                     oversampledBuffer.getWritePointer (channel),
+                                                     numSamples);
+
+        processor.processBlock (oversampledBuffer, emptyMidiBuffer);
+
+        for (auto channel = 0; channel < numChannels; ++channel)
+            oversamplers[(size_t) channel].downsample (oversampledBuffer.getReadPointer (channel),
+                                                       buffer.getWritePointer (channel),
+                                                       numSamples);
+    }
+
+    void releaseResources() override
+    {
+        processor.releaseResources();
+
+        for (auto& oversampler : oversamplers)
+            oversampler.reset();
+
+        for (auto& delayLine : bypassDelayLines)
+            delayLine.reset();
+    }
+
+    // Audio thread only. The filters don't run while bypassed, so when it's turned on again
+    // they start from silence, which gives a short fade in.
+    void setBypassed (bool shouldBeBypassed) noexcept
+    {
+        if (isBypassed && ! shouldBeBypassed)
+            for (auto& oversampler : oversamplers)
+                oversampler.reset();
+
+        isBypassed = shouldBeBypassed;
+    }
+
+    [[nodiscard]] bool isIdle() const override
+    {
+        return processor.isIdle();
+    }
+
+    [[nodiscard]] double getTailLengthSeconds() const override
+    {
+        return processor.getTailLengthSeconds();
+    }
+
+    [[nodiscard]] int getLatencySamples() const override
+    {
+        return PolyphaseOversampler<Factor>::getLatencySamples() + processor.getLatencySamples() / Factor;
+    }
+
+    [[nodiscard]] Processor& getProcessor() noexcept
+    {
+        return processor;
+    }
+
+private:
+    static constexpr auto maxNumChannels = 2;
+
+    Processor processor;
+    std::array<PolyphaseOversampler<Factor>, maxNumChannels> oversamplers;
+    juce::AudioBuffer<float> oversampledBuffer;
+    juce::MidiBuffer emptyMidiBuffer;
+    int maxBlockSize = 0;
+
+    std::array<DelayLine<float>, maxNumChannels> bypassDelayLines;
+    bool isBypassed = false;
+};
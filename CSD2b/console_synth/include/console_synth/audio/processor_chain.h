@@ -1,28 +1,58 @@
-
 // Written by Wouter Ensink
 
 #pragma once
 
 #include <console_synth/audio/audio_processor_base.h>
+#include <limits>
 
+/* A root instrument followed by a series of effects. The chain keeps track of silence:
+ * when the root instrument is idle and there is no midi, the instrument isn't rendered at all,
+ * and the effects only keep running until their (combined) tail has decayed. After that the
+ * whole chain reports itself as idle, so the owner can skip it entirely.
+ * Without a root instrument (e.g. on an effect bus), silence is detected by looking at the input buffer.
+ * */
 
 class ProcessorChain : public AudioProcessorBase
 {
 public:
-    explicit ProcessorChain (AudioProcessorBase& rootInstrument) : rootInstrument (rootInstrument) {}
+    ProcessorChain() = default;
+
+    explicit ProcessorChain (AudioProcessorBase& rootInstrument) : rootInstrument (&rootInstrument) {}
 
     void prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock) override
     {
-        rootInstrument.prepareToPlay (sampleRate, maximumExpectedSamplesPerBlock);
+        currentSampleRate = sampleRate;
+
+        if (rootInstrument != nullptr)
+            rootInstrument->prepareToPlay (sampleRate, maximumExpectedSamplesPerBlock);
 
         std::for_each (effects.begin(), effects.end(), [&] (auto& e) {
             e->prepareToPlay (sampleRate, maximumExpectedSamplesPerBlock);
         });
+
+        remainingTailSamples = 0;
     }
 
     void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages) override
     {
-        rootInstrument.processBlock (buffer, midiMessages);
+        const auto numSamples = buffer.getNumSamples();
+        const auto inputIsSilent = midiMessages.isEmpty() && isInputSilent (buffer);
+
+        if (inputIsSilent)
+        {
+            // the effect tails have decayed completely, so there's nothing left to render
+            if (remainingTailSamples <= 0)
+                return;
+
+            remainingTailSamples -= numSamples;
+        }
+        else
+        {
+            remainingTailSamples = getTailLengthSamples();
+
+            if (rootInstrument != nullptr)
+                rootInstrument->processBlock (buffer, midiMessages);
+        }
 
         std::for_each (effects.begin(), effects.end(), [&] (auto& e) {
             e->processBlock (buffer, midiMessages);
@@ -31,20 +61,75 @@ public:
 
     void releaseResources() override
     {
-        rootInstrument.releaseResources();
+        if (rootInstrument != nullptr)
+            rootInstrument->releaseResources();
 
         std::for_each (effects.begin(), effects.end(), [] (auto& e) {
             e->releaseResources();
         });
     }
 
+    [[nodiscard]] bool isIdle() const override
+    {
+        auto rootIsIdle = rootInstrument == nullptr || rootInstrument->isIdle();
+        return rootIsIdle && remainingTailSamples <= 0;
+    }
+
+    // the effects are in series, so the tail of the chain is the sum of the tails of all effects
+    [[nodiscard]] double getTailLengthSeconds() const override
+    {
+        auto tail = 0.0;
+
+        for (auto& e : effects)
+            tail += e->getTailLengthSeconds();
+
+        return tail;
+    }
+
+    [[nodiscard]] int getLatencySamples() const override
+    {
+        auto latency = 0;
+
+        for (auto& e : effects)
+            latency += e->getLatencySamples();
+
+        return latency;
+    }
+
     template <typename EffectType>
     void addEffectToChain (std::unique_ptr<EffectType> effect)
     {
         effects.push_back (std::move (effect));
     }
 
+    // make sure the chain isn't processing while calling this (the root instrument will not be prepared)
+    void setRootInstrument (AudioProcessorBase& newRootInstrument)
+    {
+        rootInstrument = &newRootInstrument;
+    }
+
 private:
-    AudioProcessorBase& rootInstrument;
+    AudioProcessorBase* rootInstrument = nullptr;
     std::vector<std::unique_ptr<AudioProcessorBase>> effects;
+    double currentSampleRate = 44100.0;
+    juce::int64 remainingTailSamples = 0;
+
+
+    [[nodiscard]] bool isInputSilent (const juce::AudioBuffer<float>& buffer) const
+    {
+        if (rootInstrument != nullptr)
+            return rootInstrument->isIdle();
+
+        return buffer.getMagnitude (0, buffer.getNumSamples()) < silenceThreshold;
+    }
+
+    [[nodiscard]] juce::int64 getTailLengthSamples() const
+    {
+        auto tailSamples = getTailLengthSeconds() * currentSampleRate;
+
+        if (tailSamples >= (double) std::numeric_limits<juce::int64>::max())
+            return std::numeric_limits<juce::int64>::max();
+
+        return (juce::int64) std::ceil (tailSamples);
+    }
 };
@@ -5,14 +5,14 @@
 
 #include "audio_processor_base.h"
 #include <juce_audio_processors/juce_audio_processors.h>
+#include <limits>
 
 
 class Reverb : public AudioProcessorBase
 {
 public:
-    Reverb()
+    explicit Reverb (const juce::Reverb::Parameters& params = {})
     {
-        auto params = juce::Reverb::Parameters {};
         reverb.setParameters (params);
     }
 
@@ -35,6 +35,21 @@ public:
         reverb.reset();
     }
 
+    // estimate based on the feedback of the longest comb filter inside the juce (freeverb) reverb:
+    // the number of passes through that comb it takes to get below the silence threshold
+    [[nodiscard]] double getTailLengthSeconds() const override
+    {
+        const auto& params = reverb.getParameters();
+
+        if (params.freezeMode >= 0.5f)
+            return std::numeric_limits<double>::infinity();
+
+        const auto longestCombSeconds = 1617.0 / 44100.0;
+        const auto feedback = params.roomSize * 0.28 + 0.7;
+        const auto numPasses = std::log (silenceThreshold) / std::log (feedback);
+        return numPasses * longestCombSeconds;
+    }
+
 private:
     juce::Reverb reverb;
 };
\ No newline at end of file
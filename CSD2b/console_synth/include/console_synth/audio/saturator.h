@@ -0,0 +1,54 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include "audio_processor_base.h"
+#include "oversampling.h"
+#include <cmath>
+
+/* Tanh waveshaper. The drive pushes the signal further into the curve, the bias makes the curve asymmetric,
+ * which adds even harmonics. The bias is removed again afterwards, so silence stays silent.
+ * The output is scaled down by the drive, so a full scale input still comes out at (about) full scale.
+ * This creates harmonics far above nyquist, so use it through OversampledSaturator.
+ * */
+
+class Saturator : public AudioProcessorBase
+{
+public:
+    explicit Saturator (float driveDecibels = 12.0f, float bias = 0.0f, float mix = 1.0f)
+        : bias { bias }, mix { mix }
+    {
+        setDriveDecibels (driveDecibels);
+    }
+
+    void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
+    {
+        const auto numSamples = buffer.getNumSamples();
+        const auto offset = std::tanh (bias);
+        const auto makeUpGain = 1.0f / std::tanh (drive);
+
+        for (auto channel = 0; channel < buffer.getNumChannels(); ++channel)
+        {
+            auto* samples = buffer.getWritePointer (channel);
+
+            for (auto i = 0; i < numSamples; ++i)
+            {
+                auto shaped = (std::tanh (samples[i] * drive + bias) - offset) * makeUpGain;
+                samples[i] += (shaped - samples[i]) * mix;
+            }
+        }
+    }
+
+    void setDriveDecibels (float decibels)
+    {
+        drive = juce::Decibels::decibelsToGain (decibels);
+    }
+
+private:
+    float drive = 1.0f;
+    float bias;
+    float mix;
+};
+
+
+using OversampledSaturator = Oversampled<Saturator, 4>;
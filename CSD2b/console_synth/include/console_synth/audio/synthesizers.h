@@ -117,6 +117,17 @@ public:
         synthEngine.clearVoices();
     }
 
+    // voices clear their current note once their envelope has finished releasing,
+    // so the synth is idle when none of the voices is active anymore
+    [[nodiscard]] bool isIdle() const override
+    {
+        for (auto i = 0; i < synthEngine.getNumVoices(); ++i)
+            if (synthEngine.getVoice (i)->isVoiceActive())
+                return false;
+
+        return true;
+    }
+
 protected:
     juce::Synthesiser synthEngine;
 
@@ -131,10 +142,10 @@ class ModulationSynthesizer : public SynthesizerBase
 public:
     using VoiceType = OscillatorSynthesizerVoice<OscType>;
 
+    // uses the synth node in the parent if there is one, so the settings of an existing synth are kept
     explicit ModulationSynthesizer (juce::ValueTree parent)
+        : synthState { parent.getOrCreateChildWithName (IDs::synth, nullptr) }
     {
-        parent.appendChild (synthState, nullptr);
-
         auto modIndices = std::array<double, OscType::getNumModulators()> {};
 
         for (auto& index : modIndices)
@@ -162,7 +173,7 @@ public:
     ~ModulationSynthesizer() override = default;
 
 private:
-    juce::ValueTree synthState { IDs::synth };
+    juce::ValueTree synthState;
     Property<int> numVoices { synthState, IDs::numVoices, 4 };
     Property<float> attack { synthState, IDs::attack, 0.001 };
     Property<float> decay { synthState, IDs::decay, 0.1 };
@@ -4,12 +4,13 @@
 #pragma once
 
 #include <console_synth/audio/audio_callback.h>
+#include <console_synth/offline_renderer.h>
 #include <console_synth/sequencer/sequencer.h>
 #include <console_synth/utility/format.h>
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_audio_devices/juce_audio_devices.h>
 
-class Engine : private juce::AudioSource
+class Engine : private juce::AudioSource, private juce::Timer
 {
 public:
     Engine();
@@ -25,17 +26,41 @@ public:
 
     juce::UndoManager* getUndoManager();
 
+    // The number of notes that were recorded since the last call. While recording, a timer adds the recorded notes to the
+    // melodies a few times per second, so the queues of the recorders don't fill up when there are no commands for a while.
+    // Message thread only
+    int takeNumRecordedNotes();
+
+    // Render the song to an audio file as fast as possible (see OfflineRenderer), the audio device is stopped meanwhile.
+    // Throws an OfflineRenderer::RenderError if the file can't be written
+    OfflineRenderer::Result renderBars (const juce::File& file, uint32_t numBars, const OfflineRenderSettings& settings = {});
+
+    OfflineRenderer::Result renderLoops (const juce::File& file, uint32_t numLoops, const OfflineRenderSettings& settings = {});
+
 private:
     juce::ValueTree engineState { IDs::engine };
     juce::UndoManager undoManager;
     Sequencer sequencer { engineState };
+    OfflineRenderer offlineRenderer { sequencer };
     juce::AudioDeviceManager deviceManager {};
     AudioIODeviceCallback audioCallback { *this };
 
+    // the notes the timer added to the melodies since the last time they were asked for
+    int numRecordedNotes = 0;
+
+    static constexpr auto recordedNotesIntervalMs = 200;
+
+
+    // stops the audio device while rendering and restarts it afterwards (which prepares the sequencer for the device again)
+    template <typename RenderFunction>
+    OfflineRenderer::Result renderWithoutDevice (RenderFunction&& render);
 
     void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override;
 
     void getNextAudioBlock (const juce::AudioSourceChannelInfo& bufferToFill) override;
 
     void releaseResources() override;
+
+    // adds the recorded notes to the melodies while recording
+    void timerCallback() override;
 };
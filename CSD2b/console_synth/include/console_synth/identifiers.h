@@ -30,6 +30,61 @@ DECLARE_ID (modulationIndex);
 DECLARE_ID (ratios);
 DECLARE_ID (name);
 DECLARE_ID (synthType);
+DECLARE_ID (bus);
+DECLARE_ID (sends);
+DECLARE_ID (editBatch);
+DECLARE_ID (selectedTrack);
+DECLARE_ID (tempoMap);
+DECLARE_ID (tempoChange);
+DECLARE_ID (tick);
+DECLARE_ID (ramp);
+DECLARE_ID (meterMap);
+DECLARE_ID (meterChange);
+DECLARE_ID (bar);
+DECLARE_ID (numerator);
+DECLARE_ID (denominator);
+DECLARE_ID (loopBars);
+DECLARE_ID (patterns);
+DECLARE_ID (pattern);
+DECLARE_ID (id);
+DECLARE_ID (arrangement);
+DECLARE_ID (clip);
+DECLARE_ID (offsetTicks);
+DECLARE_ID (loopLengthTicks);
+DECLARE_ID (transpose);
+DECLARE_ID (lookaheadBlocks);
+DECLARE_ID (midiInputs);
+DECLARE_ID (midiInput);
+DECLARE_ID (midiRoute);
+DECLARE_ID (source);
+DECLARE_ID (channel);
+DECLARE_ID (midiLatencyBlocks);
+DECLARE_ID (stepSequence);
+DECLARE_ID (numHits);
+DECLARE_ID (numSteps);
+DECLARE_ID (rotation);
+DECLARE_ID (stepLengthTicks);
+DECLARE_ID (gateTicks);
+DECLARE_ID (notes);
+DECLARE_ID (velocities);
+DECLARE_ID (groove);
+DECLARE_ID (swing);
+DECLARE_ID (swingGridTicks);
+DECLARE_ID (grooveGridTicks);
+DECLARE_ID (grooveOffsets);
+DECLARE_ID (grooveVelocities);
+DECLARE_ID (humanizeTicks);
+DECLARE_ID (humanizeVelocity);
+DECLARE_ID (seed);
+DECLARE_ID (midiProcessors);
+DECLARE_ID (chord);
+DECLARE_ID (arpeggiatorMode);
+DECLARE_ID (arpeggiatorRateTicks);
+DECLARE_ID (arpeggiatorGate);
+DECLARE_ID (arpeggiatorOctaves);
+DECLARE_ID (repeatRateTicks);
+DECLARE_ID (repeatGate);
+DECLARE_ID (masterDrive);
 
 }  // namespace IDs
 
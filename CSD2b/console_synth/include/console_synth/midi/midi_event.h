@@ -0,0 +1,57 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <type_traits>
+
+/* A short midi message (at most 3 bytes, so no sysex) as plain data: 16 bytes that can be copied around without
+ * ever touching the heap, unlike a juce::MidiMessage. This is what the midi queues between threads hold.
+ * */
+
+struct MidiEvent
+{
+    // seconds, on the clock of whoever made the event (e.g. the time stamp of the midi input device)
+    double timeStamp;
+    uint8_t data[3];
+    uint8_t numBytes;
+
+    // where the event came from (e.g. the index of the input device)
+    uint8_t source;
+
+    // returns false if the message doesn't fit (a sysex message)
+    [[nodiscard]] static bool fromMessage (const juce::MidiMessage& message, MidiEvent& event, uint8_t source = 0) noexcept
+    {
+        const auto size = message.getRawDataSize();
+
+        if (size > 3)
+            return false;
+
+        event = MidiEvent { message.getTimeStamp(), { 0, 0, 0 }, (uint8_t) size, source };
+        std::memcpy (event.data, message.getRawData(), (size_t) size);
+        return true;
+    }
+
+    [[nodiscard]] juce::MidiMessage toMessage() const
+    {
+        return juce::MidiMessage { data, (int) numBytes, timeStamp };
+    }
+};
+
+static_assert (std::is_trivially_copyable_v<MidiEvent>);
+static_assert (sizeof (MidiEvent) == 16);
+
+
+// makes room for the number of short messages in the buffer, without relying on how a juce::MidiBuffer stores them:
+// it's filled with that many and cleared again, which keeps the memory. Allocates, so never on the audio thread
+inline void reserveMidiEvents (juce::MidiBuffer& buffer, size_t numEvents)
+{
+    buffer.clear();
+
+    for (auto i = size_t { 0 }; i < numEvents; ++i)
+        buffer.addEvent (juce::MidiMessage::noteOff (1, 0), 0);
+
+    buffer.clear();
+}
@@ -0,0 +1,149 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <console_synth/midi/midi_source.h>
+#include <juce_core/juce_core.h>
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+/* A standard midi file that is played straight from disk, without its notes ever going into a melody
+ * (for very long performances). The file is memory mapped, so only the parts that are played are read from disk.
+ * Loading scans every track once (only the delta times and the lengths of the events are looked at) to build a small index:
+ * for every so many events, it keeps where the event starts, the tick before it and the running status at that point.
+ * The index never gets bigger than maxIndexSize entries per track: when it's full, every other entry is dropped
+ * and the entries are twice as far apart from then on. So the memory use doesn't depend on the length of the file.
+ * Seeking to a tick finds the last entry before it with a binary search and decodes the events from there.
+ * */
+
+class MappedMidiFile
+{
+public:
+    struct LoadError;
+
+    // a file without tracks, which plays nothing
+    MappedMidiFile() = default;
+
+    // maps the file into memory and indexes it, the ticks of the sequencer have the given ticks per quarter note.
+    // throws a LoadError if the file can't be played
+    MappedMidiFile (const juce::File& file, uint32_t ticksPerQuarterNote);
+
+    // the same for a file that's already in memory, which should stay alive as long as this object
+    MappedMidiFile (const void* fileData, size_t numBytes, uint32_t ticksPerQuarterNote);
+
+    struct Event
+    {
+        uint64_t tick; // in the ticks of the file
+        uint8_t data[3];
+        int numBytes; // 0 for meta and sysex events, those are never played
+    };
+
+    // the event of a track that's up next, and where the event after it starts
+    struct Cursor
+    {
+        Event event { 0, { 0, 0, 0 }, 0 };
+        size_t nextOffset = 0;
+        uint8_t runningStatus = 0;
+        bool isAtEnd = true;
+    };
+
+    [[nodiscard]] int getNumTracks() const noexcept;
+
+    // unique for every file that was loaded, so a player can tell that its cursors belong to another file
+    [[nodiscard]] uint64_t getId() const noexcept;
+
+    [[nodiscard]] size_t getIndexSize (int track) const noexcept;
+
+    // a cursor at the first event of the track at or after the tick (in the ticks of the file)
+    [[nodiscard]] Cursor seek (int track, uint64_t tick) const noexcept;
+
+    // moves the cursor to the next event of the track
+    void advance (int track, Cursor& cursor) const noexcept;
+
+    // the events of the file play at the nearest tick of the sequencer
+    [[nodiscard]] uint64_t toFileTick (uint64_t sequencerTick) const noexcept;
+
+    [[nodiscard]] uint64_t toSequencerTick (uint64_t fileTick) const noexcept;
+
+    static constexpr auto maxNumTracks = 64;
+    static constexpr auto maxIndexSize = size_t { 4096 };
+
+private:
+    struct IndexEntry
+    {
+        uint64_t tickBefore;
+        size_t offset;
+        uint8_t runningStatus;
+    };
+
+    struct Track
+    {
+        size_t start;
+        size_t end;
+        std::vector<IndexEntry> index;
+    };
+
+    std::unique_ptr<juce::MemoryMappedFile> mappedFile;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    uint64_t fileTicksPerQuarterNote = 1;
+    uint64_t ticksPerQuarterNote = 1;
+    uint64_t id = 0;
+    std::vector<Track> tracks;
+
+
+    void readChunks();
+
+    void indexTrack (Track& track) const;
+
+    // decodes the event at the next offset of the cursor, returns false at the end of the track (or if the track is broken)
+    bool decodeNextEvent (const Track& track, Cursor& cursor) const noexcept;
+
+    bool readVariableLength (const Track& track, size_t& offset, uint32_t& value) const noexcept;
+};
+
+
+struct MappedMidiFile::LoadError : std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+
+
+// ===================================================================================================
+
+// Plays the notes of a mapped midi file (all channels on the track, like an imported file).
+// It decodes just the events of the current block, from where the previous block ended,
+// and only seeks when the play head jumps (like when it loops), which stops the notes that were playing.
+class MidiFilePlayerMidiSource : public MidiSource
+{
+public:
+    // the file is owned by the track, so it's set for every block (like the patterns of the ArrangementMidiSource)
+    void setFile (const MappedMidiFile* newFile) noexcept;
+
+    void fillNextMidiBuffer (const PlayHead& playHead, juce::MidiBuffer& buffer, int numSamples) override;
+
+    // forgets the notes that are sounding (without stopping them), the next block seeks in the file again
+    void reset() noexcept
+    {
+        soundingNotes.reset();
+        cursorFileId = 0;
+    }
+
+private:
+    const MappedMidiFile* file = nullptr;
+    std::array<MappedMidiFile::Cursor, MappedMidiFile::maxNumTracks> cursors {};
+    uint64_t cursorFileId = 0;
+    uint64_t nextTick = 0;
+    std::bitset<128> soundingNotes { 0 };
+
+
+    void seek (uint64_t tick) noexcept;
+
+    void playRange (const TickRange& range, juce::MidiBuffer& buffer, int numSamples);
+
+    void stopSoundingNotes (juce::MidiBuffer& buffer, int samplePosition);
+};
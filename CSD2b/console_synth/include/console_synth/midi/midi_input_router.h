@@ -0,0 +1,158 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <console_synth/identifiers.h>
+#include <console_synth/midi/midi_event.h>
+#include <console_synth/midi/stream_clock.h>
+#include <console_synth/utility/atomic_snapshot.h>
+#include <console_synth/utility/mpsc_queue.h>
+#include <juce_audio_devices/juce_audio_devices.h>
+#include <array>
+#include <memory>
+#include <vector>
+
+/* Says which track plays the midi of which channel of which input. The inputs are known by their source index
+ * (the index of the device, see MidiEvent::source), channel 0 is for the messages that don't have a channel.
+ * */
+
+struct MidiRoutingTable
+{
+    static constexpr auto maxNumInputs = 16;
+    static constexpr auto noTrack = -1;
+
+    MidiRoutingTable()
+    {
+        for (auto& channels : trackIndices)
+            channels.fill (noTrack);
+    }
+
+    [[nodiscard]] int getTrackIndex (uint8_t source, int channel) const noexcept
+    {
+        if (source >= maxNumInputs || channel < 0 || channel > 16)
+            return noTrack;
+
+        return trackIndices[source][(size_t) channel];
+    }
+
+    std::array<std::array<int, 17>, maxNumInputs> trackIndices;
+};
+
+
+/* Keeps multiple midi input devices open at the same time and sends what they play to the tracks.
+ * Every open device has a midi input node in the state, with route nodes that say which track plays which channel
+ * of the device (a route without a channel takes all channels that don't have a route of their own).
+ * The devices call back on their own threads, they all push into the same lock free queue, marked with their source index.
+ * Once per block, the audio thread takes out everything that came in, puts it in time stamp order and sorts it into
+ * a midi buffer per track. The routing table is rebuilt on the message thread, the audio thread reads it as a snapshot.
+ * Every event is played a fixed latency (one block by default) after its time stamp, measured on a filtered clock of
+ * the device stream (see StreamClock), so how late the audio thread happens to wake up doesn't change where it lands.
+ * Events that are due after the current block wait in the router until their block comes.
+ * */
+
+class MidiInputRouter : private juce::ValueTree::Listener
+{
+public:
+    static constexpr auto maxNumInputs = MidiRoutingTable::maxNumInputs;
+    static constexpr auto maxNumTracks = 64;
+
+    // the most events the queue holds, which is also the most that are sorted into the tracks in one block
+    static constexpr auto maxNumEventsPerBlock = size_t { 1024 };
+
+    // creates the midi inputs node in the parent
+    explicit MidiInputRouter (juce::ValueTree& parent);
+    ~MidiInputRouter() override;
+
+    // opens the device and adds its node to the state (without routes), message thread only
+    bool openDevice (const juce::String& name);
+
+    // stops the device and removes its node (and its routes), message thread only
+    bool closeDevice (const juce::String& name);
+
+    // plays a channel (1 - 16, or 0 for all channels) of an open device on the track, instead of where it played before
+    bool setRoute (const juce::String& name, int channel, int trackIndex);
+
+    [[nodiscard]] juce::StringArray getOpenDeviceNames() const;
+
+    [[nodiscard]] juce::ValueTree getState() const noexcept { return state; }
+
+    // how long after its time stamp an event is played, in blocks. At least one block is needed to never play an event late
+    void setLatencyBlocks (double numBlocks) noexcept;
+
+    static constexpr auto maxLatencyBlocks = 8.0;
+
+    // what the devices call, from any thread. Returns false if the message was dropped (a sysex message or a full queue)
+    bool addMessage (uint8_t source, const juce::MidiMessage& message);
+
+    // the track buffers get room for all events of a block (however large the block is), so this allocates
+    void prepareToPlay (double newSampleRate, int maxBlockSize);
+
+    // Audio thread only: takes out the midi that came in and sorts what's due in this block into the track buffers.
+    // The current time should be in seconds, on the clock of the time stamps of the devices
+    void processNextBlock (int numSamples, double currentTimeSeconds);
+
+    // the midi for the track in the current block (an empty buffer for a track without midi)
+    [[nodiscard]] const juce::MidiBuffer& getMidiForTrack (int trackIndex) const noexcept;
+
+    // the number of messages that were dropped, because they were too long or the queue was full
+    [[nodiscard]] uint64_t getNumDropped() const noexcept;
+
+    // deletes the old routing tables, message thread only
+    void collectGarbage();
+
+private:
+    struct DeviceCallback final : public juce::MidiInputCallback
+    {
+        DeviceCallback (MidiInputRouter& router, uint8_t source) : router { router }, source { source } {}
+
+        void handleIncomingMidiMessage (juce::MidiInput*, const juce::MidiMessage& message) override
+        {
+            router.addMessage (source, message);
+        }
+
+        MidiInputRouter& router;
+        const uint8_t source;
+    };
+
+    struct OpenDevice
+    {
+        juce::String name;
+        uint8_t source;
+        std::unique_ptr<DeviceCallback> callback;
+        std::unique_ptr<juce::MidiInput> input;
+    };
+
+    juce::ValueTree state { IDs::midiInputs };
+    std::vector<OpenDevice> openDevices;
+    MpscQueue<MidiEvent> queue { maxNumEventsPerBlock };
+    std::atomic<uint64_t> numSysexDropped { 0 };
+    AtomicSnapshot<MidiRoutingTable> routingTable;
+
+    std::atomic<double> latencyBlocks { 1.0 };
+
+    // only used by the audio thread, the events that are due after the current block stay at the front of the pending events
+    std::vector<MidiEvent> pendingEvents;
+    size_t numHeldEvents = 0;
+    std::vector<juce::MidiBuffer> trackBuffers;
+    juce::MidiBuffer emptyBuffer;
+    StreamClock streamClock;
+    double sampleRate = 44'100.0;
+
+
+    [[nodiscard]] juce::ValueTree findDeviceState (const juce::String& name) const;
+
+    [[nodiscard]] int findFreeSource() const;
+
+    void rebuildRoutingTable();
+
+    // the midi channel of the event (1 - 16), or 0 if it's not a channel message
+    [[nodiscard]] static int getChannel (const MidiEvent& event) noexcept;
+
+    void sortByTimeStamp (size_t numEvents) noexcept;
+
+    void valueTreeChildAdded (juce::ValueTree& parent, juce::ValueTree& child) override;
+    void valueTreeChildRemoved (juce::ValueTree& parent, juce::ValueTree& child, int index) override;
+    void valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier& property) override;
+
+    JUCE_DECLARE_NON_COPYABLE (MidiInputRouter);
+};
@@ -3,33 +3,57 @@
 
 #pragma once
 
-#include <juce_audio_basics/juce_audio_basics.h>
+#include <console_synth/midi/midi_event.h>
+#include <console_synth/utility/mpsc_queue.h>
+#include <array>
 
 // lock free queue for midi messages
-// in the bigger picture, messages will be added from the message thread
-// and will then be handled from the audio thread
+// in the bigger picture, messages will be added from the message thread (or the threads of the midi input devices)
+// and will then be handled from the audio thread.
+// the messages are stored as MidiEvents (plain data), so sysex messages don't fit and are dropped (and counted)
 class MidiMessageQueue
 {
 public:
-    explicit MidiMessageQueue (std::size_t size) : fifo (size), buffer (size) {}
+    explicit MidiMessageQueue (std::size_t size) : queue (size) {}
 
-    void addMessage (const juce::MidiMessage& message)
+    // can be called from multiple threads at once, returns false if the message was dropped
+    bool addMessage (const juce::MidiMessage& message, uint8_t source = 0)
     {
-        fifo.write (1).forEach ([this, &message] (auto index) {
-            buffer[index] = message;
-        });
+        auto event = MidiEvent {};
+
+        if (! MidiEvent::fromMessage (message, event, source))
+        {
+            numSysexDropped.fetch_add (1, std::memory_order_relaxed);
+            return false;
+        }
+
+        return queue.push (event);
+    }
+
+    // the handler gets the messages as MidiEvents, so nothing is allocated while handling them
+    template <typename EventHandler>
+    void handleAllPendingEvents (EventHandler&& handler)
+    {
+        auto batch = std::array<MidiEvent, 64> {};
+
+        while (auto numEvents = queue.popBatch (batch.data(), batch.size()))
+            for (size_t i = 0; i < numEvents; ++i)
+                handler (batch[i]);
     }
 
     template <typename MessageHandler>
     void handleAllPendingMessages (MessageHandler&& handler)
     {
-        fifo.read (fifo.getNumReady()).forEach ([this, &handler] (auto index) {
-            auto message = buffer[index];
-            handler (message);
-        });
+        handleAllPendingEvents ([&handler] (const MidiEvent& event) { handler (event.toMessage()); });
+    }
+
+    // the number of messages that were dropped because the queue was full or they were too long
+    [[nodiscard]] uint64_t getNumDropped() const noexcept
+    {
+        return queue.getNumDropped() + numSysexDropped.load (std::memory_order_relaxed);
     }
 
 private:
-    juce::AbstractFifo fifo;
-    std::vector<juce::MidiMessage> buffer;
-};
\ No newline at end of file
+    MpscQueue<MidiEvent> queue;
+    std::atomic<uint64_t> numSysexDropped { 0 };
+};
@@ -0,0 +1,230 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <console_synth/sequencer/play_head.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+/* A midi processor changes the midi of a track on its way to the synth, after the sequenced and live midi are merged
+ * (see MidiProcessorChain). Processors run on the audio thread, so they never allocate: the events of a block are taken
+ * out of the buffer into a fixed size list, the buffer is cleared (which keeps its memory) and the processor adds
+ * what it plays to the buffer again.
+ * Both are limited, so the buffer of a track can be made big enough beforehand. When there's no room left,
+ * note ons are dropped and note offs are kept, since a note on without its note off would hang.
+ * */
+
+class MidiProcessor
+{
+public:
+    virtual ~MidiProcessor() = default;
+
+    // replaces the midi of the block with what the processor plays
+    virtual void processMidi (const PlayHead& playHead, bool isPlaying, juce::MidiBuffer& midi, int numSamples) = 0;
+
+    // stops the notes the processor is playing (at the sample) and forgets the notes that are held
+    virtual void reset (juce::MidiBuffer& midi, int samplePosition) = 0;
+
+    // the events a processor takes from a block, and the note ons (and other events) it adds to it
+    static constexpr auto maxNumEventsPerBlock = size_t { 512 };
+
+    // everything a processor adds to a block: on top of the note ons, a note off for every note that was sounding
+    // at the start of the block or started in it (at most 128 more than the note ons) and the note offs that came in
+    static constexpr auto maxNumOutputEventsPerBlock = 3 * maxNumEventsPerBlock + 128;
+
+protected:
+    struct Event
+    {
+        int samplePosition;
+        uint8_t data[3];
+        int numBytes;
+
+        [[nodiscard]] int getChannel() const noexcept { return (data[0] & 0x0f) + 1; }
+        [[nodiscard]] int getNoteNumber() const noexcept { return data[1]; }
+        [[nodiscard]] uint8_t getVelocity() const noexcept { return data[2]; }
+        [[nodiscard]] bool isNoteOn() const noexcept { return (data[0] & 0xf0) == 0x90 && data[2] > 0; }
+        [[nodiscard]] bool isNoteOff() const noexcept { return (data[0] & 0xf0) == 0x80 || ((data[0] & 0xf0) == 0x90 && data[2] == 0); }
+    };
+
+    std::array<Event, maxNumEventsPerBlock> events {};
+    size_t numEvents = 0;
+    size_t numEventsAdded = 0;
+
+
+    // moves the events of the buffer into the list and clears the buffer. When they don't all fit,
+    // the note ons (and other events) are dropped first, so the note offs make it
+    void takeEvents (juce::MidiBuffer& midi) noexcept
+    {
+        auto numNoteOffs = size_t { 0 };
+
+        for (auto&& metadata : midi)
+            if (metadata.numBytes <= 3 && toEvent (metadata).isNoteOff())
+                ++numNoteOffs;
+
+        auto numNoteOffsLeft = std::min (numNoteOffs, events.size());
+        numEvents = 0;
+        numEventsAdded = 0;
+
+        for (auto&& metadata : midi)
+        {
+            if (metadata.numBytes > 3)
+                continue;
+
+            const auto event = toEvent (metadata);
+
+            if (event.isNoteOff())
+            {
+                if (numNoteOffsLeft == 0)
+                    continue;
+
+                --numNoteOffsLeft;
+            }
+            else if (numEvents + numNoteOffsLeft >= events.size())
+            {
+                continue;
+            }
+
+            events[numEvents++] = event;
+        }
+
+        midi.clear();
+    }
+
+    // returns false when the processor already added maxNumEventsPerBlock note ons (and other events) to the block
+    bool addNoteOn (juce::MidiBuffer& midi, int channel, int noteNumber, uint8_t velocity, int samplePosition)
+    {
+        if (numEventsAdded >= maxNumEventsPerBlock)
+            return false;
+
+        ++numEventsAdded;
+        midi.addEvent (juce::MidiMessage::noteOn (channel, noteNumber, velocity), samplePosition);
+        return true;
+    }
+
+    static void addNoteOff (juce::MidiBuffer& midi, int channel, int noteNumber, int samplePosition)
+    {
+        midi.addEvent (juce::MidiMessage::noteOff (channel, noteNumber), samplePosition);
+    }
+
+    // a note off always goes through, anything else only while there's room (like addNoteOn())
+    bool addEvent (juce::MidiBuffer& midi, const Event& event)
+    {
+        if (! event.isNoteOff())
+        {
+            if (numEventsAdded >= maxNumEventsPerBlock)
+                return false;
+
+            ++numEventsAdded;
+        }
+
+        midi.addEvent (event.data, event.numBytes, event.samplePosition);
+        return true;
+    }
+
+private:
+    static Event toEvent (const juce::MidiMessageMetadata& metadata) noexcept
+    {
+        return { metadata.samplePosition,
+                 { metadata.data[0], metadata.numBytes > 1 ? metadata.data[1] : uint8_t { 0 }, metadata.numBytes > 2 ? metadata.data[2] : uint8_t { 0 } },
+                 metadata.numBytes };
+    }
+};
+
+
+// ===================================================================================================
+
+// The ticks of the play head while the sequencer plays. While it's stopped the play head doesn't move,
+// so the ticks go on by themselves at the tempo the play head is at (an arpeggiator should still play live notes).
+class MidiProcessorClock
+{
+public:
+    // calls the function with every tick in the block and the sample it falls on
+    template <typename Functor>
+    void forEachTick (const PlayHead& playHead, bool isPlaying, int numSamples, Functor&& function)
+    {
+        if (isPlaying)
+        {
+            isFreeRunning = false;
+
+            forEachTickRange (playHead, [&] (const TickRange& range) {
+                for (auto tick = range.startTick; tick < range.endTick; ++tick)
+                    function (tick, range.getSampleOfTick (tick, numSamples));
+            });
+
+            return;
+        }
+
+        if (! isFreeRunning)
+        {
+            freeRunningTick = playHead.getCurrentTick();
+            nextTickSample = 0.0;
+            isFreeRunning = true;
+        }
+
+        const auto samplesPerTick = getSamplesPerTick (playHead, numSamples);
+
+        if (samplesPerTick <= 0.0)
+            return;
+
+        for (; nextTickSample < numSamples; nextTickSample += samplesPerTick)
+            function (freeRunningTick++, (int) nextTickSample);
+
+        nextTickSample -= numSamples;
+    }
+
+private:
+    bool isFreeRunning = false;
+    uint64_t freeRunningTick = 0;
+    double nextTickSample = 0.0;
+
+
+    static double getSamplesPerTick (const PlayHead& playHead, int numSamples)
+    {
+        if (playHead.isSampleAccurate())
+        {
+            const auto& tempoMap = playHead.getTempoMap();
+            const auto bpm = tempoMap.getTempoAtTick ((double) playHead.getCurrentTick());
+            return playHead.getSampleRate() * 60.0 / (bpm * tempoMap.getTicksPerQuarterNote());
+        }
+
+        if (playHead.getDeviceCallbackDurationMs() <= 0.0)
+            return 0.0;
+
+        return playHead.getTickTimeMs() / playHead.getDeviceCallbackDurationMs() * numSamples;
+    }
+};
+
+
+// ===================================================================================================
+
+// A processor that does something on the ticks of the clock. The events and ticks of a block are handled in order,
+// an event on the same sample as a tick comes first.
+class TickedMidiProcessor : public MidiProcessor
+{
+public:
+    void processMidi (const PlayHead& playHead, bool isPlaying, juce::MidiBuffer& midi, int numSamples) override
+    {
+        takeEvents (midi);
+        auto nextEvent = size_t { 0 };
+
+        clock.forEachTick (playHead, isPlaying, numSamples, [&] (uint64_t tick, int samplePosition) {
+            for (; nextEvent < numEvents && events[nextEvent].samplePosition <= samplePosition; ++nextEvent)
+                handleEvent (events[nextEvent], midi);
+
+            handleTick (tick, samplePosition, midi);
+        });
+
+        for (; nextEvent < numEvents; ++nextEvent)
+            handleEvent (events[nextEvent], midi);
+    }
+
+protected:
+    virtual void handleEvent (const Event& event, juce::MidiBuffer& midi) = 0;
+
+    virtual void handleTick (uint64_t tick, int samplePosition, juce::MidiBuffer& midi) = 0;
+
+private:
+    MidiProcessorClock clock;
+};
@@ -0,0 +1,178 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <console_synth/identifiers.h>
+#include <console_synth/midi/midi_processor.h>
+#include <console_synth/utility/atomic_snapshot.h>
+#include <bitset>
+
+enum struct ArpeggiatorMode
+{
+    off,
+    up,
+    down,
+    upDown,
+    asPlayed
+};
+
+
+// the settings of all midi processors of a track, a processor without settings passes the midi through
+struct MidiProcessorSettings
+{
+    static constexpr auto maxNumChordNotes = 8;
+
+    // the intervals of the chord every note plays (0 is the note itself), no intervals means no chord
+    int numChordNotes = 0;
+    std::array<int, maxNumChordNotes> chordIntervals {};
+
+    ArpeggiatorMode arpeggiatorMode = ArpeggiatorMode::off;
+    uint64_t arpeggiatorRateTicks = 12;
+    double arpeggiatorGate = 0.5; // the part of a step a note lasts
+    int arpeggiatorOctaves = 1;
+
+    uint64_t repeatRateTicks = 0; // 0 means no note repeat
+    double repeatGate = 0.5;
+
+    // the settings of a midi processors node, everything out of range is clamped
+    [[nodiscard]] static MidiProcessorSettings fromState (const juce::ValueTree& state);
+};
+
+
+// ===================================================================================================
+
+// Chord memory: every note plays a chord (the same shape from every note). When chords overlap on a note,
+// that note keeps sounding until the last chord that plays it is released.
+class ChordMemoryProcessor : public MidiProcessor
+{
+public:
+    void setSettings (const MidiProcessorSettings* newSettings) noexcept { settings = newSettings; }
+
+    void processMidi (const PlayHead& playHead, bool isPlaying, juce::MidiBuffer& midi, int numSamples) override;
+
+    void reset (juce::MidiBuffer& midi, int samplePosition) override;
+
+private:
+    const MidiProcessorSettings* settings = nullptr;
+
+    // the notes a held note played (with the shape of when it started), so it stops the same notes
+    std::array<std::array<uint8_t, MidiProcessorSettings::maxNumChordNotes>, 128> chordOfNote {};
+    std::array<uint8_t, 128> numNotesInChordOfNote {};
+    std::array<uint8_t, 128> numChordsPlayingNote {};
+
+
+    void startChord (const Event& event, juce::MidiBuffer& midi);
+
+    void stopChord (const Event& event, juce::MidiBuffer& midi);
+};
+
+
+// ===================================================================================================
+
+// Plays the held notes one after another, on a grid of the clock. The order can go up, down, up and down
+// or follow the order the notes were played in, over one or more octaves.
+class ArpeggiatorProcessor : public TickedMidiProcessor
+{
+public:
+    void setSettings (const MidiProcessorSettings* newSettings) noexcept { settings = newSettings; }
+
+    void reset (juce::MidiBuffer& midi, int samplePosition) override;
+
+    static constexpr auto maxNumHeldNotes = 32;
+
+private:
+    struct HeldNote
+    {
+        uint8_t noteNumber;
+        uint8_t velocity;
+    };
+
+    const MidiProcessorSettings* settings = nullptr;
+    std::array<HeldNote, maxNumHeldNotes> heldNotes {};
+    int numHeldNotes = 0;
+    uint64_t step = 0;
+    int playingNote = -1;
+    int playingChannel = 1;
+    uint64_t noteOffTick = 0;
+
+
+    [[nodiscard]] bool isActive() const noexcept { return settings != nullptr && settings->arpeggiatorMode != ArpeggiatorMode::off; }
+
+    void handleEvent (const Event& event, juce::MidiBuffer& midi) override;
+
+    void handleTick (uint64_t tick, int samplePosition, juce::MidiBuffer& midi) override;
+
+    // the held note for a step of the pattern, with the octave it's in
+    [[nodiscard]] HeldNote getNoteOfStep (uint64_t stepIndex) const noexcept;
+
+    void stopPlayingNote (juce::MidiBuffer& midi, int samplePosition);
+};
+
+
+// ===================================================================================================
+
+// Repeats the held notes on a grid of the clock, for as long as they're held. A note plays right away when it's
+// pressed, the repeats follow on the grid.
+class NoteRepeatProcessor : public TickedMidiProcessor
+{
+public:
+    void setSettings (const MidiProcessorSettings* newSettings) noexcept { settings = newSettings; }
+
+    void reset (juce::MidiBuffer& midi, int samplePosition) override;
+
+private:
+    const MidiProcessorSettings* settings = nullptr;
+    std::array<uint8_t, 128> heldVelocities {}; // 0 when the note isn't held
+    std::array<uint8_t, 128> heldChannels {};
+    std::array<uint64_t, 128> noteOffTicks {};
+    std::bitset<128> soundingNotes { 0 };
+
+    // the notes that were pressed since the last tick, and the samples they were pressed at
+    std::bitset<128> pressedNotes { 0 };
+    std::array<int, 128> pressedSamples {};
+
+
+    [[nodiscard]] bool isActive() const noexcept { return settings != nullptr && settings->repeatRateTicks > 0; }
+
+    void handleEvent (const Event& event, juce::MidiBuffer& midi) override;
+
+    void handleTick (uint64_t tick, int samplePosition, juce::MidiBuffer& midi) override;
+
+    void stopSoundingNotes (juce::MidiBuffer& midi, int samplePosition);
+};
+
+
+// ===================================================================================================
+
+// The midi processors of a track, in the order they're applied: chord memory, arpeggiator, note repeat
+// (so a chord can be arpeggiated). Their settings are the properties of the midi processors node of the track,
+// every change publishes new settings, which the processors use from the next block on.
+class MidiProcessorChain : private juce::ValueTree::Listener
+{
+public:
+    // the midi processors node is created in the track state if it doesn't have one yet
+    explicit MidiProcessorChain (juce::ValueTree& trackState);
+    ~MidiProcessorChain() override;
+
+    // audio thread only
+    void processMidi (const PlayHead& playHead, bool isPlaying, juce::MidiBuffer& midi, int numSamples);
+
+    // stops everything the processors play, audio thread only
+    void reset (juce::MidiBuffer& midi, int samplePosition);
+
+    // deletes the old settings, message thread only
+    void collectGarbage();
+
+private:
+    juce::ValueTree processorsState;
+    AtomicSnapshot<MidiProcessorSettings> settings;
+    ChordMemoryProcessor chordMemory;
+    ArpeggiatorProcessor arpeggiator;
+    NoteRepeatProcessor noteRepeat;
+    std::array<MidiProcessor*, 3> processors { &chordMemory, &arpeggiator, &noteRepeat };
+
+
+    void valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier& property) override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiProcessorChain);
+};
@@ -3,7 +3,11 @@
 
 #pragma once
 
+#include <array>
+#include <bitset>
+#include <console_synth/sequencer/arrangement.h>
 #include <console_synth/sequencer/melody.h>
+#include <console_synth/sequencer/pattern_list.h>
 #include <console_synth/sequencer/play_head.h>
 #include <juce_audio_basics/juce_audio_basics.h>
 
@@ -25,24 +29,172 @@ public:
         if (melody == nullptr)
             return;
 
-        auto bufferDuration = playHead.getDeviceCallbackDurationMs();
+        forEachTickRange (playHead, [&] (const TickRange& range) {
+            melody->forEachEventInRange (cursor, range.startTick, range.endTick, [&] (const auto& event) {
+                auto samplePosition = range.getSampleOfTick ((uint64_t) event.timeStampTicks, numSamples);
 
-        forEachTick (playHead, [&] (uint64_t tick, double timeStampRelativeToBuffer) {
-            melody->forEachEvent ([&] (const auto& event) {
-                if (event.timeStampTicks == tick)
-                {
-                    auto normalizedPosition = timeStampRelativeToBuffer / bufferDuration;
-                    auto samplePosition = (int) (normalizedPosition * numSamples);
-
-                    if (event.isNoteOn)
-                        buffer.addEvent (juce::MidiMessage::noteOn (1, event.midiNote, (uint8_t) event.velocity), samplePosition);
-                    else
-                        buffer.addEvent (juce::MidiMessage::noteOff (1, event.midiNote, (uint8_t) event.velocity), samplePosition);
-                }
+                if (event.isNoteOn)
+                    buffer.addEvent (juce::MidiMessage::noteOn (1, event.midiNote, (uint8_t) event.velocity), samplePosition);
+                else
+                    buffer.addEvent (juce::MidiMessage::noteOff (1, event.midiNote, (uint8_t) event.velocity), samplePosition);
             });
         });
     }
 
 private:
     Melody* melody;
-};
\ No newline at end of file
+    Melody::Cursor cursor;
+};
+
+// Plays the clips of an arrangement, with the patterns they refer to.
+// The patterns are owned by the sequencer, so they're set for every block (see setPatterns()).
+class ArrangementMidiSource : public MidiSource
+{
+public:
+    explicit ArrangementMidiSource (const Arrangement* arrangement) : arrangement { arrangement } {}
+
+    // the patterns should stay alive until the next call to fillNextMidiBuffer() is done
+    void setPatterns (const PatternList::Patterns* newPatterns) noexcept
+    {
+        patterns = newPatterns;
+    }
+
+    // forgets the notes the clips hold, without stopping them
+    void reset() noexcept
+    {
+        soundingClips.fill ({});
+        noteHoldCounts.fill (0);
+    }
+
+    void fillNextMidiBuffer (const PlayHead& playHead, juce::MidiBuffer& buffer, int numSamples) override
+    {
+        if (arrangement == nullptr || patterns == nullptr)
+            return;
+
+        // the ticks are played one at a time, so the notes that overlapping clips share are held and let go in order
+        forEachTickRange (playHead, [&] (const TickRange& range) {
+            for (auto tick = range.startTick; tick < range.endTick; ++tick)
+            {
+                arrangement->forEachClipInRange (tick, tick + 1, [&] (const Clip& clip) {
+                    if (auto* pattern = PatternList::findPattern (*patterns, clip.patternId))
+                        playClipTick (clip, pattern->melody, tick, range.getSampleOfTick (tick, numSamples), buffer);
+                });
+            }
+        });
+    }
+
+private:
+    // the notes a clip holds, a clip is recognised by its pattern and start tick
+    struct SoundingClip
+    {
+        int patternId = 0;
+        uint64_t startTick = 0;
+        std::bitset<128> notes { 0 };
+    };
+
+    static constexpr auto maxNumSoundingClips = 32;
+
+    const Arrangement* arrangement;
+    const PatternList::Patterns* patterns = nullptr;
+    std::array<SoundingClip, maxNumSoundingClips> soundingClips {};
+
+    // overlapping clips can hold the same note, it's only stopped when the last clip that holds it lets it go
+    std::array<uint8_t, 128> noteHoldCounts {};
+
+
+    // when the pattern loops or the clip ends, the notes the clip still holds are stopped (like the track does at the
+    // end of its loop), before anything else happens at that tick
+    void playClipTick (const Clip& clip, const Melody& melody, uint64_t tick, int samplePosition, juce::MidiBuffer& buffer)
+    {
+        if (tick == clip.getEndTick())
+        {
+            stopSoundingNotes (clip, buffer, samplePosition);
+            return;
+        }
+
+        auto patternTick = clip.getPatternTick (tick);
+
+        if (clip.isLooping() && patternTick == 0 && tick != clip.startTick)
+            stopSoundingNotes (clip, buffer, samplePosition);
+
+        // the events of a pattern are looked up with a binary search, since multiple clips can play the same pattern
+        auto cursor = Melody::Cursor {};
+
+        melody.forEachEventInRange (cursor, patternTick, patternTick + 1, [&] (const Event& event) {
+            auto noteNumber = event.midiNote + clip.transpose;
+
+            if (noteNumber < 0 || noteNumber > 127)
+                return;
+
+            if (event.isNoteOn)
+            {
+                holdNote (clip, noteNumber);
+                buffer.addEvent (juce::MidiMessage::noteOn (1, noteNumber, (uint8_t) event.velocity), samplePosition);
+            }
+            else if (releaseNote (clip, noteNumber))
+            {
+                buffer.addEvent (juce::MidiMessage::noteOff (1, noteNumber, (uint8_t) event.velocity), samplePosition);
+            }
+        });
+    }
+
+    // returns the notes of the clip, or of a free slot if the clip holds nothing yet (nullptr if all slots are taken)
+    std::bitset<128>* findNotesOfClip (const Clip& clip, bool addIfMissing) noexcept
+    {
+        SoundingClip* freeSlot = nullptr;
+
+        for (auto& slot : soundingClips)
+        {
+            if (slot.notes.none())
+            {
+                if (freeSlot == nullptr)
+                    freeSlot = &slot;
+            }
+            else if (slot.patternId == clip.patternId && slot.startTick == clip.startTick)
+            {
+                return &slot.notes;
+            }
+        }
+
+        if (! addIfMissing || freeSlot == nullptr)
+            return nullptr;
+
+        freeSlot->patternId = clip.patternId;
+        freeSlot->startTick = clip.startTick;
+        return &freeSlot->notes;
+    }
+
+    void holdNote (const Clip& clip, int noteNumber) noexcept
+    {
+        // with more overlapping clips than slots the note isn't held by anyone, so the next note off stops it
+        if (auto* notes = findNotesOfClip (clip, true); notes != nullptr && ! notes->test ((size_t) noteNumber))
+        {
+            notes->set ((size_t) noteNumber);
+            ++noteHoldCounts[(size_t) noteNumber];
+        }
+    }
+
+    // returns whether the note should be stopped, which is not the case when another clip still holds it
+    bool releaseNote (const Clip& clip, int noteNumber) noexcept
+    {
+        if (auto* notes = findNotesOfClip (clip, false); notes != nullptr && notes->test ((size_t) noteNumber))
+        {
+            notes->reset ((size_t) noteNumber);
+            --noteHoldCounts[(size_t) noteNumber];
+        }
+
+        return noteHoldCounts[(size_t) noteNumber] == 0;
+    }
+
+    void stopSoundingNotes (const Clip& clip, juce::MidiBuffer& buffer, int samplePosition)
+    {
+        auto* notes = findNotesOfClip (clip, false);
+
+        if (notes == nullptr)
+            return;
+
+        for (auto i = 0; i < (int) notes->size(); ++i)
+            if (notes->test ((size_t) i) && releaseNote (clip, i))
+                buffer.addEvent (juce::MidiMessage::noteOff (1, i), samplePosition);
+    }
+};
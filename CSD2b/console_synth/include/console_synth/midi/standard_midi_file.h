@@ -0,0 +1,56 @@
+
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <console_synth/sequencer/melody.h>
+#include <console_synth/sequencer/melody_generator.h>
+#include <console_synth/sequencer/meter_map.h>
+#include <console_synth/sequencer/tempo_map.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <stdexcept>
+#include <vector>
+
+/* Reads melodies from (and writes them to) standard midi files, through juce::MidiFile.
+ * The time stamps are rescaled from the ticks per quarter note of the file to those of the sequencer (to the nearest tick),
+ * the notes of all tracks and channels of a file end up in the same melody.
+ * Importing replaces the notes of the melody in a single edit batch, so the melody builds its events once, however big the file is.
+ * Exporting writes the events in the order the melody already keeps them in, so they don't have to be sorted again.
+ * The tempo changes of the tempo map are written as tempo events. A midi file can't ramp the tempo, so a ramp is written
+ * as a step every sixteenth note, each with the average tempo of its step (so every step starts at the same time as in the ramp).
+ * A file that can't be read throws a ReadError.
+ * */
+
+class StandardMidiFile
+{
+public:
+    using Note = MelodyGenerator::Note;
+
+    struct ReadError;
+
+    // the notes of all tracks in the file, sorted by their start, in the given ticks per quarter note
+    [[nodiscard]] static std::vector<Note> readNotes (juce::InputStream& stream, uint32_t ticksPerQuarterNote);
+
+    // replaces all notes of the melody node (not undoable, like generating a melody)
+    static void replaceNotes (juce::ValueTree melodyTree, const std::vector<Note>& notes);
+
+    // reads the file into the melody node, returns the number of notes
+    static size_t importFile (const juce::File& file, juce::ValueTree melodyTree, uint32_t ticksPerQuarterNote);
+
+    // a single track with the melody, the time signatures of the meter map and the tempo changes (in the ticks of the meter map)
+    [[nodiscard]] static juce::MidiFile createMidiFile (const Melody& melody, const MeterMap& meterMap, const TempoMap& tempoMap);
+
+    // returns false if the file couldn't be written
+    static bool exportFile (const juce::File& file, const Melody& melody, const MeterMap& meterMap, const TempoMap& tempoMap);
+
+private:
+    static void addTempoEvents (juce::MidiMessageSequence& sequence, const TempoMap& tempoMap);
+
+    [[nodiscard]] static int rescale (double fileTick, int fileTicksPerQuarterNote, uint32_t ticksPerQuarterNote) noexcept;
+};
+
+
+struct StandardMidiFile::ReadError : std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
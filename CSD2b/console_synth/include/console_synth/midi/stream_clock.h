@@ -0,0 +1,77 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <cmath>
+#include <juce_core/juce_core.h>
+
+/* The audio callbacks don't come in at a steady pace (the audio thread can wake up late by up to a block), so the time at
+ * which a callback starts is a bad measure of when its block starts playing. This turns those times into a smooth clock
+ * for the device stream. The length of a block (in seconds, which drifts a little with the clock of the device) is followed
+ * by a delay locked loop, as described by Fons Adriaensen in "Using a DLL to filter time". The start of a block is found
+ * from the other side: a callback is never early, so a block can't start after its callback, and it starts one filtered
+ * block length after the previous one did. It slowly creeps later, so it keeps up when the stream really starts later.
+ * Anything with a time stamp on the same clock (e.g. the midi input devices) can be placed at the sample it belongs to.
+ * */
+
+class StreamClock
+{
+public:
+    // the bandwidth says how fast the loop follows the callbacks, lower filters out more jitter but takes longer to settle
+    explicit StreamClock (double bandwidthHz = 0.1) noexcept : bandwidth { bandwidthHz } {}
+
+    // starts over at the next update
+    void reset() noexcept { isRunning = false; }
+
+    // should be called at the start of every block, with the current time (unfiltered) in seconds
+    void update (double currentTimeSeconds, int numSamples, double sampleRate) noexcept
+    {
+        const auto period = numSamples / sampleRate;
+
+        if (isRunning && numSamples == blockSize)
+        {
+            const auto error = currentTimeSeconds - nextCallback;
+
+            // when the callback is way off (the device was stopped or there was a drop out), the clock starts over
+            if (std::abs (error) < period * maxErrorInPeriods)
+            {
+                nextCallback += b * error + filteredPeriod;
+                filteredPeriod += c * error;
+                blockStart = std::min (blockStart + filteredPeriod * (1.0 + creep), currentTimeSeconds);
+                return;
+            }
+        }
+
+        const auto omega = juce::MathConstants<double>::twoPi * bandwidth * period;
+        b = std::sqrt (2.0) * omega;
+        c = omega * omega;
+
+        blockStart = currentTimeSeconds;
+        filteredPeriod = period;
+        nextCallback = currentTimeSeconds + period;
+        blockSize = numSamples;
+        isRunning = true;
+    }
+
+    // the (filtered) time at which the current block started
+    [[nodiscard]] double getBlockStartTime() const noexcept { return blockStart; }
+
+    // where the time is relative to the start of the current block, in samples (negative for a time before the block)
+    [[nodiscard]] double getSamplesSinceBlockStart (double timeSeconds) const noexcept
+    {
+        return (timeSeconds - blockStart) * blockSize / filteredPeriod;
+    }
+
+private:
+    static constexpr auto maxErrorInPeriods = 4.0;
+    static constexpr auto creep = 1.0e-4;
+
+    double bandwidth;
+    double b = 0.0;
+    double c = 0.0;
+    double nextCallback = 0.0;
+    double filteredPeriod = 0.0;
+    double blockStart = 0.0;
+    int blockSize = 0;
+    bool isRunning = false;
+};
@@ -0,0 +1,76 @@
+
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <console_synth/sequencer/sequencer.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <stdexcept>
+
+/* Renders the sequencer to an audio file without an audio device, as fast as the cpu can render the blocks.
+ * The sequencer is exported from the start of the timeline (the live midi is left out), one block after another in a loop
+ * on the calling thread. The blocks are handed to a writer on a background thread through a fifo, so the render loop
+ * doesn't wait for the disk (only when the fifo is full, when the disk can't keep up).
+ * The output is aligned to the timeline: the latency of the master limiter is rendered extra and cut off at the start.
+ * The sequencer shouldn't be played by an audio device at the same time (see Engine, which stops the device while rendering).
+ * The format of the file depends on its extension: .flac is written as flac, everything else as wav.
+ * */
+
+struct OfflineRenderSettings
+{
+    double sampleRate = 48'000.0;
+    int blockSize = 512;
+    int numChannels = 2;
+    int bitsPerSample = 24;
+
+    // rendered after the end, so the reverb and delay can ring out
+    double tailSeconds = 0.0;
+
+    // the size of the fifo of the background writer
+    int writerBufferSamples = 1 << 17;
+};
+
+
+class OfflineRenderer
+{
+public:
+    struct Result
+    {
+        uint64_t numSamples = 0;
+        double sampleRate = 0.0;
+        double renderSeconds = 0.0; // the wall clock time, until the file was completely written
+
+        [[nodiscard]] double getAudioSeconds() const noexcept { return sampleRate > 0.0 ? (double) numSamples / sampleRate : 0.0; }
+
+        // how many times faster than realtime the audio was rendered
+        [[nodiscard]] double getRealtimeFactor() const noexcept { return renderSeconds > 0.0 ? getAudioSeconds() / renderSeconds : 0.0; }
+    };
+
+    struct RenderError : std::runtime_error
+    {
+        using std::runtime_error::runtime_error;
+    };
+
+    explicit OfflineRenderer (Sequencer& sequencerToRender);
+    ~OfflineRenderer();
+
+    // The render functions throw a RenderError if the file can't be written. Message thread only
+    Result renderBars (const juce::File& file, uint32_t numBars, const OfflineRenderSettings& settings = {});
+
+    Result renderLoops (const juce::File& file, uint32_t numLoops, const OfflineRenderSettings& settings = {});
+
+private:
+    Sequencer& sequencer;
+
+    // the thread of the background writer, it keeps running between renders
+    juce::TimeSliceThread writerThread { "offline render writer" };
+
+
+    // the length is asked for after the sequencer is prepared, since it depends on the sample rate
+    template <typename LengthFunction>
+    Result render (const juce::File& file, const OfflineRenderSettings& settings, LengthFunction&& getLengthSamples);
+
+    [[nodiscard]] static std::unique_ptr<juce::AudioFormatWriter> createWriter (const juce::File& file, const OfflineRenderSettings& settings);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (OfflineRenderer);
+};
@@ -0,0 +1,86 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <console_synth/identifiers.h>
+#include <console_synth/utility/atomic_snapshot.h>
+#include <console_synth/utility/interval_index.h>
+#include <cstdint>
+#include <vector>
+
+/* The clips on the timeline of a track. A clip plays a pattern (by id) from its start tick for its length:
+ *  - the offset is where in the pattern the clip starts playing
+ *  - with a loop length, the pattern repeats its first loop length ticks for as long as the clip lasts,
+ *    without it the pattern plays once (and the clip is silent after the pattern is done)
+ *  - the transpose is added to every note of the pattern
+ * The clips are clip nodes in the arrangement node of the track. Every change builds a new (immutable) clip list
+ * with an interval index, so the audio thread finds the clips that play in a block in O(log n).
+ * */
+
+struct Clip
+{
+    int patternId;
+    uint64_t startTick;
+    uint64_t lengthTicks;
+    uint64_t offsetTicks;
+    uint64_t loopLengthTicks;
+    int transpose;
+
+    [[nodiscard]] uint64_t getEndTick() const noexcept { return startTick + lengthTicks; }
+
+    [[nodiscard]] bool isLooping() const noexcept { return loopLengthTicks > 0; }
+
+    // the tick in the pattern that plays at the given tick on the timeline (which should be in the clip)
+    [[nodiscard]] uint64_t getPatternTick (uint64_t tick) const noexcept
+    {
+        auto patternTick = offsetTicks + (tick - startTick);
+        return isLooping() ? patternTick % loopLengthTicks : patternTick;
+    }
+
+    [[nodiscard]] static Clip fromState (const juce::ValueTree& clipState);
+};
+
+
+class Arrangement : private juce::ValueTree::Listener
+{
+public:
+    // the arrangement node is created in the track state if it doesn't have one yet
+    explicit Arrangement (juce::ValueTree& trackState);
+    ~Arrangement() override;
+
+    // calls the function with every clip that plays in [startTick, endTick), in the order of their start ticks.
+    // a clip that ends in the range is found as well (so its notes can be stopped at its end). Wait free.
+    template <typename Functor>
+    void forEachClipInRange (uint64_t startTick, uint64_t endTick, Functor&& function) const
+    {
+        auto clipList = clips.read();
+
+        clipList->index.forEachOverlap (startTick, endTick, [&] (size_t id) {
+            function (clipList->clips[id]);
+        });
+    }
+
+    [[nodiscard]] size_t getNumClips() const noexcept;
+
+    // deletes the clip lists the audio thread is done with, message thread only
+    void collectGarbage();
+
+private:
+    struct ClipList
+    {
+        std::vector<Clip> clips;
+        IntervalIndex index;
+    };
+
+    juce::ValueTree arrangementState;
+    AtomicSnapshot<ClipList> clips;
+
+
+    void rebuildClips();
+
+    void valueTreeChildAdded (juce::ValueTree& parent, juce::ValueTree& child) override;
+    void valueTreeChildRemoved (juce::ValueTree& parent, juce::ValueTree& child, int index) override;
+    void valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier& property) override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Arrangement);
+};
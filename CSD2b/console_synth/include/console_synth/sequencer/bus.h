@@ -0,0 +1,49 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <console_synth/audio/processor_chain.h>
+#include <console_synth/identifiers.h>
+#include <juce_data_structures/juce_data_structures.h>
+
+/* An aux (send) bus. Every track can send part of its signal to a bus (set by the send level of the track),
+ * which gets mixed into the bus buffer. After all tracks have rendered, the bus processes its effect chain
+ * once for the whole block and adds the result to the output. This way a single reverb (or any other effect)
+ * can be shared by all tracks, instead of every track needing its own instance.
+ * */
+
+class Bus
+{
+public:
+    Bus (juce::ValueTree parent, const juce::String& name);
+    ~Bus() = default;
+
+    static constexpr auto maxNumBusses = 8;
+
+    void prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock);
+
+    void releaseResources();
+
+    // clears the bus buffer, should be called at the start of every block before the tracks send to it
+    void startNextBlock (int numChannels, int numSamples);
+
+    // mixes the given source into the bus (called by the tracks)
+    void addFrom (const juce::AudioBuffer<float>& source, float gain);
+
+    // processes the effect chain of the bus and adds the result to the destination
+    void renderNextBlock (juce::AudioBuffer<float>& destination);
+
+    template <typename EffectType>
+    void addEffect (std::unique_ptr<EffectType> effect)
+    {
+        effectChain.addEffectToChain (std::move (effect));
+    }
+
+private:
+    juce::ValueTree busState { IDs::bus };
+    ProcessorChain effectChain;
+    juce::AudioBuffer<float> busBuffer;
+    juce::MidiBuffer emptyMidiBuffer;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Bus);
+};
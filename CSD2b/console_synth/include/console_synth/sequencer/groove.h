@@ -0,0 +1,131 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <console_synth/identifiers.h>
+#include <console_synth/sequencer/play_head.h>
+#include <console_synth/utility/atomic_snapshot.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include <cstdint>
+#include <optional>
+
+/* The groove of a track changes how its sequenced notes are played, without touching the notes themselves:
+ * swing, a groove template, humanization and transposition are applied to the midi of every block on its way to the synth
+ * (see MidiTransformChain), so changing them is heard right away and never rewrites a melody.
+ * The transforms are applied in that order:
+ *  - swing: every second step of the grid is moved later, by a fraction of a step (the steps in between move along with it)
+ *  - groove template: a note is quantized to the nearest step of the template grid, plus the offset of that step,
+ *    and its velocity is scaled by the velocity of that step
+ *  - humanize: a random delay and velocity change, the same for a note every time it plays (see seed)
+ *  - transpose
+ * There's no lookahead, so the timing can only move notes later: the groove template only moves a note to a step
+ * that's at or after it. Every note off is moved as much as its note on, so the notes keep their length.
+ * */
+
+struct GrooveSettings
+{
+    static constexpr auto maxNumGrooveSteps = 32;
+
+    double swing = 0.0; // 0 is straight, 1/3 is a triplet feel
+    uint64_t swingGridTicks = 12;
+    uint64_t grooveGridTicks = 12;
+    int numGrooveSteps = 0; // 0 means no groove template
+    std::array<double, maxNumGrooveSteps> grooveOffsetTicks {};
+    std::array<double, maxNumGrooveSteps> grooveVelocities {}; // as a factor of the velocity
+    double humanizeTicks = 0.0;
+    int humanizeVelocity = 0;
+    int64_t seed = 0;
+    int transpose = 0;
+
+    [[nodiscard]] bool isNeutral() const noexcept
+    {
+        return swing == 0.0 && numGrooveSteps == 0 && humanizeTicks == 0.0 && humanizeVelocity == 0 && transpose == 0;
+    }
+
+    // the settings of a groove node, everything out of range is clamped
+    [[nodiscard]] static GrooveSettings fromState (const juce::ValueTree& state);
+};
+
+
+class Groove : private juce::ValueTree::Listener
+{
+public:
+    // the groove node is created in the track state if it doesn't have one yet
+    explicit Groove (juce::ValueTree& trackState);
+    ~Groove() override;
+
+    // the current settings, wait free
+    [[nodiscard]] AtomicSnapshot<GrooveSettings>::ReadScope read() const noexcept;
+
+    // deletes the old settings, message thread only
+    void collectGarbage();
+
+private:
+    juce::ValueTree grooveState;
+    AtomicSnapshot<GrooveSettings> settings;
+
+
+    void valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier& property) override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Groove);
+};
+
+
+// ===================================================================================================
+
+// Applies the groove to the midi of a block, in place. Notes that are moved past the end of the block wait in a
+// fixed size list until the block they fall in, so nothing is allocated. When that list is full, a note on that has
+// to wait is dropped, and a note off is played at the end of the block, along with dropping the note ons of that note
+// that are still waiting (so a note off never comes before its note on).
+// A block has room for maxNumEventsPerBlock events, when there are more the note ons are dropped before the note offs.
+// When the play head jumps (not when it loops), the waiting note ons are dropped and their note offs played right away.
+class MidiTransformChain
+{
+public:
+    // the buffer should only have the midi of the sequenced sources (channel 1)
+    void process (const GrooveSettings& settings, const PlayHead& playHead, juce::MidiBuffer& buffer, int numSamples);
+
+    // drops the waiting events and forgets the notes that were played, without stopping them
+    void reset() noexcept;
+
+    static constexpr auto maxNumPendingEvents = size_t { 256 };
+    static constexpr auto maxNumEventsPerBlock = size_t { 512 };
+
+private:
+    struct Event
+    {
+        uint64_t samplePosition; // counted from the first block this chain processed
+        uint8_t data[3];
+        int inputNote; // the note before it was transposed
+    };
+
+    // what happened to a note when its note on was played, so its note off gets the same treatment
+    struct PlayedNote
+    {
+        int outputNote = -1;
+        uint64_t delaySamples = 0;
+    };
+
+    std::array<Event, maxNumPendingEvents> pendingEvents {};
+    size_t numPendingEvents = 0;
+    std::array<Event, maxNumEventsPerBlock> blockEvents {};
+    std::array<PlayedNote, 128> playedNotes {};
+    std::array<uint64_t, 128> lastSampleOfNote {};
+    uint64_t blockStart = 0;
+    std::optional<uint64_t> expectedTimelinePosition;
+
+
+    [[nodiscard]] static uint64_t getDelaySamples (const PlayHead& playHead, double tick, double delayTicks, int numSamples);
+
+    // nothing when the note is transposed out of range
+    [[nodiscard]] std::optional<Event> transformNoteOn (const GrooveSettings& settings, const PlayHead& playHead, const Event& event, int numSamples);
+
+    [[nodiscard]] Event transformNoteOff (const Event& event);
+
+    void schedule (const Event& event, juce::MidiBuffer& buffer, int numSamples);
+
+    void removePendingNoteOns (int outputNote) noexcept;
+
+    void flushPendingEvents (juce::MidiBuffer& buffer);
+};
@@ -4,10 +4,12 @@
 #pragma once
 
 #include <console_synth/identifiers.h>
+#include <console_synth/utility/atomic_snapshot.h>
 #include <console_synth/utility/drow_ValueTreeObjectList.h>
 #include <console_synth/utility/property.h>
 #include <utility>
 #include <console_synth/sequencer/time_signature.h>
+#include <algorithm>
 #include <cstdint>
 #include <functional>
 #include <utility>
@@ -59,10 +61,11 @@ struct Note
 
 struct Melody : private drow::ValueTreeObjectList<Note>
 {
-    explicit Melody (juce::ValueTree& tree) : drow::ValueTreeObjectList<Note> { juce::ValueTree { IDs::melody } }
+    // uses the melody node in the given tree if there is one (so existing notes are kept), otherwise it adds one
+    explicit Melody (juce::ValueTree& tree) : drow::ValueTreeObjectList<Note> { tree.getOrCreateChildWithName (IDs::melody, nullptr) }
     {
-        tree.appendChild (drow::ValueTreeObjectList<Note>::parent, nullptr);
         rebuildObjects();
+        rebuildEventList();
     }
 
     ~Melody() override
@@ -75,40 +78,130 @@ struct Melody : private drow::ValueTreeObjectList<Note>
     // could result in a dangling reference if a new melody was generated while the
     // sequencer was still using the old sequencer events.
     // and returning a copy of the events is very expensive, since it requires a heap allocation.
-    // the function has to acquire the lock, so it might have to wait a very small time.
+    // the events are published as immutable snapshots, so this never has to wait (see AtomicSnapshot).
     template <typename Functor>
-    void forEachEvent (Functor&& function)
+    void forEachEvent (Functor&& function) const
     {
-        auto lock = std::scoped_lock { eventsMutex };
-        std::for_each (events.begin(), events.end(), std::forward<Functor> (function));
+        auto eventList = eventListSnapshot.read();
+        std::for_each (eventList->events.begin(), eventList->events.end(), std::forward<Functor> (function));
+    }
+
+    // Remembers where the last lookup ended, so the next lookup can continue from there
+    // when it starts where the previous one stopped (which is the normal case during playback).
+    struct Cursor
+    {
+        size_t index = 0;
+        uint64_t tick = 0;
+        uint64_t eventListVersion = 0;
+    };
+
+    // Applies the function to each event with a time stamp within [startTick, endTick), in order.
+    // The events are sorted by time stamp, so this finds the first event with a binary search
+    // (or continues from the cursor), which means it never has to look at events outside the range.
+    template <typename Functor>
+    void forEachEventInRange (Cursor& cursor, uint64_t startTick, uint64_t endTick, Functor&& function) const
+    {
+        auto eventList = eventListSnapshot.read();
+        const auto& events = eventList->events;
+
+        auto index = cursor.index;
+
+        if (cursor.eventListVersion != eventList->version || cursor.tick != startTick || index > events.size())
+            index = findFirstEventAtOrAfter (events, startTick);
+
+        for (; index < events.size() && (uint64_t) events[index].timeStampTicks < endTick; ++index)
+            function (events[index]);
+
+        cursor = { index, endTick, eventList->version };
+    }
+
+    // deletes the old event lists that were still being read when the events changed, message thread only
+    void collectGarbage()
+    {
+        eventListSnapshot.collectGarbage();
+    }
+
+    [[nodiscard]] size_t getNumRetiredEventLists() const noexcept
+    {
+        return eventListSnapshot.getNumRetiredSnapshots();
     }
 
 private:
-    std::vector<Event> events;
-    std::mutex eventsMutex;
+    struct EventList
+    {
+        std::vector<Event> events;
+        uint64_t version = 0;
+    };
+
+    AtomicSnapshot<EventList> eventListSnapshot;
+
+    // only used on the message thread, the audio thread only sees the published copies
+    std::vector<Event> sortedEvents;
+    bool isInEditBatch = false;
+
+
+    [[nodiscard]] static size_t findFirstEventAtOrAfter (const std::vector<Event>& events, uint64_t tick)
+    {
+        auto it = std::lower_bound (events.begin(), events.end(), tick, [] (const Event& e, uint64_t t) {
+            return (uint64_t) e.timeStampTicks < t;
+        });
+
+        return (size_t) std::distance (events.begin(), it);
+    }
+
+    // sorted by time stamp, so the events in a tick range can be found with a binary search.
+    // when a note on and note off event occur at the same tick,
+    // it should first handle the note off and then the note on
+    [[nodiscard]] static bool isEarlier (const Event& a, const Event& b) noexcept
+    {
+        if (a.timeStampTicks == b.timeStampTicks)
+            return ! a.isNoteOn && b.isNoteOn;
+
+        return a.timeStampTicks < b.timeStampTicks;
+    }
 
     void rebuildEventList()
     {
-        auto newEvents = std::vector<Event> (objects.size() * 2);
+        sortedEvents.clear();
+        sortedEvents.reserve ((size_t) objects.size() * 2);
 
         for (auto* note : objects)
         {
             auto [e1, e2] = note->getSequencerEvents();
-            newEvents.emplace_back (e1);
-            newEvents.emplace_back (e2);
+            sortedEvents.emplace_back (e1);
+            sortedEvents.emplace_back (e2);
         }
 
-        // when a note on and note off event for the same note at the same tick occur,
-        // it should first handle the note off and then the note on
-        std::sort (newEvents.begin(), newEvents.end(), [] (const auto& a, const auto& b) {
-            if (a.timeStampTicks == b.timeStampTicks && a.midiNote == b.midiNote)
-                return ! a.isNoteOn;
+        std::sort (sortedEvents.begin(), sortedEvents.end(), isEarlier);
+        publishEventList();
+    }
 
-            return a.timeStampTicks > b.timeStampTicks;
+    void insertEvent (const Event& event)
+    {
+        auto position = std::upper_bound (sortedEvents.begin(), sortedEvents.end(), event, isEarlier);
+        sortedEvents.insert (position, event);
+    }
+
+    // returns false if the event wasn't found
+    bool removeEvent (const Event& event)
+    {
+        auto [first, last] = std::equal_range (sortedEvents.begin(), sortedEvents.end(), event, isEarlier);
+
+        auto match = std::find_if (first, last, [&] (const Event& e) {
+            return e.midiNote == event.midiNote && e.velocity == event.velocity;
         });
 
-        auto eventsLock = std::scoped_lock { eventsMutex };
-        events = std::move (newEvents);
+        if (match == last)
+            return false;
+
+        sortedEvents.erase (match);
+        return true;
+    }
+
+    void publishEventList()
+    {
+        auto version = eventListSnapshot.getLatestForWriter().version + 1;
+        eventListSnapshot.publish (std::make_unique<const EventList> (EventList { sortedEvents, version }));
     }
 
 
@@ -127,15 +220,94 @@ private:
         return tree.hasType (IDs::note);
     }
 
-    void newObjectAdded (Note*) override
+    // a single note only has to be inserted in (or removed from) the sorted events,
+    // during a batch nothing happens until the batch is done, then the whole list is rebuilt once
+    void newObjectAdded (Note* note) override
     {
-        rebuildEventList();
+        if (isInEditBatch)
+            return;
+
+        auto [noteOn, noteOff] = note->getSequencerEvents();
+        insertEvent (noteOn);
+        insertEvent (noteOff);
+        publishEventList();
     }
 
-    void objectRemoved (Note*) override
+    void objectRemoved (Note* note) override
     {
-        rebuildEventList();
+        if (isInEditBatch)
+            return;
+
+        auto [noteOn, noteOff] = note->getSequencerEvents();
+
+        // if the note was changed after it was added, its events can't be found anymore
+        if (! (removeEvent (noteOn) && removeEvent (noteOff)))
+        {
+            rebuildEventList();
+            return;
+        }
+
+        publishEventList();
     }
 
     void objectOrderChanged() override {}
-};
\ No newline at end of file
+
+    // During a batch the notes aren't even looked up (finding where a note is in the list takes a search over all notes,
+    // which adds up when a whole file is imported), the notes are created again from the tree when the batch ends.
+    void valueTreeChildAdded (juce::ValueTree& parentTree, juce::ValueTree& tree) override
+    {
+        if (! isInEditBatch)
+            drow::ValueTreeObjectList<Note>::valueTreeChildAdded (parentTree, tree);
+    }
+
+    void valueTreeChildRemoved (juce::ValueTree& parentTree, juce::ValueTree& tree, int index) override
+    {
+        if (! isInEditBatch)
+            drow::ValueTreeObjectList<Note>::valueTreeChildRemoved (parentTree, tree, index);
+    }
+
+    void valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier& property) override
+    {
+        if (tree == drow::ValueTreeObjectList<Note>::parent && property == IDs::editBatch)
+        {
+            isInEditBatch = tree.hasProperty (IDs::editBatch);
+
+            if (! isInEditBatch)
+            {
+                deleteAllObjects();
+                rebuildObjects();
+                rebuildEventList();
+            }
+        }
+    }
+};
+
+
+// ===================================================================================================
+
+// Marks a series of edits to a melody tree (e.g. generating or importing a melody) as one batch:
+// the melody doesn't update its events for every added or removed note, but only once when the batch ends.
+// This works through a property on the melody tree, so it only needs the tree, not the Melody object.
+// Nesting is allowed, only the outermost batch counts.
+class ScopedMelodyEditBatch
+{
+public:
+    explicit ScopedMelodyEditBatch (juce::ValueTree tree)
+        : melodyTree { std::move (tree) }, isOutermostBatch { ! melodyTree.hasProperty (IDs::editBatch) }
+    {
+        if (isOutermostBatch)
+            melodyTree.setProperty (IDs::editBatch, true, nullptr);
+    }
+
+    ~ScopedMelodyEditBatch()
+    {
+        if (isOutermostBatch)
+            melodyTree.removeProperty (IDs::editBatch, nullptr);
+    }
+
+private:
+    juce::ValueTree melodyTree;
+    bool isOutermostBatch;
+
+    JUCE_DECLARE_NON_COPYABLE (ScopedMelodyEditBatch);
+};
@@ -4,8 +4,19 @@
 #pragma once
 
 #include <console_synth/sequencer/melody.h>
-#include <console_synth/sequencer/time_signature.h>
+#include <console_synth/sequencer/meter_map.h>
 #include <juce_data_structures/juce_data_structures.h>
+#include <array>
+#include <atomic>
+#include <thread>
+
+/* Generates random melodies. With a seed, the same seed always gives the same melody.
+ * For generating a lot of melodies at once (e.g. for a data set), generateNotes() gives the notes as plain structs
+ * instead of a value tree, and generateMelodies() generates a batch of them on multiple threads.
+ * Every melody in a batch gets its own random generator, seeded with the seed of the batch and the index of the melody,
+ * so melody i of a batch is the same whatever the number of threads (and the same as generating it on its own,
+ * with getSeedOfMelody (seed, i)).
+ * */
 
 class MelodyGenerator
 {
@@ -15,33 +26,95 @@ public:
         int number, start, length, velocity;
     };
 
-    juce::ValueTree generateMelody (const TimeSignature& timeSignature)
+    // uses a random seed
+    MelodyGenerator() = default;
+
+    explicit MelodyGenerator (juce::int64 seed) : random { seed } {}
+
+    // generates two notes per beat for the given number of bars, where a beat is the denominator
+    // of the time signature of each bar (so 7/8 gets 14 sixteenth notes, 4/4 gets 8 eighth notes)
+    juce::ValueTree generateMelody (const MeterMap& meterMap, uint32_t numBars = 1)
     {
-        auto ticks = timeSignature.getTicksPerBar();
         auto result = juce::ValueTree { IDs::melody };
 
-        auto ticksPerNote = timeSignature.getTicksPerQuarterNote() / 2;
-        auto numNotes = timeSignature.getNumerator() * 2;
+        for (const auto& note : generateNotes (meterMap, numBars))
+            addNoteToTree (result, note);
 
-        auto relativeNotes = generateRelativeNotes (numNotes);
-        auto absoluteNoteNumbers = std::vector<int> {};
-        absoluteNoteNumbers.reserve (relativeNotes.size());
+        return result;
+    }
 
-        auto offset = random.nextInt ({ 60, 80 });
+    // the same as generateMelody(), without the value tree
+    std::vector<Note> generateNotes (const MeterMap& meterMap, uint32_t numBars = 1)
+    {
+        auto numNotes = 0;
+
+        for (auto bar = uint32_t { 0 }; bar < numBars; ++bar)
+            numNotes += (int) meterMap.getTimeSignatureAtBar (bar).getNumerator() * 2;
 
-        for (auto n : relativeNotes)
-            absoluteNoteNumbers.push_back (n + offset);
+        auto notes = std::vector<Note> {};
+        notes.reserve ((size_t) numNotes);
 
-        auto tick = 0;
+        auto relativeNotes = generateRelativeNotes (numNotes);
+        auto offset = random.nextInt ({ 60, 80 });
+        auto noteIndex = size_t { 0 };
 
-        for (auto num : absoluteNoteNumbers)
+        for (auto bar = uint32_t { 0 }; bar < numBars; ++bar)
         {
-            auto note = Note { num, tick, (int) ticksPerNote, 127 };
-            addNoteToTree (result, note);
-            tick += ticksPerNote;
+            const auto& timeSignature = meterMap.getTimeSignatureAtBar (bar);
+            auto ticksPerNote = timeSignature.getTicksPerDenominator() / 2;
+            auto tick = meterMap.getTickOfBar (bar);
+
+            for (auto i = 0u; i < timeSignature.getNumerator() * 2; ++i)
+            {
+                notes.push_back ({ relativeNotes[noteIndex++] + offset, (int) tick, (int) ticksPerNote, 127 });
+                tick += ticksPerNote;
+            }
         }
 
-        return result;
+        return notes;
+    }
+
+    // Generates numMelodies melodies on numThreads threads (the calling thread is one of them), see the description above.
+    // The meter map is only read, so it can be shared by all threads.
+    static std::vector<std::vector<Note>> generateMelodies (const MeterMap& meterMap,
+                                                            uint32_t numBars,
+                                                            int numMelodies,
+                                                            juce::int64 seed,
+                                                            int numThreads = (int) std::thread::hardware_concurrency())
+    {
+        auto melodies = std::vector<std::vector<Note>> ((size_t) std::max (numMelodies, 0));
+        auto nextMelody = std::atomic<int> { 0 };
+
+        // every thread takes the next melody until there are none left, the melodies are written to their own slot
+        auto generate = [&] {
+            for (auto index = nextMelody++; index < numMelodies; index = nextMelody++)
+            {
+                auto generator = MelodyGenerator { getSeedOfMelody (seed, index) };
+                melodies[(size_t) index] = generator.generateNotes (meterMap, numBars);
+            }
+        };
+
+        auto threads = std::vector<std::thread> {};
+
+        for (auto i = 1; i < std::min (numThreads, numMelodies); ++i)
+            threads.emplace_back (generate);
+
+        generate();
+
+        for (auto& thread : threads)
+            thread.join();
+
+        return melodies;
+    }
+
+    // the seed of a melody in a batch, the bits of the seed and index are mixed (splitmix64),
+    // so the generators of neighbouring melodies don't start out alike
+    static juce::int64 getSeedOfMelody (juce::int64 seed, int index) noexcept
+    {
+        auto x = (uint64_t) seed + ((uint64_t) index + 1) * 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return (juce::int64) (x ^ (x >> 31));
     }
 
     static void addNoteToTree (juce::ValueTree& tree, const Note& note)
@@ -58,17 +131,19 @@ public:
     std::vector<int> generateRelativeNotes (int numNotes) noexcept
     {
         auto notes = std::vector<int> {};
-        auto distances = std::vector { 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 3, 4 };
+        notes.reserve ((size_t) std::max (numNotes, 1));
+
+        static constexpr auto distances = std::array { 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 3, 4 };
         auto groundIndex = random.nextInt ({ 1, 5 });
         auto currentNoteIndex = groundIndex;
-        notes.push_back (normalizedMidiNoteDistances[currentNoteIndex]);
+        notes.push_back (normalizedMidiNoteDistances[(size_t) currentNoteIndex]);
 
         for (int i = 1; i < numNotes; ++i)
         {
             auto direction = random.nextBool() ? 1 : -1;
-            auto interval = direction * distances[random.nextInt (distances.size())];
+            auto interval = direction * distances[(size_t) random.nextInt ((int) distances.size())];
             currentNoteIndex = juce::jlimit (0, (int) normalizedMidiNoteDistances.size() - 1, currentNoteIndex + interval);
-            notes.push_back (normalizedMidiNoteDistances[currentNoteIndex]);
+            notes.push_back (normalizedMidiNoteDistances[(size_t) currentNoteIndex]);
         }
 
         std::reverse (std::begin (notes), std::end (notes));
@@ -78,5 +153,5 @@ public:
 
 
     juce::Random random;
-    const std::vector<int> normalizedMidiNoteDistances = { 0, 2, 4, 5, 7, 9, 11 };
-};
\ No newline at end of file
+    static constexpr auto normalizedMidiNoteDistances = std::array { 0, 2, 4, 5, 7, 9, 11 };
+};
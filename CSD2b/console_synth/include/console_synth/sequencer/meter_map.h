@@ -0,0 +1,63 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <console_synth/sequencer/musical_time.h>
+#include <console_synth/sequencer/time_signature.h>
+#include <cstdint>
+#include <vector>
+
+/* The time signatures of a song: a time signature change always starts at the beginning of a bar and lasts until the next one.
+ * For every change, the tick at which it starts is computed once (adding up the bars before it), so finding the bar
+ * a tick is in (or the tick a bar starts at) only takes a binary search over the changes and a division within it.
+ * An invalid time signature throws the errors of TimeSignature.
+ * */
+
+class MeterMap
+{
+public:
+    struct MeterChange
+    {
+        uint32_t bar;
+        uint32_t numerator;
+        uint32_t denominator;
+    };
+
+    // a single time signature for the whole song
+    explicit MeterMap (uint32_t ticksPerQuarterNote, uint32_t numerator = 4, uint32_t denominator = 4);
+
+    // the changes don't have to be sorted, if there's no change at bar 0, the first one is used from the start.
+    // when there are multiple changes at the same bar, the last one counts
+    MeterMap (std::vector<MeterChange> changes, uint32_t ticksPerQuarterNote);
+
+    [[nodiscard]] uint64_t getTickOfBar (uint32_t bar) const noexcept;
+
+    [[nodiscard]] uint64_t toTicks (const MusicalTime& time) const noexcept;
+
+    [[nodiscard]] MusicalTime toMusicalTime (uint64_t tick) const noexcept;
+
+    [[nodiscard]] const TimeSignature& getTimeSignatureAtBar (uint32_t bar) const noexcept;
+
+    [[nodiscard]] const TimeSignature& getTimeSignatureAtTick (uint64_t tick) const noexcept;
+
+    [[nodiscard]] uint32_t getTicksPerQuarterNote() const noexcept;
+
+    [[nodiscard]] const std::vector<MeterChange>& getMeterChanges() const noexcept;
+
+private:
+    struct Segment
+    {
+        uint32_t startBar;
+        uint64_t startTick;
+        TimeSignature timeSignature;
+    };
+
+    std::vector<MeterChange> meterChanges;
+    std::vector<Segment> segments;
+    uint32_t ticksPerQuarterNote;
+
+
+    [[nodiscard]] const Segment& findSegmentOfBar (uint32_t bar) const noexcept;
+
+    [[nodiscard]] const Segment& findSegmentOfTick (uint64_t tick) const noexcept;
+};
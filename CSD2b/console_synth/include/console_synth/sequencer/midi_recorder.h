@@ -0,0 +1,67 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <console_synth/identifiers.h>
+#include <console_synth/sequencer/play_head.h>
+#include <console_synth/utility/spsc_queue.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_data_structures/juce_data_structures.h>
+#include <array>
+#include <bitset>
+#include <optional>
+
+/* Records the live midi of a track into its melody while the sequencer is recording.
+ * The audio thread only pushes the note ons and note offs (at the tick the play head was at when they were played)
+ * into a queue that was allocated up front, so it never allocates or waits, however dense the playing gets.
+ * The message thread takes them out, pairs every note on with the note off of the same note, and adds the finished
+ * notes to the melody: all notes that are taken out at once are one undo transaction (and one melody edit batch).
+ * A note that is held over the end of the loop ends at the loop end, since the melody loops there.
+ * */
+
+class MidiRecorder
+{
+public:
+    // the state should be the melody node the notes are recorded into
+    explicit MidiRecorder (juce::ValueTree melodyState);
+
+    // Audio thread: records the note ons and note offs in the midi of the current block
+    void recordBlock (const juce::MidiBuffer& midi, const PlayHead& playHead) noexcept;
+
+    // Audio thread: ends the notes that are still held (at the start of the block), when the recording stops
+    void endHeldNotes (const PlayHead& playHead) noexcept;
+
+    // Message thread: adds the notes that were finished since the last call to the melody,
+    // returns the number of notes that were added. Doesn't start a new undo transaction, the caller decides on that
+    int commitRecordedNotes (juce::UndoManager* undoManager);
+
+    // the number of note ons and offs that didn't fit in the queue
+    [[nodiscard]] uint64_t getNumDropped() const noexcept;
+
+    static constexpr auto queueSize = size_t { 4096 };
+
+private:
+    struct RecordedEvent
+    {
+        double tick;
+        uint32_t loopEnd;
+        uint8_t noteNumber;
+        uint8_t velocity;
+        bool isNoteOn;
+    };
+
+    juce::ValueTree melodyState;
+    SpscQueue<RecordedEvent> queue { queueSize };
+    std::atomic<uint64_t> numDroppedNoteOns { 0 };
+
+    // audio thread only, the notes that are held according to the recorded midi
+    std::bitset<128> heldNotes;
+
+    // message thread only, the note ons that didn't get their note off yet
+    std::array<std::optional<RecordedEvent>, 128> pendingNoteOns;
+
+
+    void push (const PlayHead& playHead, double tick, uint8_t noteNumber, uint8_t velocity, bool isNoteOn) noexcept;
+
+    [[nodiscard]] static juce::ValueTree createNote (const RecordedEvent& noteOn, const RecordedEvent& noteOff);
+};
@@ -0,0 +1,106 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <array>
+#include <console_synth/sequencer/pattern_list.h>
+#include <console_synth/sequencer/scheduled_midi.h>
+#include <console_synth/sequencer/tempo_map.h>
+#include <console_synth/sequencer/track_list.h>
+#include <console_synth/utility/spsc_queue.h>
+#include <optional>
+
+/* Generates the midi of all tracks (melody, arrangement, note offs at the loop end) a number of blocks ahead of the audio thread,
+ * on a thread of its own. The midi is pushed into a queue per track with the sample it should be played at, so all the audio
+ * thread has to do is take it out again, however many clips and notes there are.
+ *
+ * The scheduler has its own play head: it starts from the last state the audio thread reported and simply advances that
+ * one block at a time. That only gives the same blocks as the audio thread if nothing changes along the way (tempo, loop,
+ * block size or position), so every block it schedules is also described by a ScheduledBlock, which the audio thread checks
+ * against its own play head at the start of that block:
+ *  - if it's the same, the tracks use the scheduled midi
+ *  - if not, the tracks generate the midi themselves (like it's done without a scheduler) and the audio thread starts a new
+ *    generation. The scheduler sees that, starts over from the current state of the audio thread and everything
+ *    it scheduled for the old generation is thrown away.
+ * If the scheduler falls behind, the audio thread doesn't have to wait for it either, it also generates the midi itself.
+ * Changes to the notes and clips are picked up when a block is scheduled, so they're heard after the lookahead.
+ * */
+
+class MidiScheduler : private juce::Thread
+{
+public:
+    MidiScheduler (const TrackList& tracks, const PatternList& patterns, const AtomicSnapshot<VersionedTempoMap>& tempoMap);
+    ~MidiScheduler() override;
+
+    // the number of blocks the scheduler works ahead, 0 turns scheduling off. Can be called from any thread
+    void setLookaheadBlocks (int numBlocks);
+
+    [[nodiscard]] int getLookaheadBlocks() const noexcept;
+
+    static constexpr auto maxLookaheadBlocks = 32;
+
+    // While suspended nothing is scheduled and the audio thread generates the midi of every block itself, so the midi
+    // doesn't depend on how far the scheduler thread got (for renders that should come out the same every time).
+    // Can be called from any thread, the scheduler starts over when it's resumed
+    void setSuspended (bool shouldBeSuspended) noexcept;
+
+    [[nodiscard]] bool isSuspended() const noexcept;
+
+    // Audio thread only, at the start of every block that plays (after the play head was updated for the block).
+    // Returns whether the midi for the block was scheduled for exactly this play head state.
+    bool beginBlock (const PlayHead& playHead);
+
+    // the block the audio thread is at, set by beginBlock()
+    [[nodiscard]] const ScheduledBlock& getCurrentBlock() const noexcept;
+
+private:
+    // what the scheduler needs to know about the play head of the audio thread to continue from there
+    struct Transport
+    {
+        ScheduledBlock block;
+        double sampleRate;
+        uint64_t isLooping;
+    };
+
+    static constexpr auto numTransportWords = (sizeof (Transport) + sizeof (uint64_t) - 1) / sizeof (uint64_t);
+
+    const TrackList& tracks;
+    const PatternList& patterns;
+    const AtomicSnapshot<VersionedTempoMap>& tempoMap;
+    std::atomic<int> lookaheadBlocks { 0 };
+    std::atomic<bool> suspended { false };
+
+    // the blocks that were scheduled, in order (from the scheduler to the audio thread)
+    SpscQueue<ScheduledBlock> scheduledBlocks { (size_t) maxLookaheadBlocks * 2 };
+
+    // the latest transport of the audio thread, written with a sequence lock: the audio thread never waits,
+    // the scheduler reads it again when the audio thread was writing at the same time (the sequence is odd or changed)
+    std::atomic<uint64_t> transportSequence { 0 };
+    std::array<std::atomic<uint64_t>, numTransportWords> transportWords {};
+
+    // only used by the audio thread
+    uint64_t generation = 0;
+    ScheduledBlock currentBlock {};
+
+    // only used by the scheduler thread
+    PlayHead playHead;
+    bool isInSync = false;
+    uint64_t schedulerGeneration = 0;
+    uint64_t nextSamplePosition = 0;
+    juce::MidiBuffer scratchBuffer;
+
+
+    void run() override;
+
+    void scheduleAhead (const Transport& transport);
+
+    void startFrom (const Transport& transport, const VersionedTempoMap& currentTempoMap);
+
+    [[nodiscard]] bool canScheduleBlock (const TrackList::Tracks& currentTracks) const noexcept;
+
+    void writeTransport (const Transport& transport) noexcept;
+
+    [[nodiscard]] std::optional<Transport> readTransport() const noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiScheduler);
+};
@@ -0,0 +1,28 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <cstdint>
+#include <tuple>
+
+/* A position in bars, beats and ticks (bar:beat:tick), where a beat is one denominator of the time signature
+ * of that bar (so in 6/8 a bar has 6 beats of an eighth note). Everything counts from 0, so the first beat
+ * of a song is 0:0:0, when showing it to a user add one to the bar and beat (1.1.0).
+ * Converting to and from ticks depends on the time signatures, that's what the MeterMap does.
+ * */
+
+struct MusicalTime
+{
+    uint32_t bar = 0;
+    uint32_t beat = 0;
+    uint32_t tick = 0;
+
+    [[nodiscard]] constexpr auto asTuple() const noexcept { return std::tuple { bar, beat, tick }; }
+
+    constexpr bool operator== (const MusicalTime& other) const noexcept { return asTuple() == other.asTuple(); }
+    constexpr bool operator!= (const MusicalTime& other) const noexcept { return asTuple() != other.asTuple(); }
+    constexpr bool operator< (const MusicalTime& other) const noexcept { return asTuple() < other.asTuple(); }
+    constexpr bool operator> (const MusicalTime& other) const noexcept { return other < *this; }
+    constexpr bool operator<= (const MusicalTime& other) const noexcept { return ! (other < *this); }
+    constexpr bool operator>= (const MusicalTime& other) const noexcept { return ! (*this < other); }
+};
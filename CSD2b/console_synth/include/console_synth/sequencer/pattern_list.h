@@ -0,0 +1,68 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <console_synth/sequencer/melody.h>
+#include <console_synth/utility/atomic_snapshot.h>
+#include <memory>
+#include <vector>
+
+/* A pattern is a melody that clips on the arrangement of any track can play. It's stored only once
+ * (a pattern node with an id in the patterns node of the sequencer), the clips only refer to it by that id.
+ * */
+
+struct Pattern
+{
+    explicit Pattern (juce::ValueTree patternState)
+        : state { std::move (patternState) }, id { (int) state.getProperty (IDs::id) }
+    {
+    }
+
+    juce::ValueTree state;
+    const int id;
+
+    // the melody follows its tree (on the message thread), also when the pattern is shared as const
+    mutable Melody melody { state };
+
+    JUCE_DECLARE_NON_COPYABLE (Pattern);
+};
+
+
+/* Keeps a Pattern object for every pattern node, in the same way the TrackList does for tracks:
+ * the audio thread gets them as an immutable list (sorted by id) and a pattern is only deleted on the message thread.
+ * Editing the notes of a pattern doesn't change the list, the melody of the pattern publishes its own events.
+ * */
+
+class PatternList : private juce::ValueTree::Listener
+{
+public:
+    using Patterns = std::vector<std::shared_ptr<const Pattern>>;
+
+    explicit PatternList (juce::ValueTree patternsState);
+    ~PatternList() override;
+
+    // wait free, so safe to call from the audio thread
+    [[nodiscard]] AtomicSnapshot<Patterns>::ReadScope read() const noexcept;
+
+    // deletes the patterns that were removed and the old event lists of the melodies of the patterns
+    // (if the audio thread isn't using them anymore), message thread only
+    void collectGarbage();
+
+    // binary search for the pattern with the id, nullptr if there is none
+    [[nodiscard]] static const Pattern* findPattern (const Patterns& patterns, int id) noexcept;
+
+private:
+    juce::ValueTree patternsState;
+    AtomicSnapshot<Patterns> patterns;
+
+
+    void rebuildPatterns();
+
+    [[nodiscard]] std::shared_ptr<const Pattern> findOrCreatePattern (const juce::ValueTree& patternState) const;
+
+    void valueTreeChildAdded (juce::ValueTree& parent, juce::ValueTree& child) override;
+    void valueTreeChildRemoved (juce::ValueTree& parent, juce::ValueTree& child, int index) override;
+    void valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier& property) override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PatternList);
+};
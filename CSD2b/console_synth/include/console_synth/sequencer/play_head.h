@@ -3,8 +3,11 @@
 
 #pragma once
 
+#include <console_synth/sequencer/tempo_map.h>
 #include <cstdint>
 #include <juce_core/juce_core.h>
+#include <algorithm>
+#include <optional>
 
 /* This is the play head of the sequencer, this was a really tricky one to get right. The design is as follows:
  * Time in this sequencer is based on the audio device callback. It is the best option, because it is already synced
@@ -18,6 +21,13 @@
  * know at what point the play head is into the session at any point in the current buffer, there is a utility function
  * called forEachTick(). This takes the play head and a function (lambda or any other callable object) and then calls that function
  * with each new tick and the corresponding time point relative to the current buffer. This also takes looping into account.
+ *
+ * Once a sample rate is set, the play head is sample accurate: it doesn't keep time in (floating point) milliseconds anymore,
+ * but keeps its position on the timeline as a fixed point number of samples (32 bits for the fraction), which only ever moves
+ * by whole blocks. Where the ticks are on that timeline comes from a TempoMap (a constant tempo unless the sequencer sets one),
+ * so the tempo can change along the way. Adding up integers can't drift, so after hours of playback, the ticks still land on
+ * exactly the same samples as they would when computed from the start. This also means the ticks within a block can be looked
+ * up directly (the first tick at or after the start and the end of the block), instead of stepping through them one by one.
  * */
 
 class PlayHead
@@ -40,7 +50,7 @@ public:
     // was at 9ms into a 10ms buffer, then this should return 1.
     [[nodiscard]] double getTimeSinceLastTickMs() const;
 
-    // looping from start to (excluding) end
+    // looping from start to (excluding) end, an empty loop (end <= start) is ignored
     void setLooping (uint64_t start, uint64_t end);
 
     // returns the start of the loop in ticks. if not looping, it returns a nullopt
@@ -67,20 +77,210 @@ public:
 
     [[nodiscard]] uint64_t getTickAfter (uint64_t tick) const;
 
+    // returns the tick that comes numTicks after the given tick (taking looping into account), in constant time
+    [[nodiscard]] uint64_t getTickAfter (uint64_t tick, uint64_t numTicks) const;
+
+    // ===============================================================================================
+    // sample accurate mode
+
+    // fixed point format of the positions: the lower 32 bits are the fraction of a sample
+    static constexpr auto subSampleBits = TempoMap::subSampleBits;
+    static constexpr auto subSamplesPerSample = TempoMap::subSamplesPerSample;
+
+    // makes the play head sample accurate (see the description above). The tick time and
+    // device callback duration are converted to samples, so it's best to set the sample rate first
+    void setSampleRate (double rate);
+
+    [[nodiscard]] bool isSampleAccurate() const;
+
+    [[nodiscard]] double getSampleRate() const;
+
+    // sets the length of a device callback in samples (only in sample accurate mode)
+    void setBlockSizeSamples (int numSamples);
+
+    [[nodiscard]] int getBlockSizeSamples() const;
+
+    // Uses the given tempo map instead of the constant tick time (only in sample accurate mode).
+    // The play head doesn't own the map, it should stay alive until the next call (or until the block is done).
+    // When the version changes, the play head stays at the same musical position (tick), not the same time.
+    void setTempoMap (const TempoMap* map, uint64_t version);
+
+    [[nodiscard]] const TempoMap& getTempoMap() const;
+
+    [[nodiscard]] uint64_t getTempoMapVersion() const;
+
+    // the tempo (in bpm) at the start of the current block, 0 when there is no tempo map
+    [[nodiscard]] double getTempoBpm() const;
+
+    // the number of samples the play head advanced since the sample rate was set
+    [[nodiscard]] uint64_t getSamplePosition() const;
+
+    // the position of the start of the block on the timeline of the tempo map, in sub samples
+    [[nodiscard]] uint64_t getTimelinePositionSubSamples() const;
+
+    // moves the start of the block to the position (needs a tempo map), to continue where another play head is
+    void setTimelinePositionSubSamples (uint64_t position);
+
+    // the number of ticks that fall within the current block
+    [[nodiscard]] uint64_t getNumTicksInBlock() const;
+
+    // the (fractional) tick on the timeline at the given sample of the current block, after the loop wrapped if it did.
+    // only exact in sample accurate mode, otherwise it's the current tick
+    [[nodiscard]] double getTickAtSample (int sample) const;
+
+    // Splits the current block into the stretches of the timeline it plays: normally that's a single stretch,
+    // but when the loop wraps around during the block, there's one up to the loop end and one from the loop start.
+    // The function is called with the ticks in the stretch [startTick, endTick) and the position on the timeline
+    // that corresponds to the first sample of the block (so the sample of a tick is its position minus that origin).
+    // Returns the position on the timeline at the end of the block.
+    template <typename Functor>
+    uint64_t forEachStretchOfBlock (Functor&& function) const
+    {
+        if (tempoMap == nullptr)
+            return timelinePosition;
+
+        const auto blockLength = (uint64_t) blockSizeSamples << subSampleBits;
+        auto position = timelinePosition;
+        auto blockOffset = uint64_t { 0 };
+
+        for (;;)
+        {
+            const auto stretchEnd = position + (blockLength - blockOffset);
+
+            if (isLooping())
+            {
+                const auto loopStartPosition = tempoMap->getPositionOfTick (loopingRangeTicks->getStart());
+                const auto loopEndPosition = tempoMap->getPositionOfTick (loopingRangeTicks->getEnd());
+
+                // outside of the loop, jump to the start right away
+                if (position >= loopEndPosition)
+                {
+                    position = loopStartPosition;
+                    continue;
+                }
+
+                if (stretchEnd >= loopEndPosition)
+                {
+                    // the origin can wrap around (when the loop starts at 0), the unsigned math still works out
+                    function (tempoMap->getFirstTickAtOrAfter (position), loopingRangeTicks->getEnd(), position - blockOffset);
+
+                    blockOffset += loopEndPosition - position;
+                    position = loopStartPosition;
+
+                    if (blockOffset == blockLength)
+                        return position;
+
+                    continue;
+                }
+            }
+
+            function (tempoMap->getFirstTickAtOrAfter (position), tempoMap->getFirstTickAtOrAfter (stretchEnd), position - blockOffset);
+            return stretchEnd;
+        }
+    }
+
 private:
     double tickTimeMs = 0;
     double blockDurationMs = 0;
     uint64_t currentTick = 0;
     double timeSinceLastTickMs = 0;
     std::optional<juce::Range<uint64_t>> loopingRangeTicks = std::nullopt;
+
+    // only used in sample accurate mode
+    double sampleRate = 0;
+    int blockSizeSamples = 0;
+    uint64_t samplePosition = 0;
+    uint64_t timelinePosition = 0;
+    std::optional<TempoMap> constantTempoMap;
+    const TempoMap* tempoMap = nullptr;
+    uint64_t tempoMapVersion = 0;
+
+    // the musical position, so it can be restored when the tempo map changes
+    double tickPosition = 0;
+
+    void setTimelinePosition (uint64_t position);
+
+    void setCurrentTempoMap (const TempoMap* map);
+
+    [[nodiscard]] uint64_t msToSubSamples (double ms) const;
+    [[nodiscard]] double subSamplesToMs (uint64_t subSamples) const;
 };
 
 
 // ===================================================================================================
+
+// A run of consecutive ticks within one device callback, from startTick up to (excluding) endTick.
+// Tick startTick + i lies at startTimeMs + i * tickTimeMs into the buffer.
+// When the play head is sample accurate, the positions of the ticks come from the tempo map instead,
+// so they're exact, even when the tempo changes within the range.
+struct TickRange
+{
+    uint64_t startTick;
+    uint64_t endTick;
+    double startTimeMs;
+    double tickTimeMs;
+    double blockDurationMs;
+    const TempoMap* tempoMap = nullptr;
+    uint64_t originSubSamples = 0;
+
+    [[nodiscard]] double getTimeOfTickMs (uint64_t tick) const noexcept
+    {
+        if (tempoMap != nullptr)
+            return (double) getOffsetOfTick (tick) / (double) PlayHead::subSamplesPerSample / tempoMap->getSampleRate() * 1000.0;
+
+        return startTimeMs + (double) (tick - startTick) * tickTimeMs;
+    }
+
+    // the sample within the block at which the tick falls
+    [[nodiscard]] int getSampleOfTick (uint64_t tick, int numSamplesInBlock) const noexcept
+    {
+        if (tempoMap != nullptr)
+            return (int) (getOffsetOfTick (tick) >> PlayHead::subSampleBits);
+
+        return (int) (getTimeOfTickMs (tick) / blockDurationMs * numSamplesInBlock);
+    }
+
+private:
+    [[nodiscard]] uint64_t getOffsetOfTick (uint64_t tick) const noexcept
+    {
+        return tempoMap->getPositionOfTick (tick) - originSubSamples;
+    }
+};
+
+
+// In sample accurate mode the ranges come straight from the tempo map: the first tick at or after the start
+// of the block (or the stretch of it up to the loop end) and the first tick at or after its end.
+template <typename Functor>
+auto forEachSampleAccurateTickRange (const PlayHead& playHead, Functor&& function)
+{
+    const auto& tempoMap = playHead.getTempoMap();
+
+    playHead.forEachStretchOfBlock ([&] (uint64_t startTick, uint64_t endTick, uint64_t origin) {
+        if (startTick >= endTick)
+            return;
+
+        auto range = TickRange { startTick, endTick, 0.0, 0.0, playHead.getDeviceCallbackDurationMs(), &tempoMap, origin };
+        range.startTimeMs = range.getTimeOfTickMs (startTick);
+        range.tickTimeMs = range.getTimeOfTickMs (startTick + 1) - range.startTimeMs;
+        function (range);
+    });
+}
+
+
 // Functor should have a call operator with the signature: (uint64_t tick, double timeRelativeToBufferMs)
 template <typename Functor>
 auto forEachTick (const PlayHead& playHead, Functor&& function)
 {
+    if (playHead.isSampleAccurate())
+    {
+        forEachSampleAccurateTickRange (playHead, [&function] (const TickRange& range) {
+            for (auto tick = range.startTick; tick < range.endTick; ++tick)
+                function (tick, range.getTimeOfTickMs (tick));
+        });
+
+        return;
+    }
+
     auto currentTick = playHead.getCurrentTick();
     auto timePointMs = playHead.getTickTimeMs() - playHead.getTimeSinceLastTickMs();
 
@@ -90,4 +290,37 @@ auto forEachTick (const PlayHead& playHead, Functor&& function)
         timePointMs += playHead.getTickTimeMs();
         currentTick = playHead.getTickAfter (currentTick);
     }
-}
\ No newline at end of file
+}
+
+
+// Same as forEachTick, but calls the function once per run of consecutive ticks, instead of once per tick.
+// This way the caller can look up everything in the range at once. Normally that's a single range,
+// but when the loop wraps around during the buffer, there's one range up to the loop end and one from the loop start.
+// Functor should have a call operator with the signature: (const TickRange& range)
+template <typename Functor>
+auto forEachTickRange (const PlayHead& playHead, Functor&& function)
+{
+    if (playHead.isSampleAccurate())
+    {
+        forEachSampleAccurateTickRange (playHead, std::forward<Functor> (function));
+        return;
+    }
+
+    auto range = std::optional<TickRange> {};
+
+    forEachTick (playHead, [&] (uint64_t tick, double timePointMs) {
+        if (range.has_value() && tick == range->endTick)
+        {
+            ++range->endTick;
+            return;
+        }
+
+        if (range.has_value())
+            function (*range);
+
+        range = TickRange { tick, tick + 1, timePointMs, playHead.getTickTimeMs(), playHead.getDeviceCallbackDurationMs() };
+    });
+
+    if (range.has_value())
+        function (*range);
+}
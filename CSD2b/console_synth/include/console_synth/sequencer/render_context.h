@@ -3,28 +3,40 @@
 
 #pragma once
 
+#include <console_synth/midi/midi_input_router.h>
+#include <console_synth/sequencer/bus.h>
 #include <console_synth/sequencer/play_head.h>
-#include <console_synth/sequencer/time_signature.h>
+#include <console_synth/sequencer/meter_map.h>
+#include <console_synth/sequencer/pattern_list.h>
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <console_synth/sequencer/play_state.h>
+#include <console_synth/sequencer/scheduled_midi.h>
 
 struct RenderContext final
 {
 public:
     RenderContext (juce::AudioBuffer<float>& audioBuffer,
-                   const juce::MidiBuffer& externalMidi,
+                   const MidiInputRouter& midiInputs,
                    const PlayHead& playHead,
                    PlayState playState,
                    double sampleRate,
                    juce::Range<double> deviceStreamTimeSpanMs,
-                   const TimeSignature& timeSignature)
+                   const MeterMap& meterMap,
+                   const PatternList::Patterns& patterns,
+                   std::vector<std::unique_ptr<Bus>>& busses,
+                   const ScheduledBlock& currentBlock,
+                   bool midiIsScheduled)
         : destinationAudioBuffer { audioBuffer },
-          externalMidi { externalMidi },
+          midiInputs { midiInputs },
           playHead { playHead },
           playState { playState },
           sampleRate { sampleRate },
           deviceStreamTimeSpan { deviceStreamTimeSpanMs },
-          timeSignature { timeSignature }
+          meterMap { meterMap },
+          patterns { patterns },
+          busses { busses },
+          currentBlock { currentBlock },
+          midiIsScheduled { midiIsScheduled }
     {
     }
 
@@ -42,22 +54,45 @@ public:
 
     [[nodiscard]] int getNumSamples() const noexcept { return destinationAudioBuffer.getNumSamples(); }
 
+    [[nodiscard]] int getNumChannels() const noexcept { return destinationAudioBuffer.getNumChannels(); }
+
     [[nodiscard]] double getSampleRate() const noexcept { return sampleRate; }
 
-    [[nodiscard]] const juce::MidiBuffer& getExternalMidi() const noexcept { return externalMidi; }
+    // the midi that came in from the midi inputs routed to the track
+    [[nodiscard]] const juce::MidiBuffer& getExternalMidi (int trackIndex) const noexcept { return midiInputs.getMidiForTrack (trackIndex); }
 
     juce::AudioBuffer<float>& getAudioBuffer() noexcept { return destinationAudioBuffer; }
 
-    [[nodiscard]] const TimeSignature& getTimeSignature() const noexcept { return timeSignature; }
+    [[nodiscard]] const MeterMap& getMeterMap() const noexcept { return meterMap; }
+
+    [[nodiscard]] const PatternList::Patterns& getPatterns() const noexcept { return patterns; }
 
     [[nodiscard]] PlayState getPlayState() const noexcept { return playState; }
 
+    // the state of the play head at the start of this block, as the MidiScheduler describes the blocks it schedules
+    [[nodiscard]] const ScheduledBlock& getCurrentBlock() const noexcept { return currentBlock; }
+
+    // whether the midi of the tracks for this block was generated ahead of time by the MidiScheduler
+    [[nodiscard]] bool isMidiScheduled() const noexcept { return midiIsScheduled; }
+
+    [[nodiscard]] int getNumBusses() const noexcept { return (int) busses.size(); }
+
+    // mixes the source into the given aux bus, scaled by the gain (send level)
+    void addToBus (int busIndex, const juce::AudioBuffer<float>& source, float gain)
+    {
+        busses[busIndex]->addFrom (source, gain);
+    }
+
 private:
     juce::AudioBuffer<float>& destinationAudioBuffer;
-    const juce::MidiBuffer& externalMidi;
+    const MidiInputRouter& midiInputs;
     const PlayHead& playHead;
     PlayState playState;
     double sampleRate;
     juce::Range<double> deviceStreamTimeSpan;
-    const TimeSignature& timeSignature;
+    const MeterMap& meterMap;
+    const PatternList::Patterns& patterns;
+    std::vector<std::unique_ptr<Bus>>& busses;
+    const ScheduledBlock& currentBlock;
+    bool midiIsScheduled;
 };
@@ -0,0 +1,69 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <console_synth/sequencer/play_head.h>
+#include <cstdint>
+
+/* The MidiScheduler renders the midi of the tracks a few blocks ahead of the audio thread, with its own copy of the play head.
+ * Every block it schedules is described by the state of the play head at the start of that block, when the audio thread
+ * gets to that block, it only uses the scheduled midi if its own play head is in exactly the same state (otherwise the
+ * tempo, loop or position changed in the meantime and the midi is generated in the audio callback, like it used to be).
+ *
+ * The generation is the number of times the audio thread told the scheduler to start over (see MidiScheduler),
+ * everything from an older generation is thrown away.
+ * */
+
+struct ScheduledBlock
+{
+    uint64_t generation;
+    uint64_t samplePosition;
+    uint64_t timelinePosition;
+    uint64_t tempoMapVersion;
+    uint64_t loopStart;
+    uint64_t loopEnd;
+    int blockSize;
+
+    [[nodiscard]] static ScheduledBlock fromPlayHead (const PlayHead& playHead, uint64_t generation, uint64_t samplePosition) noexcept
+    {
+        return {
+            generation,
+            samplePosition,
+            playHead.getTimelinePositionSubSamples(),
+            playHead.getTempoMapVersion(),
+            playHead.getLoopingStart().value_or (0),
+            playHead.getLoopingEnd().value_or (0),
+            playHead.getBlockSizeSamples()
+        };
+    }
+
+    // whether both describe the same block, played with the same play head state
+    [[nodiscard]] bool isSameBlockAs (const ScheduledBlock& other) const noexcept
+    {
+        return samplePosition == other.samplePosition
+               && timelinePosition == other.timelinePosition
+               && tempoMapVersion == other.tempoMapVersion
+               && loopStart == other.loopStart
+               && loopEnd == other.loopEnd
+               && blockSize == other.blockSize;
+    }
+};
+
+
+// a (channel voice) midi message at a sample within a scheduled block
+struct ScheduledMidiEvent
+{
+    uint64_t generation;
+    uint64_t samplePosition;
+    int sampleOffset;
+    uint8_t data[3];
+
+    // a block with more events than a track has room for is scheduled as a single event without a message,
+    // so the track knows it has to generate the midi of that block itself
+    [[nodiscard]] static ScheduledMidiEvent incompleteBlock (uint64_t generation, uint64_t samplePosition) noexcept
+    {
+        return { generation, samplePosition, 0, { 0, 0, 0 } };
+    }
+
+    [[nodiscard]] bool isIncompleteBlock() const noexcept { return data[0] == 0; }
+};
@@ -4,15 +4,23 @@
 #pragma once
 
 #include <console_synth/audio/audio_processor_base.h>
+#include <console_synth/audio/limiter.h>
+#include <console_synth/audio/saturator.h>
 #include <console_synth/identifiers.h>
+#include <console_synth/midi/midi_input_router.h>
+#include <console_synth/sequencer/bus.h>
+#include <console_synth/sequencer/meter_map.h>
+#include <console_synth/sequencer/midi_scheduler.h>
+#include <console_synth/sequencer/pattern_list.h>
 #include <console_synth/sequencer/play_head.h>
-#include <console_synth/sequencer/time_signature.h>
-#include <console_synth/sequencer/track.h>
+#include <console_synth/sequencer/tempo_map.h>
+#include <console_synth/sequencer/track_list.h>
 #include <console_synth/utility/property.h>
+#include <console_synth/utility/realtime_thread_pool.h>
 #include <juce_audio_devices/juce_audio_devices.h>
 
 
-class Sequencer : public juce::AudioSource
+class Sequencer : public juce::AudioSource, private juce::ValueTree::Listener
 {
 public:
     explicit Sequencer (juce::ValueTree& parent);
@@ -27,7 +35,15 @@ public:
     void releaseResources() override;
 
 
-    bool openMidiInputDevice (const juce::String& name);
+    // opens the midi input (next to the ones that are already open) and plays all its channels on the track
+    bool openMidiInputDevice (const juce::String& name, int trackIndex);
+
+    bool closeMidiInputDevice (const juce::String& name);
+
+    // plays a channel (1 - 16, 0 for all channels) of an open midi input on the track
+    bool routeMidiInput (const juce::String& name, int channel, int trackIndex);
+
+    [[nodiscard]] juce::StringArray getOpenMidiInputDevices() const;
 
     void stopPlayback();
 
@@ -35,22 +51,118 @@ public:
 
     [[nodiscard]] bool isPlaying() const noexcept;
 
-    const TimeSignature& getTimeSignature() const noexcept;
+    // plays like startPlayback(), but also records the live midi of the tracks into their melodies
+    void startRecording();
+
+    [[nodiscard]] bool isRecording() const noexcept;
+
+    // Plays from the start of the timeline without the live midi, for rendering the song to a file (see OfflineRenderer).
+    // The play head moves to the start in the next block, so this should be called before the first block of the export
+    void startExporting();
+
+    [[nodiscard]] bool isExporting() const noexcept;
+
+    // without the lookahead scheduling the midi of every block is generated in the block itself, see MidiScheduler::setSuspended()
+    void setMidiSchedulingSuspended (bool shouldBeSuspended) noexcept;
+
+    // the number of samples the first bars of the timeline last (at the current tempo map and sample rate), message thread only
+    [[nodiscard]] uint64_t getLengthOfBarsSamples (uint32_t numBars) const;
+
+    // the number of samples the loop lasts when it's played the number of times, message thread only
+    [[nodiscard]] uint64_t getLengthOfLoopsSamples (uint32_t numLoops) const;
+
+    // Adds the notes that were recorded since the last call to the melodies of the tracks, as one undo transaction.
+    // Message thread only, returns the number of notes that were added
+    int commitRecordedNotes (juce::UndoManager* undoManager);
+
+    // Streams the midi file on the track (from the start of the timeline), without adding its notes to the melody.
+    // Returns false if there's no such track, throws a MappedMidiFile::LoadError if the file can't be played
+    bool loadMidiFile (int trackIndex, const juce::File& file);
+
+    // stops streaming the midi file of the track
+    bool unloadMidiFile (int trackIndex);
+
+    // the time signatures of the song, should only be used on the message thread
+    [[nodiscard]] const MeterMap& getMeterMap() const noexcept;
+
+    // the tempo changes of the song, should only be used on the message thread
+    [[nodiscard]] const TempoMap& getTempoMap() const noexcept;
+
+    static constexpr auto ticksPerQuarterNote = uint32_t { 48 };
+
+    // adds a new (empty) track at the end, can be called while the audio is running
+    void addTrack();
+
+    // deletes the tracks, patterns and tempo maps that were removed, if the audio thread is done with them
+    void collectGarbage();
+
+    // the latency of the master bus (the oversampling of the saturator and the limiter lookahead), needed to align exported audio
+    [[nodiscard]] int getLatencySamples() const noexcept;
 
 
 private:
     juce::ValueTree sequencerState { IDs::sequencer };
     Property<double> tempoBpm { sequencerState, IDs::tempo, 100 };
-    TimeSignature timeSignature { 4, 4, 48 };
     double sampleRate = 0;
+
+    // the time signature changes, the meter map is rebuilt from these (4/4 if there are none)
+    juce::ValueTree meterMapState { IDs::meterMap };
+    AtomicSnapshot<MeterMap> meterMap { std::make_unique<const MeterMap> (ticksPerQuarterNote) };
+
+    // the loop always starts at the first bar, the end depends on the time signatures of the bars in the loop
+    Property<int> loopLengthBars { sequencerState, IDs::loopBars, 1 };
+    std::atomic<uint64_t> loopEndTick { 0 };
+
+    // set on the message thread to move the play head to the start, like the loop end it's only changed on the audio thread
+    std::atomic<bool> shouldRewind { false };
+
+    // the tempo changes after the start (the tempo property is the tempo at the start)
+    juce::ValueTree tempoMapState { IDs::tempoMap };
+
+    // rebuilt with the right sample rate in prepareToPlay, the audio thread reads it as a snapshot
+    AtomicSnapshot<VersionedTempoMap> tempoMap { std::make_unique<const VersionedTempoMap> (VersionedTempoMap {
+        TempoMap { tempoBpm.getValue(), 44'100.0, ticksPerQuarterNote }, 0 }) };
+
+    // the patterns the clips of all tracks can play
+    juce::ValueTree patternsState { IDs::patterns };
+    PatternList patterns { patternsState };
+
     PlayHead playHead;
     PlayState playState = PlayState::stopped;
-    Track track { sequencerState };
-    juce::MidiMessageCollector midiMessageCollector;
-    std::unique_ptr<juce::MidiInput> currentMidiInput = nullptr;
+    TrackList tracks { sequencerState };
+
+    // generates the midi of the tracks ahead of time, the lookahead is in blocks (0 generates it in the audio callback)
+    Property<int> lookaheadBlocks { sequencerState, IDs::lookaheadBlocks, 4 };
+    MidiScheduler midiScheduler { tracks, patterns, tempoMap };
+
+    RealtimeThreadPool renderPool;
+    std::vector<std::unique_ptr<Bus>> busses;
+    Limiter masterLimiter;
+
+    // saturation on the master bus (before the limiter), in decibels of drive: 0 leaves the mix clean
+    Property<double> masterDriveDecibels { sequencerState, IDs::masterDrive, 0.0 };
+    std::atomic<float> masterDrive { 0.0f };
+    OversampledSaturator masterSaturator { 0.0f, 0.0f, 0.0f };
+    MidiInputRouter midiInputs { sequencerState };
+
+    // how long after it came in live midi is played, in blocks (a fixed latency, so the timing doesn't jitter)
+    Property<double> midiLatencyBlocks { sequencerState, IDs::midiLatencyBlocks, 1.0 };
+
+    // the master bus doesn't get any midi, but the processors need a buffer
     juce::MidiBuffer midiBuffer;
 
 
-    void setTempoBpm (double bpm);
+    void rebuildTempoMap();
+    void rebuildMeterMap();
+    void updateLoopRange();
+    void stateChanged (const juce::ValueTree& tree);
     void setSampleRate (double rate);
+    void addReverbBus();
+    void addDelayBus();
+    void addChorusBus();
+    void addFlangerBus();
+
+    void valueTreeChildAdded (juce::ValueTree& parent, juce::ValueTree& child) override;
+    void valueTreeChildRemoved (juce::ValueTree& parent, juce::ValueTree& child, int index) override;
+    void valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier& property) override;
 };
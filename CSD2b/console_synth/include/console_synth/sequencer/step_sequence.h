@@ -0,0 +1,115 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <console_synth/identifiers.h>
+#include <console_synth/midi/midi_source.h>
+#include <console_synth/utility/atomic_snapshot.h>
+#include <array>
+#include <bitset>
+#include <cstdint>
+
+/* A rhythm that is computed instead of stored: a number of steps of a fixed length (in ticks), of which some are hits.
+ * The hits are spread as evenly as possible over the steps, like euclidean.py did with the bresenham algorithm,
+ * but in closed form: step i of the pattern is a hit when (i * hits) % steps < hits. The rotation moves the hits a number of steps later.
+ * Every step has its own note and velocity (the lists repeat when they're shorter than the pattern), a step with velocity 0
+ * is a rest, so with as many hits as steps it's a plain step sequencer.
+ * The pattern repeats from the start of the timeline, so the notes of a block follow from its tick range alone:
+ * nothing is stored per note and the memory use doesn't depend on the length of the song.
+ * The settings are properties of the step sequence node of the track, every change publishes a new (small) pattern,
+ * which is heard from the next block on.
+ * */
+
+struct StepPattern
+{
+    static constexpr auto maxNumSteps = 64;
+
+    int numHits = 0;
+    int numSteps = 16;
+    int rotation = 0;
+    uint64_t stepLengthTicks = 12;
+    uint64_t gateTicks = 6;
+    std::array<uint8_t, maxNumSteps> notes {};
+    std::array<uint8_t, maxNumSteps> velocities {};
+    uint64_t version = 0;
+
+    [[nodiscard]] bool isActive() const noexcept { return numHits > 0; }
+
+    // the step of the pattern that plays at the step of the timeline
+    [[nodiscard]] int getStepInPattern (uint64_t step) const noexcept { return (int) (step % (uint64_t) numSteps); }
+
+    [[nodiscard]] bool isHit (uint64_t step) const noexcept
+    {
+        const auto stepInPattern = getStepInPattern (step);
+        const auto rotated = (stepInPattern + numSteps - rotation) % numSteps;
+        return (rotated * numHits) % numSteps < numHits && velocities[(size_t) stepInPattern] > 0;
+    }
+
+    // calls the function with the step in the pattern and the tick of every hit that starts in [startTick, endTick)
+    template <typename Functor>
+    void forEachHitInRange (uint64_t startTick, uint64_t endTick, Functor&& function) const
+    {
+        if (! isActive())
+            return;
+
+        for (auto step = (startTick + stepLengthTicks - 1) / stepLengthTicks; step * stepLengthTicks < endTick; ++step)
+            if (isHit (step))
+                function (getStepInPattern (step), step * stepLengthTicks);
+    }
+
+    // the settings of a step sequence node, everything out of range is clamped
+    [[nodiscard]] static StepPattern fromState (const juce::ValueTree& state);
+};
+
+
+class StepSequence : private juce::ValueTree::Listener
+{
+public:
+    // the step sequence node is created in the track state if it doesn't have one yet
+    explicit StepSequence (juce::ValueTree& trackState);
+    ~StepSequence() override;
+
+    // the current pattern, wait free
+    [[nodiscard]] AtomicSnapshot<StepPattern>::ReadScope read() const noexcept;
+
+    // deletes the old patterns, message thread only
+    void collectGarbage();
+
+private:
+    juce::ValueTree stepSequenceState;
+    AtomicSnapshot<StepPattern> pattern;
+
+
+    void rebuildPattern();
+
+    void valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier& property) override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StepSequence);
+};
+
+
+// ===================================================================================================
+
+// Plays the hits of a step sequence (on channel 1), the notes of a block are computed from its tick range.
+// When the pattern changes or the play head jumps, the notes that are sounding are stopped first.
+class StepSequenceMidiSource : public MidiSource
+{
+public:
+    explicit StepSequenceMidiSource (const StepSequence* stepSequence) : stepSequence { stepSequence } {}
+
+    void fillNextMidiBuffer (const PlayHead& playHead, juce::MidiBuffer& buffer, int numSamples) override;
+
+    // forgets the notes that are sounding, without stopping them
+    void reset() noexcept { soundingNotes.reset(); }
+
+private:
+    const StepSequence* stepSequence;
+    uint64_t patternVersion = 0;
+    uint64_t nextTick = 0;
+    std::bitset<128> soundingNotes { 0 };
+
+
+    void playRange (const StepPattern& pattern, const TickRange& range, juce::MidiBuffer& buffer, int numSamples);
+
+    void stopSoundingNotes (juce::MidiBuffer& buffer, int samplePosition);
+};
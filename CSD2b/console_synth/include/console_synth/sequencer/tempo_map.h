@@ -0,0 +1,113 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/* Maps ticks to positions on the timeline (in samples) and back, for a tempo that changes over time.
+ * The tempo is given as a list of tempo changes, each one starting at a tick. From a change, the tempo either stays the
+ * same until the next change (a step), or it moves linearly (per tick) towards the tempo of the next change (a ramp).
+ *
+ * The position of every change is computed once, when the map is built, so a conversion only has to find the
+ * change it falls after (a binary search) and then do the math within that segment, which has a closed form solution:
+ *  - in a step segment every tick has the same length, so it's a multiplication
+ *  - in a ramp segment the length of a tick is inversely proportional to the tempo, so the time since the start of the
+ *    segment is the integral of that: a logarithm. Going back from a position to a tick is the exponent of that.
+ *
+ * Positions are in sub samples: fixed point samples with 32 bits for the fraction (the same as the PlayHead).
+ * In a step segment the tick length is rounded to a whole number of sub samples once, after that everything is integer math,
+ * so a constant tempo can run for hours without the ticks drifting. In a ramp segment the position of every tick is computed
+ * from the start of the segment, so the rounding errors don't add up either.
+ * */
+
+class TempoMap
+{
+public:
+    enum class Curve
+    {
+        step,
+        ramp
+    };
+
+    struct TempoChange
+    {
+        uint64_t tick;
+        double bpm;
+        Curve curveToNext = Curve::step;
+    };
+
+    static constexpr auto minimumBpm = 1.0;
+
+    static constexpr auto subSampleBits = 32;
+    static constexpr auto subSamplesPerSample = uint64_t { 1 } << subSampleBits;
+
+    // a constant tempo
+    TempoMap (double bpm, double sampleRate, uint32_t ticksPerQuarterNote);
+
+    // the changes don't have to be sorted. If there's no change at tick 0, the first tempo is used from the start.
+    // tempos below minimumBpm are raised to it, a ramp on the last change is the same as a step
+    TempoMap (std::vector<TempoChange> changes, double sampleRate, uint32_t ticksPerQuarterNote);
+
+    // the position of the tick on the timeline in sub samples
+    [[nodiscard]] uint64_t getPositionOfTick (uint64_t tick) const noexcept;
+
+    // same, for a position in between ticks
+    [[nodiscard]] uint64_t getPositionOfTick (double tick) const noexcept;
+
+    // the (fractional) tick at the given position on the timeline
+    [[nodiscard]] double getTickAtPosition (uint64_t position) const noexcept;
+
+    // the first tick that lies at or after the given position, consistent with getPositionOfTick()
+    [[nodiscard]] uint64_t getFirstTickAtOrAfter (uint64_t position) const noexcept;
+
+    // the tempo at the given tick (which moves between the changes in a ramp)
+    [[nodiscard]] double getTempoAtTick (double tick) const noexcept;
+
+    [[nodiscard]] double getSampleRate() const noexcept;
+
+    [[nodiscard]] uint32_t getTicksPerQuarterNote() const noexcept;
+
+    [[nodiscard]] const std::vector<TempoChange>& getTempoChanges() const noexcept;
+
+private:
+    struct Segment
+    {
+        uint64_t startTick;
+        uint64_t startPosition;
+        double startBpm;
+
+        // step: the length of a tick in sub samples
+        uint64_t tickLength;
+
+        // ramp: the tempo changes by bpmPerTick every tick
+        bool isRamp;
+        double bpmPerTick;
+    };
+
+    std::vector<TempoChange> tempoChanges;
+    std::vector<Segment> segments;
+    double sampleRate;
+    uint32_t ticksPerQuarterNote;
+
+    // the length of a tick in sub samples at 1 bpm, at any other tempo it's this divided by the tempo
+    double subSamplesPerTickAtOneBpm;
+
+
+    [[nodiscard]] const Segment& findSegmentOfTick (double tick) const noexcept;
+
+    [[nodiscard]] const Segment& findSegmentAtPosition (uint64_t position) const noexcept;
+
+    [[nodiscard]] double getSubSamplesIntoSegment (const Segment& segment, double ticksIntoSegment) const noexcept;
+
+    [[nodiscard]] double getTicksIntoSegment (const Segment& segment, double subSamplesIntoSegment) const noexcept;
+};
+
+
+// a tempo map with the number of the change it came from, so a play head can tell two maps apart
+// even when the new one happens to be allocated at the address of the old one
+struct VersionedTempoMap
+{
+    TempoMap map;
+    uint64_t version;
+};
@@ -3,37 +3,145 @@
 
 #pragma once
 
+#include <console_synth/audio/processor_chain.h>
 #include <console_synth/audio/synth_types.h>
 #include <console_synth/audio/synthesizers.h>
+#include <console_synth/midi/midi_file_player.h>
+#include <console_synth/midi/midi_processors.h>
 #include <console_synth/midi/midi_source.h>
+#include <console_synth/sequencer/groove.h>
 #include <console_synth/sequencer/melody.h>
+#include <console_synth/sequencer/midi_recorder.h>
 #include <console_synth/sequencer/render_context.h>
+#include <console_synth/sequencer/scheduled_midi.h>
+#include <console_synth/sequencer/step_sequence.h>
+#include <console_synth/utility/spsc_queue.h>
+
+/* A track owns its own synth, effect chain, melody and arrangement, all described by a track node in the sequencer state.
+ * The melody loops (with the loop of the sequencer), the arrangement plays clips of the shared patterns on the timeline.
+ * A midi file can be streamed from disk on the timeline as well (see MappedMidiFile), without its notes going into the melody,
+ * and a step sequence plays a euclidean rhythm that's computed for every block (see StepSequence).
+ * All of that midi goes through the groove of the track (swing, humanize, transpose), then it's merged with the live midi
+ * and goes through the midi processors of the track (chord memory, arpeggiator, note repeat) before it reaches the synth.
+ * Rendering is split in two stages, so multiple tracks can render at the same time:
+ *  - renderNextBlock() only touches the track itself (it renders into the track buffer),
+ *    so it can be called for different tracks on different threads
+ *  - addToMix() adds the track buffer to the output and the busses, which are shared by all tracks,
+ *    so that is called for one track at a time
+ * The midi of the melody and arrangement is normally generated ahead of time by the MidiScheduler (see scheduleBlock()),
+ * which pushes it into a queue that renderNextBlock() only has to drain. When the scheduled midi can't be used for a block,
+ * the track generates it itself, with its own set of midi sources (the scheduler thread has its own set).
+ * Each set only knows the notes it started itself, so when the midi of a block comes from the other set than in the
+ * block before, the track stops the notes that are still sounding and the set that takes over starts without any.
+ * */
 
 struct Track
 {
-    explicit Track (juce::ValueTree parent);
+    // the state should be a track node, the synth and melody of the track are created in it (if it doesn't have them yet)
+    explicit Track (juce::ValueTree state);
     ~Track() = default;
 
     void prepareToPlay (double newSampleRate, int numSamplesPerBlockExpected);
 
-    void renderNextBlock (RenderContext& renderContext);
+    // renders the next block into the track buffer, the index is where the track is in the track list (for the midi routing)
+    void renderNextBlock (const RenderContext& renderContext, int trackIndex);
+
+    // adds the last rendered block to the destination buffer and the busses
+    void addToMix (RenderContext& renderContext);
 
     void releaseResources();
 
+    // deletes the old event lists of the melody, clip lists of the arrangement (and other old snapshots), message thread only
+    void collectGarbage();
+
+    // adds the notes that were recorded (and finished) since the last call to the melody, message thread only
+    int commitRecordedNotes (juce::UndoManager* undoManager);
+
+    [[nodiscard]] uint64_t getNumDroppedRecordedEvents() const noexcept;
+
+    // streams the midi file on the track, next to the melody and arrangement (an empty file stops it), message thread only
+    void loadMidiFile (std::unique_ptr<const MappedMidiFile> file);
+
+    // Generates the midi for the block the play head is at, and pushes it into the queue the audio thread takes it from.
+    // A block with more events than maxNumScheduledEventsPerBlock isn't pushed, the track generates that block itself.
+    // Only called by the scheduler thread, it uses the scratch buffer to collect the midi.
+    void scheduleBlock (const PlayHead& playHead,
+                        const PatternList::Patterns& patterns,
+                        const ScheduledBlock& block,
+                        juce::MidiBuffer& scratchBuffer);
+
+    // the scheduler only schedules a block when all tracks have at least this much room left in their queue
+    [[nodiscard]] bool canScheduleBlock() const noexcept;
+
+    static constexpr auto maxNumScheduledEventsPerBlock = size_t { 512 };
+
+    // forgets the notes the midi sources of the scheduler hold, when the scheduler starts over
+    // (the audio thread stops the ones it played). Only called by the scheduler thread
+    void restartScheduling() noexcept;
+
+    // the number of notes the synth of the track plays, after the last rendered block
+    [[nodiscard]] size_t getNumActiveMidiNotes() const noexcept { return activeMidiNotes.count(); }
+
+    [[nodiscard]] const juce::ValueTree& getState() const noexcept { return trackState; }
+
 private:
-    juce::ValueTree trackState { IDs::track };
+    juce::ValueTree trackState;
     std::mutex synthMutex;
     Property<SynthType> synthType { trackState, IDs::synthType, SynthType::fm };
-    std::unique_ptr<SynthesizerBase> synth = std::make_unique<FmSynthesizer> (trackState);
+    std::unique_ptr<SynthesizerBase> synth = createSynth (synthType.getValue(), trackState);
+    ProcessorChain processorChain { *synth };
+    juce::AudioBuffer<float> trackBuffer;
+    bool hasRenderedAudio = false;
+    ArrayProperty sendLevelsState { trackState, IDs::sends, {} };
+    std::array<std::atomic<float>, Bus::maxNumBusses> sendLevels {};
     std::bitset<128> activeMidiNotes { 0 };
     Melody melody { trackState };
-    MelodyPlayerMidiSource melodyPlayerMidiSource { &melody };
+    Arrangement arrangement { trackState };
+    StepSequence stepSequence { trackState };
+    Groove groove { trackState };
+    MidiProcessorChain midiProcessors { trackState };
+    MidiRecorder recorder { trackState.getChildWithName (IDs::melody) };
+    AtomicSnapshot<MappedMidiFile> midiFile;
+
+    // the sources keep state between blocks, so the audio thread and the scheduler each have their own
+    struct SequencedMidiSources
+    {
+        SequencedMidiSources (Melody& melody, const Arrangement& arrangement, const StepSequence& stepSequence)
+            : melodyPlayer { &melody }, arrangementPlayer { &arrangement }, stepSequencePlayer { &stepSequence }
+        {
+        }
+
+        MelodyPlayerMidiSource melodyPlayer;
+        ArrangementMidiSource arrangementPlayer;
+        MidiFilePlayerMidiSource midiFilePlayer;
+        StepSequenceMidiSource stepSequencePlayer;
+        MidiTransformChain transforms;
+        std::bitset<128> activeNotes { 0 };
+
+        // forgets all notes that are sounding (without stopping them), no allocation
+        void reset() noexcept
+        {
+            arrangementPlayer.reset();
+            midiFilePlayer.reset();
+            stepSequencePlayer.reset();
+            transforms.reset();
+            activeNotes.reset();
+        }
+    };
+
+    SequencedMidiSources audioThreadMidiSources { melody, arrangement, stepSequence };
+    SequencedMidiSources schedulerMidiSources { melody, arrangement, stepSequence };
+    SpscQueue<ScheduledMidiEvent> scheduledMidi { maxNumScheduledEventsPerBlock * 8 };
+    std::bitset<128> sequencedNotes { 0 };
+    bool previousBlockWasScheduled = false;
     bool isRecordEnabled = true;
     juce::MidiBuffer midiScratchBuffer;
     PlayState previousPlayState = PlayState::stopped;
     double sampleRate = 44100.0;
 
 
+    static std::unique_ptr<SynthesizerBase> createSynth (SynthType type, juce::ValueTree& state);
+
     template <typename SynthType>
     void switchSynth()
     {
@@ -42,12 +150,36 @@ private:
         trackState.removeChild (synthNode, nullptr);
         auto newSynth = std::make_unique<SynthType> (trackState);
         newSynth->prepareToPlay (sampleRate, 512);
+        processorChain.setRootInstrument (*newSynth);
         synth = std::move (newSynth);
     }
 
-    void addInternalMidiToScratchBuffer (const RenderContext& renderContext);
+    void renderProcessorChain (const RenderContext& renderContext);
+
+    void addToBusses (RenderContext& renderContext);
+
+    void sendLevelsChanged();
+
+    void addSequencedMidiToScratchBuffer (const RenderContext& renderContext);
+
+    // throws away the scheduled midi of the blocks before the current one, then returns whether the track has
+    // all the scheduled midi for the current block
+    bool hasScheduledMidi (const RenderContext& renderContext);
+
+    // takes the scheduled midi for the current block out of the queue, only adds it to the scratch buffer if the track has it
+    void takeScheduledMidi (const RenderContext& renderContext, bool isScheduled);
+
+    // the melody, arrangement, midi file and step sequence for the block of the play head (with the groove applied),
+    // including the note offs at the end of the loop. the buffer should be empty, so all notes in it come from these sources
+    static void generateSequencedMidi (SequencedMidiSources& sources,
+                                       const PlayHead& playHead,
+                                       const PatternList::Patterns& patterns,
+                                       const MappedMidiFile& file,
+                                       const GrooveSettings& grooveSettings,
+                                       juce::MidiBuffer& buffer,
+                                       int numSamples);
 
-    void addExternalMidiToScratchBuffer (const RenderContext& renderContext);
+    void addExternalMidiToScratchBuffer (const RenderContext& renderContext, int trackIndex);
 
     void updateActiveMidiNotes();
 
@@ -0,0 +1,57 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <console_synth/sequencer/track.h>
+#include <console_synth/utility/atomic_snapshot.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/* Keeps a Track object for every track node in the sequencer state. Adding or removing a track node
+ * (from anywhere, including undo/redo) adds or removes the track while the audio is running.
+ * The audio thread gets the tracks as an immutable list (see AtomicSnapshot), a change publishes a new list.
+ * A track is shared by all lists it's in, so it only gets destroyed when the last list that holds it is deleted,
+ * which always happens on the message thread, never while the audio thread might still be rendering it.
+ * */
+
+class TrackList : private juce::ValueTree::Listener
+{
+public:
+    using Tracks = std::vector<std::shared_ptr<Track>>;
+
+    explicit TrackList (juce::ValueTree sequencerState);
+    ~TrackList() override;
+
+    void prepareToPlay (double sampleRate, int numSamplesPerBlockExpected);
+
+    void releaseResources();
+
+    // the current tracks, in the order of the track nodes. Wait free, so safe to call from the audio thread
+    [[nodiscard]] AtomicSnapshot<Tracks>::ReadScope read() const noexcept;
+
+    // deletes the tracks that were removed (and the old state of the tracks that are left),
+    // if the audio thread isn't using them anymore. Message thread only
+    void collectGarbage();
+
+    [[nodiscard]] int getNumTracks() const noexcept;
+
+private:
+    juce::ValueTree sequencerState;
+    AtomicSnapshot<Tracks> tracks;
+    std::atomic<double> sampleRate { 0.0 };
+    std::atomic<int> blockSize { 0 };
+
+
+    void rebuildTracks();
+
+    [[nodiscard]] std::shared_ptr<Track> findOrCreateTrack (const juce::ValueTree& trackState) const;
+
+    [[nodiscard]] bool isTrackInSequencer (const juce::ValueTree& parent, const juce::ValueTree& child) const;
+
+    void valueTreeChildAdded (juce::ValueTree& parent, juce::ValueTree& child) override;
+    void valueTreeChildRemoved (juce::ValueTree& parent, juce::ValueTree& child, int index) override;
+    void valueTreeChildOrderChanged (juce::ValueTree& parent, int oldIndex, int newIndex) override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TrackList);
+};
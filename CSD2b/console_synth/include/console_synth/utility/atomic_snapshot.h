@@ -0,0 +1,106 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <atomic>
+#include <juce_core/juce_core.h>
+#include <memory>
+#include <vector>
+
+/* Shares an immutable object between a single writer (the message thread) and realtime readers (the audio thread),
+ * without the readers ever having to wait for the writer. This works like read-copy-update:
+ *  - the writer never changes the current snapshot, it builds a completely new one and publishes it
+ *    by swapping the atomic pointer
+ *  - a reader announces itself by incrementing the reader count, then loads the pointer and uses that snapshot
+ *    until it's done. That's two atomic increments and a load, no locks, no loops and no reference counting
+ *  - the old snapshot can't be deleted right away, since a reader might still be using it. So it's retired and
+ *    only deleted once the writer sees that no reader is active. Any reader that starts after the swap gets
+ *    the new snapshot, so when the count has been zero after the swap, nobody can hold the old one anymore.
+ * The memory is always freed by the writer, so the audio thread never has to deallocate.
+ * */
+
+template <typename T>
+class AtomicSnapshot
+{
+public:
+    explicit AtomicSnapshot (std::unique_ptr<const T> initialSnapshot = std::make_unique<const T>())
+        : current { initialSnapshot.release() }
+    {}
+
+    // there shouldn't be any readers left when this is destroyed
+    ~AtomicSnapshot()
+    {
+        jassert (numActiveReaders.load() == 0);
+        delete current.load();
+    }
+
+    // ===============================================================================================
+
+    // Keeps a snapshot alive while it's in scope. Should only be kept for a short while (e.g. one audio block),
+    // since no old snapshot can be deleted while a reader is active.
+    class ReadScope
+    {
+    public:
+        explicit ReadScope (const AtomicSnapshot& owner) noexcept : owner { owner }
+        {
+            owner.numActiveReaders.fetch_add (1, std::memory_order_seq_cst);
+            snapshot = owner.current.load (std::memory_order_seq_cst);
+        }
+
+        ~ReadScope()
+        {
+            owner.numActiveReaders.fetch_sub (1, std::memory_order_release);
+        }
+
+        const T& operator*() const noexcept { return *snapshot; }
+        const T* operator->() const noexcept { return snapshot; }
+
+    private:
+        const AtomicSnapshot& owner;
+        const T* snapshot;
+
+        JUCE_DECLARE_NON_COPYABLE (ReadScope);
+    };
+
+    // wait free, can be called from any thread
+    [[nodiscard]] ReadScope read() const noexcept
+    {
+        return ReadScope { *this };
+    }
+
+    // ===============================================================================================
+
+    // should only be called by the writer (the message thread)
+    void publish (std::unique_ptr<const T> newSnapshot)
+    {
+        auto* old = current.exchange (newSnapshot.release(), std::memory_order_seq_cst);
+        retired.emplace_back (old);
+        collectGarbage();
+    }
+
+    // deletes the retired snapshots if no reader is active, should only be called by the writer.
+    // if a reader is active, they stay around until the next call (or the next publish)
+    void collectGarbage()
+    {
+        if (! retired.empty() && numActiveReaders.load (std::memory_order_seq_cst) == 0)
+            retired.clear();
+    }
+
+    // the writer can always look at the latest snapshot without protection, since it's the only one that deletes
+    [[nodiscard]] const T& getLatestForWriter() const noexcept
+    {
+        return *current.load (std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] size_t getNumRetiredSnapshots() const noexcept
+    {
+        return retired.size();
+    }
+
+private:
+    std::atomic<const T*> current;
+    mutable std::atomic<int> numActiveReaders { 0 };
+    std::vector<std::unique_ptr<const T>> retired;
+
+    JUCE_DECLARE_NON_COPYABLE (AtomicSnapshot);
+};
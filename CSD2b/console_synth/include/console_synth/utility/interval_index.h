@@ -0,0 +1,142 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/* A static index over half open intervals [start, end), which finds all intervals that overlap a range
+ * in O(log n + k) (k being the number of overlapping intervals), without allocating. So it can be queried on the audio thread.
+ *
+ * The intervals are sorted by start and the sorted array itself is used as a binary tree (an implicit interval tree):
+ * the leaves are at the even indices, and the nodes at level k are the indices with k trailing ones (in binary).
+ * Every node stores the largest end in its subtree, so whole subtrees that end before the range can be skipped.
+ * This is the layout of cgranges (by Heng Li), which doesn't need any pointers or extra nodes.
+ * The index is built once (O(n log n)) and never changed, a change means building a new one.
+ * */
+
+class IntervalIndex
+{
+public:
+    struct Interval
+    {
+        uint64_t start;
+        uint64_t end;
+
+        // the index of the interval in the list it was built from
+        size_t id;
+    };
+
+    IntervalIndex() = default;
+
+    explicit IntervalIndex (std::vector<Interval> newIntervals) : intervals { std::move (newIntervals) }
+    {
+        std::sort (intervals.begin(), intervals.end(), [] (const Interval& a, const Interval& b) { return a.start < b.start; });
+        buildTree();
+    }
+
+    // calls the function with the id of every interval that overlaps [start, end), in the order of their starts
+    template <typename Functor>
+    void forEachOverlap (uint64_t start, uint64_t end, Functor&& function) const
+    {
+        if (intervals.empty() || start >= end)
+            return;
+
+        struct StackItem
+        {
+            int level;
+            int64_t node;
+            bool isLeftDone;
+        };
+
+        // the tree is at most 64 levels deep, every level pushes at most two items
+        auto stack = std::array<StackItem, 128> {};
+        auto stackSize = 0;
+        const auto numIntervals = (int64_t) intervals.size();
+
+        stack[(size_t) stackSize++] = { rootLevel, (int64_t { 1 } << rootLevel) - 1, false };
+
+        while (stackSize > 0)
+        {
+            auto item = stack[(size_t) --stackSize];
+
+            // small subtrees are faster to just walk through
+            if (item.level <= 3)
+            {
+                auto first = item.node >> item.level << item.level;
+                auto last = std::min (first + (int64_t { 1 } << (item.level + 1)) - 1, numIntervals);
+
+                for (auto i = first; i < last && intervals[(size_t) i].start < end; ++i)
+                    if (start < intervals[(size_t) i].end)
+                        function (intervals[(size_t) i].id);
+            }
+            else if (! item.isLeftDone)
+            {
+                auto leftChild = item.node - (int64_t { 1 } << (item.level - 1));
+                stack[(size_t) stackSize++] = { item.level, item.node, true };
+
+                // a left child past the end isn't a real node, but its subtree can still have real nodes
+                if (leftChild >= numIntervals || maxEnds[(size_t) leftChild] > start)
+                    stack[(size_t) stackSize++] = { item.level - 1, leftChild, false };
+            }
+            else if (item.node < numIntervals && intervals[(size_t) item.node].start < end)
+            {
+                if (start < intervals[(size_t) item.node].end)
+                    function (intervals[(size_t) item.node].id);
+
+                stack[(size_t) stackSize++] = { item.level - 1, item.node + (int64_t { 1 } << (item.level - 1)), false };
+            }
+        }
+    }
+
+    [[nodiscard]] size_t size() const noexcept { return intervals.size(); }
+
+private:
+    std::vector<Interval> intervals;
+    std::vector<uint64_t> maxEnds;
+    int rootLevel = 0;
+
+
+    void buildTree()
+    {
+        const auto numIntervals = (int64_t) intervals.size();
+        maxEnds.resize (intervals.size());
+
+        if (numIntervals == 0)
+            return;
+
+        // the right most node of the tree (and its max end), a right child can lie past the end of the array,
+        // in which case the max end of the right most node is used for it
+        auto lastNode = int64_t { 0 };
+        auto lastMaxEnd = uint64_t { 0 };
+
+        for (auto i = int64_t { 0 }; i < numIntervals; i += 2)
+        {
+            lastNode = i;
+            lastMaxEnd = maxEnds[(size_t) i] = intervals[(size_t) i].end;
+        }
+
+        auto level = 1;
+
+        for (; (int64_t { 1 } << level) <= numIntervals; ++level)
+        {
+            const auto halfSpan = int64_t { 1 } << (level - 1);
+
+            for (auto i = (halfSpan << 1) - 1; i < numIntervals; i += halfSpan << 2)
+            {
+                auto leftMax = maxEnds[(size_t) (i - halfSpan)];
+                auto rightMax = i + halfSpan < numIntervals ? maxEnds[(size_t) (i + halfSpan)] : lastMaxEnd;
+                maxEnds[(size_t) i] = std::max ({ intervals[(size_t) i].end, leftMax, rightMax });
+            }
+
+            lastNode = (lastNode >> level & 1) ? lastNode - halfSpan : lastNode + halfSpan;
+
+            if (lastNode < numIntervals && maxEnds[(size_t) lastNode] > lastMaxEnd)
+                lastMaxEnd = maxEnds[(size_t) lastNode];
+        }
+
+        rootLevel = level - 1;
+    }
+};
@@ -0,0 +1,128 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+/* A bounded multiple producer, single consumer queue for small trivially copyable items (e.g. midi from several input devices,
+ * each calling back on its own thread). Every cell has a sequence number that says whose turn it is (the design of Dmitry Vyukov's
+ * bounded queue): a producer claims a cell by moving the shared write index forward (compare and swap), writes the item and then
+ * bumps the sequence of the cell to hand it to the consumer. The consumer bumps it again when it's done with it, to hand it to
+ * the producers of the next round. No locks, no allocations after construction, and a full queue drops the item (and counts it)
+ * instead of waiting. The write index and the read index live on their own cache lines.
+ * */
+
+template <typename T>
+class MpscQueue
+{
+public:
+    static_assert (std::is_trivially_copyable_v<T>, "items are copied around as plain memory");
+
+    // the capacity is rounded up to a power of two
+    explicit MpscQueue (size_t minimumCapacity)
+        : capacity { roundUpToPowerOfTwo (minimumCapacity) }, mask { capacity - 1 }, cells { std::make_unique<Cell[]> (capacity) }
+    {
+        for (size_t i = 0; i < capacity; ++i)
+            cells[i].sequence.store (i, std::memory_order_relaxed);
+    }
+
+    // can be called from any number of threads at once, returns false (and counts the item as dropped) if the queue is full
+    bool push (const T& item) noexcept
+    {
+        auto position = writeIndex.load (std::memory_order_relaxed);
+
+        for (;;)
+        {
+            auto& cell = cells[position & mask];
+            const auto difference = (intptr_t) cell.sequence.load (std::memory_order_acquire) - (intptr_t) position;
+
+            // the cell is free in this round, try to claim it
+            if (difference == 0)
+            {
+                if (writeIndex.compare_exchange_weak (position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.item = item;
+                    cell.sequence.store (position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            // the consumer didn't get to the cell of the previous round yet: full
+            else if (difference < 0)
+            {
+                numDropped.fetch_add (1, std::memory_order_relaxed);
+                return false;
+            }
+            // another producer claimed it first, try the next one
+            else
+            {
+                position = writeIndex.load (std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // consumer only, returns false if the queue is empty
+    bool pop (T& item) noexcept
+    {
+        return popBatch (&item, 1) == 1;
+    }
+
+    // consumer only, moves up to maxNumItems items (in order) into the destination, returns how many it moved.
+    // stops at a cell that is claimed by a producer, but not written yet
+    size_t popBatch (T* destination, size_t maxNumItems) noexcept
+    {
+        auto numItems = size_t { 0 };
+
+        for (; numItems < maxNumItems; ++numItems)
+        {
+            auto& cell = cells[readIndex & mask];
+
+            if (cell.sequence.load (std::memory_order_acquire) != readIndex + 1)
+                break;
+
+            destination[numItems] = cell.item;
+            cell.sequence.store (readIndex + capacity, std::memory_order_release);
+            ++readIndex;
+        }
+
+        return numItems;
+    }
+
+    // the number of items that didn't fit since the queue was made
+    [[nodiscard]] uint64_t getNumDropped() const noexcept { return numDropped.load (std::memory_order_relaxed); }
+
+    [[nodiscard]] size_t getCapacity() const noexcept { return capacity; }
+
+private:
+    static constexpr auto cacheLineSize = size_t { 64 };
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence { 0 };
+        T item {};
+    };
+
+    const size_t capacity;
+    const size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    std::atomic<uint64_t> numDropped { 0 };
+
+    alignas (cacheLineSize) std::atomic<size_t> writeIndex { 0 };
+
+    // only the consumer uses this one
+    alignas (cacheLineSize) size_t readIndex = 0;
+
+
+    static size_t roundUpToPowerOfTwo (size_t size) noexcept
+    {
+        auto result = size_t { 1 };
+
+        while (result < size)
+            result <<= 1;
+
+        return result;
+    }
+};
@@ -0,0 +1,171 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <atomic>
+#include <juce_core/juce_core.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/* Spreads a number of independent jobs (e.g. rendering tracks) over a set of worker threads, from the audio thread.
+ * The calling thread doesn't just wait, it takes jobs as well: all threads take the next job index from a shared atomic
+ * counter until there are no jobs left. Because of that, the audio thread never depends on a worker waking up in time:
+ * if none of the workers wakes up, the audio thread simply does all jobs itself. It only ever waits for jobs that a
+ * worker already started.
+ *
+ * No allocations or locks happen on the calling thread (waking a worker is only a signal).
+ * Workers spin for a short while after a round of jobs, so they're usually still awake for the next block.
+ * */
+
+class RealtimeThreadPool
+{
+public:
+    // by default, one worker per core (minus the one for the audio thread)
+    explicit RealtimeThreadPool (int numWorkers = getDefaultNumWorkers())
+    {
+        for (auto i = 0; i < numWorkers; ++i)
+        {
+            workers.push_back (std::make_unique<Worker> (*this, i));
+            workers.back()->startThread (9);
+        }
+    }
+
+    ~RealtimeThreadPool()
+    {
+        for (auto& worker : workers)
+            worker->signalThreadShouldExit();
+
+        for (auto& worker : workers)
+        {
+            worker->wakeUp.signal();
+            worker->stopThread (1000);
+        }
+    }
+
+    // calls job (index) for every index in [0, numJobs), returns when all jobs are done.
+    // should only be called from one thread at a time (the audio thread)
+    template <typename Job>
+    void run (int numJobs, Job& job)
+    {
+        if (numJobs <= 0)
+            return;
+
+        if (numJobs == 1 || workers.empty())
+        {
+            for (auto i = 0; i < numJobs; ++i)
+                job (i);
+
+            return;
+        }
+
+        jassert (numJobs <= maxNumJobs);
+
+        currentJob = &job;
+        invokeJob = [] (void* context, int index) { (*static_cast<Job*> (context)) (index); };
+        numJobsDone.store (0, std::memory_order_relaxed);
+
+        auto round = (jobCounter.load (std::memory_order_relaxed) >> 32) + 1;
+        jobCounter.store ((round << 32) | ((uint64_t) numJobs << 16), std::memory_order_release);
+        generation.fetch_add (1, std::memory_order_acq_rel);
+
+        // no need to wake more workers than there are jobs for them
+        for (auto i = 0; i < std::min (numJobs - 1, (int) workers.size()); ++i)
+            workers[(size_t) i]->wakeUp.signal();
+
+        doAvailableJobs();
+
+        while (numJobsDone.load (std::memory_order_acquire) < numJobs)
+            std::this_thread::yield();
+    }
+
+    [[nodiscard]] int getNumWorkers() const noexcept
+    {
+        return (int) workers.size();
+    }
+
+    static int getDefaultNumWorkers()
+    {
+        return std::max (0, (int) std::thread::hardware_concurrency() - 1);
+    }
+
+private:
+    struct Worker : public juce::Thread
+    {
+        Worker (RealtimeThreadPool& pool, int index) : juce::Thread { "render worker " + juce::String (index) }, pool { pool } {}
+
+        void run() override
+        {
+            auto lastGeneration = pool.generation.load (std::memory_order_acquire);
+
+            while (! threadShouldExit())
+            {
+                if (waitForNextGeneration (lastGeneration))
+                    pool.doAvailableJobs();
+            }
+        }
+
+        // returns true if there's a new round of jobs
+        bool waitForNextGeneration (uint64_t& lastGeneration)
+        {
+            for (auto i = 0; i < numSpinsBeforeSleeping; ++i)
+            {
+                auto current = pool.generation.load (std::memory_order_acquire);
+
+                if (current != lastGeneration)
+                {
+                    lastGeneration = current;
+                    return true;
+                }
+
+                std::this_thread::yield();
+            }
+
+            wakeUp.wait (10);
+            return false;
+        }
+
+        static constexpr auto numSpinsBeforeSleeping = 2000;
+
+        RealtimeThreadPool& pool;
+        juce::WaitableEvent wakeUp;
+    };
+
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    static constexpr auto maxNumJobs = 0xffff;
+
+    void* currentJob = nullptr;
+    void (*invokeJob) (void*, int) = nullptr;
+    std::atomic<int> numJobsDone { 0 };
+    std::atomic<uint64_t> generation { 0 };
+
+    // the round (upper 32 bits), the number of jobs in that round (16 bits) and the next job index (lower 16 bits),
+    // packed together so a worker that is late can never take a job index of one round with the job count of another
+    std::atomic<uint64_t> jobCounter { 0 };
+
+
+    void doAvailableJobs()
+    {
+        auto counter = jobCounter.load (std::memory_order_acquire);
+
+        for (;;)
+        {
+            auto numJobs = (int) ((counter >> 16) & 0xffff);
+            auto index = (int) (counter & 0xffff);
+
+            if (index >= numJobs)
+                return;
+
+            if (jobCounter.compare_exchange_weak (counter, counter + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+                invokeJob (currentJob, index);
+                numJobsDone.fetch_add (1, std::memory_order_release);
+                counter = jobCounter.load (std::memory_order_acquire);
+            }
+        }
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (RealtimeThreadPool);
+};
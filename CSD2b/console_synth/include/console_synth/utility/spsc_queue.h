@@ -0,0 +1,106 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+/* A bounded single producer, single consumer ring buffer for small trivially copyable items.
+ * Both sides are wait free and never allocate (the memory is allocated once, up front).
+ * The read and write index each live on their own cache line, so the producer and consumer
+ * don't keep invalidating each other's cache when they're working at the same time.
+ * A full queue doesn't wait, the item is dropped (and counted). See MpscQueue for multiple producers.
+ * */
+
+template <typename T>
+class SpscQueue
+{
+public:
+    static_assert (std::is_trivially_copyable_v<T>, "items are copied around as plain memory");
+
+    // the capacity is rounded up to a power of two
+    explicit SpscQueue (size_t minimumCapacity) : buffer (roundUpToPowerOfTwo (minimumCapacity)), mask { buffer.size() - 1 } {}
+
+    // producer only, returns false (and counts the item as dropped) if the queue is full
+    bool push (const T& item) noexcept
+    {
+        const auto write = writeIndex.load (std::memory_order_relaxed);
+
+        if (write - readIndex.load (std::memory_order_acquire) == buffer.size())
+        {
+            numDropped.fetch_add (1, std::memory_order_relaxed);
+            return false;
+        }
+
+        buffer[write & mask] = item;
+        writeIndex.store (write + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only, the oldest item (or nullptr if the queue is empty), stays valid until it's popped
+    [[nodiscard]] const T* peek() const noexcept
+    {
+        const auto read = readIndex.load (std::memory_order_relaxed);
+
+        if (read == writeIndex.load (std::memory_order_acquire))
+            return nullptr;
+
+        return &buffer[read & mask];
+    }
+
+    // consumer only, should only be called when peek() returned an item
+    void pop() noexcept
+    {
+        readIndex.store (readIndex.load (std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // consumer only, moves up to maxNumItems items (in order) into the destination, returns how many it moved
+    size_t popBatch (T* destination, size_t maxNumItems) noexcept
+    {
+        const auto read = readIndex.load (std::memory_order_relaxed);
+        const auto numItems = std::min (maxNumItems, writeIndex.load (std::memory_order_acquire) - read);
+
+        for (size_t i = 0; i < numItems; ++i)
+            destination[i] = buffer[(read + i) & mask];
+
+        readIndex.store (read + numItems, std::memory_order_release);
+        return numItems;
+    }
+
+    // the number of items that can be pushed, exact for the producer (the consumer can only make it bigger)
+    [[nodiscard]] size_t getFreeSpace() const noexcept
+    {
+        return buffer.size() - (writeIndex.load (std::memory_order_relaxed) - readIndex.load (std::memory_order_acquire));
+    }
+
+    [[nodiscard]] size_t getCapacity() const noexcept { return buffer.size(); }
+
+    // the number of items that didn't fit since the queue was made
+    [[nodiscard]] uint64_t getNumDropped() const noexcept { return numDropped.load (std::memory_order_relaxed); }
+
+private:
+    static constexpr auto cacheLineSize = size_t { 64 };
+
+    std::vector<T> buffer;
+    const size_t mask;
+    std::atomic<uint64_t> numDropped { 0 };
+
+    // the indices only ever go up, the position in the buffer is the index masked by the capacity
+    alignas (cacheLineSize) std::atomic<size_t> readIndex { 0 };
+    alignas (cacheLineSize) std::atomic<size_t> writeIndex { 0 };
+
+
+    static size_t roundUpToPowerOfTwo (size_t size) noexcept
+    {
+        auto capacity = size_t { 1 };
+
+        while (capacity < size)
+            capacity <<= 1;
+
+        return capacity;
+    }
+};
@@ -3,13 +3,53 @@
 
 #include <console_synth/console_interface/console_interface.h>
 #include <console_synth/engine.h>
+#include <console_synth/midi/midi_processors.h>
+#include <console_synth/midi/standard_midi_file.h>
+#include <console_synth/sequencer/groove.h>
 #include <console_synth/sequencer/melody_generator.h>
+#include <console_synth/sequencer/step_sequence.h>
 #include <console_synth/utility/format.h>
 #include <ctre.hpp>
 #include <thread>
 
 // =================================================================================================
 
+// the commands that change a track (notes, synth, sends) work on the selected track,
+// the index of that track is stored in the sequencer state
+static int getSelectedTrackIndex (Engine& engine)
+{
+    return (int) engine.getValueTreeState().getChildWithName (IDs::sequencer).getProperty (IDs::selectedTrack, 0);
+}
+
+static juce::ValueTree getTrack (Engine& engine, int index)
+{
+    auto trackIndex = 0;
+
+    for (auto&& child : engine.getValueTreeState().getChildWithName (IDs::sequencer))
+        if (child.hasType (IDs::track) && trackIndex++ == index)
+            return child;
+
+    return {};
+}
+
+static int getNumTracks (Engine& engine)
+{
+    auto numTracks = 0;
+
+    for (auto&& child : engine.getValueTreeState().getChildWithName (IDs::sequencer))
+        if (child.hasType (IDs::track))
+            ++numTracks;
+
+    return numTracks;
+}
+
+static juce::ValueTree getSelectedTrack (Engine& engine)
+{
+    return getTrack (engine, getSelectedTrackIndex (engine));
+}
+
+// =================================================================================================
+
 struct ChangeTempo_CommandHandler : public CommandHandler
 {
     ~ChangeTempo_CommandHandler() override = default;
@@ -37,6 +77,209 @@ private:
 
 // =================================================================================================
 
+struct AddTempoChange_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto match = ctre::match<pattern> (command);
+        auto bpm = std::stod (match.get<1>().to_string());
+        auto beat = std::stod (match.get<2>().to_string());
+        auto isRamp = ! match.get<3>().to_view().empty();
+
+        auto ticksPerQuarterNote = engine.getSequencer().getMeterMap().getTicksPerQuarterNote();
+        auto tick = (juce::int64) std::llround (beat * ticksPerQuarterNote);
+
+        auto change = juce::ValueTree { IDs::tempoChange };
+        change.setProperty (IDs::tick, tick, nullptr);
+        change.setProperty (IDs::tempo, bpm, nullptr);
+        change.setProperty (IDs::ramp, isRamp, nullptr);
+
+        engine.getValueTreeState()
+            .getChildWithName (IDs::sequencer)
+            .getChildWithName (IDs::tempoMap)
+            .appendChild (change, engine.getUndoManager());
+
+        return fmt::format ("{} to {} bpm at beat {}", isRamp ? "ramping" : "changing", bpm, beat);
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "tempo <tempo_bpm> at <beat> [ramp] (changes the tempo at the given beat, 'ramp' moves there gradually)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^tempo\s([0-9]+(?:\.[0-9]+)?)\sat\s([0-9]+(?:\.[0-9]+)?)(\sramp)?$)" };
+};
+
+// =================================================================================================
+
+struct ClearTempoChanges_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        engine.getValueTreeState()
+            .getChildWithName (IDs::sequencer)
+            .getChildWithName (IDs::tempoMap)
+            .removeAllChildren (engine.getUndoManager());
+
+        return "removed all tempo changes";
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "clear tempo (removes all tempo changes, only the tempo at the start is left)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { "^clear\\stempo$" };
+};
+
+// =================================================================================================
+
+struct ChangeMeter_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto match = ctre::match<pattern> (command);
+        auto numerator = std::stoi (match.get<1>().to_string());
+        auto denominator = std::stoi (match.get<2>().to_string());
+        auto bar = match.get<3>().to_view().empty() ? 1 : std::stoi (match.get<3>().to_string());
+
+        if (numerator == 0 || ! TimeSignature::isValidDenominator ((uint32_t) denominator))
+            return fmt::format ("{}/{} is not a valid time signature", numerator, denominator);
+
+        if (bar == 0)
+            return "bars start counting at 1";
+
+        auto meterMapState = engine.getValueTreeState().getChildWithName (IDs::sequencer).getChildWithName (IDs::meterMap);
+
+        // a bar can only have one time signature, so replace the one that's already there
+        for (auto i = meterMapState.getNumChildren() - 1; i >= 0; --i)
+            if ((int) meterMapState.getChild (i).getProperty (IDs::bar) == bar - 1)
+                meterMapState.removeChild (i, engine.getUndoManager());
+
+        auto change = juce::ValueTree { IDs::meterChange };
+        change.setProperty (IDs::bar, bar - 1, nullptr);
+        change.setProperty (IDs::numerator, numerator, nullptr);
+        change.setProperty (IDs::denominator, denominator, nullptr);
+        meterMapState.appendChild (change, engine.getUndoManager());
+
+        return fmt::format ("set time signature to {}/{} from bar {}", numerator, denominator, bar);
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "meter <numerator>/<denominator> [at <bar>] (sets the time signature from the given bar, or from the start)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^meter\s([0-9]+)/([0-9]+)(?:\sat\s([0-9]+))?$)" };
+};
+
+// =================================================================================================
+
+struct ChangeLoopLength_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto numBars = std::stoi (ctre::match<pattern> (command).get<1>().to_string());
+
+        if (numBars == 0)
+            return "the loop should be at least one bar long";
+
+        engine.getValueTreeState().getChildWithName (IDs::sequencer).setProperty (IDs::loopBars, numBars, engine.getUndoManager());
+        return fmt::format ("set loop length to {} bars", numBars);
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "loop <num_bars> (sets the length of the loop, generated melodies fill the whole loop)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^loop\s([0-9]+)$)" };
+};
+
+// =================================================================================================
+
+struct ChangeLookahead_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto numBlocks = std::min (std::stoi (ctre::match<pattern> (command).get<1>().to_string()), MidiScheduler::maxLookaheadBlocks);
+        engine.getValueTreeState().getChildWithName (IDs::sequencer).setProperty (IDs::lookaheadBlocks, numBlocks, nullptr);
+
+        if (numBlocks == 0)
+            return "midi is generated in the audio callback";
+
+        return fmt::format ("midi is generated {} blocks ahead", numBlocks);
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "lookahead <num_blocks> (how many blocks ahead the midi of the tracks is generated, 0 turns it off)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^lookahead\s([0-9]+)$)" };
+};
+
+// =================================================================================================
+
+struct ChangeMidiLatency_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto numBlocks = std::min (std::stod (ctre::match<pattern> (command).get<1>().to_string()), MidiInputRouter::maxLatencyBlocks);
+        engine.getValueTreeState().getChildWithName (IDs::sequencer).setProperty (IDs::midiLatencyBlocks, numBlocks, nullptr);
+
+        if (numBlocks < 1.0)
+            return fmt::format ("live midi is played {} blocks after it came in (below one block, the timing can jitter)", numBlocks);
+
+        return fmt::format ("live midi is played {} blocks after it came in", numBlocks);
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "midi latency <num_blocks> (how long after it came in live midi is played, 1 block by default)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^midi\slatency\s([0-9]+(?:\.[0-9]+)?)$)" };
+};
+
+// =================================================================================================
+
 struct ListAudioDevices_CommandHandler : public CommandHandler
 {
     bool canHandleCommand (std::string_view command) noexcept override
@@ -65,12 +308,1055 @@ struct ListAudioDevices_CommandHandler : public CommandHandler
     }
 
 private:
-    static constexpr auto pattern = ctll::fixed_string { "^ls\\saudio\\sdevices$" };
+    static constexpr auto pattern = ctll::fixed_string { "^ls\\saudio\\sdevices$" };
+};
+
+// =================================================================================================
+
+struct ListMidiDevices_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto deviceNames = Engine::getAvailableMidiDevices();
+
+        auto nameList = std::string {};
+
+        for (auto& name : deviceNames)
+            nameList += fmt::format ("\n - {}", name);
+
+        if (nameList.empty())
+            return "no midi devices available";
+
+        return nameList;
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "ls midi devices (gives a list of available midi input devices)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { "^ls\\smidi\\sdevices$" };
+};
+
+// =================================================================================================
+
+
+struct OpenMidiInputDevice_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto name = ctre::match<pattern> (command).get<1>().to_string();
+
+        auto trackIndex = getSelectedTrackIndex (engine);
+
+        if (engine.getSequencer().openMidiInputDevice (name, trackIndex))
+            return fmt::format ("Successfully opened midi input device '{}', it plays on track {}", name, trackIndex);
+
+        return fmt::format ("Failed to open '{}'", name);
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "open midi <midi_input_name> (attemts to open midi input device, it plays on the selected track)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^open\smidi\s([a-zA-Z0-9\s]+)$)" };
+};
+
+
+// =================================================================================================
+
+
+struct CloseMidiInputDevice_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto name = ctre::match<pattern> (command).get<1>().to_string();
+
+        if (engine.getSequencer().closeMidiInputDevice (name))
+            return fmt::format ("Closed midi input device '{}'", name);
+
+        return fmt::format ("'{}' is not open", name);
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "close midi <midi_input_name> (closes an open midi input device)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^close\smidi\s([a-zA-Z0-9\s]+)$)" };
+};
+
+
+// =================================================================================================
+
+
+struct RouteMidiInput_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto match = ctre::match<pattern> (command);
+        auto channelText = match.get<1>().to_string();
+        auto channel = channelText == "all" ? 0 : std::stoi (channelText);
+        auto trackIndex = std::stoi (match.get<2>().to_string());
+        auto name = match.get<3>().to_string();
+
+        if (trackIndex >= getNumTracks (engine))
+            return fmt::format ("there is no track {}", trackIndex);
+
+        if (engine.getSequencer().routeMidiInput (name, channel, trackIndex))
+            return fmt::format ("channel {} of '{}' plays on track {}", channelText, name, trackIndex);
+
+        return fmt::format ("Failed to route '{}' (is it open?)", name);
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "route midi <channel|all> <track> <midi_input_name> (plays a channel of an open midi input on a track)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^route\smidi\s(all|\d+)\s(\d+)\s([a-zA-Z0-9\s]+)$)" };
+};
+
+
+// =================================================================================================
+
+
+struct ListMidiInputs_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto response = std::string {};
+        auto midiInputs = engine.getValueTreeState().getChildWithName (IDs::sequencer).getChildWithName (IDs::midiInputs);
+
+        for (auto&& input : midiInputs)
+        {
+            response += fmt::format ("\n - {}", input.getProperty (IDs::name).toString());
+
+            for (auto&& route : input)
+            {
+                auto channel = (int) route.getProperty (IDs::channel);
+                auto channelText = channel == 0 ? std::string { "all" } : std::to_string (channel);
+                response += fmt::format ("\n     channel {} -> track {}", channelText, (int) route.getProperty (IDs::track));
+            }
+        }
+
+        if (response.empty())
+            return "no midi inputs open";
+
+        return response;
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "ls midi inputs (lists the open midi inputs and the tracks they play on)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { "^ls\\smidi\\sinputs$" };
+};
+
+
+// =================================================================================================
+
+struct StopPlayback_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        engine.getSequencer().stopPlayback();
+        return "stopped playback";
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "stop (stops playback)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { "^stop$" };
+};
+
+// =================================================================================================
+
+struct StartRecording_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        engine.getSequencer().startRecording();
+        return "recording the midi inputs into the melodies of their tracks";
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "record (starts playback and records the midi inputs, 'stop' ends the recording)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { "^record$" };
+};
+
+// =================================================================================================
+
+struct StartPlayback_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        engine.getSequencer().startPlayback();
+        return "started playback";
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "start (start playback)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { "^start$" };
+};
+
+// =================================================================================================
+
+struct AddNote_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto note = juce::ValueTree { IDs::note };
+
+        if (auto m = ctre::match<pattern> (command))
+        {
+            auto noteNumber = std::stoi (m.get<1>().to_string());
+            auto start = std::stoi (m.get<2>().to_string());
+
+            auto length = 48;
+            auto velocity = 127;
+
+            note.setProperty (IDs::midiNoteNumber, noteNumber, nullptr);
+            note.setProperty (IDs::startTimeTicks, start, nullptr);
+            note.setProperty (IDs::lengthTicks, length, nullptr);
+            note.setProperty (IDs::velocity, velocity, nullptr);
+
+            getSelectedTrack (engine)
+                .getChildWithName (IDs::melody)
+                .appendChild (note, engine.getUndoManager());
+
+            return fmt::format ("added note {} at tick {}", noteNumber, start);
+        }
+
+        return "failed to add note";
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "add note <number> <position_ticks>";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^add\snote\s([0-9]+)\s([0-9]+)$)" };
+};
+
+// =================================================================================================
+
+struct ListNotes_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto melody = getSelectedTrack (engine)
+                          .getChildWithName (IDs::melody);
+
+        auto answer = std::string {};
+
+        const auto& meterMap = engine.getSequencer().getMeterMap();
+        auto ticksPerQuarterNote = (double) meterMap.getTicksPerQuarterNote();
+
+        for (auto&& note : melody)
+        {
+            auto midiNum = (int) note.getProperty (IDs::midiNoteNumber);
+            auto start = meterMap.toMusicalTime ((uint64_t) (int) note.getProperty (IDs::startTimeTicks));
+            auto length = (double) ((int) note.getProperty (IDs::lengthTicks)) / ticksPerQuarterNote;
+            auto velocity = (int) note.getProperty (IDs::velocity);
+
+            // bars and beats are shown counting from 1
+            answer += fmt::format ("\n - number: {},\tstart (bar.beat.tick): {}.{}.{},\tlength (quarter notes): {},\tvelocity: {}",
+                                   midiNum,
+                                   start.bar + 1,
+                                   start.beat + 1,
+                                   start.tick,
+                                   length,
+                                   velocity);
+        }
+
+        if (answer.empty())
+            return "No notes in the melody currently";
+
+        return answer;
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "ls notes (gives a formatted list of all notes in the melody)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { "^ls\\snotes$" };
+};
+
+// =================================================================================================
+
+struct GenerateMelody_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto seed = ctre::match<pattern> (command).get<1>();
+        auto generator = seed.to_view().empty() ? MelodyGenerator {} : MelodyGenerator { std::stoll (seed.to_string()) };
+        auto numBars = (int) engine.getValueTreeState().getChildWithName (IDs::sequencer).getProperty (IDs::loopBars, 1);
+        auto melody = generator.generateMelody (engine.getSequencer().getMeterMap(), (uint32_t) std::max (numBars, 1));
+
+        auto m = getSelectedTrack (engine)
+                     .getChildWithName (IDs::melody);
+
+        auto shouldPausePlayback = engine.getSequencer().isPlaying();
+
+        if (shouldPausePlayback)
+            engine.getSequencer().stopPlayback();
+
+        // kind of a hack to make all notes currently playing stop... (wait for more than 1 buffer length)
+        std::this_thread::sleep_for (std::chrono::milliseconds { 50 });
+
+        {
+            // the melody only rebuilds its events once, after all notes have been replaced
+            auto batch = ScopedMelodyEditBatch { m };
+            m.removeAllChildren (nullptr);
+
+            for (const auto& note : melody)
+                m.appendChild (note.createCopy(), nullptr);
+        }
+
+        if (shouldPausePlayback)
+            engine.getSequencer().startPlayback();
+
+        return "generated melody";
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "g [seed <seed>] (generates melody, the same seed gives the same melody)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^g(?:\sseed\s([0-9]+))?$)" };
+};
+
+// =================================================================================================
+
+struct ImportMidiFile_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto path = ctre::match<pattern> (command).get<1>().to_string();
+        auto file = juce::File::getCurrentWorkingDirectory().getChildFile (path);
+
+        auto melody = getSelectedTrack (engine)
+                          .getChildWithName (IDs::melody);
+
+        auto shouldPausePlayback = engine.getSequencer().isPlaying();
+
+        if (shouldPausePlayback)
+            engine.getSequencer().stopPlayback();
+
+        // same hack as when generating a melody, so the notes that are playing stop
+        std::this_thread::sleep_for (std::chrono::milliseconds { 50 });
+
+        auto answer = std::string {};
+
+        try
+        {
+            auto numNotes = StandardMidiFile::importFile (file, melody, Sequencer::ticksPerQuarterNote);
+            answer = fmt::format ("imported {} notes from {}", numNotes, file.getFullPathName().toStdString());
+        }
+        catch (std::exception& e)
+        {
+            answer = fmt::format ("failed to import midi file: {}", e.what());
+        }
+
+        if (shouldPausePlayback)
+            engine.getSequencer().startPlayback();
+
+        return answer;
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "import midi <file> (replaces the melody with the notes of a midi file)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^import\smidi\s(.+)$)" };
+};
+
+// =================================================================================================
+
+struct ExportMidiFile_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto path = ctre::match<pattern> (command).get<1>().to_string();
+        auto file = juce::File::getCurrentWorkingDirectory().getChildFile (path);
+
+        auto track = getSelectedTrack (engine);
+        auto melody = Melody { track };
+        auto& sequencer = engine.getSequencer();
+
+        if (! StandardMidiFile::exportFile (file, melody, sequencer.getMeterMap(), sequencer.getTempoMap()))
+            return fmt::format ("failed to write {}", file.getFullPathName().toStdString());
+
+        return fmt::format ("exported melody to {}", file.getFullPathName().toStdString());
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "export midi <file> (writes the melody to a midi file)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^export\smidi\s(.+)$)" };
+};
+
+// =================================================================================================
+
+struct RenderAudioFile_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto match = ctre::match<pattern> (command);
+        auto file = juce::File::getCurrentWorkingDirectory().getChildFile (match.get<1>().to_string());
+        auto count = match.get<3>().to_view().empty() ? 1u : (uint32_t) std::stoul (match.get<3>().to_string());
+
+        auto settings = OfflineRenderSettings {};
+
+        if (! match.get<4>().to_view().empty())
+            settings.tailSeconds = std::stod (match.get<4>().to_string());
+
+        auto shouldResumePlayback = engine.getSequencer().isPlaying();
+
+        try
+        {
+            auto result = match.get<2>().to_view() == "bars" ? engine.renderBars (file, count, settings)
+                                                    : engine.renderLoops (file, count, settings);
+
+            if (shouldResumePlayback)
+                engine.getSequencer().startPlayback();
+
+            return fmt::format ("rendered {:.2f} seconds of audio to {} in {:.2f} seconds ({:.1f}x realtime)",
+                                result.getAudioSeconds(),
+                                file.getFullPathName().toStdString(),
+                                result.renderSeconds,
+                                result.getRealtimeFactor());
+        }
+        catch (std::exception& e)
+        {
+            return fmt::format ("failed to render audio file: {}", e.what());
+        }
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "bounce <file> [bars|loops <n>] [tail <seconds>] (renders the song to a wav or flac file, as fast as possible)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^bounce\s(.+?)(?:\s(bars|loops)\s([0-9]+))?(?:\stail\s([0-9]+(?:\.[0-9]+)?))?$)" };
+};
+
+// =================================================================================================
+
+struct LoadMidiFile_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto path = ctre::match<pattern> (command).get<1>().to_string();
+        auto file = juce::File::getCurrentWorkingDirectory().getChildFile (path);
+
+        try
+        {
+            if (engine.getSequencer().loadMidiFile (getSelectedTrackIndex (engine), file))
+                return fmt::format ("streaming {} on the selected track", file.getFullPathName().toStdString());
+        }
+        catch (std::exception& e)
+        {
+            return fmt::format ("failed to load midi file: {}", e.what());
+        }
+
+        return "no track selected";
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "load midi <file> (streams a midi file on the selected track, without adding its notes to the melody)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^load\smidi\s(.+)$)" };
+};
+
+// =================================================================================================
+
+struct UnloadMidiFile_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        if (engine.getSequencer().unloadMidiFile (getSelectedTrackIndex (engine)))
+            return "stopped streaming the midi file";
+
+        return "no track selected";
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "unload midi (stops streaming the midi file of the selected track)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { "^unload\\smidi$" };
+};
+
+// =================================================================================================
+
+struct ChangeStepSequence_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command) || ctre::match<offPattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto stepSequence = getSelectedTrack (engine).getChildWithName (IDs::stepSequence);
+
+        if (ctre::match<offPattern> (command))
+        {
+            stepSequence.setProperty (IDs::numHits, 0, engine.getUndoManager());
+            return "turned the step sequence of the selected track off";
+        }
+
+        auto match = ctre::match<pattern> (command);
+        auto numHits = std::stoi (match.get<1>().to_string());
+        auto numSteps = std::stoi (match.get<2>().to_string());
+
+        if (numSteps == 0 || numSteps > StepPattern::maxNumSteps || numHits > numSteps)
+            return fmt::format ("a pattern has 1 to {} steps and can't have more hits than steps", StepPattern::maxNumSteps);
+
+        stepSequence.setProperty (IDs::numHits, numHits, engine.getUndoManager());
+        stepSequence.setProperty (IDs::numSteps, numSteps, engine.getUndoManager());
+        stepSequence.setProperty (IDs::rotation, match.get<3>().to_view().empty() ? 0 : std::stoi (match.get<3>().to_string()), engine.getUndoManager());
+
+        if (! match.get<4>().to_view().empty())
+            stepSequence.setProperty (IDs::stepLengthTicks, std::max (1, std::stoi (match.get<4>().to_string())), engine.getUndoManager());
+
+        return fmt::format ("playing {} hits in {} steps on the selected track", numHits, numSteps);
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "euclid <hits> <steps> [rotate <steps>] [grid <ticks>] | euclid off (spreads the hits evenly over the steps of the selected track)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string {
+        R"(^euclid\s([0-9]+)\s([0-9]+)(?:\srotate\s(-?[0-9]+))?(?:\sgrid\s([0-9]+))?$)"
+    };
+    static constexpr auto offPattern = ctll::fixed_string { "^euclid\\soff$" };
+};
+
+// =================================================================================================
+
+struct ChangeStepValues_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto match = ctre::match<pattern> (command);
+        auto isNotes = match.get<1>().to_view() == "notes";
+        auto values = juce::Array<juce::var> {};
+
+        for (auto&& token : juce::StringArray::fromTokens (match.get<2>().to_string(), " ", ""))
+            if (token.isNotEmpty())
+                values.add (juce::jlimit (0, 127, token.getIntValue()));
+
+        if (values.size() > StepPattern::maxNumSteps)
+            return fmt::format ("a pattern has at most {} steps", StepPattern::maxNumSteps);
+
+        getSelectedTrack (engine)
+            .getChildWithName (IDs::stepSequence)
+            .setProperty (isNotes ? IDs::notes : IDs::velocities, values, engine.getUndoManager());
+
+        return fmt::format ("set the {} of {} steps", isNotes ? "notes" : "velocities", values.size());
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "euclid notes|velocities <value> ... (the values repeat over the steps, velocity 0 is a rest)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^euclid\s(notes|velocities)((?:\s[0-9]+)+)$)" };
+};
+
+// =================================================================================================
+
+struct ChangeSwing_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto match = ctre::match<pattern> (command);
+        auto percent = std::stoi (match.get<1>().to_string());
+        auto groove = getSelectedTrack (engine).getChildWithName (IDs::groove);
+
+        if (percent > 90)
+            return "the swing can be at most 90 percent of a step";
+
+        groove.setProperty (IDs::swing, percent / 100.0, engine.getUndoManager());
+
+        if (! match.get<2>().to_view().empty())
+            groove.setProperty (IDs::swingGridTicks, std::max (1, std::stoi (match.get<2>().to_string())), engine.getUndoManager());
+
+        return fmt::format ("set the swing of the selected track to {}%", percent);
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "swing <percent> [grid <ticks>] (moves every second step of the grid later, 33 is a triplet feel)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^swing\s([0-9]+)(?:\sgrid\s([0-9]+))?$)" };
+};
+
+// =================================================================================================
+
+struct ChangeGrooveTemplate_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command) || ctre::match<offPattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto groove = getSelectedTrack (engine).getChildWithName (IDs::groove);
+
+        if (ctre::match<offPattern> (command))
+        {
+            groove.removeProperty (IDs::grooveOffsets, engine.getUndoManager());
+            groove.removeProperty (IDs::grooveVelocities, engine.getUndoManager());
+            return "removed the groove template of the selected track";
+        }
+
+        auto match = ctre::match<pattern> (command);
+        auto isVelocities = ! match.get<1>().to_view().empty();
+        auto values = juce::Array<juce::var> {};
+
+        for (auto&& token : juce::StringArray::fromTokens (match.get<2>().to_string(), " ", ""))
+            if (token.isNotEmpty())
+                values.add (token.getIntValue());
+
+        if (values.size() > GrooveSettings::maxNumGrooveSteps)
+            return fmt::format ("a groove template has at most {} steps", GrooveSettings::maxNumGrooveSteps);
+
+        groove.setProperty (isVelocities ? IDs::grooveVelocities : IDs::grooveOffsets, values, engine.getUndoManager());
+
+        if (! isVelocities && ! match.get<3>().to_view().empty())
+            groove.setProperty (IDs::grooveGridTicks, std::max (1, std::stoi (match.get<3>().to_string())), engine.getUndoManager());
+
+        return fmt::format ("set the groove {} of {} steps", isVelocities ? "velocities" : "offsets", values.size());
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "groove [velocities] <value> ... [grid <ticks>] | groove off (offsets in ticks or velocities in percent per step of the template)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^groove(\svelocities)?((?:\s[0-9]+)+)(?:\sgrid\s([0-9]+))?$)" };
+    static constexpr auto offPattern = ctll::fixed_string { "^groove\\soff$" };
+};
+
+// =================================================================================================
+
+struct ChangeHumanize_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto match = ctre::match<pattern> (command);
+        auto ticks = std::stod (match.get<1>().to_string());
+        auto velocity = std::stoi (match.get<2>().to_string());
+        auto groove = getSelectedTrack (engine).getChildWithName (IDs::groove);
+
+        groove.setProperty (IDs::humanizeTicks, ticks, engine.getUndoManager());
+        groove.setProperty (IDs::humanizeVelocity, std::min (velocity, 127), engine.getUndoManager());
+
+        if (! match.get<3>().to_view().empty())
+            groove.setProperty (IDs::seed, std::stoi (match.get<3>().to_string()), engine.getUndoManager());
+
+        return fmt::format ("humanizing the selected track by up to {} ticks and {} velocity", ticks, velocity);
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "humanize <ticks> <velocity> [seed <seed>] (random delays and velocities, the same every time with the same seed)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^humanize\s([0-9]+(?:\.[0-9]+)?)\s([0-9]+)(?:\sseed\s([0-9]+))?$)" };
+};
+
+// =================================================================================================
+
+struct ChangeTranspose_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto semitones = std::stoi (ctre::match<pattern> (command).get<1>().to_string());
+        getSelectedTrack (engine).getChildWithName (IDs::groove).setProperty (IDs::transpose, semitones, engine.getUndoManager());
+        return fmt::format ("transposed the selected track by {} semitones", semitones);
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "transpose <semitones> (transposes everything the selected track plays, without changing its notes)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^transpose\s(-?[0-9]+)$)" };
+};
+
+// =================================================================================================
+
+struct ChangeArpeggiator_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto match = ctre::match<pattern> (command);
+        auto modeName = match.get<1>().to_string();
+        auto processors = getSelectedTrack (engine).getChildWithName (IDs::midiProcessors);
+
+        static constexpr auto modeNames = std::array { "off", "up", "down", "updown", "played" };
+        auto mode = (int) std::distance (modeNames.begin(), std::find (modeNames.begin(), modeNames.end(), modeName));
+
+        processors.setProperty (IDs::arpeggiatorMode, mode, engine.getUndoManager());
+
+        if (! match.get<2>().to_view().empty())
+            processors.setProperty (IDs::arpeggiatorRateTicks, std::max (1, std::stoi (match.get<2>().to_string())), engine.getUndoManager());
+
+        if (! match.get<3>().to_view().empty())
+            processors.setProperty (IDs::arpeggiatorGate, std::stoi (match.get<3>().to_string()) / 100.0, engine.getUndoManager());
+
+        if (! match.get<4>().to_view().empty())
+            processors.setProperty (IDs::arpeggiatorOctaves, std::stoi (match.get<4>().to_string()), engine.getUndoManager());
+
+        return fmt::format ("set the arpeggiator of the selected track to {}", modeName);
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "arp off|up|down|updown|played [rate <ticks>] [gate <percent>] [octaves <1-4>] (arpeggiates the held notes of the selected track)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string {
+        R"(^arp\s(off|up|down|updown|played)(?:\srate\s([0-9]+))?(?:\sgate\s([0-9]+))?(?:\soctaves\s([0-9]+))?$)"
+    };
+};
+
+// =================================================================================================
+
+struct ChangeChord_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command) || ctre::match<offPattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto processors = getSelectedTrack (engine).getChildWithName (IDs::midiProcessors);
+
+        if (ctre::match<offPattern> (command))
+        {
+            processors.removeProperty (IDs::chord, engine.getUndoManager());
+            return "removed the chord of the selected track";
+        }
+
+        auto intervals = juce::Array<juce::var> {};
+
+        for (auto&& token : juce::StringArray::fromTokens (ctre::match<pattern> (command).get<1>().to_string(), " ", ""))
+            if (token.isNotEmpty())
+                intervals.add (token.getIntValue());
+
+        if (intervals.size() > MidiProcessorSettings::maxNumChordNotes)
+            return fmt::format ("a chord has at most {} notes", MidiProcessorSettings::maxNumChordNotes);
+
+        processors.setProperty (IDs::chord, intervals, engine.getUndoManager());
+        return fmt::format ("every note of the selected track plays a chord of {} notes", intervals.size());
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "chord <interval> ... | chord off (every note plays a chord, e.g. chord 0 4 7)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^chord((?:\s-?[0-9]+)+)$)" };
+    static constexpr auto offPattern = ctll::fixed_string { "^chord\\soff$" };
+};
+
+// =================================================================================================
+
+struct ChangeNoteRepeat_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command) || ctre::match<offPattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto processors = getSelectedTrack (engine).getChildWithName (IDs::midiProcessors);
+
+        if (ctre::match<offPattern> (command))
+        {
+            processors.setProperty (IDs::repeatRateTicks, 0, engine.getUndoManager());
+            return "turned note repeat off on the selected track";
+        }
+
+        auto match = ctre::match<pattern> (command);
+        auto rate = std::stoi (match.get<1>().to_string());
+        processors.setProperty (IDs::repeatRateTicks, rate, engine.getUndoManager());
+
+        if (! match.get<2>().to_view().empty())
+            processors.setProperty (IDs::repeatGate, std::stoi (match.get<2>().to_string()) / 100.0, engine.getUndoManager());
+
+        return fmt::format ("repeating the held notes of the selected track every {} ticks", rate);
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "repeat <ticks> [gate <percent>] | repeat off (repeats the held notes of the selected track)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { R"(^repeat\s([0-9]+)(?:\sgate\s([0-9]+))?$)" };
+    static constexpr auto offPattern = ctll::fixed_string { "^repeat\\soff$" };
+};
+
+// =================================================================================================
+
+struct Undo_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        if (engine.getUndoManager()->undo())
+            return "undo successful";
+
+        return "undo failed";
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "undo (undoes effect of last command)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { "^undo$" };
+};
+
+// =================================================================================================
+
+struct Redo_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        if (engine.getUndoManager()->redo())
+            return "redo successful";
+
+        return "redo failed";
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "redo (redoes effect of last undone command)";
+    }
+
+private:
+    static constexpr auto pattern = ctll::fixed_string { "^redo$" };
+};
+
+// =================================================================================================
+
+struct ChangeEnvelope_CommandHandler : public CommandHandler
+{
+    bool canHandleCommand (std::string_view command) noexcept override
+    {
+        return ctre::match<pattern> (command);
+    }
+
+    std::string handleCommand (Engine& engine, std::string_view command) override
+    {
+        auto synth = getSelectedTrack (engine)
+                         .getChildWithName (IDs::synth);
+
+        auto match = ctre::match<pattern> (command);
+
+        try
+        {
+            auto a = std::stod (match.get<1>().to_string());
+            auto d = std::stod (match.get<2>().to_string());
+            auto s = std::stod (match.get<3>().to_string());
+            auto r = std::stod (match.get<4>().to_string());
+
+            synth.setProperty (IDs::attack, a, nullptr);
+            synth.setProperty (IDs::decay, d, nullptr);
+            synth.setProperty (IDs::sustain, s, nullptr);
+            synth.setProperty (IDs::release, r, nullptr);
+        }
+        catch (std::exception& e)
+        {
+            return fmt::format ("error in parsing envelope command: {}", e.what());
+        }
+
+        return "adsr set successfully";
+    }
+
+    [[nodiscard]] std::string_view getHelpString() const noexcept override
+    {
+        return "adsr <a> <d> <s> <r> (sets the envelope)";
+    }
+
+private:
+    // regex for: "adsr <float> <float> <float> <float>"
+    static constexpr auto pattern = ctll::fixed_string { R"(^adsr\s(\d+\.\d+)\s(\d+\.\d+)\s(\d+\.\d+)\s(\d+\.\d+)$)" };
 };
 
 // =================================================================================================
 
-struct ListMidiDevices_CommandHandler : public CommandHandler
+struct ChangeSynth_CommandHandler : public CommandHandler
 {
     bool canHandleCommand (std::string_view command) noexcept override
     {
@@ -79,61 +1365,92 @@ struct ListMidiDevices_CommandHandler : public CommandHandler
 
     std::string handleCommand (Engine& engine, std::string_view command) override
     {
-        auto deviceNames = Engine::getAvailableMidiDevices();
+        auto type = ctre::match<pattern> (command).get<1>().to_view();
+        auto track = getSelectedTrack (engine);
 
-        auto nameList = std::string {};
+        auto newType = SynthType::fm;
 
-        for (auto& name : deviceNames)
-            nameList += fmt::format ("\n - {}", name);
+        if (type == "rm")
+            newType = SynthType::rm;
 
-        if (nameList.empty())
-            return "no midi devices available";
+        track.setProperty (IDs::synthType, juce::VariantConverter<SynthType>::toVar (newType), engine.getUndoManager());
 
-        return nameList;
+        return fmt::format ("changed synth type to {}", type);
     }
 
     [[nodiscard]] std::string_view getHelpString() const noexcept override
     {
-        return "ls midi devices (gives a list of available midi input devices)";
+        return "switch synth <rm|fm> (switches the synth to the given type)";
     }
 
 private:
-    static constexpr auto pattern = ctll::fixed_string { "^ls\\smidi\\sdevices$" };
+    static constexpr auto pattern = ctll::fixed_string { R"(^switch\ssynth\s(rm|fm)$)" };
 };
 
 // =================================================================================================
 
-
-struct OpenMidiInputDevice_CommandHandler : public CommandHandler
+struct ChangeRatios_CommandHandler : public CommandHandler
 {
     bool canHandleCommand (std::string_view command) noexcept override
     {
-        return ctre::match<pattern> (command);
+        if (ctre::match<fmPattern> (command) || ctre::match<rmPattern> (command))
+            return true;
+
+        return false;
     }
 
     std::string handleCommand (Engine& engine, std::string_view command) override
     {
-        auto name = ctre::match<pattern> (command).get<1>().to_string();
+        auto typeProperty = getSelectedTrack (engine)
+                                .getProperty (IDs::synthType);
 
-        if (engine.getSequencer().openMidiInputDevice (name))
-            return fmt::format ("Successfully opened midi input device '{}'", name);
+        auto type = juce::VariantConverter<SynthType>::fromVar (typeProperty);
 
-        return fmt::format ("Failed to open '{}'", name);
+        auto synth = getSelectedTrack (engine)
+                         .getChildWithName (IDs::synth);
+
+        if (auto match = ctre::match<fmPattern> (command))
+        {
+            if (type != SynthType::fm)
+                return "didn't give enough arguments for fm synth";
+
+            auto first = std::stod (match.get<1>().to_string());
+            auto second = std::stod (match.get<2>().to_string());
+            auto third = std::stod (match.get<3>().to_string());
+
+            auto newRatios = juce::Array<juce::var> { first, second, third };
+            synth.setProperty (IDs::ratios, newRatios, engine.getUndoManager());
+        }
+
+        if (auto match = ctre::match<rmPattern> (command))
+        {
+            if (type != SynthType::rm)
+                return "gave too many arguments for rm synth";
+
+            auto first = std::stod (match.get<1>().to_string());
+            auto second = std::stod (match.get<2>().to_string());
+
+            auto newRatios = juce::Array<juce::var> { first, second };
+            synth.setProperty (IDs::ratios, newRatios, engine.getUndoManager());
+        }
+
+        return "set ratios";
     }
 
+
     [[nodiscard]] std::string_view getHelpString() const noexcept override
     {
-        return "open midi <midi_input_name> (attemts to open midi input device)";
+        return "ratios <ratios>";
     }
 
 private:
-    static constexpr auto pattern = ctll::fixed_string { R"(^open\smidi\s([a-zA-Z0-9\s]+)$)" };
+    static constexpr auto fmPattern = ctll::fixed_string { R"(^ratios\s(\d+\.\d+)\s(\d+\.\d+)\s(\d+\.\d+)$)" };
+    static constexpr auto rmPattern = ctll::fixed_string { R"(^ratios\s(\d+\.\d+)\s(\d+\.\d+)$)" };
 };
 
-
 // =================================================================================================
 
-struct StopPlayback_CommandHandler : public CommandHandler
+struct ChangeSendLevel_CommandHandler : public CommandHandler
 {
     bool canHandleCommand (std::string_view command) noexcept override
     {
@@ -142,22 +1459,54 @@ struct StopPlayback_CommandHandler : public CommandHandler
 
     std::string handleCommand (Engine& engine, std::string_view command) override
     {
-        engine.getSequencer().stopPlayback();
-        return "stopped playback";
+        auto match = ctre::match<pattern> (command);
+        auto busName = match.get<1>().to_string();
+        auto level = std::stod (match.get<2>().to_string());
+
+        auto sequencer = engine.getValueTreeState().getChildWithName (IDs::sequencer);
+        auto track = getSelectedTrack (engine);
+
+        // the send levels are stored per bus, in the order the busses appear in the sequencer
+        auto busIndex = 0;
+
+        for (auto&& child : sequencer)
+        {
+            if (! child.hasType (IDs::bus))
+                continue;
+
+            if (child.getProperty (IDs::name).toString() == juce::String { busName })
+            {
+                auto levels = juce::Array<juce::var> {};
+
+                if (auto* currentLevels = track.getProperty (IDs::sends).getArray())
+                    levels = *currentLevels;
+
+                while (levels.size() <= busIndex)
+                    levels.add (0.0);
+
+                levels.set (busIndex, level);
+                track.setProperty (IDs::sends, levels, engine.getUndoManager());
+
+                return fmt::format ("set send level to bus '{}' to {}", busName, level);
+            }
+
+            ++busIndex;
+        }
+
+        return fmt::format ("there is no bus with the name '{}'", busName);
     }
 
     [[nodiscard]] std::string_view getHelpString() const noexcept override
     {
-        return "stop (stops playback)";
+        return "send <bus_name> <level> (sets the send level of the track to the reverb, delay, chorus or flanger bus, e.g. 'send reverb 0.3')";
     }
 
 private:
-    static constexpr auto pattern = ctll::fixed_string { "^stop$" };
+    static constexpr auto pattern = ctll::fixed_string { R"(^send\s([a-z]+)\s(\d+\.\d+)$)" };
 };
-
 // =================================================================================================
 
-struct StartPlayback_CommandHandler : public CommandHandler
+struct ChangeMasterDrive_CommandHandler : public CommandHandler
 {
     bool canHandleCommand (std::string_view command) noexcept override
     {
@@ -166,22 +1515,28 @@ struct StartPlayback_CommandHandler : public CommandHandler
 
     std::string handleCommand (Engine& engine, std::string_view command) override
     {
-        engine.getSequencer().startPlayback();
-        return "started playback";
+        auto decibels = std::min (std::stod (ctre::match<pattern> (command).get<1>().to_string()), maxDriveDecibels);
+        engine.getValueTreeState().getChildWithName (IDs::sequencer).setProperty (IDs::masterDrive, decibels, engine.getUndoManager());
+
+        if (decibels <= 0.0)
+            return "turned the saturation on the master bus off";
+
+        return fmt::format ("set the drive of the saturation on the master bus to {} dB", decibels);
     }
 
     [[nodiscard]] std::string_view getHelpString() const noexcept override
     {
-        return "start (start playback)";
+        return "drive <decibels> (saturates the master bus, 0 turns it off)";
     }
 
 private:
-    static constexpr auto pattern = ctll::fixed_string { "^start$" };
+    static constexpr auto maxDriveDecibels = 36.0;
+    static constexpr auto pattern = ctll::fixed_string { R"(^drive\s([0-9]+(?:\.[0-9]+)?)$)" };
 };
 
 // =================================================================================================
 
-struct AddNote_CommandHandler : public CommandHandler
+struct AddTrack_CommandHandler : public CommandHandler
 {
     bool canHandleCommand (std::string_view command) noexcept override
     {
@@ -190,45 +1545,26 @@ struct AddNote_CommandHandler : public CommandHandler
 
     std::string handleCommand (Engine& engine, std::string_view command) override
     {
-        auto note = juce::ValueTree { IDs::note };
-
-        if (auto m = ctre::match<pattern> (command))
-        {
-            auto noteNumber = std::stoi (m.get<1>().to_string());
-            auto start = std::stoi (m.get<2>().to_string());
-
-            auto length = 48;
-            auto velocity = 127;
-
-            note.setProperty (IDs::midiNoteNumber, noteNumber, nullptr);
-            note.setProperty (IDs::startTimeTicks, start, nullptr);
-            note.setProperty (IDs::lengthTicks, length, nullptr);
-            note.setProperty (IDs::velocity, velocity, nullptr);
-
-            engine.getValueTreeState()
-                .getChildWithName (IDs::sequencer)
-                .getChildWithName (IDs::track)
-                .getChildWithName (IDs::melody)
-                .appendChild (note, engine.getUndoManager());
+        engine.getSequencer().addTrack();
 
-            return fmt::format ("added note {} at tick {}", noteNumber, start);
-        }
+        auto newIndex = getNumTracks (engine) - 1;
+        engine.getValueTreeState().getChildWithName (IDs::sequencer).setProperty (IDs::selectedTrack, newIndex, nullptr);
 
-        return "failed to add note";
+        return fmt::format ("added track {} (and selected it)", newIndex);
     }
 
     [[nodiscard]] std::string_view getHelpString() const noexcept override
     {
-        return "add note <number> <position_ticks>";
+        return "add track (adds a new track and selects it)";
     }
 
 private:
-    static constexpr auto pattern = ctll::fixed_string { R"(^add\snote\s([0-9]+)\s([0-9]+)$)" };
+    static constexpr auto pattern = ctll::fixed_string { "^add\\strack$" };
 };
 
 // =================================================================================================
 
-struct ListNotes_CommandHandler : public CommandHandler
+struct RemoveTrack_CommandHandler : public CommandHandler
 {
     bool canHandleCommand (std::string_view command) noexcept override
     {
@@ -237,43 +1573,33 @@ struct ListNotes_CommandHandler : public CommandHandler
 
     std::string handleCommand (Engine& engine, std::string_view command) override
     {
-        auto melody = engine.getValueTreeState()
-                          .getChildWithName (IDs::sequencer)
-                          .getChildWithName (IDs::track)
-                          .getChildWithName (IDs::melody);
+        auto numTracks = getNumTracks (engine);
 
-        auto answer = std::string {};
-
-        auto ticksPerQuarterNote = (double) engine.getSequencer().getTimeSignature().getTicksPerQuarterNote();
-
-        for (auto&& note : melody)
-        {
-            auto midiNum = (int) note.getProperty (IDs::midiNoteNumber);
-            auto start = (double) ((int) note.getProperty (IDs::startTimeTicks)) / ticksPerQuarterNote;
-            auto length = (double) ((int) note.getProperty (IDs::lengthTicks)) / ticksPerQuarterNote;
-            auto velocity = (int) note.getProperty (IDs::velocity);
+        if (numTracks <= 1)
+            return "can't remove the last track";
 
-            answer += fmt::format ("\n - number: {},\tstart (beats): {},\tlength (beats): {},\tvelocity: {}", midiNum, start, length, velocity);
-        }
+        auto index = getSelectedTrackIndex (engine);
+        auto sequencer = engine.getValueTreeState().getChildWithName (IDs::sequencer);
+        sequencer.removeChild (getTrack (engine, index), engine.getUndoManager());
 
-        if (answer.empty())
-            return "No notes in the melody currently";
+        if (index >= numTracks - 1)
+            sequencer.setProperty (IDs::selectedTrack, numTracks - 2, nullptr);
 
-        return answer;
+        return fmt::format ("removed track {}", index);
     }
 
     [[nodiscard]] std::string_view getHelpString() const noexcept override
     {
-        return "ls notes (gives a formatted list of all notes in the melody)";
+        return "remove track (removes the selected track)";
     }
 
 private:
-    static constexpr auto pattern = ctll::fixed_string { "^ls\\snotes$" };
+    static constexpr auto pattern = ctll::fixed_string { "^remove\\strack$" };
 };
 
 // =================================================================================================
 
-struct GenerateMelody_CommandHandler : public CommandHandler
+struct SelectTrack_CommandHandler : public CommandHandler
 {
     bool canHandleCommand (std::string_view command) noexcept override
     {
@@ -282,43 +1608,27 @@ struct GenerateMelody_CommandHandler : public CommandHandler
 
     std::string handleCommand (Engine& engine, std::string_view command) override
     {
-        auto generator = MelodyGenerator {};
-        auto melody = generator.generateMelody (engine.getSequencer().getTimeSignature());
-
-        auto m = engine.getValueTreeState()
-                     .getChildWithName (IDs::sequencer)
-                     .getChildWithName (IDs::track)
-                     .getChildWithName (IDs::melody);
-
-        auto shouldPausePlayback = engine.getSequencer().isPlaying();
-
-        if (shouldPausePlayback)
-            engine.getSequencer().stopPlayback();
-
-        // kind of a hack to make all notes currently playing stop... (wait for more than 1 buffer length)
-        std::this_thread::sleep_for (std::chrono::milliseconds { 50 });
+        auto index = std::stoi (ctre::match<pattern> (command).get<1>().to_string());
 
-        m.removeAllChildren (nullptr);
-        m.copyPropertiesAndChildrenFrom (melody, nullptr);
-
-        if (shouldPausePlayback)
-            engine.getSequencer().startPlayback();
+        if (index >= getNumTracks (engine))
+            return fmt::format ("there is no track {}", index);
 
-        return "generated melody";
+        engine.getValueTreeState().getChildWithName (IDs::sequencer).setProperty (IDs::selectedTrack, index, nullptr);
+        return fmt::format ("selected track {}", index);
     }
 
     [[nodiscard]] std::string_view getHelpString() const noexcept override
     {
-        return "g (generates melody)";
+        return "select track <index> (the track that the other commands change)";
     }
 
 private:
-    static constexpr auto pattern = ctll::fixed_string { "^g$" };
+    static constexpr auto pattern = ctll::fixed_string { R"(^select\strack\s([0-9]+)$)" };
 };
 
 // =================================================================================================
 
-struct Undo_CommandHandler : public CommandHandler
+struct ListTracks_CommandHandler : public CommandHandler
 {
     bool canHandleCommand (std::string_view command) noexcept override
     {
@@ -327,24 +1637,38 @@ struct Undo_CommandHandler : public CommandHandler
 
     std::string handleCommand (Engine& engine, std::string_view command) override
     {
-        if (engine.getUndoManager()->undo())
-            return "undo successful";
+        auto answer = std::string {};
+        auto selectedIndex = getSelectedTrackIndex (engine);
 
-        return "undo failed";
+        for (auto i = 0; i < getNumTracks (engine); ++i)
+        {
+            auto track = getTrack (engine, i);
+            auto type = juce::VariantConverter<SynthType>::fromVar (track.getProperty (IDs::synthType));
+            auto numNotes = track.getChildWithName (IDs::melody).getNumChildren();
+
+            answer += fmt::format ("\n {} {}: synth: {},\tnotes: {}",
+                                   i == selectedIndex ? "*" : "-",
+                                   i,
+                                   type == SynthType::rm ? "rm" : "fm",
+                                   numNotes);
+        }
+
+        return answer;
     }
 
     [[nodiscard]] std::string_view getHelpString() const noexcept override
     {
-        return "undo (undoes effect of last command)";
+        return "ls tracks (gives a list of all tracks, the selected one is marked with *)";
     }
 
 private:
-    static constexpr auto pattern = ctll::fixed_string { "^undo$" };
+    static constexpr auto pattern = ctll::fixed_string { "^ls\\stracks$" };
 };
 
 // =================================================================================================
 
-struct Redo_CommandHandler : public CommandHandler
+// copies the melody of the selected track into a new pattern, which clips on any track can then play
+struct AddPattern_CommandHandler : public CommandHandler
 {
     bool canHandleCommand (std::string_view command) noexcept override
     {
@@ -353,24 +1677,32 @@ struct Redo_CommandHandler : public CommandHandler
 
     std::string handleCommand (Engine& engine, std::string_view command) override
     {
-        if (engine.getUndoManager()->redo())
-            return "redo successful";
+        auto patternsState = engine.getValueTreeState().getChildWithName (IDs::sequencer).getChildWithName (IDs::patterns);
+        auto id = 0;
 
-        return "redo failed";
+        for (auto&& child : patternsState)
+            id = std::max (id, (int) child.getProperty (IDs::id) + 1);
+
+        auto newPattern = juce::ValueTree { IDs::pattern };
+        newPattern.setProperty (IDs::id, id, nullptr);
+        newPattern.appendChild (getSelectedTrack (engine).getChildWithName (IDs::melody).createCopy(), nullptr);
+        patternsState.appendChild (newPattern, engine.getUndoManager());
+
+        return fmt::format ("added pattern {} with the melody of track {}", id, getSelectedTrackIndex (engine));
     }
 
     [[nodiscard]] std::string_view getHelpString() const noexcept override
     {
-        return "redo (redoes effect of last undone command)";
+        return "add pattern (adds a pattern with the melody of the selected track)";
     }
 
 private:
-    static constexpr auto pattern = ctll::fixed_string { "^redo$" };
+    static constexpr auto pattern = ctll::fixed_string { "^add\\spattern$" };
 };
 
 // =================================================================================================
 
-struct ChangeEnvelope_CommandHandler : public CommandHandler
+struct AddClip_CommandHandler : public CommandHandler
 {
     bool canHandleCommand (std::string_view command) noexcept override
     {
@@ -379,46 +1711,45 @@ struct ChangeEnvelope_CommandHandler : public CommandHandler
 
     std::string handleCommand (Engine& engine, std::string_view command) override
     {
-        auto synth = engine.getValueTreeState()
-                         .getChildWithName (IDs::sequencer)
-                         .getChildWithName (IDs::track)
-                         .getChildWithName (IDs::synth);
-
         auto match = ctre::match<pattern> (command);
+        auto patternId = std::stoi (match.get<1>().to_string());
+        auto bar = std::stoi (match.get<2>().to_string());
+        auto numBars = std::stoi (match.get<3>().to_string());
+        auto loopBars = match.get<4>().to_view().empty() ? 0 : std::stoi (match.get<4>().to_string());
+        auto transpose = match.get<5>().to_view().empty() ? 0 : std::stoi (match.get<5>().to_string());
 
-        try
-        {
-            auto a = std::stod (match.get<1>().to_string());
-            auto d = std::stod (match.get<2>().to_string());
-            auto s = std::stod (match.get<3>().to_string());
-            auto r = std::stod (match.get<4>().to_string());
+        if (bar == 0 || numBars == 0)
+            return "bars start counting at 1 and a clip should be at least one bar long";
 
-            synth.setProperty (IDs::attack, a, nullptr);
-            synth.setProperty (IDs::decay, d, nullptr);
-            synth.setProperty (IDs::sustain, s, nullptr);
-            synth.setProperty (IDs::release, r, nullptr);
-        }
-        catch (std::exception& e)
-        {
-            return fmt::format ("error in parsing envelope command: {}", e.what());
-        }
+        const auto& meterMap = engine.getSequencer().getMeterMap();
+        auto startTick = meterMap.getTickOfBar ((uint32_t) bar - 1);
 
-        return "adsr set successfully";
+        auto clip = juce::ValueTree { IDs::clip };
+        clip.setProperty (IDs::pattern, patternId, nullptr);
+        clip.setProperty (IDs::startTimeTicks, (juce::int64) startTick, nullptr);
+        clip.setProperty (IDs::lengthTicks, (juce::int64) (meterMap.getTickOfBar ((uint32_t) (bar - 1 + numBars)) - startTick), nullptr);
+        clip.setProperty (IDs::loopLengthTicks, (juce::int64) (meterMap.getTickOfBar ((uint32_t) (bar - 1 + loopBars)) - startTick), nullptr);
+        clip.setProperty (IDs::transpose, transpose, nullptr);
+
+        getSelectedTrack (engine).getChildWithName (IDs::arrangement).appendChild (clip, engine.getUndoManager());
+
+        return fmt::format ("added clip of pattern {} at bar {} for {} bars", patternId, bar, numBars);
     }
 
     [[nodiscard]] std::string_view getHelpString() const noexcept override
     {
-        return "adsr <a> <d> <s> <r> (sets the envelope)";
+        return "clip <pattern> at <bar> for <num_bars> [loop <num_bars>] [transpose <semitones>] (adds a clip to the selected track)";
     }
 
 private:
-    // regex for: "adsr <float> <float> <float> <float>"
-    static constexpr auto pattern = ctll::fixed_string { R"(^adsr\s(\d+\.\d+)\s(\d+\.\d+)\s(\d+\.\d+)\s(\d+\.\d+)$)" };
+    static constexpr auto pattern = ctll::fixed_string {
+        R"(^clip\s([0-9]+)\sat\s([0-9]+)\sfor\s([0-9]+)(?:\sloop\s([0-9]+))?(?:\stranspose\s(-?[0-9]+))?$)"
+    };
 };
 
 // =================================================================================================
 
-struct ChangeSynth_CommandHandler : public CommandHandler
+struct ListClips_CommandHandler : public CommandHandler
 {
     bool canHandleCommand (std::string_view command) noexcept override
     {
@@ -427,92 +1758,63 @@ struct ChangeSynth_CommandHandler : public CommandHandler
 
     std::string handleCommand (Engine& engine, std::string_view command) override
     {
-        auto type = ctre::match<pattern> (command).get<1>().to_view();
-        auto track = engine.getValueTreeState().getChildWithName (IDs::sequencer).getChildWithName (IDs::track);
-
-        auto newType = SynthType::fm;
-
-        if (type == "rm")
-            newType = SynthType::rm;
+        auto answer = std::string {};
+        const auto& meterMap = engine.getSequencer().getMeterMap();
 
-        track.setProperty (IDs::synthType, juce::VariantConverter<SynthType>::toVar (newType), engine.getUndoManager());
+        for (auto&& clipState : getSelectedTrack (engine).getChildWithName (IDs::arrangement))
+        {
+            auto clip = Clip::fromState (clipState);
+            auto start = meterMap.toMusicalTime (clip.startTick);
+            auto end = meterMap.toMusicalTime (clip.getEndTick());
+
+            answer += fmt::format ("\n - pattern: {},\tfrom: {}.{}.{},\tto: {}.{}.{},\tloop (ticks): {},\ttranspose: {}",
+                                   clip.patternId,
+                                   start.bar + 1,
+                                   start.beat + 1,
+                                   start.tick,
+                                   end.bar + 1,
+                                   end.beat + 1,
+                                   end.tick,
+                                   clip.loopLengthTicks,
+                                   clip.transpose);
+        }
 
-        return fmt::format ("changed synth type to {}", type);
+        return answer;
     }
 
     [[nodiscard]] std::string_view getHelpString() const noexcept override
     {
-        return "switch synth <rm|fm> (switches the synth to the given type)";
+        return "ls clips (gives a list of the clips on the selected track)";
     }
 
 private:
-    static constexpr auto pattern = ctll::fixed_string { R"(^switch\ssynth\s(rm|fm)$)" };
+    static constexpr auto pattern = ctll::fixed_string { "^ls\\sclips$" };
 };
 
 // =================================================================================================
 
-struct ChangeRatios_CommandHandler : public CommandHandler
+struct ClearClips_CommandHandler : public CommandHandler
 {
     bool canHandleCommand (std::string_view command) noexcept override
     {
-        if (ctre::match<fmPattern> (command) || ctre::match<rmPattern> (command))
-            return true;
-
-        return false;
+        return ctre::match<pattern> (command);
     }
 
     std::string handleCommand (Engine& engine, std::string_view command) override
     {
-        auto typeProperty = engine.getValueTreeState()
-                                .getChildWithName (IDs::sequencer)
-                                .getChildWithName (IDs::track)
-                                .getProperty (IDs::synthType);
-
-        auto type = juce::VariantConverter<SynthType>::fromVar (typeProperty);
-
-        auto synth = engine.getValueTreeState()
-                         .getChildWithName (IDs::sequencer)
-                         .getChildWithName (IDs::track)
-                         .getChildWithName (IDs::synth);
-
-        if (auto match = ctre::match<fmPattern> (command))
-        {
-            if (type != SynthType::fm)
-                return "didn't give enough arguments for fm synth";
-
-            auto first = std::stod (match.get<1>().to_string());
-            auto second = std::stod (match.get<2>().to_string());
-            auto third = std::stod (match.get<3>().to_string());
-
-            auto newRatios = juce::Array<juce::var> { first, second, third };
-            synth.setProperty (IDs::ratios, newRatios, engine.getUndoManager());
-        }
-
-        if (auto match = ctre::match<rmPattern> (command))
-        {
-            if (type != SynthType::rm)
-                return "gave too many arguments for rm synth";
-
-            auto first = std::stod (match.get<1>().to_string());
-            auto second = std::stod (match.get<2>().to_string());
-
-            auto newRatios = juce::Array<juce::var> { first, second };
-            synth.setProperty (IDs::ratios, newRatios, engine.getUndoManager());
-        }
-
-        return "set ratios";
+        getSelectedTrack (engine).getChildWithName (IDs::arrangement).removeAllChildren (engine.getUndoManager());
+        return "removed all clips from the selected track";
     }
 
-
     [[nodiscard]] std::string_view getHelpString() const noexcept override
     {
-        return "ratios <ratios>";
+        return "clear clips (removes all clips from the selected track)";
     }
 
 private:
-    static constexpr auto fmPattern = ctll::fixed_string { R"(^ratios\s(\d+\.\d+)\s(\d+\.\d+)\s(\d+\.\d+)$)" };
-    static constexpr auto rmPattern = ctll::fixed_string { R"(^ratios\s(\d+\.\d+)\s(\d+\.\d+)$)" };
+    static constexpr auto pattern = ctll::fixed_string { "^clear\\sclips$" };
 };
+
 // =================================================================================================
 
 
@@ -520,18 +1822,52 @@ ConsoleInterface::ConsoleInterface (Engine& engineToControl) : engine { engineTo
 {
     addCommandHandler (std::make_unique<StartPlayback_CommandHandler>());
     addCommandHandler (std::make_unique<StopPlayback_CommandHandler>());
+    addCommandHandler (std::make_unique<StartRecording_CommandHandler>());
     addCommandHandler (std::make_unique<ChangeTempo_CommandHandler>());
+    addCommandHandler (std::make_unique<AddTempoChange_CommandHandler>());
+    addCommandHandler (std::make_unique<ClearTempoChanges_CommandHandler>());
+    addCommandHandler (std::make_unique<ChangeMeter_CommandHandler>());
+    addCommandHandler (std::make_unique<ChangeLoopLength_CommandHandler>());
+    addCommandHandler (std::make_unique<ChangeLookahead_CommandHandler>());
+    addCommandHandler (std::make_unique<ChangeMidiLatency_CommandHandler>());
     addCommandHandler (std::make_unique<ListAudioDevices_CommandHandler>());
     addCommandHandler (std::make_unique<ListMidiDevices_CommandHandler>());
     addCommandHandler (std::make_unique<OpenMidiInputDevice_CommandHandler>());
+    addCommandHandler (std::make_unique<CloseMidiInputDevice_CommandHandler>());
+    addCommandHandler (std::make_unique<RouteMidiInput_CommandHandler>());
+    addCommandHandler (std::make_unique<ListMidiInputs_CommandHandler>());
     addCommandHandler (std::make_unique<AddNote_CommandHandler>());
     addCommandHandler (std::make_unique<ListNotes_CommandHandler>());
     addCommandHandler (std::make_unique<GenerateMelody_CommandHandler>());
+    addCommandHandler (std::make_unique<ImportMidiFile_CommandHandler>());
+    addCommandHandler (std::make_unique<ExportMidiFile_CommandHandler>());
+    addCommandHandler (std::make_unique<RenderAudioFile_CommandHandler>());
+    addCommandHandler (std::make_unique<LoadMidiFile_CommandHandler>());
+    addCommandHandler (std::make_unique<UnloadMidiFile_CommandHandler>());
+    addCommandHandler (std::make_unique<ChangeStepSequence_CommandHandler>());
+    addCommandHandler (std::make_unique<ChangeStepValues_CommandHandler>());
+    addCommandHandler (std::make_unique<ChangeSwing_CommandHandler>());
+    addCommandHandler (std::make_unique<ChangeGrooveTemplate_CommandHandler>());
+    addCommandHandler (std::make_unique<ChangeHumanize_CommandHandler>());
+    addCommandHandler (std::make_unique<ChangeTranspose_CommandHandler>());
+    addCommandHandler (std::make_unique<ChangeArpeggiator_CommandHandler>());
+    addCommandHandler (std::make_unique<ChangeChord_CommandHandler>());
+    addCommandHandler (std::make_unique<ChangeNoteRepeat_CommandHandler>());
     addCommandHandler (std::make_unique<Undo_CommandHandler>());
     addCommandHandler (std::make_unique<Redo_CommandHandler>());
     addCommandHandler (std::make_unique<ChangeEnvelope_CommandHandler>());
     addCommandHandler (std::make_unique<ChangeSynth_CommandHandler>());
     addCommandHandler (std::make_unique<ChangeRatios_CommandHandler>());
+    addCommandHandler (std::make_unique<ChangeSendLevel_CommandHandler>());
+    addCommandHandler (std::make_unique<ChangeMasterDrive_CommandHandler>());
+    addCommandHandler (std::make_unique<AddTrack_CommandHandler>());
+    addCommandHandler (std::make_unique<RemoveTrack_CommandHandler>());
+    addCommandHandler (std::make_unique<SelectTrack_CommandHandler>());
+    addCommandHandler (std::make_unique<ListTracks_CommandHandler>());
+    addCommandHandler (std::make_unique<AddPattern_CommandHandler>());
+    addCommandHandler (std::make_unique<AddClip_CommandHandler>());
+    addCommandHandler (std::make_unique<ListClips_CommandHandler>());
+    addCommandHandler (std::make_unique<ClearClips_CommandHandler>());
 }
 
 void ConsoleInterface::handleCommand (std::string_view command)
@@ -540,7 +1876,16 @@ void ConsoleInterface::handleCommand (std::string_view command)
     {
         if (handler->canHandleCommand (command))
         {
+            // the console runs on a thread of its own, the lock keeps the timers of the message thread out meanwhile
+            const juce::MessageManagerLock lock;
             feedback = handler->handleCommand (engine, command);
+
+            // what was recorded since the last command (most of it is already in the melodies, see Engine)
+            if (auto numNotes = engine.takeNumRecordedNotes(); numNotes > 0)
+                feedback += fmt::format ("\nrecorded {} notes", numNotes);
+
+            // a command might have removed a track, which can only be deleted once the audio thread is done with it
+            engine.getSequencer().collectGarbage();
             return;
         }
     }
@@ -580,7 +1925,11 @@ void ConsoleInterface::run()
 {
     while (keepRunning)
     {
-        printHeader();
+        {
+            const juce::MessageManagerLock lock;
+            printHeader();
+        }
+
         auto command = fetchUserInput (" --> ");
 
         handleCommand (command);
@@ -596,13 +1945,14 @@ void ConsoleInterface::printHeader()
     fmt::print ("{}\n\n", header);
 
     auto& sequencer = engine.getSequencer();
-    fmt::print ("play state: {}\n", sequencer.isPlaying() ? "playing" : "stopped");
+    fmt::print ("play state: {}\n", sequencer.isRecording() ? "recording" : (sequencer.isPlaying() ? "playing" : "stopped"));
 
     auto tempo = (double) engine.getValueTreeState()
                      .getChildWithName (IDs::sequencer)
                      .getProperty (IDs::tempo);
 
-    fmt::print ("tempo: {} bpm\n\n", tempo);
+    fmt::print ("tempo: {} bpm\n", tempo);
+    fmt::print ("selected track: {}\n\n", getSelectedTrackIndex (engine));
     fmt::print ("feedback: {}\n\n", feedback);
 }
 
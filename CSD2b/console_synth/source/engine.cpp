@@ -2,6 +2,7 @@
 // Written by Wouter Ensink
 
 #include <console_synth/engine.h>
+#include <utility>
 
 
 Engine::Engine()
@@ -10,11 +11,14 @@ Engine::Engine()
     auto numOutputChannels = 2;
     deviceManager.initialiseWithDefaultDevices (numInputChannels, numOutputChannels);
     deviceManager.addAudioCallback (&audioCallback);
+
+    startTimer (recordedNotesIntervalMs);
 }
 
 
 Engine::~Engine()
 {
+    stopTimer();
     deviceManager.closeAudioDevice();
 }
 
@@ -37,6 +41,36 @@ void Engine::releaseResources()
     sequencer.releaseResources();
 }
 
+OfflineRenderer::Result Engine::renderBars (const juce::File& file, uint32_t numBars, const OfflineRenderSettings& settings)
+{
+    return renderWithoutDevice ([&] { return offlineRenderer.renderBars (file, numBars, settings); });
+}
+
+
+OfflineRenderer::Result Engine::renderLoops (const juce::File& file, uint32_t numLoops, const OfflineRenderSettings& settings)
+{
+    return renderWithoutDevice ([&] { return offlineRenderer.renderLoops (file, numLoops, settings); });
+}
+
+
+template <typename RenderFunction>
+OfflineRenderer::Result Engine::renderWithoutDevice (RenderFunction&& render)
+{
+    deviceManager.removeAudioCallback (&audioCallback);
+
+    try
+    {
+        auto result = render();
+        deviceManager.addAudioCallback (&audioCallback);
+        return result;
+    }
+    catch (...)
+    {
+        deviceManager.addAudioCallback (&audioCallback);
+        throw;
+    }
+}
+
 Sequencer& Engine::getSequencer() { return sequencer; }
 
 juce::StringArray Engine::getAvailableAudioDevices() const
@@ -62,4 +96,17 @@ juce::ValueTree Engine::getValueTreeState() const
     return engineState;
 }
 
-juce::UndoManager* Engine::getUndoManager() { return &undoManager; }
\ No newline at end of file
+juce::UndoManager* Engine::getUndoManager() { return &undoManager; }
+
+int Engine::takeNumRecordedNotes()
+{
+    // also the notes that were recorded after the last timer callback (or ended when the recording stopped)
+    numRecordedNotes += sequencer.commitRecordedNotes (&undoManager);
+    return std::exchange (numRecordedNotes, 0);
+}
+
+void Engine::timerCallback()
+{
+    if (sequencer.isRecording())
+        numRecordedNotes += sequencer.commitRecordedNotes (&undoManager);
+}
\ No newline at end of file
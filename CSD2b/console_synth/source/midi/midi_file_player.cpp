@@ -0,0 +1,363 @@
+// Written by Wouter Ensink
+
+#include <console_synth/midi/midi_file_player.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+
+static uint64_t createFileId() noexcept
+{
+    static auto lastId = std::atomic<uint64_t> { 0 };
+    return ++lastId;
+}
+
+
+static uint32_t readBigEndian (const uint8_t* bytes, int numBytes) noexcept
+{
+    auto value = uint32_t { 0 };
+
+    for (auto i = 0; i < numBytes; ++i)
+        value = (value << 8) | bytes[i];
+
+    return value;
+}
+
+
+MappedMidiFile::MappedMidiFile (const juce::File& file, uint32_t sequencerTicksPerQuarterNote)
+    : mappedFile { std::make_unique<juce::MemoryMappedFile> (file, juce::MemoryMappedFile::readOnly) },
+      ticksPerQuarterNote { sequencerTicksPerQuarterNote }
+{
+    if (mappedFile->getData() == nullptr)
+        throw LoadError { "couldn't open " + file.getFullPathName().toStdString() };
+
+    data = static_cast<const uint8_t*> (mappedFile->getData());
+    size = mappedFile->getSize();
+    readChunks();
+}
+
+
+MappedMidiFile::MappedMidiFile (const void* fileData, size_t numBytes, uint32_t sequencerTicksPerQuarterNote)
+    : data { static_cast<const uint8_t*> (fileData) }, size { numBytes }, ticksPerQuarterNote { sequencerTicksPerQuarterNote }
+{
+    readChunks();
+}
+
+
+int MappedMidiFile::getNumTracks() const noexcept
+{
+    return (int) tracks.size();
+}
+
+
+uint64_t MappedMidiFile::getId() const noexcept
+{
+    return id;
+}
+
+
+size_t MappedMidiFile::getIndexSize (int track) const noexcept
+{
+    return tracks[(size_t) track].index.size();
+}
+
+
+MappedMidiFile::Cursor MappedMidiFile::seek (int trackIndex, uint64_t tick) const noexcept
+{
+    const auto& track = tracks[(size_t) trackIndex];
+
+    // every event before the last entry with an earlier tick is before the tick, so decoding can start there
+    auto entry = std::lower_bound (track.index.begin(), track.index.end(), tick, [] (const IndexEntry& e, uint64_t t) {
+        return e.tickBefore < t;
+    });
+
+    if (entry != track.index.begin())
+        --entry;
+
+    auto cursor = Cursor {};
+    cursor.event.tick = entry->tickBefore;
+    cursor.nextOffset = entry->offset;
+    cursor.runningStatus = entry->runningStatus;
+    cursor.isAtEnd = false;
+
+    do
+        advance (trackIndex, cursor);
+    while (! cursor.isAtEnd && cursor.event.tick < tick);
+
+    return cursor;
+}
+
+
+void MappedMidiFile::advance (int track, Cursor& cursor) const noexcept
+{
+    if (! cursor.isAtEnd && ! decodeNextEvent (tracks[(size_t) track], cursor))
+        cursor.isAtEnd = true;
+}
+
+
+// the first tick of the file that rounds to the tick of the sequencer (or a later one)
+uint64_t MappedMidiFile::toFileTick (uint64_t sequencerTick) const noexcept
+{
+    const auto halfTick = fileTicksPerQuarterNote / 2;
+    const auto position = sequencerTick * fileTicksPerQuarterNote;
+
+    if (position <= halfTick)
+        return 0;
+
+    return (position - halfTick + ticksPerQuarterNote - 1) / ticksPerQuarterNote;
+}
+
+
+// rounded to the nearest tick, like an imported file
+uint64_t MappedMidiFile::toSequencerTick (uint64_t fileTick) const noexcept
+{
+    return (fileTick * ticksPerQuarterNote + fileTicksPerQuarterNote / 2) / fileTicksPerQuarterNote;
+}
+
+
+void MappedMidiFile::readChunks()
+{
+    if (size < 14 || std::memcmp (data, "MThd", 4) != 0)
+        throw LoadError { "not a valid midi file" };
+
+    const auto headerLength = readBigEndian (data + 4, 4);
+    const auto division = readBigEndian (data + 12, 2);
+
+    // with the highest bit set, the time stamps are in frames of a smpte time code, not in beats
+    if ((division & 0x8000) != 0 || division == 0)
+        throw LoadError { "midi files with smpte time stamps are not supported" };
+
+    fileTicksPerQuarterNote = division;
+
+    // the tracks are the MTrk chunks, other chunks are skipped (like the spec says)
+    for (auto offset = size_t { 8 } + headerLength; offset + 8 <= size;)
+    {
+        const auto chunkLength = (size_t) readBigEndian (data + offset + 4, 4);
+        const auto start = offset + 8;
+
+        if (std::memcmp (data + offset, "MTrk", 4) == 0)
+            tracks.push_back ({ start, std::min (start + chunkLength, size), {} });
+
+        offset = start + chunkLength;
+    }
+
+    if (tracks.empty())
+        throw LoadError { "the midi file has no tracks" };
+
+    if (tracks.size() > (size_t) maxNumTracks)
+        throw LoadError { "the midi file has more than " + std::to_string (maxNumTracks) + " tracks" };
+
+    for (auto& track : tracks)
+        indexTrack (track);
+
+    id = createFileId();
+}
+
+
+void MappedMidiFile::indexTrack (Track& track) const
+{
+    auto cursor = Cursor {};
+    cursor.nextOffset = track.start;
+    cursor.isAtEnd = false;
+
+    auto stride = size_t { 64 };
+    track.index.reserve (maxIndexSize);
+
+    for (auto eventIndex = size_t { 0 }; ! cursor.isAtEnd; ++eventIndex)
+    {
+        if (eventIndex % stride == 0)
+        {
+            // keeps the entries at the new stride (the even ones), so the index doesn't grow any further
+            if (track.index.size() == maxIndexSize)
+            {
+                for (auto i = size_t { 0 }; i < maxIndexSize / 2; ++i)
+                    track.index[i] = track.index[i * 2];
+
+                track.index.resize (maxIndexSize / 2);
+                stride *= 2;
+            }
+
+            if (eventIndex % stride == 0)
+                track.index.push_back ({ cursor.event.tick, cursor.nextOffset, cursor.runningStatus });
+        }
+
+        cursor.isAtEnd = ! decodeNextEvent (track, cursor);
+    }
+}
+
+
+bool MappedMidiFile::decodeNextEvent (const Track& track, Cursor& cursor) const noexcept
+{
+    auto offset = cursor.nextOffset;
+    auto deltaTime = uint32_t { 0 };
+
+    if (! readVariableLength (track, offset, deltaTime) || offset >= track.end)
+        return false;
+
+    auto& event = cursor.event;
+    event.tick += deltaTime;
+    event.numBytes = 0;
+
+    auto status = data[offset];
+
+    // without a status byte, the status of the previous channel message is used (running status)
+    if ((status & 0x80) != 0)
+        ++offset;
+    else
+        status = cursor.runningStatus;
+
+    if (status == 0xff)
+    {
+        if (offset >= track.end || data[offset] == 0x2f)
+            return false;
+
+        ++offset;
+        auto length = uint32_t { 0 };
+
+        if (! readVariableLength (track, offset, length))
+            return false;
+
+        offset += length;
+    }
+    else if (status == 0xf0 || status == 0xf7)
+    {
+        auto length = uint32_t { 0 };
+
+        if (! readVariableLength (track, offset, length))
+            return false;
+
+        offset += length;
+    }
+    else if (status >= 0x80 && status < 0xf0)
+    {
+        const auto type = status & 0xf0;
+        const auto numDataBytes = (type == 0xc0 || type == 0xd0) ? 1 : 2;
+
+        if (offset + (size_t) numDataBytes > track.end)
+            return false;
+
+        event.data[0] = status;
+        event.data[1] = data[offset];
+        event.data[2] = numDataBytes == 2 ? data[offset + 1] : 0;
+        event.numBytes = 1 + numDataBytes;
+
+        cursor.runningStatus = status;
+        offset += (size_t) numDataBytes;
+    }
+    else
+    {
+        // a data byte without a status before it (or a status that doesn't belong in a file), the track is broken from here on
+        return false;
+    }
+
+    if (offset > track.end)
+        return false;
+
+    cursor.nextOffset = offset;
+    return true;
+}
+
+
+bool MappedMidiFile::readVariableLength (const Track& track, size_t& offset, uint32_t& value) const noexcept
+{
+    value = 0;
+
+    // at most four bytes, seven bits each
+    for (auto i = 0; i < 4 && offset < track.end; ++i)
+    {
+        const auto byte = data[offset++];
+        value = (value << 7) | (byte & 0x7f);
+
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+
+// ===================================================================================================
+
+void MidiFilePlayerMidiSource::setFile (const MappedMidiFile* newFile) noexcept
+{
+    file = newFile;
+}
+
+
+void MidiFilePlayerMidiSource::fillNextMidiBuffer (const PlayHead& playHead, juce::MidiBuffer& buffer, int numSamples)
+{
+    // the notes of a file that was unloaded shouldn't go on forever
+    if (file == nullptr || file->getNumTracks() == 0)
+    {
+        stopSoundingNotes (buffer, 0);
+        cursorFileId = 0;
+        return;
+    }
+
+    forEachTickRange (playHead, [&] (const TickRange& range) {
+        if (cursorFileId != file->getId() || nextTick != range.startTick)
+        {
+            stopSoundingNotes (buffer, range.getSampleOfTick (range.startTick, numSamples));
+            seek (range.startTick);
+        }
+
+        playRange (range, buffer, numSamples);
+        nextTick = range.endTick;
+    });
+}
+
+
+void MidiFilePlayerMidiSource::seek (uint64_t tick) noexcept
+{
+    const auto fileTick = file->toFileTick (tick);
+
+    for (auto track = 0; track < file->getNumTracks(); ++track)
+        cursors[(size_t) track] = file->seek (track, fileTick);
+
+    cursorFileId = file->getId();
+    nextTick = tick;
+}
+
+
+void MidiFilePlayerMidiSource::playRange (const TickRange& range, juce::MidiBuffer& buffer, int numSamples)
+{
+    const auto endFileTick = file->toFileTick (range.endTick);
+
+    for (auto track = 0; track < file->getNumTracks(); ++track)
+    {
+        auto& cursor = cursors[(size_t) track];
+
+        for (; ! cursor.isAtEnd && cursor.event.tick < endFileTick; file->advance (track, cursor))
+        {
+            const auto& event = cursor.event;
+            const auto type = event.data[0] & 0xf0;
+
+            if (event.numBytes != 3 || (type != 0x80 && type != 0x90))
+                continue;
+
+            const auto noteNumber = event.data[1] & 0x7f;
+            const auto velocity = (uint8_t) (event.data[2] & 0x7f);
+            const auto isNoteOn = type == 0x90 && velocity > 0;
+
+            const auto tick = std::clamp (file->toSequencerTick (event.tick), range.startTick, range.endTick - 1);
+            const auto samplePosition = range.getSampleOfTick (tick, numSamples);
+
+            if (isNoteOn)
+                buffer.addEvent (juce::MidiMessage::noteOn (1, noteNumber, velocity), samplePosition);
+            else if (soundingNotes.test ((size_t) noteNumber))
+                buffer.addEvent (juce::MidiMessage::noteOff (1, noteNumber), samplePosition);
+
+            soundingNotes.set ((size_t) noteNumber, isNoteOn);
+        }
+    }
+}
+
+
+void MidiFilePlayerMidiSource::stopSoundingNotes (juce::MidiBuffer& buffer, int samplePosition)
+{
+    for (auto i = 0; i < (int) soundingNotes.size(); ++i)
+        if (soundingNotes.test ((size_t) i))
+            buffer.addEvent (juce::MidiMessage::noteOff (1, i), samplePosition);
+
+    soundingNotes.reset();
+}
@@ -0,0 +1,311 @@
+// Written by Wouter Ensink
+
+#include <console_synth/midi/midi_input_router.h>
+
+
+MidiInputRouter::MidiInputRouter (juce::ValueTree& parent)
+{
+    parent.appendChild (state, nullptr);
+    state.addListener (this);
+
+    pendingEvents.resize (queue.getCapacity());
+    trackBuffers.resize (maxNumTracks);
+    rebuildRoutingTable();
+}
+
+
+MidiInputRouter::~MidiInputRouter()
+{
+    state.removeListener (this);
+
+    for (auto& device : openDevices)
+        device.input->stop();
+}
+
+
+bool MidiInputRouter::openDevice (const juce::String& name)
+{
+    if (findDeviceState (name).isValid())
+        return true;
+
+    auto source = findFreeSource();
+
+    if (source < 0)
+        return false;
+
+    for (auto& info : juce::MidiInput::getAvailableDevices())
+    {
+        if (! info.name.equalsIgnoreCase (name))
+            continue;
+
+        auto callback = std::make_unique<DeviceCallback> (*this, (uint8_t) source);
+
+        if (auto input = juce::MidiInput::openDevice (info.identifier, callback.get()))
+        {
+            auto deviceState = juce::ValueTree { IDs::midiInput };
+            deviceState.setProperty (IDs::name, info.name, nullptr);
+            deviceState.setProperty (IDs::source, source, nullptr);
+            state.appendChild (deviceState, nullptr);
+
+            input->start();
+            openDevices.push_back ({ info.name, (uint8_t) source, std::move (callback), std::move (input) });
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+bool MidiInputRouter::closeDevice (const juce::String& name)
+{
+    auto deviceState = findDeviceState (name);
+
+    if (! deviceState.isValid())
+        return false;
+
+    // the device is stopped before the node is removed, so nothing comes in from it after its routes are gone
+    for (auto it = openDevices.begin(); it != openDevices.end(); ++it)
+    {
+        if (it->name.equalsIgnoreCase (name))
+        {
+            it->input->stop();
+            openDevices.erase (it);
+            break;
+        }
+    }
+
+    state.removeChild (deviceState, nullptr);
+    return true;
+}
+
+
+bool MidiInputRouter::setRoute (const juce::String& name, int channel, int trackIndex)
+{
+    auto deviceState = findDeviceState (name);
+
+    if (! deviceState.isValid() || channel < 0 || channel > 16 || trackIndex < 0 || trackIndex >= maxNumTracks)
+        return false;
+
+    for (auto i = deviceState.getNumChildren(); --i >= 0;)
+        if ((int) deviceState.getChild (i).getProperty (IDs::channel) == channel)
+            deviceState.removeChild (i, nullptr);
+
+    auto route = juce::ValueTree { IDs::midiRoute };
+    route.setProperty (IDs::channel, channel, nullptr);
+    route.setProperty (IDs::track, trackIndex, nullptr);
+    deviceState.appendChild (route, nullptr);
+    return true;
+}
+
+
+void MidiInputRouter::setLatencyBlocks (double numBlocks) noexcept
+{
+    latencyBlocks.store (juce::jlimit (0.0, maxLatencyBlocks, numBlocks), std::memory_order_relaxed);
+}
+
+
+juce::StringArray MidiInputRouter::getOpenDeviceNames() const
+{
+    auto names = juce::StringArray {};
+
+    for (auto& device : openDevices)
+        names.add (device.name);
+
+    return names;
+}
+
+
+bool MidiInputRouter::addMessage (uint8_t source, const juce::MidiMessage& message)
+{
+    auto event = MidiEvent {};
+
+    if (! MidiEvent::fromMessage (message, event, source))
+    {
+        numSysexDropped.fetch_add (1, std::memory_order_relaxed);
+        return false;
+    }
+
+    return queue.push (event);
+}
+
+
+// a block never has more events than fit in the pending events (the size of the queue), but they can all be for the same track
+void MidiInputRouter::prepareToPlay (double newSampleRate, int)
+{
+    sampleRate = newSampleRate;
+    streamClock.reset();
+    numHeldEvents = 0;
+
+    for (auto& buffer : trackBuffers)
+        reserveMidiEvents (buffer, pendingEvents.size());
+}
+
+
+void MidiInputRouter::processNextBlock (int numSamples, double currentTimeSeconds)
+{
+    for (auto& buffer : trackBuffers)
+        buffer.clear();
+
+    streamClock.update (currentTimeSeconds, numSamples, sampleRate);
+    const auto latencySamples = latencyBlocks.load (std::memory_order_relaxed) * numSamples;
+
+    // the new events go after the ones that are still waiting, those are already in order
+    const auto numNewEvents = queue.popBatch (pendingEvents.data() + numHeldEvents, pendingEvents.size() - numHeldEvents);
+    const auto numEvents = numHeldEvents + numNewEvents;
+    sortByTimeStamp (numEvents);
+
+    const auto table = routingTable.read();
+    numHeldEvents = 0;
+
+    for (size_t i = 0; i < numEvents; ++i)
+    {
+        const auto& event = pendingEvents[i];
+        const auto position = std::floor (streamClock.getSamplesSinceBlockStart (event.timeStamp) + latencySamples);
+
+        // due in a later block, it waits (in order) at the front
+        if (position >= numSamples)
+        {
+            pendingEvents[numHeldEvents++] = event;
+            continue;
+        }
+
+        const auto trackIndex = table->getTrackIndex (event.source, getChannel (event));
+
+        if (trackIndex == MidiRoutingTable::noTrack || trackIndex >= (int) trackBuffers.size())
+            continue;
+
+        // an event that is later than the latency (e.g. when the latency is below one block) is played as soon as possible
+        const auto sample = std::max (0, (int) position);
+        trackBuffers[(size_t) trackIndex].addEvent (event.data, (int) event.numBytes, sample);
+    }
+}
+
+
+const juce::MidiBuffer& MidiInputRouter::getMidiForTrack (int trackIndex) const noexcept
+{
+    if (trackIndex < 0 || trackIndex >= (int) trackBuffers.size())
+        return emptyBuffer;
+
+    return trackBuffers[(size_t) trackIndex];
+}
+
+
+uint64_t MidiInputRouter::getNumDropped() const noexcept
+{
+    return queue.getNumDropped() + numSysexDropped.load (std::memory_order_relaxed);
+}
+
+
+void MidiInputRouter::collectGarbage()
+{
+    routingTable.collectGarbage();
+}
+
+
+juce::ValueTree MidiInputRouter::findDeviceState (const juce::String& name) const
+{
+    for (auto&& child : state)
+        if (child.hasType (IDs::midiInput) && child.getProperty (IDs::name).toString().equalsIgnoreCase (name))
+            return child;
+
+    return {};
+}
+
+
+int MidiInputRouter::findFreeSource() const
+{
+    auto isUsed = std::array<bool, maxNumInputs> {};
+
+    for (auto&& child : state)
+        if (auto source = (int) child.getProperty (IDs::source, -1); source >= 0 && source < maxNumInputs)
+            isUsed[(size_t) source] = true;
+
+    for (auto source = 0; source < maxNumInputs; ++source)
+        if (! isUsed[(size_t) source])
+            return source;
+
+    return -1;
+}
+
+
+// the routes for all channels go in first, so the routes for a single channel overwrite them
+void MidiInputRouter::rebuildRoutingTable()
+{
+    auto table = std::make_unique<MidiRoutingTable>();
+
+    for (auto isForAllChannels : { true, false })
+    {
+        for (auto&& device : state)
+        {
+            auto source = (int) device.getProperty (IDs::source, -1);
+
+            if (! device.hasType (IDs::midiInput) || source < 0 || source >= maxNumInputs)
+                continue;
+
+            auto& channels = table->trackIndices[(size_t) source];
+
+            for (auto&& route : device)
+            {
+                auto channel = (int) route.getProperty (IDs::channel, 0);
+                auto trackIndex = (int) route.getProperty (IDs::track, MidiRoutingTable::noTrack);
+
+                if (channel < 0 || channel > 16 || (channel == 0) != isForAllChannels)
+                    continue;
+
+                if (isForAllChannels)
+                    channels.fill (trackIndex);
+                else
+                    channels[(size_t) channel] = trackIndex;
+            }
+        }
+    }
+
+    routingTable.publish (std::move (table));
+}
+
+
+int MidiInputRouter::getChannel (const MidiEvent& event) noexcept
+{
+    const auto status = event.numBytes > 0 ? event.data[0] : 0;
+
+    if (status < 0x80 || status >= 0xf0)
+        return 0;
+
+    return (status & 0x0f) + 1;
+}
+
+
+// Every device pushes its messages in order, so the events are a few sorted runs mixed together.
+// An insertion sort merges those in close to linear time, it's stable and (unlike std::stable_sort) never allocates
+void MidiInputRouter::sortByTimeStamp (size_t numEvents) noexcept
+{
+    for (size_t i = 1; i < numEvents; ++i)
+    {
+        const auto event = pendingEvents[i];
+        auto j = i;
+
+        for (; j > 0 && pendingEvents[j - 1].timeStamp > event.timeStamp; --j)
+            pendingEvents[j] = pendingEvents[j - 1];
+
+        pendingEvents[j] = event;
+    }
+}
+
+
+void MidiInputRouter::valueTreeChildAdded (juce::ValueTree&, juce::ValueTree&)
+{
+    rebuildRoutingTable();
+}
+
+
+void MidiInputRouter::valueTreeChildRemoved (juce::ValueTree&, juce::ValueTree&, int)
+{
+    rebuildRoutingTable();
+}
+
+
+void MidiInputRouter::valueTreePropertyChanged (juce::ValueTree&, const juce::Identifier&)
+{
+    rebuildRoutingTable();
+}
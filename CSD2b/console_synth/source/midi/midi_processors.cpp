@@ -0,0 +1,389 @@
+// Written by Wouter Ensink
+
+#include <console_synth/midi/midi_processors.h>
+#include <algorithm>
+#include <cmath>
+
+
+// the length of a note in ticks, for a part of a step
+static uint64_t getGateTicks (uint64_t rateTicks, double gate) noexcept
+{
+    return std::max (uint64_t { 1 }, (uint64_t) std::llround ((double) rateTicks * gate));
+}
+
+
+MidiProcessorSettings MidiProcessorSettings::fromState (const juce::ValueTree& state)
+{
+    auto settings = MidiProcessorSettings {};
+
+    if (const auto* intervals = state.getProperty (IDs::chord).getArray())
+    {
+        settings.numChordNotes = std::min (intervals->size(), maxNumChordNotes);
+
+        for (auto i = 0; i < settings.numChordNotes; ++i)
+            settings.chordIntervals[(size_t) i] = juce::jlimit (-48, 48, (int) (*intervals)[i]);
+    }
+
+    const auto mode = juce::jlimit (0, (int) ArpeggiatorMode::asPlayed, (int) state.getProperty (IDs::arpeggiatorMode, 0));
+    settings.arpeggiatorMode = static_cast<ArpeggiatorMode> (mode);
+    settings.arpeggiatorRateTicks = (uint64_t) std::max (juce::int64 { 1 }, (juce::int64) state.getProperty (IDs::arpeggiatorRateTicks, 12));
+    settings.arpeggiatorGate = juce::jlimit (0.05, 1.0, (double) state.getProperty (IDs::arpeggiatorGate, 0.5));
+    settings.arpeggiatorOctaves = juce::jlimit (1, 4, (int) state.getProperty (IDs::arpeggiatorOctaves, 1));
+
+    settings.repeatRateTicks = (uint64_t) std::max (juce::int64 { 0 }, (juce::int64) state.getProperty (IDs::repeatRateTicks, 0));
+    settings.repeatGate = juce::jlimit (0.05, 1.0, (double) state.getProperty (IDs::repeatGate, 0.5));
+
+    return settings;
+}
+
+
+// ===================================================================================================
+
+void ChordMemoryProcessor::processMidi (const PlayHead&, bool, juce::MidiBuffer& midi, int)
+{
+    takeEvents (midi);
+
+    for (auto i = size_t { 0 }; i < numEvents; ++i)
+    {
+        const auto& event = events[i];
+
+        if (event.isNoteOn())
+            startChord (event, midi);
+        else if (event.isNoteOff())
+            stopChord (event, midi);
+        else
+            addEvent (midi, event);
+    }
+}
+
+
+void ChordMemoryProcessor::reset (juce::MidiBuffer& midi, int samplePosition)
+{
+    for (auto note = 0; note < 128; ++note)
+        if (numChordsPlayingNote[(size_t) note] > 0)
+            addNoteOff (midi, 1, note, samplePosition);
+
+    numNotesInChordOfNote.fill (0);
+    numChordsPlayingNote.fill (0);
+}
+
+
+void ChordMemoryProcessor::startChord (const Event& event, juce::MidiBuffer& midi)
+{
+    const auto noteNumber = event.getNoteNumber();
+
+    // the same note again, without a note off in between
+    if (numNotesInChordOfNote[(size_t) noteNumber] > 0)
+        stopChord (event, midi);
+
+    const auto hasChord = settings != nullptr && settings->numChordNotes > 0;
+    const auto numIntervals = hasChord ? settings->numChordNotes : 1;
+    auto& chord = chordOfNote[(size_t) noteNumber];
+    auto numNotes = uint8_t { 0 };
+
+    for (auto i = 0; i < numIntervals; ++i)
+    {
+        const auto chordNote = noteNumber + (hasChord ? settings->chordIntervals[(size_t) i] : 0);
+
+        if (chordNote < 0 || chordNote > 127)
+            continue;
+
+        // a note that is already playing in another chord isn't started again,
+        // a note that didn't fit in the block isn't part of the chord
+        if (numChordsPlayingNote[(size_t) chordNote] == 0
+            && ! addNoteOn (midi, event.getChannel(), chordNote, event.getVelocity(), event.samplePosition))
+            continue;
+
+        ++numChordsPlayingNote[(size_t) chordNote];
+        chord[numNotes++] = (uint8_t) chordNote;
+    }
+
+    numNotesInChordOfNote[(size_t) noteNumber] = numNotes;
+}
+
+
+void ChordMemoryProcessor::stopChord (const Event& event, juce::MidiBuffer& midi)
+{
+    const auto noteNumber = event.getNoteNumber();
+    auto& numNotes = numNotesInChordOfNote[(size_t) noteNumber];
+
+    // a note off of a note that didn't play a chord here can't hurt
+    if (numNotes == 0)
+    {
+        addEvent (midi, event);
+        return;
+    }
+
+    for (auto i = 0; i < numNotes; ++i)
+    {
+        const auto chordNote = chordOfNote[(size_t) noteNumber][(size_t) i];
+
+        if (--numChordsPlayingNote[chordNote] == 0)
+            addNoteOff (midi, event.getChannel(), chordNote, event.samplePosition);
+    }
+
+    numNotes = 0;
+}
+
+
+// ===================================================================================================
+
+void ArpeggiatorProcessor::reset (juce::MidiBuffer& midi, int samplePosition)
+{
+    stopPlayingNote (midi, samplePosition);
+    numHeldNotes = 0;
+    step = 0;
+}
+
+
+void ArpeggiatorProcessor::handleEvent (const Event& event, juce::MidiBuffer& midi)
+{
+    if (! isActive())
+    {
+        reset (midi, event.samplePosition);
+        addEvent (midi, event);
+        return;
+    }
+
+    const auto noteNumber = (uint8_t) event.getNoteNumber();
+    const auto heldNote = std::find_if (heldNotes.begin(), heldNotes.begin() + numHeldNotes, [&] (const HeldNote& note) {
+        return note.noteNumber == noteNumber;
+    });
+
+    const auto isHeld = heldNote != heldNotes.begin() + numHeldNotes;
+
+    if (event.isNoteOn())
+    {
+        if (isHeld)
+            heldNote->velocity = event.getVelocity();
+        else if (numHeldNotes < maxNumHeldNotes)
+            heldNotes[(size_t) numHeldNotes++] = { noteNumber, event.getVelocity() };
+
+        playingChannel = event.getChannel();
+    }
+    else if (event.isNoteOff() && isHeld)
+    {
+        // the order the notes were played in is kept
+        std::copy (heldNote + 1, heldNotes.begin() + numHeldNotes, heldNote);
+
+        // the next chord starts at the beginning of the pattern
+        if (--numHeldNotes == 0)
+            reset (midi, event.samplePosition);
+    }
+    else
+    {
+        addEvent (midi, event);
+    }
+}
+
+
+void ArpeggiatorProcessor::handleTick (uint64_t tick, int samplePosition, juce::MidiBuffer& midi)
+{
+    if (! isActive())
+    {
+        stopPlayingNote (midi, samplePosition);
+        return;
+    }
+
+    if (playingNote >= 0 && tick >= noteOffTick)
+        stopPlayingNote (midi, samplePosition);
+
+    const auto rate = settings->arpeggiatorRateTicks;
+
+    if (numHeldNotes == 0 || tick % rate != 0)
+        return;
+
+    stopPlayingNote (midi, samplePosition);
+    const auto note = getNoteOfStep (step++);
+
+    if (note.noteNumber > 127 || ! addNoteOn (midi, playingChannel, note.noteNumber, note.velocity, samplePosition))
+        return;
+
+    playingNote = note.noteNumber;
+    noteOffTick = tick + getGateTicks (rate, settings->arpeggiatorGate);
+}
+
+
+ArpeggiatorProcessor::HeldNote ArpeggiatorProcessor::getNoteOfStep (uint64_t stepIndex) const noexcept
+{
+    auto notes = heldNotes;
+
+    if (settings->arpeggiatorMode != ArpeggiatorMode::asPlayed)
+        std::sort (notes.begin(), notes.begin() + numHeldNotes, [] (const HeldNote& a, const HeldNote& b) {
+            return a.noteNumber < b.noteNumber;
+        });
+
+    // the notes of all octaves in a row, going up
+    const auto numSteps = (uint64_t) (numHeldNotes * settings->arpeggiatorOctaves);
+    auto index = stepIndex % numSteps;
+
+    if (settings->arpeggiatorMode == ArpeggiatorMode::down)
+    {
+        index = numSteps - 1 - index;
+    }
+    else if (settings->arpeggiatorMode == ArpeggiatorMode::upDown)
+    {
+        // the highest and lowest notes aren't played twice in a row
+        const auto period = std::max (uint64_t { 1 }, numSteps * 2 - 2);
+        const auto position = stepIndex % period;
+        index = position < numSteps ? position : period - position;
+    }
+
+    auto note = notes[(size_t) (index % (uint64_t) numHeldNotes)];
+    note.noteNumber = (uint8_t) (note.noteNumber + 12 * (index / (uint64_t) numHeldNotes));
+    return note;
+}
+
+
+void ArpeggiatorProcessor::stopPlayingNote (juce::MidiBuffer& midi, int samplePosition)
+{
+    if (playingNote >= 0)
+        addNoteOff (midi, playingChannel, playingNote, samplePosition);
+
+    playingNote = -1;
+}
+
+
+// ===================================================================================================
+
+void NoteRepeatProcessor::reset (juce::MidiBuffer& midi, int samplePosition)
+{
+    stopSoundingNotes (midi, samplePosition);
+    heldVelocities.fill (0);
+    pressedNotes.reset();
+}
+
+
+void NoteRepeatProcessor::handleEvent (const Event& event, juce::MidiBuffer& midi)
+{
+    if (! isActive())
+    {
+        reset (midi, event.samplePosition);
+        addEvent (midi, event);
+        return;
+    }
+
+    const auto noteNumber = (size_t) event.getNoteNumber();
+
+    if (event.isNoteOn())
+    {
+        if (soundingNotes.test (noteNumber))
+            addNoteOff (midi, event.getChannel(), (int) noteNumber, event.samplePosition);
+
+        // the note plays until the next repeat (or until it's released)
+        heldVelocities[noteNumber] = event.getVelocity();
+        heldChannels[noteNumber] = (uint8_t) event.getChannel();
+        noteOffTicks[noteNumber] = ~uint64_t { 0 };
+        soundingNotes.set (noteNumber, addEvent (midi, event));
+        pressedNotes.set (noteNumber);
+        pressedSamples[noteNumber] = event.samplePosition;
+    }
+    else if (event.isNoteOff() && heldVelocities[noteNumber] > 0)
+    {
+        if (soundingNotes.test (noteNumber))
+            addEvent (midi, event);
+
+        heldVelocities[noteNumber] = 0;
+        soundingNotes.reset (noteNumber);
+    }
+    else
+    {
+        addEvent (midi, event);
+    }
+}
+
+
+void NoteRepeatProcessor::handleTick (uint64_t tick, int samplePosition, juce::MidiBuffer& midi)
+{
+    if (! isActive())
+    {
+        stopSoundingNotes (midi, samplePosition);
+        return;
+    }
+
+    const auto rate = settings->repeatRateTicks;
+    const auto isRepeat = tick % rate == 0;
+
+    for (auto note = size_t { 0 }; note < heldVelocities.size(); ++note)
+    {
+        if (soundingNotes.test (note) && tick >= noteOffTicks[note])
+        {
+            addNoteOff (midi, heldChannels[note], (int) note, samplePosition);
+            soundingNotes.reset (note);
+        }
+
+        if (! isRepeat || heldVelocities[note] == 0)
+            continue;
+
+        // a note that was pressed on this very tick is the first repeat already
+        if (! (pressedNotes.test (note) && pressedSamples[note] == samplePosition))
+        {
+            if (soundingNotes.test (note))
+                addNoteOff (midi, heldChannels[note], (int) note, samplePosition);
+
+            soundingNotes.set (note, addNoteOn (midi, heldChannels[note], (int) note, heldVelocities[note], samplePosition));
+        }
+
+        noteOffTicks[note] = tick + getGateTicks (rate, settings->repeatGate);
+    }
+
+    pressedNotes.reset();
+}
+
+
+void NoteRepeatProcessor::stopSoundingNotes (juce::MidiBuffer& midi, int samplePosition)
+{
+    for (auto note = size_t { 0 }; note < soundingNotes.size(); ++note)
+        if (soundingNotes.test (note))
+            addNoteOff (midi, heldChannels[note], (int) note, samplePosition);
+
+    soundingNotes.reset();
+}
+
+
+// ===================================================================================================
+
+MidiProcessorChain::MidiProcessorChain (juce::ValueTree& trackState)
+    : processorsState { trackState.getOrCreateChildWithName (IDs::midiProcessors, nullptr) },
+      settings { std::make_unique<const MidiProcessorSettings> (MidiProcessorSettings::fromState (processorsState)) }
+{
+    processorsState.addListener (this);
+}
+
+
+MidiProcessorChain::~MidiProcessorChain()
+{
+    processorsState.removeListener (this);
+}
+
+
+void MidiProcessorChain::processMidi (const PlayHead& playHead, bool isPlaying, juce::MidiBuffer& midi, int numSamples)
+{
+    auto currentSettings = settings.read();
+    chordMemory.setSettings (&*currentSettings);
+    arpeggiator.setSettings (&*currentSettings);
+    noteRepeat.setSettings (&*currentSettings);
+
+    for (auto* processor : processors)
+        processor->processMidi (playHead, isPlaying, midi, numSamples);
+}
+
+
+void MidiProcessorChain::reset (juce::MidiBuffer& midi, int samplePosition)
+{
+    for (auto* processor : processors)
+        processor->reset (midi, samplePosition);
+}
+
+
+void MidiProcessorChain::collectGarbage()
+{
+    settings.collectGarbage();
+}
+
+
+void MidiProcessorChain::valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier&)
+{
+    if (tree == processorsState)
+        settings.publish (std::make_unique<const MidiProcessorSettings> (MidiProcessorSettings::fromState (processorsState)));
+}
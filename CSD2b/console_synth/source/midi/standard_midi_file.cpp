@@ -0,0 +1,191 @@
+
+// Written by Wouter Ensink
+
+#include <console_synth/midi/standard_midi_file.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <optional>
+
+
+std::vector<StandardMidiFile::Note> StandardMidiFile::readNotes (juce::InputStream& stream, uint32_t ticksPerQuarterNote)
+{
+    auto file = juce::MidiFile {};
+
+    // the notes are matched up below in one pass, matching them while reading takes a search for every note on
+    if (! file.readFrom (stream, false))
+        throw ReadError { "not a valid midi file" };
+
+    const auto fileTicksPerQuarterNote = (int) file.getTimeFormat();
+
+    // a negative time format means the time stamps are in frames of a smpte time code, not in beats
+    if (fileTicksPerQuarterNote <= 0)
+        throw ReadError { "midi files with smpte time stamps are not supported" };
+
+    struct HeldNote
+    {
+        double tick;
+        int velocity;
+    };
+
+    auto notes = std::vector<Note> {};
+
+    const auto addNote = [&] (int noteNumber, const HeldNote& held, double endTick) {
+        const auto start = rescale (held.tick, fileTicksPerQuarterNote, ticksPerQuarterNote);
+        const auto end = rescale (endTick, fileTicksPerQuarterNote, ticksPerQuarterNote);
+        notes.push_back ({ noteNumber, start, std::max (end - start, 1), held.velocity });
+    };
+
+    for (auto trackIndex = 0; trackIndex < file.getNumTracks(); ++trackIndex)
+    {
+        const auto& track = *file.getTrack (trackIndex);
+
+        // the note that is held for every channel and note number
+        auto heldNotes = std::array<std::optional<HeldNote>, 16 * 128> {};
+
+        for (auto i = 0; i < track.getNumEvents(); ++i)
+        {
+            const auto& message = track.getEventPointer (i)->message;
+
+            // a note on without velocity counts as a note off
+            if (! (message.isNoteOn() || message.isNoteOff()))
+                continue;
+
+            auto& held = heldNotes[(size_t) ((message.getChannel() - 1) * 128 + message.getNoteNumber())];
+
+            // a note off ends the note, so does a second note on for the same note (which then starts a new one)
+            if (held.has_value())
+            {
+                addNote (message.getNoteNumber(), *held, message.getTimeStamp());
+                held.reset();
+            }
+
+            if (message.isNoteOn())
+                held = HeldNote { message.getTimeStamp(), (int) message.getVelocity() };
+        }
+
+        // notes that never got a note off last until the end of the track
+        for (auto index = size_t { 0 }; index < heldNotes.size(); ++index)
+            if (heldNotes[index].has_value())
+                addNote ((int) (index % 128), *heldNotes[index], track.getEndTime());
+    }
+
+    std::stable_sort (notes.begin(), notes.end(), [] (const Note& a, const Note& b) {
+        return a.start != b.start ? a.start < b.start : a.number < b.number;
+    });
+
+    return notes;
+}
+
+
+void StandardMidiFile::replaceNotes (juce::ValueTree melodyTree, const std::vector<Note>& notes)
+{
+    jassert (melodyTree.hasType (IDs::melody));
+
+    // the melody only rebuilds its events once, after all notes have been replaced
+    auto batch = ScopedMelodyEditBatch { melodyTree };
+    melodyTree.removeAllChildren (nullptr);
+
+    for (const auto& note : notes)
+        MelodyGenerator::addNoteToTree (melodyTree, note);
+}
+
+
+size_t StandardMidiFile::importFile (const juce::File& file, juce::ValueTree melodyTree, uint32_t ticksPerQuarterNote)
+{
+    auto stream = juce::FileInputStream { file };
+
+    if (stream.failedToOpen())
+        throw ReadError { "couldn't open " + file.getFullPathName().toStdString() };
+
+    auto notes = readNotes (stream, ticksPerQuarterNote);
+    replaceNotes (std::move (melodyTree), notes);
+    return notes.size();
+}
+
+
+juce::MidiFile StandardMidiFile::createMidiFile (const Melody& melody, const MeterMap& meterMap, const TempoMap& tempoMap)
+{
+    jassert (tempoMap.getTicksPerQuarterNote() == meterMap.getTicksPerQuarterNote());
+
+    auto sequence = juce::MidiMessageSequence {};
+
+    addTempoEvents (sequence, tempoMap);
+
+    for (const auto& change : meterMap.getMeterChanges())
+    {
+        const auto tick = (double) meterMap.getTickOfBar (change.bar);
+        sequence.addEvent (juce::MidiMessage::timeSignatureMetaEvent ((int) change.numerator, (int) change.denominator), tick);
+    }
+
+    // the events are already sorted, so every event is added at the end of the sequence
+    melody.forEachEvent ([&sequence] (const Event& event) {
+        const auto message = event.isNoteOn
+                                 ? juce::MidiMessage::noteOn (1, event.midiNote, (juce::uint8) event.velocity)
+                                 : juce::MidiMessage::noteOff (1, event.midiNote);
+
+        sequence.addEvent (message, (double) event.timeStampTicks);
+    });
+
+    auto file = juce::MidiFile {};
+    file.setTicksPerQuarterNote ((int) meterMap.getTicksPerQuarterNote());
+    file.addTrack (sequence);
+    return file;
+}
+
+
+bool StandardMidiFile::exportFile (const juce::File& file, const Melody& melody, const MeterMap& meterMap, const TempoMap& tempoMap)
+{
+    auto stream = juce::FileOutputStream { file };
+
+    if (stream.failedToOpen())
+        return false;
+
+    // the stream starts at the end of an existing file, so that is emptied first
+    stream.setPosition (0);
+    stream.truncate();
+
+    return createMidiFile (melody, meterMap, tempoMap).writeTo (stream);
+}
+
+
+void StandardMidiFile::addTempoEvents (juce::MidiMessageSequence& sequence, const TempoMap& tempoMap)
+{
+    const auto addTempoEvent = [&sequence] (uint64_t tick, double bpm) {
+        sequence.addEvent (juce::MidiMessage::tempoMetaEvent ((int) std::round (60'000'000.0 / bpm)), (double) tick);
+    };
+
+    const auto getSeconds = [&tempoMap] (uint64_t tick) {
+        return (double) tempoMap.getPositionOfTick (tick) / (double) TempoMap::subSamplesPerSample / tempoMap.getSampleRate();
+    };
+
+    // the changes of the map are sorted, the first one is at the start and the tempos that were too low are raised already
+    const auto& changes = tempoMap.getTempoChanges();
+    const auto ticksPerStep = (uint64_t) std::max (tempoMap.getTicksPerQuarterNote() / 4, 1u);
+
+    for (auto i = size_t { 0 }; i < changes.size(); ++i)
+    {
+        const auto& change = changes[i];
+
+        if (change.curveToNext != TempoMap::Curve::ramp || i + 1 == changes.size())
+        {
+            addTempoEvent (change.tick, change.bpm);
+            continue;
+        }
+
+        const auto endTick = changes[i + 1].tick;
+
+        for (auto tick = change.tick; tick < endTick; tick += ticksPerStep)
+        {
+            const auto stepEnd = std::min (tick + ticksPerStep, endTick);
+            const auto quarterNotes = (double) (stepEnd - tick) / tempoMap.getTicksPerQuarterNote();
+            addTempoEvent (tick, quarterNotes * 60.0 / (getSeconds (stepEnd) - getSeconds (tick)));
+        }
+    }
+}
+
+
+int StandardMidiFile::rescale (double fileTick, int fileTicksPerQuarterNote, uint32_t ticksPerQuarterNote) noexcept
+{
+    return (int) std::llround (fileTick * (double) ticksPerQuarterNote / (double) fileTicksPerQuarterNote);
+}
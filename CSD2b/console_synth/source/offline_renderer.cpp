@@ -0,0 +1,125 @@
+
+// Written by Wouter Ensink
+
+#include <console_synth/offline_renderer.h>
+#include <cmath>
+
+
+OfflineRenderer::OfflineRenderer (Sequencer& sequencerToRender) : sequencer { sequencerToRender }
+{
+    writerThread.startThread();
+}
+
+
+OfflineRenderer::~OfflineRenderer()
+{
+    writerThread.stopThread (1000);
+}
+
+
+OfflineRenderer::Result OfflineRenderer::renderBars (const juce::File& file, uint32_t numBars, const OfflineRenderSettings& settings)
+{
+    return render (file, settings, [this, numBars] { return sequencer.getLengthOfBarsSamples (numBars); });
+}
+
+
+OfflineRenderer::Result OfflineRenderer::renderLoops (const juce::File& file, uint32_t numLoops, const OfflineRenderSettings& settings)
+{
+    return render (file, settings, [this, numLoops] { return sequencer.getLengthOfLoopsSamples (numLoops); });
+}
+
+
+template <typename LengthFunction>
+OfflineRenderer::Result OfflineRenderer::render (const juce::File& file, const OfflineRenderSettings& settings, LengthFunction&& getLengthSamples)
+{
+    jassert (settings.sampleRate > 0.0 && settings.blockSize > 0 && settings.numChannels > 0);
+
+    // the writer owns the format writer, when it's deleted it writes what's left in the fifo
+    auto writer = std::make_unique<juce::AudioFormatWriter::ThreadedWriter> (createWriter (file, settings).release(),
+                                                                            writerThread,
+                                                                            settings.writerBufferSamples);
+
+    const auto startTimeMs = juce::Time::getMillisecondCounterHiRes();
+
+    // the scheduler thread could be ahead or behind of the render loop, so the render generates all midi itself to come out
+    // the same every time
+    sequencer.setMidiSchedulingSuspended (true);
+
+    // preparing also resets the synths and effects, so nothing of what played before ends up in the file
+    sequencer.prepareToPlay (settings.blockSize, settings.sampleRate);
+    sequencer.startExporting();
+
+    const auto numSamples = getLengthSamples() + (uint64_t) std::llround (std::max (settings.tailSeconds, 0.0) * settings.sampleRate);
+    const auto latency = (uint64_t) sequencer.getLatencySamples();
+    const auto blockSize = (uint64_t) settings.blockSize;
+
+    auto buffer = juce::AudioBuffer<float> (settings.numChannels, settings.blockSize);
+    auto channels = std::vector<const float*> ((size_t) settings.numChannels);
+
+    // the block size stays the same (so the play head doesn't change along the way), the last block can be
+    // longer than what's left of the file, the rest of it is not written
+    for (auto renderedSamples = uint64_t { 0 }; renderedSamples < latency + numSamples; renderedSamples += blockSize)
+    {
+        buffer.clear();
+        sequencer.getNextAudioBlock (juce::AudioSourceChannelInfo { &buffer, 0, settings.blockSize });
+
+        const auto start = renderedSamples < latency ? std::min (latency - renderedSamples, blockSize) : uint64_t { 0 };
+        const auto end = std::min (latency + numSamples - renderedSamples, blockSize);
+
+        if (start >= end)
+            continue;
+
+        for (auto channel = 0; channel < settings.numChannels; ++channel)
+            channels[(size_t) channel] = buffer.getReadPointer (channel, (int) start);
+
+        // only waits when the writer can't keep up with the rendering
+        while (! writer->write (channels.data(), (int) (end - start)))
+            juce::Thread::sleep (1);
+    }
+
+    // one stopped block, so the tracks send the note offs of the notes that are still playing
+    sequencer.stopPlayback();
+    buffer.clear();
+    sequencer.getNextAudioBlock (juce::AudioSourceChannelInfo { &buffer, 0, settings.blockSize });
+    sequencer.releaseResources();
+    sequencer.setMidiSchedulingSuspended (false);
+
+    writer.reset();
+
+    return { numSamples, settings.sampleRate, (juce::Time::getMillisecondCounterHiRes() - startTimeMs) * 0.001 };
+}
+
+
+std::unique_ptr<juce::AudioFormatWriter> OfflineRenderer::createWriter (const juce::File& file, const OfflineRenderSettings& settings)
+{
+    auto format = std::unique_ptr<juce::AudioFormat> {};
+
+    if (file.hasFileExtension ("flac"))
+        format = std::make_unique<juce::FlacAudioFormat>();
+    else
+        format = std::make_unique<juce::WavAudioFormat>();
+
+    auto stream = std::make_unique<juce::FileOutputStream> (file);
+
+    if (stream->failedToOpen())
+        throw RenderError { "couldn't open " + file.getFullPathName().toStdString() };
+
+    // the stream starts at the end of an existing file, so that is emptied first
+    stream->setPosition (0);
+    stream->truncate();
+
+    auto writer = std::unique_ptr<juce::AudioFormatWriter> (format->createWriterFor (stream.get(),
+                                                                                    settings.sampleRate,
+                                                                                    (unsigned int) settings.numChannels,
+                                                                                    settings.bitsPerSample,
+                                                                                    {},
+                                                                                    0));
+
+    if (writer == nullptr)
+        throw RenderError { "can't write " + std::to_string (settings.bitsPerSample) + " bit audio at "
+                            + std::to_string ((int) settings.sampleRate) + " Hz to " + file.getFullPathName().toStdString() };
+
+    // the writer deletes the stream when it's done
+    stream.release();
+    return writer;
+}
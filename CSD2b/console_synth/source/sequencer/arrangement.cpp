@@ -0,0 +1,91 @@
+// Written by Wouter Ensink
+
+#include <console_synth/sequencer/arrangement.h>
+
+
+Clip Clip::fromState (const juce::ValueTree& clipState)
+{
+    auto getTicks = [&clipState] (const juce::Identifier& property) {
+        return (uint64_t) std::max (juce::int64 { 0 }, (juce::int64) clipState.getProperty (property, 0));
+    };
+
+    return Clip {
+        (int) clipState.getProperty (IDs::pattern),
+        getTicks (IDs::startTimeTicks),
+        getTicks (IDs::lengthTicks),
+        getTicks (IDs::offsetTicks),
+        getTicks (IDs::loopLengthTicks),
+        (int) clipState.getProperty (IDs::transpose, 0)
+    };
+}
+
+
+Arrangement::Arrangement (juce::ValueTree& trackState)
+    : arrangementState { trackState.getOrCreateChildWithName (IDs::arrangement, nullptr) }
+{
+    arrangementState.addListener (this);
+    rebuildClips();
+}
+
+
+Arrangement::~Arrangement()
+{
+    arrangementState.removeListener (this);
+}
+
+
+size_t Arrangement::getNumClips() const noexcept
+{
+    return clips.getLatestForWriter().clips.size();
+}
+
+
+void Arrangement::collectGarbage()
+{
+    clips.collectGarbage();
+}
+
+
+void Arrangement::rebuildClips()
+{
+    auto newClips = std::vector<Clip> {};
+    auto intervals = std::vector<IntervalIndex::Interval> {};
+
+    for (auto&& child : arrangementState)
+    {
+        if (! child.hasType (IDs::clip))
+            continue;
+
+        auto clip = Clip::fromState (child);
+
+        if (clip.lengthTicks == 0)
+            continue;
+
+        // one past the end, so the end tick itself can be found too
+        intervals.push_back ({ clip.startTick, clip.getEndTick() + 1, newClips.size() });
+        newClips.push_back (clip);
+    }
+
+    clips.publish (std::make_unique<const ClipList> (ClipList { std::move (newClips), IntervalIndex { std::move (intervals) } }));
+}
+
+
+void Arrangement::valueTreeChildAdded (juce::ValueTree& parent, juce::ValueTree&)
+{
+    if (parent == arrangementState)
+        rebuildClips();
+}
+
+
+void Arrangement::valueTreeChildRemoved (juce::ValueTree& parent, juce::ValueTree&, int)
+{
+    if (parent == arrangementState)
+        rebuildClips();
+}
+
+
+void Arrangement::valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier&)
+{
+    if (tree.getParent() == arrangementState)
+        rebuildClips();
+}
@@ -0,0 +1,50 @@
+// Written by Wouter Ensink
+
+#include <console_synth/sequencer/bus.h>
+
+
+Bus::Bus (juce::ValueTree parent, const juce::String& name)
+{
+    busState.setProperty (IDs::name, name, nullptr);
+    parent.appendChild (busState, nullptr);
+}
+
+
+void Bus::prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock)
+{
+    busBuffer.setSize (2, maximumExpectedSamplesPerBlock);
+    effectChain.prepareToPlay (sampleRate, maximumExpectedSamplesPerBlock);
+}
+
+
+void Bus::releaseResources()
+{
+    effectChain.releaseResources();
+}
+
+
+void Bus::startNextBlock (int numChannels, int numSamples)
+{
+    busBuffer.setSize (numChannels, numSamples, false, false, true);
+    busBuffer.clear();
+}
+
+
+void Bus::addFrom (const juce::AudioBuffer<float>& source, float gain)
+{
+    for (auto channel = 0; channel < busBuffer.getNumChannels(); ++channel)
+        busBuffer.addFrom (channel, 0, source, channel, 0, busBuffer.getNumSamples(), gain);
+}
+
+
+void Bus::renderNextBlock (juce::AudioBuffer<float>& destination)
+{
+    // when nobody sends to the bus and the effect tails have decayed, there's nothing to add
+    if (effectChain.isIdle() && busBuffer.getMagnitude (0, busBuffer.getNumSamples()) < AudioProcessorBase::silenceThreshold)
+        return;
+
+    effectChain.processBlock (busBuffer, emptyMidiBuffer);
+
+    for (auto channel = 0; channel < destination.getNumChannels(); ++channel)
+        destination.addFrom (channel, 0, busBuffer, channel, 0, busBuffer.getNumSamples());
+}
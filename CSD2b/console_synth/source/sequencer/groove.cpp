@@ -0,0 +1,372 @@
+// Written by Wouter Ensink
+
+#include <console_synth/sequencer/groove.h>
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+
+
+// the values of an array property, repeated over all steps
+template <size_t numSteps>
+static void fillSteps (std::array<double, numSteps>& steps, const juce::var& values, double defaultValue)
+{
+    const auto* array = values.getArray();
+    const auto numValues = array != nullptr ? array->size() : 0;
+
+    for (auto step = 0; step < (int) steps.size(); ++step)
+        steps[(size_t) step] = numValues > 0 ? (double) (*array)[step % numValues] : defaultValue;
+}
+
+
+GrooveSettings GrooveSettings::fromState (const juce::ValueTree& state)
+{
+    auto settings = GrooveSettings {};
+
+    // at a swing of 1 the second step would be at the same time as the step after it
+    settings.swing = juce::jlimit (0.0, 0.9, (double) state.getProperty (IDs::swing, 0.0));
+    settings.swingGridTicks = (uint64_t) std::max (juce::int64 { 1 }, (juce::int64) state.getProperty (IDs::swingGridTicks, 12));
+    settings.grooveGridTicks = (uint64_t) std::max (juce::int64 { 1 }, (juce::int64) state.getProperty (IDs::grooveGridTicks, 12));
+
+    const auto offsets = state.getProperty (IDs::grooveOffsets);
+    settings.numGrooveSteps = offsets.isArray() ? std::min (offsets.size(), maxNumGrooveSteps) : 0;
+    fillSteps (settings.grooveOffsetTicks, offsets, 0.0);
+
+    // the velocities are in percent
+    fillSteps (settings.grooveVelocities, state.getProperty (IDs::grooveVelocities), 100.0);
+
+    for (auto& velocity : settings.grooveVelocities)
+        velocity = juce::jlimit (0.0, 2.0, velocity / 100.0);
+
+    settings.humanizeTicks = std::max (0.0, (double) state.getProperty (IDs::humanizeTicks, 0.0));
+    settings.humanizeVelocity = juce::jlimit (0, 127, (int) state.getProperty (IDs::humanizeVelocity, 0));
+    settings.seed = (juce::int64) state.getProperty (IDs::seed, 0);
+    settings.transpose = juce::jlimit (-127, 127, (int) state.getProperty (IDs::transpose, 0));
+
+    return settings;
+}
+
+
+// ===================================================================================================
+
+Groove::Groove (juce::ValueTree& trackState)
+    : grooveState { trackState.getOrCreateChildWithName (IDs::groove, nullptr) },
+      settings { std::make_unique<const GrooveSettings> (GrooveSettings::fromState (grooveState)) }
+{
+    grooveState.addListener (this);
+}
+
+
+Groove::~Groove()
+{
+    grooveState.removeListener (this);
+}
+
+
+AtomicSnapshot<GrooveSettings>::ReadScope Groove::read() const noexcept
+{
+    return settings.read();
+}
+
+
+void Groove::collectGarbage()
+{
+    settings.collectGarbage();
+}
+
+
+void Groove::valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier&)
+{
+    if (tree == grooveState)
+        settings.publish (std::make_unique<const GrooveSettings> (GrooveSettings::fromState (grooveState)));
+}
+
+
+// ===================================================================================================
+
+static bool isNoteOn (const uint8_t* data) noexcept
+{
+    return (data[0] & 0xf0) == 0x90 && data[2] > 0;
+}
+
+
+static bool isNoteOff (const uint8_t* data) noexcept
+{
+    return (data[0] & 0xf0) == 0x80 || ((data[0] & 0xf0) == 0x90 && data[2] == 0);
+}
+
+
+// the sources play their notes on whole ticks, the tick of their sample is only off by less than a sample
+static double snapToTick (double tick) noexcept
+{
+    const auto nearest = std::round (tick);
+    return std::abs (tick - nearest) < 0.01 ? nearest : tick;
+}
+
+
+static double applySwing (const GrooveSettings& settings, double tick) noexcept
+{
+    if (settings.swing == 0.0)
+        return tick;
+
+    // the first step of every pair is stretched, the second one squeezed, so the second step starts later
+    const auto grid = (double) settings.swingGridTicks;
+    const auto positionInPair = std::fmod (tick, grid * 2.0);
+    const auto pairStart = tick - positionInPair;
+
+    if (positionInPair < grid)
+        return pairStart + positionInPair * (1.0 + settings.swing);
+
+    return pairStart + grid * (1.0 + settings.swing) + (positionInPair - grid) * (1.0 - settings.swing);
+}
+
+
+static double applyGrooveTemplate (const GrooveSettings& settings, double tick, double& velocity) noexcept
+{
+    if (settings.numGrooveSteps == 0)
+        return tick;
+
+    const auto grid = (double) settings.grooveGridTicks;
+    const auto step = (int64_t) std::llround (tick / grid);
+    const auto stepInTemplate = (size_t) (step % settings.numGrooveSteps);
+    const auto target = (double) step * grid + settings.grooveOffsetTicks[stepInTemplate];
+
+    velocity *= settings.grooveVelocities[stepInTemplate];
+    return std::max (tick, target);
+}
+
+
+// the same note at the same tick always gets the same random numbers, however the blocks fall
+static juce::Random createRandom (int64_t seed, double tick, int note) noexcept
+{
+    auto x = (uint64_t) seed + (uint64_t) std::llround (tick) * 0x9e3779b97f4a7c15ull + (uint64_t) note * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return juce::Random { (juce::int64) (x ^ (x >> 31)) };
+}
+
+
+void MidiTransformChain::process (const GrooveSettings& settings, const PlayHead& playHead, juce::MidiBuffer& buffer, int numSamples)
+{
+    auto numNoteOffs = size_t { 0 };
+
+    for (auto&& metadata : buffer)
+        if (metadata.numBytes == 3 && isNoteOff (metadata.data))
+            ++numNoteOffs;
+
+    // when the events don't all fit, the note ons are dropped first. The note offs that don't fit either
+    // are played at the end of the block (there's no note on left in the block then)
+    auto numNoteOffsLeft = std::min (numNoteOffs, blockEvents.size());
+    auto numBlockEvents = size_t { 0 };
+    auto droppedNoteOffs = std::bitset<128> { 0 };
+
+    for (auto&& metadata : buffer)
+    {
+        if (metadata.numBytes != 3)
+            continue;
+
+        if (isNoteOff (metadata.data))
+        {
+            if (numNoteOffsLeft == 0)
+            {
+                droppedNoteOffs.set (metadata.data[1]);
+                continue;
+            }
+
+            --numNoteOffsLeft;
+        }
+        else if (numBlockEvents + numNoteOffsLeft >= blockEvents.size())
+        {
+            continue;
+        }
+
+        blockEvents[numBlockEvents++] = { blockStart + (uint64_t) metadata.samplePosition,
+                                          { metadata.data[0], metadata.data[1], metadata.data[2] },
+                                          metadata.data[1] };
+    }
+
+    // clearing keeps the memory of the buffer
+    buffer.clear();
+
+    // a loop is a jump of the play head as well, but it's one that forEachStretchOfBlock() knows about
+    if (playHead.isSampleAccurate())
+    {
+        if (expectedTimelinePosition.has_value() && *expectedTimelinePosition != playHead.getTimelinePositionSubSamples())
+            flushPendingEvents (buffer);
+
+        expectedTimelinePosition = playHead.forEachStretchOfBlock ([] (uint64_t, uint64_t, uint64_t) {});
+    }
+
+    // the events that were moved into this block (in the order they were moved)
+    auto numStillPending = size_t { 0 };
+
+    for (auto i = size_t { 0 }; i < numPendingEvents; ++i)
+    {
+        const auto& event = pendingEvents[i];
+
+        if (event.samplePosition < blockStart + (uint64_t) numSamples)
+            buffer.addEvent (event.data, 3, (int) (event.samplePosition - blockStart));
+        else
+            pendingEvents[numStillPending++] = event;
+    }
+
+    numPendingEvents = numStillPending;
+
+    for (auto i = size_t { 0 }; i < numBlockEvents; ++i)
+    {
+        const auto& event = blockEvents[i];
+        const auto type = event.data[0] & 0xf0;
+
+        if (type == 0x90 && event.data[2] > 0)
+        {
+            if (auto transformed = transformNoteOn (settings, playHead, event, numSamples))
+                schedule (*transformed, buffer, numSamples);
+        }
+        else if (type == 0x80 || type == 0x90)
+        {
+            schedule (transformNoteOff (event), buffer, numSamples);
+        }
+        else
+        {
+            schedule (event, buffer, numSamples);
+        }
+    }
+
+    for (auto note = 0; note < (int) droppedNoteOffs.size(); ++note)
+        if (droppedNoteOffs.test ((size_t) note))
+            schedule (transformNoteOff ({ blockStart + (uint64_t) numSamples - 1, { 0x80, (uint8_t) note, 0 }, note }), buffer, numSamples);
+
+    blockStart += (uint64_t) numSamples;
+}
+
+
+void MidiTransformChain::reset() noexcept
+{
+    numPendingEvents = 0;
+    playedNotes.fill ({});
+    lastSampleOfNote.fill (0);
+    expectedTimelinePosition.reset();
+}
+
+
+uint64_t MidiTransformChain::getDelaySamples (const PlayHead& playHead, double tick, double delayTicks, int numSamples)
+{
+    if (delayTicks <= 0.0)
+        return 0;
+
+    // with a tempo map, the delay follows the tempo changes in between
+    if (playHead.isSampleAccurate())
+    {
+        const auto& tempoMap = playHead.getTempoMap();
+        return (tempoMap.getPositionOfTick (tick + delayTicks) - tempoMap.getPositionOfTick (tick)) >> PlayHead::subSampleBits;
+    }
+
+    return (uint64_t) (delayTicks * playHead.getTickTimeMs() / playHead.getDeviceCallbackDurationMs() * numSamples);
+}
+
+
+std::optional<MidiTransformChain::Event> MidiTransformChain::transformNoteOn (const GrooveSettings& settings,
+                                                                              const PlayHead& playHead,
+                                                                              const Event& event,
+                                                                              int numSamples)
+{
+    const auto tick = snapToTick (playHead.getTickAtSample ((int) (event.samplePosition - blockStart)));
+    auto velocity = (double) event.data[2];
+
+    auto playedTick = applySwing (settings, tick);
+    playedTick = applyGrooveTemplate (settings, playedTick, velocity);
+
+    if (settings.humanizeTicks > 0.0 || settings.humanizeVelocity > 0)
+    {
+        auto random = createRandom (settings.seed, tick, event.inputNote);
+        playedTick += random.nextDouble() * settings.humanizeTicks;
+        velocity += random.nextInt ({ -settings.humanizeVelocity, settings.humanizeVelocity + 1 });
+    }
+
+    const auto outputNote = event.inputNote + settings.transpose;
+    auto& playedNote = playedNotes[(size_t) event.inputNote];
+
+    if (outputNote < 0 || outputNote > 127)
+    {
+        playedNote.outputNote = -1;
+        return std::nullopt;
+    }
+
+    // a note never starts before the previous note off of the same note, which could have been moved further
+    auto transformed = event;
+    transformed.samplePosition = std::max (event.samplePosition + getDelaySamples (playHead, tick, playedTick - tick, numSamples),
+                                           lastSampleOfNote[(size_t) outputNote]);
+    transformed.data[1] = (uint8_t) outputNote;
+    transformed.data[2] = (uint8_t) juce::jlimit (1, 127, (int) std::lround (velocity));
+
+    playedNote = { outputNote, transformed.samplePosition - event.samplePosition };
+    lastSampleOfNote[(size_t) outputNote] = transformed.samplePosition;
+    return transformed;
+}
+
+
+MidiTransformChain::Event MidiTransformChain::transformNoteOff (const Event& event)
+{
+    auto& playedNote = playedNotes[(size_t) event.inputNote];
+
+    // a note off of a note that wasn't played here can't hurt
+    if (playedNote.outputNote < 0)
+        return event;
+
+    auto transformed = event;
+    transformed.samplePosition = std::max (event.samplePosition + playedNote.delaySamples, lastSampleOfNote[(size_t) playedNote.outputNote]);
+    transformed.data[1] = (uint8_t) playedNote.outputNote;
+
+    lastSampleOfNote[(size_t) playedNote.outputNote] = transformed.samplePosition;
+    playedNote.outputNote = -1;
+    return transformed;
+}
+
+
+void MidiTransformChain::schedule (const Event& event, juce::MidiBuffer& buffer, int numSamples)
+{
+    const auto blockEnd = blockStart + (uint64_t) numSamples;
+
+    if (event.samplePosition < blockEnd)
+    {
+        buffer.addEvent (event.data, 3, (int) (event.samplePosition - blockStart));
+    }
+    else if (numPendingEvents < pendingEvents.size())
+    {
+        pendingEvents[numPendingEvents++] = event;
+    }
+    else if (! isNoteOn (event.data))
+    {
+        // the note ons that are still waiting would play after their note off
+        if (isNoteOff (event.data))
+            removePendingNoteOns (event.data[1]);
+
+        buffer.addEvent (event.data, 3, numSamples - 1);
+    }
+}
+
+
+void MidiTransformChain::removePendingNoteOns (int outputNote) noexcept
+{
+    auto pendingEnd = std::remove_if (pendingEvents.begin(), pendingEvents.begin() + (long) numPendingEvents, [&] (const Event& event) {
+        return isNoteOn (event.data) && event.data[1] == outputNote;
+    });
+
+    numPendingEvents = (size_t) std::distance (pendingEvents.begin(), pendingEnd);
+}
+
+
+void MidiTransformChain::flushPendingEvents (juce::MidiBuffer& buffer)
+{
+    for (auto i = size_t { 0 }; i < numPendingEvents; ++i)
+    {
+        const auto& event = pendingEvents[i];
+
+        if ((event.data[0] & 0xf0) == 0x80 || event.data[2] == 0)
+            buffer.addEvent (event.data, 3, 0);
+        else
+            playedNotes[(size_t) event.inputNote].outputNote = -1;
+    }
+
+    numPendingEvents = 0;
+    lastSampleOfNote.fill (0);
+}
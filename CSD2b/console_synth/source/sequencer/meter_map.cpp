@@ -0,0 +1,116 @@
+// Written by Wouter Ensink
+
+#include <algorithm>
+#include <console_synth/sequencer/meter_map.h>
+
+
+MeterMap::MeterMap (uint32_t ticksPerQuarterNote, uint32_t numerator, uint32_t denominator)
+    : MeterMap { std::vector<MeterChange> { { 0, numerator, denominator } }, ticksPerQuarterNote }
+{
+}
+
+
+MeterMap::MeterMap (std::vector<MeterChange> changes, uint32_t ticksPerQuarterNote)
+    : meterChanges { std::move (changes) }, ticksPerQuarterNote { ticksPerQuarterNote }
+{
+    std::stable_sort (meterChanges.begin(), meterChanges.end(), [] (auto& a, auto& b) { return a.bar < b.bar; });
+
+    if (meterChanges.empty())
+        meterChanges.push_back ({ 0, 4, 4 });
+
+    meterChanges.front().bar = 0;
+
+    for (const auto& change : meterChanges)
+    {
+        auto timeSignature = TimeSignature { change.numerator, change.denominator, ticksPerQuarterNote };
+
+        if (! segments.empty() && segments.back().startBar == change.bar)
+        {
+            segments.back().timeSignature = timeSignature;
+            continue;
+        }
+
+        auto startTick = uint64_t { 0 };
+
+        if (! segments.empty())
+        {
+            const auto& previous = segments.back();
+            startTick = previous.startTick + (uint64_t) (change.bar - previous.startBar) * previous.timeSignature.getTicksPerBar();
+        }
+
+        segments.push_back ({ change.bar, startTick, timeSignature });
+    }
+}
+
+
+uint64_t MeterMap::getTickOfBar (uint32_t bar) const noexcept
+{
+    const auto& segment = findSegmentOfBar (bar);
+    return segment.startTick + (uint64_t) (bar - segment.startBar) * segment.timeSignature.getTicksPerBar();
+}
+
+
+uint64_t MeterMap::toTicks (const MusicalTime& time) const noexcept
+{
+    const auto& timeSignature = findSegmentOfBar (time.bar).timeSignature;
+    return getTickOfBar (time.bar) + (uint64_t) time.beat * timeSignature.getTicksPerDenominator() + time.tick;
+}
+
+
+MusicalTime MeterMap::toMusicalTime (uint64_t tick) const noexcept
+{
+    const auto& segment = findSegmentOfTick (tick);
+    const auto ticksPerBar = (uint64_t) segment.timeSignature.getTicksPerBar();
+    const auto ticksPerBeat = (uint64_t) segment.timeSignature.getTicksPerDenominator();
+
+    const auto ticksIntoSegment = tick - segment.startTick;
+    const auto ticksIntoBar = ticksIntoSegment % ticksPerBar;
+
+    return MusicalTime { segment.startBar + (uint32_t) (ticksIntoSegment / ticksPerBar),
+                         (uint32_t) (ticksIntoBar / ticksPerBeat),
+                         (uint32_t) (ticksIntoBar % ticksPerBeat) };
+}
+
+
+const TimeSignature& MeterMap::getTimeSignatureAtBar (uint32_t bar) const noexcept
+{
+    return findSegmentOfBar (bar).timeSignature;
+}
+
+
+const TimeSignature& MeterMap::getTimeSignatureAtTick (uint64_t tick) const noexcept
+{
+    return findSegmentOfTick (tick).timeSignature;
+}
+
+
+uint32_t MeterMap::getTicksPerQuarterNote() const noexcept
+{
+    return ticksPerQuarterNote;
+}
+
+
+const std::vector<MeterMap::MeterChange>& MeterMap::getMeterChanges() const noexcept
+{
+    return meterChanges;
+}
+
+
+const MeterMap::Segment& MeterMap::findSegmentOfBar (uint32_t bar) const noexcept
+{
+    auto it = std::upper_bound (segments.begin(), segments.end(), bar, [] (uint32_t b, const Segment& s) {
+        return b < s.startBar;
+    });
+
+    return *std::prev (it);
+}
+
+
+const MeterMap::Segment& MeterMap::findSegmentOfTick (uint64_t tick) const noexcept
+{
+    auto it = std::upper_bound (segments.begin(), segments.end(), tick, [] (uint64_t t, const Segment& s) {
+        return t < s.startTick;
+    });
+
+    return *std::prev (it);
+}
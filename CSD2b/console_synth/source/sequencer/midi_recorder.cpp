@@ -0,0 +1,120 @@
+// Written by Wouter Ensink
+
+#include <console_synth/sequencer/melody.h>
+#include <console_synth/sequencer/midi_recorder.h>
+
+
+MidiRecorder::MidiRecorder (juce::ValueTree state) : melodyState { std::move (state) }
+{
+    jassert (melodyState.hasType (IDs::melody));
+}
+
+
+void MidiRecorder::recordBlock (const juce::MidiBuffer& midi, const PlayHead& playHead) noexcept
+{
+    for (auto&& metadata : midi)
+    {
+        if (metadata.numBytes < 3)
+            continue;
+
+        const auto status = metadata.data[0] & 0xf0;
+        const auto noteNumber = (uint8_t) (metadata.data[1] & 0x7f);
+        const auto velocity = (uint8_t) (metadata.data[2] & 0x7f);
+
+        // a note on without velocity is a note off
+        const auto isNoteOn = status == 0x90 && velocity > 0;
+        const auto isNoteOff = status == 0x80 || (status == 0x90 && velocity == 0);
+
+        if (! (isNoteOn || isNoteOff))
+            continue;
+
+        push (playHead, playHead.getTickAtSample (metadata.samplePosition), noteNumber, velocity, isNoteOn);
+    }
+}
+
+
+void MidiRecorder::endHeldNotes (const PlayHead& playHead) noexcept
+{
+    if (heldNotes.none())
+        return;
+
+    const auto tick = playHead.getTickAtSample (0);
+
+    for (auto note = 0; note < (int) heldNotes.size(); ++note)
+        if (heldNotes.test ((size_t) note))
+            push (playHead, tick, (uint8_t) note, 0, false);
+}
+
+
+int MidiRecorder::commitRecordedNotes (juce::UndoManager* undoManager)
+{
+    auto numNotes = 0;
+    auto batch = std::optional<ScopedMelodyEditBatch> {};
+
+    while (auto* event = queue.peek())
+    {
+        auto& noteOn = pendingNoteOns[event->noteNumber];
+
+        // a note off ends the note, so does a second note on for the same note (which then starts a new one)
+        if (noteOn.has_value())
+        {
+            // the melody only updates its events once, when all notes that were taken out at once are in
+            if (! batch.has_value())
+                batch.emplace (melodyState);
+
+            melodyState.appendChild (createNote (*noteOn, *event), undoManager);
+            noteOn.reset();
+            ++numNotes;
+        }
+
+        if (event->isNoteOn)
+            noteOn = *event;
+
+        queue.pop();
+    }
+
+    return numNotes;
+}
+
+
+uint64_t MidiRecorder::getNumDropped() const noexcept
+{
+    return queue.getNumDropped() + numDroppedNoteOns.load (std::memory_order_relaxed);
+}
+
+
+void MidiRecorder::push (const PlayHead& playHead, double tick, uint8_t noteNumber, uint8_t velocity, bool isNoteOn) noexcept
+{
+    const auto loopEnd = (uint32_t) playHead.getLoopingEnd().value_or (0);
+
+    // A note off that doesn't fit is worse than a note on that doesn't fit, so a note on is only taken when there's still
+    // room for the note offs of all notes that are held after it (endHeldNotes() can then always end them)
+    const auto numHeldAfterNoteOn = heldNotes.count() + (heldNotes.test (noteNumber) ? 0 : 1);
+
+    if (isNoteOn && queue.getFreeSpace() < numHeldAfterNoteOn + 1)
+    {
+        numDroppedNoteOns.fetch_add (1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (queue.push ({ tick, loopEnd, noteNumber, velocity, isNoteOn }))
+        heldNotes.set (noteNumber, isNoteOn);
+}
+
+
+// a note that's released after the loop wrapped (or past the loop end) ends at the loop end
+juce::ValueTree MidiRecorder::createNote (const RecordedEvent& noteOn, const RecordedEvent& noteOff)
+{
+    const auto start = (int) std::floor (noteOn.tick);
+    auto end = (int) std::floor (noteOff.tick);
+
+    if (noteOn.loopEnd > 0 && (end < start || end > (int) noteOn.loopEnd))
+        end = (int) noteOn.loopEnd;
+
+    auto note = juce::ValueTree { IDs::note };
+    note.setProperty (IDs::midiNoteNumber, (int) noteOn.noteNumber, nullptr);
+    note.setProperty (IDs::startTimeTicks, start, nullptr);
+    note.setProperty (IDs::lengthTicks, std::max (end - start, 1), nullptr);
+    note.setProperty (IDs::velocity, (int) noteOn.velocity, nullptr);
+    return note;
+}
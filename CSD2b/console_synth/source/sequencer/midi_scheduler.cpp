@@ -0,0 +1,223 @@
+// Written by Wouter Ensink
+
+#include <console_synth/sequencer/midi_scheduler.h>
+#include <cstring>
+
+
+MidiScheduler::MidiScheduler (const TrackList& tracks, const PatternList& patterns, const AtomicSnapshot<VersionedTempoMap>& tempoMap)
+    : juce::Thread { "midi scheduler" }, tracks { tracks }, patterns { patterns }, tempoMap { tempoMap }
+{
+    scratchBuffer.ensureSize (Track::maxNumScheduledEventsPerBlock * 8);
+    startThread();
+}
+
+
+MidiScheduler::~MidiScheduler()
+{
+    stopThread (1000);
+}
+
+
+void MidiScheduler::setLookaheadBlocks (int numBlocks)
+{
+    lookaheadBlocks.store (std::clamp (numBlocks, 0, maxLookaheadBlocks));
+}
+
+
+int MidiScheduler::getLookaheadBlocks() const noexcept
+{
+    return lookaheadBlocks.load();
+}
+
+
+void MidiScheduler::setSuspended (bool shouldBeSuspended) noexcept
+{
+    suspended.store (shouldBeSuspended);
+}
+
+
+bool MidiScheduler::isSuspended() const noexcept
+{
+    return suspended.load();
+}
+
+
+bool MidiScheduler::beginBlock (const PlayHead& playHead)
+{
+    currentBlock = ScheduledBlock::fromPlayHead (playHead, generation, playHead.getSamplePosition());
+
+    // what was scheduled before the suspension is thrown away, and a new generation makes the scheduler start over when resumed
+    if (suspended.load())
+    {
+        while (scheduledBlocks.peek() != nullptr)
+            scheduledBlocks.pop();
+
+        currentBlock.generation = ++generation;
+        writeTransport ({ currentBlock, playHead.getSampleRate(), playHead.isLooping() ? 1u : 0u });
+        return false;
+    }
+
+    auto isScheduled = false;
+
+    // the blocks before this one were never played (the play head moved or the audio thread was stopped), so they're skipped
+    while (auto* block = scheduledBlocks.peek())
+    {
+        if (block->generation != generation || block->samplePosition < currentBlock.samplePosition)
+        {
+            scheduledBlocks.pop();
+            continue;
+        }
+
+        isScheduled = block->isSameBlockAs (currentBlock);
+
+        // when the scheduler is somewhere else (or the state changed since it scheduled this block), it has to start over
+        if (! isScheduled)
+        {
+            currentBlock.generation = ++generation;
+            break;
+        }
+
+        scheduledBlocks.pop();
+        break;
+    }
+
+    writeTransport ({ currentBlock, playHead.getSampleRate(), playHead.isLooping() ? 1u : 0u });
+    return isScheduled;
+}
+
+
+const ScheduledBlock& MidiScheduler::getCurrentBlock() const noexcept
+{
+    return currentBlock;
+}
+
+
+void MidiScheduler::run()
+{
+    while (! threadShouldExit())
+    {
+        if (auto transport = readTransport(); transport.has_value() && lookaheadBlocks.load() > 0 && ! suspended.load())
+            scheduleAhead (*transport);
+
+        // a short wait, so it keeps up with small blocks, without waking up the scheduler from the audio thread
+        wait (1);
+    }
+}
+
+
+void MidiScheduler::scheduleAhead (const Transport& transport)
+{
+    auto currentTempoMap = tempoMap.read();
+
+    // the audio thread picks up a new tempo map at the start of a block, until then the blocks can't be scheduled
+    if (currentTempoMap->version != transport.block.tempoMapVersion)
+        return;
+
+    auto currentTracks = tracks.read();
+
+    if (! isInSync
+        || transport.block.generation != schedulerGeneration
+        || transport.block.samplePosition >= nextSamplePosition
+        || transport.block.blockSize != playHead.getBlockSizeSamples())
+    {
+        startFrom (transport, *currentTempoMap);
+
+        // the notes the tracks hold were played in blocks that are thrown away (or already stopped by the audio thread)
+        for (auto& track : *currentTracks)
+            track->restartScheduling();
+    }
+
+    // the map is the same one (same version), but the play head only holds on to it while it's being read
+    playHead.setTempoMap (&currentTempoMap->map, currentTempoMap->version);
+
+    const auto blockSize = (uint64_t) transport.block.blockSize;
+    const auto lastSamplePosition = transport.block.samplePosition + (uint64_t) lookaheadBlocks.load() * blockSize;
+
+    auto currentPatterns = patterns.read();
+
+    while (nextSamplePosition <= lastSamplePosition && canScheduleBlock (*currentTracks))
+    {
+        auto block = ScheduledBlock::fromPlayHead (playHead, schedulerGeneration, nextSamplePosition);
+
+        for (auto& track : *currentTracks)
+            track->scheduleBlock (playHead, *currentPatterns, block, scratchBuffer);
+
+        // only after the midi of all tracks is in their queues, so the audio thread never sees half a block
+        scheduledBlocks.push (block);
+
+        playHead.advanceDeviceBuffer();
+        nextSamplePosition += blockSize;
+    }
+}
+
+
+void MidiScheduler::startFrom (const Transport& transport, const VersionedTempoMap& currentTempoMap)
+{
+    playHead = PlayHead {};
+    playHead.setSampleRate (transport.sampleRate);
+    playHead.setBlockSizeSamples (transport.block.blockSize);
+    playHead.setTempoMap (&currentTempoMap.map, currentTempoMap.version);
+
+    if (transport.isLooping != 0)
+        playHead.setLooping (transport.block.loopStart, transport.block.loopEnd);
+
+    playHead.setTimelinePositionSubSamples (transport.block.timelinePosition);
+
+    // the audio thread is already rendering the block of the transport, so it starts with the one after that
+    playHead.advanceDeviceBuffer();
+    nextSamplePosition = transport.block.samplePosition + (uint64_t) transport.block.blockSize;
+    schedulerGeneration = transport.block.generation;
+    isInSync = true;
+}
+
+
+bool MidiScheduler::canScheduleBlock (const TrackList::Tracks& currentTracks) const noexcept
+{
+    if (scheduledBlocks.getFreeSpace() == 0)
+        return false;
+
+    return std::all_of (currentTracks.begin(), currentTracks.end(), [] (auto& track) { return track->canScheduleBlock(); });
+}
+
+
+void MidiScheduler::writeTransport (const Transport& transport) noexcept
+{
+    auto words = std::array<uint64_t, numTransportWords> {};
+    std::memcpy (words.data(), &transport, sizeof (Transport));
+
+    const auto sequence = transportSequence.load (std::memory_order_relaxed);
+    transportSequence.store (sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence (std::memory_order_release);
+
+    for (size_t i = 0; i < numTransportWords; ++i)
+        transportWords[i].store (words[i], std::memory_order_relaxed);
+
+    transportSequence.store (sequence + 2, std::memory_order_release);
+}
+
+
+std::optional<MidiScheduler::Transport> MidiScheduler::readTransport() const noexcept
+{
+    auto words = std::array<uint64_t, numTransportWords> {};
+
+    for (;;)
+    {
+        const auto sequenceBefore = transportSequence.load (std::memory_order_acquire);
+
+        // nothing was written yet
+        if (sequenceBefore == 0)
+            return std::nullopt;
+
+        for (size_t i = 0; i < numTransportWords; ++i)
+            words[i] = transportWords[i].load (std::memory_order_relaxed);
+
+        std::atomic_thread_fence (std::memory_order_acquire);
+
+        if (sequenceBefore % 2 == 0 && transportSequence.load (std::memory_order_relaxed) == sequenceBefore)
+            break;
+    }
+
+    auto transport = Transport {};
+    std::memcpy (&transport, words.data(), sizeof (Transport));
+    return transport;
+}
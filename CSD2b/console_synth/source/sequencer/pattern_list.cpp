@@ -0,0 +1,89 @@
+// Written by Wouter Ensink
+
+#include <console_synth/sequencer/pattern_list.h>
+
+
+PatternList::PatternList (juce::ValueTree state) : patternsState { std::move (state) }
+{
+    patternsState.addListener (this);
+    rebuildPatterns();
+}
+
+
+PatternList::~PatternList()
+{
+    patternsState.removeListener (this);
+}
+
+
+AtomicSnapshot<PatternList::Patterns>::ReadScope PatternList::read() const noexcept
+{
+    return patterns.read();
+}
+
+
+void PatternList::collectGarbage()
+{
+    patterns.collectGarbage();
+
+    for (auto& pattern : patterns.getLatestForWriter())
+        pattern->melody.collectGarbage();
+}
+
+
+const Pattern* PatternList::findPattern (const Patterns& patterns, int id) noexcept
+{
+    auto it = std::lower_bound (patterns.begin(), patterns.end(), id, [] (const auto& pattern, int i) {
+        return pattern->id < i;
+    });
+
+    if (it == patterns.end() || (*it)->id != id)
+        return nullptr;
+
+    return it->get();
+}
+
+
+void PatternList::rebuildPatterns()
+{
+    auto newPatterns = std::make_unique<Patterns>();
+
+    for (auto&& child : patternsState)
+        if (child.hasType (IDs::pattern))
+            newPatterns->push_back (findOrCreatePattern (child));
+
+    std::stable_sort (newPatterns->begin(), newPatterns->end(), [] (auto& a, auto& b) { return a->id < b->id; });
+    patterns.publish (std::move (newPatterns));
+}
+
+
+// a pattern whose id changed is created again, since the id of a pattern never changes
+std::shared_ptr<const Pattern> PatternList::findOrCreatePattern (const juce::ValueTree& patternState) const
+{
+    for (auto& pattern : patterns.getLatestForWriter())
+        if (pattern->state == patternState && pattern->id == (int) patternState.getProperty (IDs::id))
+            return pattern;
+
+    return std::make_shared<const Pattern> (patternState);
+}
+
+
+void PatternList::valueTreeChildAdded (juce::ValueTree& parent, juce::ValueTree& child)
+{
+    if (parent == patternsState && child.hasType (IDs::pattern))
+        rebuildPatterns();
+}
+
+
+void PatternList::valueTreeChildRemoved (juce::ValueTree& parent, juce::ValueTree& child, int)
+{
+    if (parent == patternsState && child.hasType (IDs::pattern))
+        rebuildPatterns();
+}
+
+
+void PatternList::valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier& property)
+{
+    if (tree.getParent() == patternsState && property == IDs::id)
+        rebuildPatterns();
+}
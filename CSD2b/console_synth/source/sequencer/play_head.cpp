@@ -2,44 +2,76 @@
 // Written by Wouter Ensink
 
 #include <console_synth/sequencer/play_head.h>
+#include <cmath>
 
 
 void PlayHead::setTickTimeMs (double tickTime)
 {
     tickTimeMs = tickTime;
     timeSinceLastTickMs = tickTime;
+
+    // like above, the next tick will be at the start of the next block
+    if (isSampleAccurate() && tickTime > 0.0)
+    {
+        constantTempoMap.emplace (60'000.0 / tickTime, sampleRate, 1);
+        tickPosition = (double) currentTick;
+        setCurrentTempoMap (&*constantTempoMap);
+    }
 }
 
 void PlayHead::setDeviceCallbackDurationMs (double duration)
 {
     blockDurationMs = duration;
+
+    if (isSampleAccurate())
+        blockSizeSamples = (int) std::round (duration * sampleRate / 1000.0);
 }
 
 void PlayHead::setPositionInTicks (uint64_t position)
 {
     currentTick = position;
+
+    if (isSampleAccurate() && tempoMap != nullptr)
+        setTimelinePosition (tempoMap->getPositionOfTick (position));
 }
 
 void PlayHead::setTimeSinceLastTickMs (double time)
 {
     timeSinceLastTickMs = time;
+
+    if (isSampleAccurate() && tempoMap != nullptr)
+    {
+        auto nextTickPosition = tempoMap->getPositionOfTick (currentTick);
+        auto tickLength = nextTickPosition - tempoMap->getPositionOfTick (currentTick > 0 ? currentTick - 1 : 0);
+        auto timeUntilNextTick = tickLength - std::min (msToSubSamples (time), tickLength);
+        setTimelinePosition (nextTickPosition - timeUntilNextTick);
+    }
 }
 
 
 [[nodiscard]] double PlayHead::getTimeSinceLastTickMs() const
 {
+    if (isSampleAccurate() && tempoMap != nullptr)
+    {
+        auto nextTickPosition = tempoMap->getPositionOfTick (currentTick);
+        auto tickLength = nextTickPosition - tempoMap->getPositionOfTick (currentTick > 0 ? currentTick - 1 : 0);
+        return subSamplesToMs (tickLength) - subSamplesToMs (nextTickPosition - timelinePosition);
+    }
+
     return timeSinceLastTickMs;
 }
 
 
 void PlayHead::setLooping (uint64_t start, uint64_t end)
 {
+    // an empty loop has no time to play, the play head would keep wrapping around without ever getting anywhere
+    if (end <= start)
+        return;
+
     loopingRangeTicks = { start, end };
 
     if (! (*loopingRangeTicks).contains (currentTick))
-    {
-        currentTick = start;
-    }
+        setPositionInTicks (start);
 }
 
 
@@ -73,6 +105,10 @@ void PlayHead::setLooping (uint64_t start, uint64_t end)
 
 [[nodiscard]] double PlayHead::getTickTimeMs() const
 {
+    // with a tempo map, it's the length of a tick at the current position
+    if (isSampleAccurate() && tempoMap != nullptr)
+        return 60'000.0 / (tempoMap->getTempoAtTick (tickPosition) * tempoMap->getTicksPerQuarterNote());
+
     return tickTimeMs;
 }
 
@@ -85,6 +121,13 @@ void PlayHead::setLooping (uint64_t start, uint64_t end)
 
 void PlayHead::advanceDeviceBuffer()
 {
+    if (isSampleAccurate())
+    {
+        setTimelinePosition (forEachStretchOfBlock ([] (uint64_t, uint64_t, uint64_t) {}));
+        samplePosition += (uint64_t) blockSizeSamples;
+        return;
+    }
+
     auto timePoint = tickTimeMs - timeSinceLastTickMs;
     auto tick = currentTick;
 
@@ -107,4 +150,169 @@ void PlayHead::advanceDeviceBuffer()
         if (tick >= loopingRangeTicks->getEnd())
             tick = loopingRangeTicks->getStart();
     return tick;
-}
\ No newline at end of file
+}
+
+uint64_t PlayHead::getTickAfter (uint64_t tick, uint64_t numTicks) const
+{
+    if (numTicks == 0)
+        return tick;
+
+    if (! isLooping())
+        return tick + numTicks;
+
+    const auto loopStart = loopingRangeTicks->getStart();
+    const auto loopEnd = loopingRangeTicks->getEnd();
+
+    // a tick outside of the loop first moves on like normal (which wraps around to the loop start after the loop end)
+    if (tick >= loopEnd)
+    {
+        tick = loopStart;
+        --numTicks;
+    }
+
+    if (tick + numTicks < loopEnd)
+        return tick + numTicks;
+
+    // every time the loop end is reached, it starts at the loop start again
+    numTicks -= loopEnd - tick;
+    return loopStart + numTicks % (loopEnd - loopStart);
+}
+
+
+// ===================================================================================================
+
+void PlayHead::setSampleRate (double rate)
+{
+    jassert (rate > 0.0);
+
+    sampleRate = rate;
+    samplePosition = 0;
+    tempoMap = nullptr;
+    setTickTimeMs (tickTimeMs);
+    setDeviceCallbackDurationMs (blockDurationMs);
+}
+
+bool PlayHead::isSampleAccurate() const
+{
+    return sampleRate > 0.0;
+}
+
+double PlayHead::getSampleRate() const
+{
+    return sampleRate;
+}
+
+void PlayHead::setBlockSizeSamples (int numSamples)
+{
+    jassert (isSampleAccurate());
+
+    blockSizeSamples = numSamples;
+    blockDurationMs = numSamples * 1000.0 / sampleRate;
+}
+
+int PlayHead::getBlockSizeSamples() const
+{
+    return blockSizeSamples;
+}
+
+void PlayHead::setTempoMap (const TempoMap* map, uint64_t version)
+{
+    jassert (isSampleAccurate() && map != nullptr);
+
+    if (map == tempoMap && version == tempoMapVersion)
+        return;
+
+    tempoMapVersion = version;
+    setCurrentTempoMap (map);
+}
+
+const TempoMap& PlayHead::getTempoMap() const
+{
+    jassert (tempoMap != nullptr);
+    return *tempoMap;
+}
+
+uint64_t PlayHead::getTempoMapVersion() const
+{
+    return tempoMapVersion;
+}
+
+double PlayHead::getTempoBpm() const
+{
+    if (tempoMap == nullptr)
+        return 0.0;
+
+    return tempoMap->getTempoAtTick (tickPosition);
+}
+
+uint64_t PlayHead::getSamplePosition() const
+{
+    return samplePosition;
+}
+
+uint64_t PlayHead::getTimelinePositionSubSamples() const
+{
+    return timelinePosition;
+}
+
+void PlayHead::setTimelinePositionSubSamples (uint64_t position)
+{
+    jassert (isSampleAccurate() && tempoMap != nullptr);
+    setTimelinePosition (position);
+}
+
+uint64_t PlayHead::getNumTicksInBlock() const
+{
+    auto numTicks = uint64_t { 0 };
+
+    forEachStretchOfBlock ([&numTicks] (uint64_t startTick, uint64_t endTick, uint64_t) {
+        if (endTick > startTick)
+            numTicks += endTick - startTick;
+    });
+
+    return numTicks;
+}
+
+double PlayHead::getTickAtSample (int sample) const
+{
+    if (tempoMap == nullptr)
+        return (double) currentTick;
+
+    const auto offset = (uint64_t) sample << subSampleBits;
+    const auto loopEndPosition = isLooping() ? tempoMap->getPositionOfTick (loopingRangeTicks->getEnd()) : ~uint64_t { 0 };
+    auto tick = std::optional<double> {};
+
+    // the stretches come in order, the sample is in the first one that doesn't end before it
+    forEachStretchOfBlock ([&] (uint64_t, uint64_t, uint64_t origin) {
+        const auto position = origin + offset;
+
+        if (! tick.has_value() && position < loopEndPosition)
+            tick = tempoMap->getTickAtPosition (position);
+    });
+
+    return tick.value_or ((double) currentTick);
+}
+
+void PlayHead::setTimelinePosition (uint64_t position)
+{
+    timelinePosition = position;
+    currentTick = tempoMap->getFirstTickAtOrAfter (position);
+    tickPosition = tempoMap->getTickAtPosition (position);
+}
+
+// the new map can put the ticks at completely different positions, so it continues from the same tick, not the same time
+void PlayHead::setCurrentTempoMap (const TempoMap* map)
+{
+    tempoMap = map;
+    setTimelinePosition (tempoMap->getPositionOfTick (tickPosition));
+}
+
+uint64_t PlayHead::msToSubSamples (double ms) const
+{
+    return (uint64_t) std::llround (ms / 1000.0 * sampleRate * (double) subSamplesPerSample);
+}
+
+double PlayHead::subSamplesToMs (uint64_t subSamples) const
+{
+    return (double) subSamples / (double) subSamplesPerSample / sampleRate * 1000.0;
+}
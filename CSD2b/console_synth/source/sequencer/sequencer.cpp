@@ -1,55 +1,130 @@
 
 // Written by Wouter Ensink
 
+#include <console_synth/audio/delay_effects.h>
+#include <console_synth/audio/reverb.h>
 #include <console_synth/sequencer/sequencer.h>
 
 
 Sequencer::Sequencer (juce::ValueTree& parent)
 {
-    playHead.setLooping (0, timeSignature.getTicksPerBar() + 1);
-    setTempoBpm (tempoBpm.getValue());
     parent.appendChild (sequencerState, nullptr);
+    sequencerState.appendChild (tempoMapState, nullptr);
+    sequencerState.appendChild (meterMapState, nullptr);
+    sequencerState.appendChild (patternsState, nullptr);
 
-    tempoBpm.onChange = [this] (auto newTempo) { setTempoBpm (newTempo); };
-    midiMessageCollector.ensureStorageAllocated (256);
+    updateLoopRange();
+    playHead.setLooping (0, loopEndTick.load());
+
+    tempoBpm.onChange = [this] (auto) { rebuildTempoMap(); };
+    loopLengthBars.onChange = [this] (auto) { updateLoopRange(); };
+    lookaheadBlocks.onChange = [this] (auto numBlocks) { midiScheduler.setLookaheadBlocks (numBlocks); };
+    midiScheduler.setLookaheadBlocks (lookaheadBlocks.getValue());
+    midiLatencyBlocks.onChange = [this] (auto numBlocks) { midiInputs.setLatencyBlocks (numBlocks); };
+    midiInputs.setLatencyBlocks (midiLatencyBlocks.getValue());
+    masterDriveDecibels.onChange = [this] (auto decibels) { masterDrive.store ((float) decibels); };
+    masterDrive.store ((float) masterDriveDecibels.getValue());
+    tempoMapState.addListener (this);
+    meterMapState.addListener (this);
+
+    addReverbBus();
+    addDelayBus();
+    addChorusBus();
+    addFlangerBus();
+    addTrack();
 }
 
 
 void Sequencer::prepareToPlay (int samplesPerBlockExpected, double newSampleRate)
 {
     setSampleRate (newSampleRate);
-    track.prepareToPlay (sampleRate, samplesPerBlockExpected);
-    midiMessageCollector.reset (sampleRate);
+    tracks.prepareToPlay (sampleRate, samplesPerBlockExpected);
+
+    for (auto& bus : busses)
+        bus->prepareToPlay (sampleRate, samplesPerBlockExpected);
+
+    masterSaturator.prepareToPlay (sampleRate, samplesPerBlockExpected);
+    masterLimiter.prepareToPlay (sampleRate, samplesPerBlockExpected);
+
+    midiInputs.prepareToPlay (sampleRate, samplesPerBlockExpected);
 }
 
 
 void Sequencer::getNextAudioBlock (const juce::AudioSourceChannelInfo& bufferToFill)
 {
-    // ensure the play head has the right callback duration set
+    // ensure the play head has the right callback duration set (the play head counts in samples, so this is exact)
     const auto callbackDurationMs = (double) (bufferToFill.numSamples / sampleRate) * 1000;
 
-    if (callbackDurationMs != playHead.getDeviceCallbackDurationMs())
-        playHead.setDeviceCallbackDurationMs (callbackDurationMs);
+    if (bufferToFill.numSamples != playHead.getBlockSizeSamples())
+        playHead.setBlockSizeSamples (bufferToFill.numSamples);
 
-    // clear the destination buffer for the external midi messages
     midiBuffer.clear();
 
-    // fetch the incoming midi messages from external midi
-    midiMessageCollector.removeNextBlockOfMessages (midiBuffer, bufferToFill.numSamples);
+    // fetch the incoming midi messages of all midi inputs, sorted into a buffer per track
+    midiInputs.processNextBlock (bufferToFill.numSamples, juce::Time::getMillisecondCounterHiRes() * 0.001);
+
+    // the tempo map stays alive until the play head is done with it at the end of the block
+    auto currentTempoMap = tempoMap.read();
+    playHead.setTempoMap (&currentTempoMap->map, currentTempoMap->version);
+
+    // the loop range is changed on the message thread, but the play head is only changed here
+    if (auto newLoopEnd = loopEndTick.load (std::memory_order_relaxed); playHead.getLoopingEnd() != newLoopEnd)
+        playHead.setLooping (0, newLoopEnd);
+
+    if (shouldRewind.exchange (false, std::memory_order_relaxed))
+        playHead.setPositionInTicks (0);
+
+    auto currentMeterMap = meterMap.read();
+    auto currentPatterns = patterns.read();
+
+    // the play head is where it will be for this block now, so it can be checked against the block the midi was scheduled for
+    auto isMidiScheduled = playState != PlayState::stopped && midiScheduler.beginBlock (playHead);
 
     // prepare the render context for the current render pass
     auto renderContext = RenderContext {
         *bufferToFill.buffer,
-        midiBuffer,
+        midiInputs,
         playHead,
         playState,
         sampleRate,
         { 0, callbackDurationMs },
-        timeSignature
+        *currentMeterMap,
+        *currentPatterns,
+        busses,
+        midiScheduler.getCurrentBlock(),
+        isMidiScheduled
+    };
+
+    for (auto& bus : busses)
+        bus->startNextBlock (bufferToFill.buffer->getNumChannels(), bufferToFill.numSamples);
+
+    // the tracks don't depend on each other, so they render at the same time, each into its own buffer...
+    auto currentTracks = tracks.read();
+
+    auto renderTrack = [&currentTracks, &renderContext] (int index) {
+        (*currentTracks)[(size_t) index]->renderNextBlock (renderContext, index);
     };
 
-    // render over all tracks...
-    track.renderNextBlock (renderContext);
+    renderPool.run ((int) currentTracks->size(), renderTrack);
+
+    // ...then they're added to the output and the busses one by one, always in the same order,
+    // so the result doesn't depend on which thread finished first
+    for (auto& track : *currentTracks)
+        track->addToMix (renderContext);
+
+    // the busses process what the tracks sent to them, once for all tracks together
+    for (auto& bus : busses)
+        bus->renderNextBlock (*bufferToFill.buffer);
+
+    // without drive the saturator is bypassed, it then only delays the mix by its latency,
+    // so the latency of the master bus stays the same
+    auto drive = masterDrive.load (std::memory_order_relaxed);
+    masterSaturator.getProcessor().setDriveDecibels (drive);
+    masterSaturator.setBypassed (drive <= 0.0f);
+    masterSaturator.processBlock (*bufferToFill.buffer, midiBuffer);
+
+    // protect the output from overs when a lot of voices stack up
+    masterLimiter.processBlock (*bufferToFill.buffer, midiBuffer);
 
     // move play head one block ahead to prepare for the next callback
     if (playState != PlayState::stopped)
@@ -59,29 +134,34 @@ void Sequencer::getNextAudioBlock (const juce::AudioSourceChannelInfo& bufferToF
 
 void Sequencer::releaseResources()
 {
-    track.releaseResources();
+    tracks.releaseResources();
+
+    for (auto& bus : busses)
+        bus->releaseResources();
+
+    masterSaturator.releaseResources();
+    masterLimiter.releaseResources();
 }
 
 
-bool Sequencer::openMidiInputDevice (const juce::String& name)
+bool Sequencer::openMidiInputDevice (const juce::String& name, int trackIndex)
 {
-    for (auto& d : juce::MidiInput::getAvailableDevices())
-    {
-        if (d.name.equalsIgnoreCase (name))
-        {
-            if (auto newInput = juce::MidiInput::openDevice (d.identifier, &midiMessageCollector))
-            {
-                if (currentMidiInput != nullptr)
-                    currentMidiInput->stop();
-
-                currentMidiInput = std::move (newInput);
-                currentMidiInput->start();
-                return true;
-            }
-        }
-    }
+    return midiInputs.openDevice (name) && midiInputs.setRoute (name, 0, trackIndex);
+}
+
+bool Sequencer::closeMidiInputDevice (const juce::String& name)
+{
+    return midiInputs.closeDevice (name);
+}
+
+bool Sequencer::routeMidiInput (const juce::String& name, int channel, int trackIndex)
+{
+    return midiInputs.setRoute (name, channel, trackIndex);
+}
 
-    return false;
+juce::StringArray Sequencer::getOpenMidiInputDevices() const
+{
+    return midiInputs.getOpenDeviceNames();
 }
 
 void Sequencer::stopPlayback()
@@ -99,19 +179,247 @@ void Sequencer::startPlayback()
     return playState == PlayState::playing;
 }
 
-const TimeSignature& Sequencer::getTimeSignature() const noexcept
+void Sequencer::startRecording()
+{
+    playState = PlayState::recording;
+}
+
+bool Sequencer::isRecording() const noexcept
 {
-    return timeSignature;
+    return playState == PlayState::recording;
 }
 
-void Sequencer::setTempoBpm (double bpm)
+void Sequencer::startExporting()
 {
-    auto ticksPerMinute = bpm * timeSignature.getTicksPerQuarterNote();
-    auto msPerTick = 60'000 / ticksPerMinute;
-    playHead.setTickTimeMs (msPerTick);
+    shouldRewind.store (true, std::memory_order_relaxed);
+    playState = PlayState::exporting;
+}
+
+bool Sequencer::isExporting() const noexcept
+{
+    return playState == PlayState::exporting;
+}
+
+void Sequencer::setMidiSchedulingSuspended (bool shouldBeSuspended) noexcept
+{
+    midiScheduler.setSuspended (shouldBeSuspended);
+}
+
+// the positions on the timeline are in sub samples, a part of a sample at the end is rendered as a whole one
+uint64_t Sequencer::getLengthOfBarsSamples (uint32_t numBars) const
+{
+    const auto& map = tempoMap.getLatestForWriter().map;
+    const auto position = map.getPositionOfTick (getMeterMap().getTickOfBar (numBars));
+    return (position + PlayHead::subSamplesPerSample - 1) >> PlayHead::subSampleBits;
+}
+
+// the play head wraps at the exact position of the loop end, so the loops add up without rounding
+uint64_t Sequencer::getLengthOfLoopsSamples (uint32_t numLoops) const
+{
+    const auto& map = tempoMap.getLatestForWriter().map;
+    const auto position = map.getPositionOfTick (loopEndTick.load (std::memory_order_relaxed)) * numLoops;
+    return (position + PlayHead::subSamplesPerSample - 1) >> PlayHead::subSampleBits;
+}
+
+int Sequencer::commitRecordedNotes (juce::UndoManager* undoManager)
+{
+    if (undoManager != nullptr)
+        undoManager->beginNewTransaction ("record");
+
+    auto numNotes = 0;
+    auto currentTracks = tracks.read();
+
+    for (auto& track : *currentTracks)
+        numNotes += track->commitRecordedNotes (undoManager);
+
+    return numNotes;
+}
+
+bool Sequencer::loadMidiFile (int trackIndex, const juce::File& file)
+{
+    auto currentTracks = tracks.read();
+
+    if (trackIndex < 0 || trackIndex >= (int) currentTracks->size())
+        return false;
+
+    // mapping and indexing the file happens here, the audio thread only gets the finished file
+    (*currentTracks)[(size_t) trackIndex]->loadMidiFile (std::make_unique<const MappedMidiFile> (file, ticksPerQuarterNote));
+    return true;
+}
+
+bool Sequencer::unloadMidiFile (int trackIndex)
+{
+    auto currentTracks = tracks.read();
+
+    if (trackIndex < 0 || trackIndex >= (int) currentTracks->size())
+        return false;
+
+    (*currentTracks)[(size_t) trackIndex]->loadMidiFile (std::make_unique<const MappedMidiFile>());
+    return true;
+}
+
+const MeterMap& Sequencer::getMeterMap() const noexcept
+{
+    return meterMap.getLatestForWriter();
+}
+
+const TempoMap& Sequencer::getTempoMap() const noexcept
+{
+    return tempoMap.getLatestForWriter().map;
+}
+
+void Sequencer::addTrack()
+{
+    sequencerState.appendChild (juce::ValueTree { IDs::track }, nullptr);
+}
+
+void Sequencer::collectGarbage()
+{
+    tracks.collectGarbage();
+    tempoMap.collectGarbage();
+    meterMap.collectGarbage();
+    patterns.collectGarbage();
+    midiInputs.collectGarbage();
+}
+
+int Sequencer::getLatencySamples() const noexcept
+{
+    return masterSaturator.getLatencySamples() + masterLimiter.getLatencySamples();
+}
+
+// the tempo property is the tempo at the start, every tempo change node adds a change at its tick.
+// a change with the ramp property moves linearly from the previous tempo towards it, instead of jumping to it
+void Sequencer::rebuildTempoMap()
+{
+    struct TempoChangeNode
+    {
+        uint64_t tick;
+        double bpm;
+        bool isRamp;
+    };
+
+    auto nodes = std::vector<TempoChangeNode> {};
+
+    for (auto&& node : tempoMapState)
+        if (node.hasType (IDs::tempoChange))
+            nodes.push_back ({ (uint64_t) (juce::int64) node.getProperty (IDs::tick),
+                               (double) node.getProperty (IDs::tempo),
+                               (bool) node.getProperty (IDs::ramp, false) });
+
+    std::stable_sort (nodes.begin(), nodes.end(), [] (auto& a, auto& b) { return a.tick < b.tick; });
+
+    auto changes = std::vector<TempoMap::TempoChange> { { 0, tempoBpm.getValue() } };
+
+    for (auto& node : nodes)
+    {
+        if (node.isRamp)
+            changes.back().curveToNext = TempoMap::Curve::ramp;
+
+        changes.push_back ({ node.tick, node.bpm });
+    }
+
+    auto rate = sampleRate > 0.0 ? sampleRate : 44'100.0;
+    auto version = tempoMap.getLatestForWriter().version + 1;
+    tempoMap.publish (std::make_unique<const VersionedTempoMap> (VersionedTempoMap {
+        TempoMap { std::move (changes), rate, ticksPerQuarterNote }, version }));
+}
+
+void Sequencer::rebuildMeterMap()
+{
+    auto changes = std::vector<MeterMap::MeterChange> {};
+
+    for (auto&& node : meterMapState)
+        if (node.hasType (IDs::meterChange))
+            changes.push_back ({ (uint32_t) (int) node.getProperty (IDs::bar),
+                                 (uint32_t) (int) node.getProperty (IDs::numerator),
+                                 (uint32_t) (int) node.getProperty (IDs::denominator) });
+
+    meterMap.publish (std::make_unique<const MeterMap> (std::move (changes), ticksPerQuarterNote));
+    updateLoopRange();
+}
+
+// the loop ends exactly at the end of the last bar, the tracks play the note offs of the notes that end there
+void Sequencer::updateLoopRange()
+{
+    auto numBars = (uint32_t) std::max (loopLengthBars.getValue(), 1);
+    loopEndTick.store (getMeterMap().getTickOfBar (numBars), std::memory_order_relaxed);
 }
 
 void Sequencer::setSampleRate (double rate)
 {
     sampleRate = rate;
-}
\ No newline at end of file
+
+    // from now on the play head keeps time in samples, the tempo map has to be built for this sample rate
+    playHead.setSampleRate (rate);
+    rebuildTempoMap();
+}
+
+void Sequencer::addReverbBus()
+{
+    // on a send bus the reverb should only output the wet signal, the dry signal is already in the mix
+    auto params = juce::Reverb::Parameters {};
+    params.wetLevel = 1.0f;
+    params.dryLevel = 0.0f;
+
+    auto bus = std::make_unique<Bus> (sequencerState, "reverb");
+    bus->addEffect (std::make_unique<Reverb> (params));
+    busses.push_back (std::move (bus));
+}
+
+void Sequencer::addDelayBus()
+{
+    auto params = TempoSyncedDelay::Parameters {};
+    params.wetLevel = 1.0f;
+    params.dryLevel = 0.0f;
+
+    auto bus = std::make_unique<Bus> (sequencerState, "delay");
+    bus->addEffect (std::make_unique<TempoSyncedDelay> (playHead, params));
+    busses.push_back (std::move (bus));
+}
+
+void Sequencer::addChorusBus()
+{
+    auto params = Chorus::defaultParameters;
+    params.wetLevel = 1.0f;
+    params.dryLevel = 0.0f;
+
+    auto bus = std::make_unique<Bus> (sequencerState, "chorus");
+    bus->addEffect (std::make_unique<Chorus> (playHead, params));
+    busses.push_back (std::move (bus));
+}
+
+void Sequencer::addFlangerBus()
+{
+    auto params = Flanger::defaultParameters;
+    params.wetLevel = 1.0f;
+    params.dryLevel = 0.0f;
+
+    auto bus = std::make_unique<Bus> (sequencerState, "flanger");
+    bus->addEffect (std::make_unique<Flanger> (playHead, params));
+    busses.push_back (std::move (bus));
+}
+
+// both the tempo map and the meter map state are listened to, this finds out which one changed
+void Sequencer::stateChanged (const juce::ValueTree& tree)
+{
+    if (tree == tempoMapState || tree.getParent() == tempoMapState)
+        rebuildTempoMap();
+
+    else if (tree == meterMapState || tree.getParent() == meterMapState)
+        rebuildMeterMap();
+}
+
+void Sequencer::valueTreeChildAdded (juce::ValueTree& parent, juce::ValueTree&)
+{
+    stateChanged (parent);
+}
+
+void Sequencer::valueTreeChildRemoved (juce::ValueTree& parent, juce::ValueTree&, int)
+{
+    stateChanged (parent);
+}
+
+void Sequencer::valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier&)
+{
+    stateChanged (tree);
+}
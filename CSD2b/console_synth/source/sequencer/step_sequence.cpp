@@ -0,0 +1,144 @@
+// Written by Wouter Ensink
+
+#include <console_synth/sequencer/step_sequence.h>
+
+
+// the values of an array property, repeated over all steps (or the default if there are none)
+static void fillSteps (std::array<uint8_t, StepPattern::maxNumSteps>& steps, const juce::var& values, int defaultValue)
+{
+    const auto* array = values.getArray();
+    const auto numValues = array != nullptr ? array->size() : 0;
+
+    for (auto step = 0; step < (int) steps.size(); ++step)
+    {
+        auto value = numValues > 0 ? (int) (*array)[step % numValues] : defaultValue;
+        steps[(size_t) step] = (uint8_t) juce::jlimit (0, 127, value);
+    }
+}
+
+
+StepPattern StepPattern::fromState (const juce::ValueTree& state)
+{
+    auto pattern = StepPattern {};
+
+    pattern.numSteps = juce::jlimit (1, maxNumSteps, (int) state.getProperty (IDs::numSteps, 16));
+    pattern.numHits = juce::jlimit (0, pattern.numSteps, (int) state.getProperty (IDs::numHits, 0));
+
+    // a negative rotation moves the hits earlier
+    pattern.rotation = (int) state.getProperty (IDs::rotation, 0) % pattern.numSteps;
+
+    if (pattern.rotation < 0)
+        pattern.rotation += pattern.numSteps;
+
+    // by default a step is a sixteenth note (at the 48 ticks per quarter note of the sequencer)
+    pattern.stepLengthTicks = (uint64_t) std::max (juce::int64 { 1 }, (juce::int64) state.getProperty (IDs::stepLengthTicks, 12));
+
+    // the note ends before the next step starts, so a note never overlaps itself
+    const auto gate = (juce::int64) state.getProperty (IDs::gateTicks, (juce::int64) pattern.stepLengthTicks / 2);
+    pattern.gateTicks = (uint64_t) juce::jlimit (juce::int64 { 1 }, (juce::int64) pattern.stepLengthTicks, gate);
+
+    fillSteps (pattern.notes, state.getProperty (IDs::notes), 60);
+    fillSteps (pattern.velocities, state.getProperty (IDs::velocities), 100);
+
+    return pattern;
+}
+
+
+// ===================================================================================================
+
+StepSequence::StepSequence (juce::ValueTree& trackState)
+    : stepSequenceState { trackState.getOrCreateChildWithName (IDs::stepSequence, nullptr) }
+{
+    stepSequenceState.addListener (this);
+    rebuildPattern();
+}
+
+
+StepSequence::~StepSequence()
+{
+    stepSequenceState.removeListener (this);
+}
+
+
+AtomicSnapshot<StepPattern>::ReadScope StepSequence::read() const noexcept
+{
+    return pattern.read();
+}
+
+
+void StepSequence::collectGarbage()
+{
+    pattern.collectGarbage();
+}
+
+
+void StepSequence::rebuildPattern()
+{
+    auto newPattern = StepPattern::fromState (stepSequenceState);
+    newPattern.version = pattern.getLatestForWriter().version + 1;
+    pattern.publish (std::make_unique<const StepPattern> (newPattern));
+}
+
+
+void StepSequence::valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier&)
+{
+    if (tree == stepSequenceState)
+        rebuildPattern();
+}
+
+
+// ===================================================================================================
+
+void StepSequenceMidiSource::fillNextMidiBuffer (const PlayHead& playHead, juce::MidiBuffer& buffer, int numSamples)
+{
+    if (stepSequence == nullptr)
+        return;
+
+    auto pattern = stepSequence->read();
+
+    forEachTickRange (playHead, [&] (const TickRange& range) {
+        if (patternVersion != pattern->version || nextTick != range.startTick)
+        {
+            stopSoundingNotes (buffer, range.getSampleOfTick (range.startTick, numSamples));
+            patternVersion = pattern->version;
+        }
+
+        playRange (*pattern, range, buffer, numSamples);
+        nextTick = range.endTick;
+    });
+}
+
+
+void StepSequenceMidiSource::playRange (const StepPattern& pattern, const TickRange& range, juce::MidiBuffer& buffer, int numSamples)
+{
+    // the hits that end in this range started a gate earlier, their notes stop before the new ones start
+    // (a hit that started before the first tick of the timeline never played)
+    const auto gateStart = range.startTick >= pattern.gateTicks ? range.startTick - pattern.gateTicks : 0;
+    const auto gateEnd = range.endTick >= pattern.gateTicks ? range.endTick - pattern.gateTicks : 0;
+
+    pattern.forEachHitInRange (gateStart, gateEnd, [&] (int step, uint64_t tick) {
+        const auto noteNumber = pattern.notes[(size_t) step];
+
+        if (soundingNotes.test (noteNumber))
+            buffer.addEvent (juce::MidiMessage::noteOff (1, noteNumber), range.getSampleOfTick (tick + pattern.gateTicks, numSamples));
+
+        soundingNotes.reset (noteNumber);
+    });
+
+    pattern.forEachHitInRange (range.startTick, range.endTick, [&] (int step, uint64_t tick) {
+        const auto noteNumber = pattern.notes[(size_t) step];
+        const auto samplePosition = range.getSampleOfTick (tick, numSamples);
+        buffer.addEvent (juce::MidiMessage::noteOn (1, noteNumber, pattern.velocities[(size_t) step]), samplePosition);
+        soundingNotes.set (noteNumber);
+    });
+}
+
+
+void StepSequenceMidiSource::stopSoundingNotes (juce::MidiBuffer& buffer, int samplePosition)
+{
+    for (auto i = 0; i < (int) soundingNotes.size(); ++i)
+        if (soundingNotes.test ((size_t) i))
+            buffer.addEvent (juce::MidiMessage::noteOff (1, i), samplePosition);
+
+    soundingNotes.reset();
+}
@@ -0,0 +1,195 @@
+// Written by Wouter Ensink
+
+#include <algorithm>
+#include <cmath>
+#include <console_synth/sequencer/tempo_map.h>
+
+
+TempoMap::TempoMap (double bpm, double sampleRate, uint32_t ticksPerQuarterNote)
+    : TempoMap { std::vector<TempoChange> { { 0, bpm } }, sampleRate, ticksPerQuarterNote }
+{
+}
+
+
+TempoMap::TempoMap (std::vector<TempoChange> changes, double sampleRate, uint32_t ticksPerQuarterNote)
+    : tempoChanges { std::move (changes) },
+      sampleRate { sampleRate },
+      ticksPerQuarterNote { ticksPerQuarterNote },
+      subSamplesPerTickAtOneBpm { sampleRate * 60.0 / ticksPerQuarterNote * (double) subSamplesPerSample }
+{
+    std::stable_sort (tempoChanges.begin(), tempoChanges.end(), [] (auto& a, auto& b) { return a.tick < b.tick; });
+
+    if (tempoChanges.empty())
+        tempoChanges.push_back ({ 0, 120.0 });
+
+    tempoChanges.front().tick = 0;
+
+    for (auto& change : tempoChanges)
+        change.bpm = std::max (change.bpm, minimumBpm);
+
+    auto position = uint64_t { 0 };
+
+    for (auto i = size_t { 0 }; i < tempoChanges.size(); ++i)
+    {
+        const auto& change = tempoChanges[i];
+        const auto isLast = i == tempoChanges.size() - 1;
+
+        auto segment = Segment {};
+        segment.startTick = change.tick;
+        segment.startPosition = position;
+        segment.startBpm = change.bpm;
+        segment.tickLength = (uint64_t) std::llround (subSamplesPerTickAtOneBpm / change.bpm);
+        segment.isRamp = change.curveToNext == Curve::ramp && ! isLast;
+        segment.bpmPerTick = 0.0;
+
+        if (isLast)
+        {
+            segments.push_back (segment);
+            break;
+        }
+
+        const auto& next = tempoChanges[i + 1];
+        const auto numTicks = next.tick - change.tick;
+
+        if (segment.isRamp && numTicks > 0)
+        {
+            segment.bpmPerTick = (next.bpm - change.bpm) / (double) numTicks;
+            position += (uint64_t) std::llround (getSubSamplesIntoSegment (segment, (double) numTicks));
+        }
+        else
+        {
+            segment.isRamp = false;
+            position += numTicks * segment.tickLength;
+        }
+
+        segments.push_back (segment);
+    }
+}
+
+
+uint64_t TempoMap::getPositionOfTick (uint64_t tick) const noexcept
+{
+    const auto& segment = findSegmentOfTick ((double) tick);
+
+    if (! segment.isRamp)
+        return segment.startPosition + (tick - segment.startTick) * segment.tickLength;
+
+    return segment.startPosition + (uint64_t) std::llround (getSubSamplesIntoSegment (segment, (double) (tick - segment.startTick)));
+}
+
+
+uint64_t TempoMap::getPositionOfTick (double tick) const noexcept
+{
+    tick = std::max (tick, 0.0);
+    const auto& segment = findSegmentOfTick (tick);
+    const auto ticksIntoSegment = tick - (double) segment.startTick;
+
+    if (! segment.isRamp)
+        return segment.startPosition + (uint64_t) std::llround (ticksIntoSegment * (double) segment.tickLength);
+
+    return segment.startPosition + (uint64_t) std::llround (getSubSamplesIntoSegment (segment, ticksIntoSegment));
+}
+
+
+double TempoMap::getTickAtPosition (uint64_t position) const noexcept
+{
+    const auto& segment = findSegmentAtPosition (position);
+    const auto subSamplesIntoSegment = position - segment.startPosition;
+
+    if (! segment.isRamp)
+        return (double) segment.startTick + (double) subSamplesIntoSegment / (double) segment.tickLength;
+
+    return (double) segment.startTick + getTicksIntoSegment (segment, (double) subSamplesIntoSegment);
+}
+
+
+uint64_t TempoMap::getFirstTickAtOrAfter (uint64_t position) const noexcept
+{
+    const auto& segment = findSegmentAtPosition (position);
+    const auto subSamplesIntoSegment = position - segment.startPosition;
+
+    if (! segment.isRamp)
+        return segment.startTick + (subSamplesIntoSegment + segment.tickLength - 1) / segment.tickLength;
+
+    // the closed form solution is rounded differently than the positions of the ticks,
+    // so it might be one tick off, which is corrected here
+    auto tick = segment.startTick + (uint64_t) std::ceil (getTicksIntoSegment (segment, (double) subSamplesIntoSegment));
+
+    while (tick > segment.startTick && getPositionOfTick (tick - 1) >= position)
+        --tick;
+
+    while (getPositionOfTick (tick) < position)
+        ++tick;
+
+    return tick;
+}
+
+
+double TempoMap::getTempoAtTick (double tick) const noexcept
+{
+    const auto& segment = findSegmentOfTick (tick);
+
+    if (! segment.isRamp)
+        return segment.startBpm;
+
+    return segment.startBpm + segment.bpmPerTick * (tick - (double) segment.startTick);
+}
+
+
+double TempoMap::getSampleRate() const noexcept
+{
+    return sampleRate;
+}
+
+
+uint32_t TempoMap::getTicksPerQuarterNote() const noexcept
+{
+    return ticksPerQuarterNote;
+}
+
+
+const std::vector<TempoMap::TempoChange>& TempoMap::getTempoChanges() const noexcept
+{
+    return tempoChanges;
+}
+
+
+const TempoMap::Segment& TempoMap::findSegmentOfTick (double tick) const noexcept
+{
+    auto it = std::upper_bound (segments.begin(), segments.end(), tick, [] (double t, const Segment& s) {
+        return t < (double) s.startTick;
+    });
+
+    return *std::prev (it);
+}
+
+
+const TempoMap::Segment& TempoMap::findSegmentAtPosition (uint64_t position) const noexcept
+{
+    auto it = std::upper_bound (segments.begin(), segments.end(), position, [] (uint64_t p, const Segment& s) {
+        return p < s.startPosition;
+    });
+
+    return *std::prev (it);
+}
+
+
+// the length of a tick is subSamplesPerTickAtOneBpm / bpm, with the tempo moving linearly: bpm = startBpm + bpmPerTick * x.
+// integrating that over x gives (subSamplesPerTickAtOneBpm / bpmPerTick) * ln (bpm / startBpm)
+double TempoMap::getSubSamplesIntoSegment (const Segment& segment, double ticksIntoSegment) const noexcept
+{
+    if (segment.bpmPerTick == 0.0)
+        return ticksIntoSegment * subSamplesPerTickAtOneBpm / segment.startBpm;
+
+    return subSamplesPerTickAtOneBpm / segment.bpmPerTick * std::log1p (segment.bpmPerTick * ticksIntoSegment / segment.startBpm);
+}
+
+
+// the inverse of getSubSamplesIntoSegment()
+double TempoMap::getTicksIntoSegment (const Segment& segment, double subSamplesIntoSegment) const noexcept
+{
+    if (segment.bpmPerTick == 0.0)
+        return subSamplesIntoSegment * segment.startBpm / subSamplesPerTickAtOneBpm;
+
+    return segment.startBpm * std::expm1 (subSamplesIntoSegment * segment.bpmPerTick / subSamplesPerTickAtOneBpm) / segment.bpmPerTick;
+}
@@ -63,6 +63,6 @@ bool TimeSignature::isValidDenominator (uint32_t toCheck) noexcept
 
 [[nodiscard]] uint32_t TimeSignature::getTicksPerDenominator() const
 {
-    auto numDenominatorsInQuarterNote = denominator / 4;
-    return ticksPerQuarterNote / numDenominatorsInQuarterNote;
+    // computed from a whole note, so a half note (denominator 2) works as well
+    return ticksPerQuarterNote * 4 / denominator;
 }
\ No newline at end of file
@@ -1,12 +1,14 @@
 
 // Written by Wouter Ensink
 
+#include <console_synth/midi/midi_event.h>
 #include <console_synth/sequencer/track.h>
+#include <algorithm>
 
 
-Track::Track (juce::ValueTree parent)
+Track::Track (juce::ValueTree state) : trackState { std::move (state) }
 {
-    parent.appendChild (trackState, nullptr);
+    jassert (trackState.hasType (IDs::track));
 
     synthType.onChange = [this] (auto newType) {
         if (newType == SynthType::fm && dynamic_cast<FmSynthesizer*> (synth.get()) == nullptr)
@@ -15,6 +17,9 @@ Track::Track (juce::ValueTree parent)
         else if (newType == SynthType::rm && dynamic_cast<RmSynthesizer*> (synth.get()) == nullptr)
             switchSynth<RmSynthesizer>();
     };
+
+    sendLevelsChanged();
+    sendLevelsState.onChange = [this] (auto) { sendLevelsChanged(); };
 }
 
 
@@ -24,27 +29,45 @@ void Track::prepareToPlay (double newSampleRate, int numSamplesPerBlockExpected)
 
     {
         auto synthLock = std::scoped_lock { synthMutex };
-        synth->prepareToPlay (sampleRate, numSamplesPerBlockExpected);
+        processorChain.prepareToPlay (sampleRate, numSamplesPerBlockExpected);
     }
-    // size is arbitrary, but it's probably enough as the midi buffer will never
-    // hold more than one buffer length worth of data.
-    midiScratchBuffer.ensureSize (256);
+    // the midi processors add notes to the buffer, so it has room for as many events as one of them can leave in it,
+    // that way they never make it allocate
+    reserveMidiEvents (midiScratchBuffer, MidiProcessor::maxNumOutputEventsPerBlock);
+
+    // the track renders into its own buffer first, so the effects only process this track
+    trackBuffer.setSize (2, numSamplesPerBlockExpected);
 }
 
 
-void Track::renderNextBlock (RenderContext& renderContext)
+void Track::renderNextBlock (const RenderContext& renderContext, int trackIndex)
 {
     midiScratchBuffer.clear();
+    hasRenderedAudio = false;
 
-    // if playback is not stopped, the midi buffer should be filled with the melody on this track
+    // if playback is not stopped, the midi buffer should be filled with the melody and arrangement on this track
     if (! renderContext.isStopped())
-        addInternalMidiToScratchBuffer (renderContext);
+        addSequencedMidiToScratchBuffer (renderContext);
 
     // if the track is record enabled and the engine is not exporting to audio:
     // merge external midi with track midi
     if (isRecordEnabled && ! renderContext.isExporting())
-        addExternalMidiToScratchBuffer (renderContext);
+        addExternalMidiToScratchBuffer (renderContext, trackIndex);
+
+    // while recording, the external midi also goes into the recorder (before the melody is merged in).
+    // when the recording stops, the notes that are still held end at the start of this block
+    if (isRecordEnabled && renderContext.isRecording())
+        recorder.recordBlock (renderContext.getExternalMidi (trackIndex), renderContext.getPlayHead());
+
+    else if (previousPlayState == PlayState::recording)
+        recorder.endHeldNotes (renderContext.getPlayHead());
 
+    // the midi processors change the sequenced and live midi together (the recorder got the live midi as it was played).
+    // when playback stops, they stop playing as well, since the sequenced notes they hold won't get a note off
+    if (previousPlayState != PlayState::stopped && renderContext.isStopped())
+        midiProcessors.reset (midiScratchBuffer, 0);
+
+    midiProcessors.processMidi (renderContext.getPlayHead(), ! renderContext.isStopped(), midiScratchBuffer, renderContext.getNumSamples());
 
     // keep track of the active midi notes, so we can send noteOff messages when playback stops
     updateActiveMidiNotes();
@@ -53,50 +76,310 @@ void Track::renderNextBlock (RenderContext& renderContext)
     // be active. To prevent them from endlessly playing, we send their corresponding
     // noteOff events
     if (previousPlayState != PlayState::stopped && renderContext.isStopped())
-        addMidiOffMessagesForActiveMidiNotes (0);
-
-    // when the play head reaches the end of a loop, it should fire note off events for all active midi notes
-    // to prevent them from going on forever
-    if (renderContext.getPlayHead().isLooping())
     {
-        forEachTick (renderContext.getPlayHead(), [this, &renderContext] (uint64_t tick, double timeRelativeToBuffer) {
-            if (tick == *renderContext.getPlayHead().getLoopingEnd() - 1)
-            {
-                auto sample = (int) (timeRelativeToBuffer / renderContext.getPlayHead().getDeviceCallbackDurationMs()) * renderContext.getNumSamples();
-                addMidiOffMessagesForActiveMidiNotes (sample);
-            }
-        });
+        addMidiOffMessagesForActiveMidiNotes (0);
+        sequencedNotes.reset();
     }
 
-    // render the next audio block with the synth, given all relevant midi data for this callback
+    // render the next audio block with the synth and its effects, given all relevant midi data for this callback.
+    // if there is no midi, no active voice and no effect tail left, the track would only render silence,
+    // so it is skipped entirely.
     {
         auto synthLock = std::scoped_lock { synthMutex };
-        synth->processBlock (renderContext.getAudioBuffer(), midiScratchBuffer);
+
+        if (! (midiScratchBuffer.isEmpty() && processorChain.isIdle()))
+            renderProcessorChain (renderContext);
     }
 
     previousPlayState = renderContext.getPlayState();
 }
 
 
+void Track::addToMix (RenderContext& renderContext)
+{
+    if (! hasRenderedAudio)
+        return;
+
+    auto& destination = renderContext.getAudioBuffer();
+    const auto numSamples = renderContext.getNumSamples();
+
+    for (auto channel = 0; channel < destination.getNumChannels(); ++channel)
+        juce::FloatVectorOperations::add (destination.getWritePointer (channel), trackBuffer.getReadPointer (channel), numSamples);
+
+    addToBusses (renderContext);
+}
+
+
 void Track::releaseResources()
 {
     auto synthLock = std::scoped_lock { synthMutex };
-    synth->releaseResources();
+    processorChain.releaseResources();
+}
+
+
+void Track::collectGarbage()
+{
+    melody.collectGarbage();
+    arrangement.collectGarbage();
+    midiFile.collectGarbage();
+    stepSequence.collectGarbage();
+    groove.collectGarbage();
+    midiProcessors.collectGarbage();
+}
+
+
+int Track::commitRecordedNotes (juce::UndoManager* undoManager)
+{
+    return recorder.commitRecordedNotes (undoManager);
+}
+
+
+uint64_t Track::getNumDroppedRecordedEvents() const noexcept
+{
+    return recorder.getNumDropped();
+}
+
+
+void Track::loadMidiFile (std::unique_ptr<const MappedMidiFile> file)
+{
+    midiFile.publish (std::move (file));
+}
+
+
+std::unique_ptr<SynthesizerBase> Track::createSynth (SynthType type, juce::ValueTree& state)
+{
+    if (type == SynthType::rm)
+        return std::make_unique<RmSynthesizer> (state);
+
+    return std::make_unique<FmSynthesizer> (state);
+}
+
+
+void Track::renderProcessorChain (const RenderContext& renderContext)
+{
+    // keeps the allocated memory if the buffer gets smaller, so this will only allocate
+    // if the device uses a bigger block size than the one the track was prepared with
+    trackBuffer.setSize (renderContext.getNumChannels(), renderContext.getNumSamples(), false, false, true);
+    trackBuffer.clear();
+
+    processorChain.processBlock (trackBuffer, midiScratchBuffer);
+    hasRenderedAudio = true;
+}
+
+
+void Track::addToBusses (RenderContext& renderContext)
+{
+    for (auto bus = 0; bus < renderContext.getNumBusses(); ++bus)
+    {
+        auto level = sendLevels[bus].load (std::memory_order_relaxed);
+
+        if (level > 0.0f)
+            renderContext.addToBus (bus, trackBuffer, level);
+    }
+}
+
+
+// the send levels are stored as an array in the value tree (one level per bus, in bus order),
+// but they're copied into atomics, so the audio thread never has to touch the juce::var
+void Track::sendLevelsChanged()
+{
+    auto levels = sendLevelsState.getValue();
+    auto numLevels = levels.isArray() ? levels.size() : 0;
+
+    for (auto bus = 0; bus < Bus::maxNumBusses; ++bus)
+        sendLevels[bus].store (bus < numLevels ? (float) levels[bus] : 0.0f, std::memory_order_relaxed);
+}
+
+
+void Track::scheduleBlock (const PlayHead& playHead,
+                           const PatternList::Patterns& patterns,
+                           const ScheduledBlock& block,
+                           juce::MidiBuffer& scratchBuffer)
+{
+    scratchBuffer.clear();
+    auto file = midiFile.read();
+    auto grooveSettings = groove.read();
+    generateSequencedMidi (schedulerMidiSources, playHead, patterns, *file, *grooveSettings, scratchBuffer, playHead.getBlockSizeSamples());
+
+    // the sources only make note ons and note offs, which always fit
+    auto numEvents = size_t { 0 };
+
+    for (auto&& metadata : scratchBuffer)
+        if (metadata.numBytes <= 3)
+            ++numEvents;
+
+    // canScheduleBlock() only made room for so many events. Half a block would lose note offs,
+    // so then the audio thread generates the whole block
+    if (numEvents > maxNumScheduledEventsPerBlock)
+    {
+        scheduledMidi.push (ScheduledMidiEvent::incompleteBlock (block.generation, block.samplePosition));
+        return;
+    }
+
+    for (auto&& metadata : scratchBuffer)
+    {
+        if (metadata.numBytes > 3)
+            continue;
+
+        auto event = ScheduledMidiEvent { block.generation, block.samplePosition, metadata.samplePosition, { 0, 0, 0 } };
+        std::copy (metadata.data, metadata.data + metadata.numBytes, event.data);
+        scheduledMidi.push (event);
+    }
+}
+
+
+bool Track::canScheduleBlock() const noexcept
+{
+    return scheduledMidi.getFreeSpace() >= maxNumScheduledEventsPerBlock;
+}
+
+
+void Track::restartScheduling() noexcept
+{
+    schedulerMidiSources.reset();
+}
+
+
+void Track::addSequencedMidiToScratchBuffer (const RenderContext& renderContext)
+{
+    // the queue is always drained, so it doesn't fill up with midi for blocks that have passed
+    const auto isScheduled = hasScheduledMidi (renderContext);
+
+    // the other set of sources won't play the note offs of the notes that are sounding, so they're stopped
+    // before anything else is played. The sources of the audio thread start over from what they play next
+    if (isScheduled != previousBlockWasScheduled)
+    {
+        for (auto note = 0; note < (int) sequencedNotes.size(); ++note)
+            if (sequencedNotes.test ((size_t) note))
+                midiScratchBuffer.addEvent (juce::MidiMessage::noteOff (1, note), 0);
+
+        sequencedNotes.reset();
+
+        if (! isScheduled)
+            audioThreadMidiSources.reset();
+
+        previousBlockWasScheduled = isScheduled;
+    }
+
+    takeScheduledMidi (renderContext, isScheduled);
+
+    if (! isScheduled)
+    {
+        auto file = midiFile.read();
+        auto grooveSettings = groove.read();
+        generateSequencedMidi (audioThreadMidiSources,
+                               renderContext.getPlayHead(),
+                               renderContext.getPatterns(),
+                               *file,
+                               *grooveSettings,
+                               midiScratchBuffer,
+                               renderContext.getNumSamples());
+    }
+
+    // only the sequenced midi is in the buffer yet
+    for (auto&& metadata : midiScratchBuffer)
+    {
+        auto message = metadata.getMessage();
+
+        if (message.isNoteOnOrOff())
+            sequencedNotes.set ((size_t) message.getNoteNumber(), message.isNoteOn());
+    }
 }
 
 
-void Track::addInternalMidiToScratchBuffer (const RenderContext& renderContext)
+bool Track::hasScheduledMidi (const RenderContext& renderContext)
 {
-    melodyPlayerMidiSource.fillNextMidiBuffer (renderContext.getPlayHead(),
-                                               midiScratchBuffer,
-                                               renderContext.getNumSamples());
+    const auto& block = renderContext.getCurrentBlock();
+
+    while (auto* event = scheduledMidi.peek())
+    {
+        auto isCurrentGeneration = event->generation == block.generation;
+
+        if (isCurrentGeneration && event->samplePosition >= block.samplePosition)
+            return renderContext.isMidiScheduled() && ! (event->samplePosition == block.samplePosition && event->isIncompleteBlock());
+
+        scheduledMidi.pop();
+    }
+
+    return renderContext.isMidiScheduled();
+}
+
+
+void Track::takeScheduledMidi (const RenderContext& renderContext, bool isScheduled)
+{
+    const auto& block = renderContext.getCurrentBlock();
+
+    while (auto* event = scheduledMidi.peek())
+    {
+        if (event->generation == block.generation && event->samplePosition > block.samplePosition)
+            return;
+
+        if (isScheduled && event->generation == block.generation && event->samplePosition == block.samplePosition)
+            midiScratchBuffer.addEvent (event->data, 3, event->sampleOffset);
+
+        scheduledMidi.pop();
+    }
+}
+
+
+void Track::generateSequencedMidi (SequencedMidiSources& sources,
+                                   const PlayHead& playHead,
+                                   const PatternList::Patterns& patterns,
+                                   const MappedMidiFile& file,
+                                   const GrooveSettings& grooveSettings,
+                                   juce::MidiBuffer& buffer,
+                                   int numSamples)
+{
+    jassert (buffer.isEmpty());
+
+    sources.melodyPlayer.fillNextMidiBuffer (playHead, buffer, numSamples);
+    sources.arrangementPlayer.setPatterns (&patterns);
+    sources.arrangementPlayer.fillNextMidiBuffer (playHead, buffer, numSamples);
+    sources.midiFilePlayer.setFile (&file);
+    sources.midiFilePlayer.fillNextMidiBuffer (playHead, buffer, numSamples);
+    sources.stepSequencePlayer.fillNextMidiBuffer (playHead, buffer, numSamples);
+    sources.transforms.process (grooveSettings, playHead, buffer, numSamples);
+
+    for (auto&& metadata : buffer)
+    {
+        auto message = metadata.getMessage();
+
+        if (message.isNoteOnOrOff())
+            sources.activeNotes.set ((size_t) message.getNoteNumber(), message.isNoteOn());
+    }
+
+    // when the play head reaches the end of a loop, it should fire note off events for all active midi notes
+    // to prevent them from going on forever
+    if (! playHead.isLooping())
+        return;
+
+    // the note offs are played on the last sample before the loop end, so the notes that end at the loop end
+    // (where the melody can't play their note offs) play for their full length, before the loop starts over.
+    // when the loop end is in the next block, that's the last sample of this block
+    auto loopEnd = *playHead.getLoopingEnd();
+    auto lastTickOfLoop = loopEnd - 1;
+
+    forEachTickRange (playHead, [&] (const TickRange& range) {
+        if (lastTickOfLoop < range.startTick || lastTickOfLoop >= range.endTick)
+            return;
+
+        auto samplePosition = std::clamp (range.getSampleOfTick (loopEnd, numSamples) - 1,
+                                          range.getSampleOfTick (lastTickOfLoop, numSamples),
+                                          numSamples - 1);
+
+        for (auto note = 0; note < (int) sources.activeNotes.size(); ++note)
+            if (sources.activeNotes.test ((size_t) note))
+                buffer.addEvent (juce::MidiMessage::noteOff (1, note), samplePosition);
+
+        sources.activeNotes.reset();
+    });
 }
 
 
-void Track::addExternalMidiToScratchBuffer (const RenderContext& renderContext)
+void Track::addExternalMidiToScratchBuffer (const RenderContext& renderContext, int trackIndex)
 {
-    // if the timing is off: experiment with last argument in this call (time offset external midi)
-    midiScratchBuffer.addEvents (renderContext.getExternalMidi(), 0, renderContext.getNumSamples(), 0);
+    // the midi inputs already placed their midi at the right samples (with a fixed latency), see MidiInputRouter
+    midiScratchBuffer.addEvents (renderContext.getExternalMidi (trackIndex), 0, renderContext.getNumSamples(), 0);
 }
 
 
@@ -0,0 +1,114 @@
+// Written by Wouter Ensink
+
+#include <console_synth/sequencer/track_list.h>
+
+
+TrackList::TrackList (juce::ValueTree state) : sequencerState { std::move (state) }
+{
+    sequencerState.addListener (this);
+    rebuildTracks();
+}
+
+
+TrackList::~TrackList()
+{
+    sequencerState.removeListener (this);
+}
+
+
+void TrackList::prepareToPlay (double newSampleRate, int numSamplesPerBlockExpected)
+{
+    sampleRate.store (newSampleRate);
+    blockSize.store (numSamplesPerBlockExpected);
+
+    auto currentTracks = tracks.read();
+
+    for (auto& track : *currentTracks)
+        track->prepareToPlay (newSampleRate, numSamplesPerBlockExpected);
+}
+
+
+void TrackList::releaseResources()
+{
+    auto currentTracks = tracks.read();
+
+    for (auto& track : *currentTracks)
+        track->releaseResources();
+}
+
+
+AtomicSnapshot<TrackList::Tracks>::ReadScope TrackList::read() const noexcept
+{
+    return tracks.read();
+}
+
+
+void TrackList::collectGarbage()
+{
+    tracks.collectGarbage();
+
+    for (auto& track : tracks.getLatestForWriter())
+        track->collectGarbage();
+}
+
+
+int TrackList::getNumTracks() const noexcept
+{
+    return (int) tracks.getLatestForWriter().size();
+}
+
+
+// builds a new list with a track for every track node, the tracks that already exist are kept as they are
+void TrackList::rebuildTracks()
+{
+    auto newTracks = std::make_unique<Tracks>();
+
+    for (auto&& child : sequencerState)
+        if (child.hasType (IDs::track))
+            newTracks->push_back (findOrCreateTrack (child));
+
+    tracks.publish (std::move (newTracks));
+}
+
+
+std::shared_ptr<Track> TrackList::findOrCreateTrack (const juce::ValueTree& trackState) const
+{
+    for (auto& track : tracks.getLatestForWriter())
+        if (track->getState() == trackState)
+            return track;
+
+    auto track = std::make_shared<Track> (trackState);
+
+    // a new track has to be ready to render before the audio thread can see it
+    if (auto rate = sampleRate.load(); rate > 0.0)
+        track->prepareToPlay (rate, blockSize.load());
+
+    return track;
+}
+
+
+bool TrackList::isTrackInSequencer (const juce::ValueTree& parent, const juce::ValueTree& child) const
+{
+    return parent == sequencerState && child.hasType (IDs::track);
+}
+
+
+void TrackList::valueTreeChildAdded (juce::ValueTree& parent, juce::ValueTree& child)
+{
+    if (isTrackInSequencer (parent, child))
+        rebuildTracks();
+}
+
+
+void TrackList::valueTreeChildRemoved (juce::ValueTree& parent, juce::ValueTree& child, int)
+{
+    if (isTrackInSequencer (parent, child))
+        rebuildTracks();
+}
+
+
+void TrackList::valueTreeChildOrderChanged (juce::ValueTree& parent, int, int)
+{
+    if (parent == sequencerState)
+        rebuildTracks();
+}
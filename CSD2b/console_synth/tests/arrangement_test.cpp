@@ -0,0 +1,236 @@
+// Written by Wouter Ensink
+
+#include <catch2/catch_all.hpp>
+#include <console_synth/midi/midi_source.h>
+#include <console_synth/sequencer/melody_generator.h>
+#include <console_synth/utility/interval_index.h>
+#include <random>
+
+
+TEST_CASE ("interval index finds the same intervals as checking all of them")
+{
+    auto rng = std::mt19937 { 42 };
+    auto startDistribution = std::uniform_int_distribution<uint64_t> { 0, 10'000 };
+    auto lengthDistribution = std::uniform_int_distribution<uint64_t> { 1, 500 };
+
+    for (auto numIntervals : { 0, 1, 2, 3, 7, 16, 17, 100, 1000 })
+    {
+        auto intervals = std::vector<IntervalIndex::Interval> {};
+
+        for (auto i = 0; i < numIntervals; ++i)
+        {
+            auto start = startDistribution (rng);
+            intervals.push_back ({ start, start + lengthDistribution (rng), (size_t) i });
+        }
+
+        auto index = IntervalIndex { intervals };
+
+        for (auto query = 0; query < 200; ++query)
+        {
+            auto start = startDistribution (rng);
+            auto end = start + lengthDistribution (rng);
+
+            auto found = std::vector<size_t> {};
+            index.forEachOverlap (start, end, [&] (size_t id) { found.push_back (id); });
+
+            auto expected = std::vector<size_t> {};
+
+            for (auto& interval : intervals)
+                if (interval.start < end && start < interval.end)
+                    expected.push_back (interval.id);
+
+            // found in the order of their starts, so compare them as sets
+            std::sort (found.begin(), found.end());
+            CHECK (found == expected);
+        }
+    }
+}
+
+
+struct PlayedEvent
+{
+    uint64_t tick;
+    int noteNumber;
+    bool isNoteOn;
+
+    bool operator== (const PlayedEvent& other) const
+    {
+        return tick == other.tick && noteNumber == other.noteNumber && isNoteOn == other.isNoteOn;
+    }
+};
+
+
+TEST_CASE ("clips play a shared pattern with their own offset, loop and transpose")
+{
+    auto sequencerState = juce::ValueTree { IDs::sequencer };
+    auto patternsState = juce::ValueTree { IDs::patterns };
+    sequencerState.appendChild (patternsState, nullptr);
+    auto patternList = PatternList { patternsState };
+
+    // a pattern of 4 ticks: two notes of 2 ticks
+    auto patternState = juce::ValueTree { IDs::pattern };
+    patternState.setProperty (IDs::id, 3, nullptr);
+    auto melodyState = juce::ValueTree { IDs::melody };
+    MelodyGenerator::addNoteToTree (melodyState, { 60, 0, 2, 100 });
+    MelodyGenerator::addNoteToTree (melodyState, { 62, 2, 2, 100 });
+    patternState.appendChild (melodyState, nullptr);
+    patternsState.appendChild (patternState, nullptr);
+
+    auto trackState = juce::ValueTree { IDs::track };
+    auto arrangement = Arrangement { trackState };
+
+    auto addClip = [&trackState] (int patternId, int start, int length, int offset, int loopLength, int transpose) {
+        auto clip = juce::ValueTree { IDs::clip };
+        clip.setProperty (IDs::pattern, patternId, nullptr);
+        clip.setProperty (IDs::startTimeTicks, start, nullptr);
+        clip.setProperty (IDs::lengthTicks, length, nullptr);
+        clip.setProperty (IDs::offsetTicks, offset, nullptr);
+        clip.setProperty (IDs::loopLengthTicks, loopLength, nullptr);
+        clip.setProperty (IDs::transpose, transpose, nullptr);
+        trackState.getChildWithName (IDs::arrangement).appendChild (clip, nullptr);
+    };
+
+    // loops the pattern an octave higher, then plays it once from its second tick, then one that refers to nothing
+    addClip (3, 10, 10, 0, 4, 12);
+    addClip (3, 25, 10, 1, 0, 0);
+    addClip (7, 0, 40, 0, 0, 0);
+    CHECK (arrangement.getNumClips() == 3);
+
+    // 10 ticks per quarter note at 60 bpm and a sample rate of 1000: 100 samples per tick, 10 ticks per block
+    auto tempoMap = TempoMap { 60.0, 1000.0, 10 };
+    auto playHead = PlayHead();
+    playHead.setSampleRate (1000.0);
+    playHead.setBlockSizeSamples (1000);
+    playHead.setTempoMap (&tempoMap, 1);
+    playHead.setPositionInTicks (0);
+
+    auto source = ArrangementMidiSource { &arrangement };
+    auto played = std::vector<PlayedEvent> {};
+
+    for (auto block = 0; block < 4; ++block)
+    {
+        auto buffer = juce::MidiBuffer {};
+        auto patterns = patternList.read();
+        source.setPatterns (&*patterns);
+        source.fillNextMidiBuffer (playHead, buffer, 1000);
+
+        for (auto&& metadata : buffer)
+        {
+            auto message = metadata.getMessage();
+            played.push_back ({ (uint64_t) (block * 10 + metadata.samplePosition / 100), message.getNoteNumber(), message.isNoteOn() });
+        }
+
+        playHead.advanceDeviceBuffer();
+    }
+
+    auto expected = std::vector<PlayedEvent> {
+        { 10, 72, true },
+        { 12, 72, false },
+        { 12, 74, true },
+        { 14, 74, false },  // the loop stops the sounding note
+        { 14, 72, true },
+        { 16, 72, false },
+        { 16, 74, true },
+        { 18, 74, false },
+        { 18, 72, true },
+        { 20, 72, false },  // the end of the clip stops the sounding note
+        { 26, 60, false },  // the second clip starts halfway into the first note, so only its note off is played
+        { 26, 62, true },
+        { 28, 62, false },
+    };
+
+    CHECK (played == expected);
+}
+
+
+TEST_CASE ("the end of a clip doesn't stop the notes an overlapping clip still holds")
+{
+    auto patternsState = juce::ValueTree { IDs::patterns };
+    auto patternList = PatternList { patternsState };
+
+    // a pattern of one long note
+    auto patternState = juce::ValueTree { IDs::pattern };
+    patternState.setProperty (IDs::id, 1, nullptr);
+    auto melodyState = juce::ValueTree { IDs::melody };
+    MelodyGenerator::addNoteToTree (melodyState, { 60, 0, 8, 100 });
+    patternState.appendChild (melodyState, nullptr);
+    patternsState.appendChild (patternState, nullptr);
+
+    auto trackState = juce::ValueTree { IDs::track };
+    auto arrangement = Arrangement { trackState };
+
+    auto addClip = [&trackState] (int start, int length) {
+        auto clip = juce::ValueTree { IDs::clip };
+        clip.setProperty (IDs::pattern, 1, nullptr);
+        clip.setProperty (IDs::startTimeTicks, start, nullptr);
+        clip.setProperty (IDs::lengthTicks, length, nullptr);
+        trackState.getChildWithName (IDs::arrangement).appendChild (clip, nullptr);
+    };
+
+    // the first clip ends while the second one plays the same note
+    addClip (0, 4);
+    addClip (2, 10);
+
+    // 100 samples per tick, 10 ticks per block
+    auto tempoMap = TempoMap { 60.0, 1000.0, 10 };
+    auto playHead = PlayHead();
+    playHead.setSampleRate (1000.0);
+    playHead.setBlockSizeSamples (1000);
+    playHead.setTempoMap (&tempoMap, 1);
+    playHead.setPositionInTicks (0);
+
+    auto source = ArrangementMidiSource { &arrangement };
+    auto played = std::vector<PlayedEvent> {};
+
+    for (auto block = 0; block < 2; ++block)
+    {
+        auto buffer = juce::MidiBuffer {};
+        auto patterns = patternList.read();
+        source.setPatterns (&*patterns);
+        source.fillNextMidiBuffer (playHead, buffer, 1000);
+
+        for (auto&& metadata : buffer)
+        {
+            auto message = metadata.getMessage();
+            played.push_back ({ (uint64_t) (block * 10 + metadata.samplePosition / 100), message.getNoteNumber(), message.isNoteOn() });
+        }
+
+        playHead.advanceDeviceBuffer();
+    }
+
+    auto expected = std::vector<PlayedEvent> {
+        { 0, 60, true },
+        { 2, 60, true },
+        { 10, 60, false },  // only when the second clip lets the note go
+    };
+
+    CHECK (played == expected);
+}
+
+
+TEST_CASE ("pattern list deletes the old event lists of the pattern melodies when collecting garbage")
+{
+    auto patternsState = juce::ValueTree { IDs::patterns };
+    auto patternList = PatternList { patternsState };
+
+    auto patternState = juce::ValueTree { IDs::pattern };
+    patternState.setProperty (IDs::id, 1, nullptr);
+    auto melodyState = juce::ValueTree { IDs::melody };
+    MelodyGenerator::addNoteToTree (melodyState, { 60, 0, 2, 100 });
+    patternState.appendChild (melodyState, nullptr);
+    patternsState.appendChild (patternState, nullptr);
+
+    auto patterns = patternList.read();
+    const auto& melody = (*patterns)[0]->melody;
+    auto isEdited = false;
+
+    // the event list that is being read when the pattern is edited is retired, it can only be deleted afterwards
+    melody.forEachEvent ([&] (const Event&) {
+        if (! std::exchange (isEdited, true))
+            MelodyGenerator::addNoteToTree (melodyState, { 62, 2, 2, 100 });
+    });
+
+    CHECK (melody.getNumRetiredEventLists() == 1);
+    patternList.collectGarbage();
+    CHECK (melody.getNumRetiredEventLists() == 0);
+}
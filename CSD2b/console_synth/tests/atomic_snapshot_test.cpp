@@ -0,0 +1,70 @@
+// Written by Wouter Ensink
+
+#include <catch2/catch_all.hpp>
+#include <console_synth/utility/atomic_snapshot.h>
+#include <thread>
+
+
+TEST_CASE ("atomic snapshot publishes new snapshots")
+{
+    auto snapshot = AtomicSnapshot<std::vector<int>> { std::make_unique<const std::vector<int>> (3, 1) };
+
+    CHECK (snapshot.read()->size() == 3);
+
+    snapshot.publish (std::make_unique<const std::vector<int>> (5, 2));
+
+    auto scope = snapshot.read();
+    CHECK (scope->size() == 5);
+    CHECK ((*scope)[0] == 2);
+}
+
+
+TEST_CASE ("atomic snapshot keeps retired snapshots alive while reading")
+{
+    auto snapshot = AtomicSnapshot<std::vector<int>> { std::make_unique<const std::vector<int>> (3, 1) };
+
+    {
+        auto scope = snapshot.read();
+        snapshot.publish (std::make_unique<const std::vector<int>> (5, 2));
+
+        // the reader still holds the old one, so it can't be deleted yet
+        CHECK (snapshot.getNumRetiredSnapshots() == 1);
+        CHECK (scope->size() == 3);
+    }
+
+    snapshot.collectGarbage();
+    CHECK (snapshot.getNumRetiredSnapshots() == 0);
+}
+
+
+TEST_CASE ("atomic snapshot concurrent reading and publishing")
+{
+    // every snapshot holds the same value in all elements, so a reader that sees
+    // a snapshot that is (partially) deleted or overwritten would see different values
+    auto snapshot = AtomicSnapshot<std::vector<int>> { std::make_unique<const std::vector<int>> (64, 0) };
+    auto done = std::atomic<bool> { false };
+    auto numInconsistentReads = std::atomic<int> { 0 };
+
+    auto reader = std::thread ([&] {
+        while (! done.load())
+        {
+            auto scope = snapshot.read();
+            auto first = scope->front();
+
+            for (auto value : *scope)
+                if (value != first)
+                    ++numInconsistentReads;
+        }
+    });
+
+    for (auto i = 1; i <= 2000; ++i)
+        snapshot.publish (std::make_unique<const std::vector<int>> (64, i));
+
+    done.store (true);
+    reader.join();
+    snapshot.collectGarbage();
+
+    CHECK (numInconsistentReads.load() == 0);
+    CHECK (snapshot.read()->front() == 2000);
+    CHECK (snapshot.getNumRetiredSnapshots() == 0);
+}
@@ -0,0 +1,182 @@
+// Written by Wouter Ensink
+
+#include <catch2/catch_all.hpp>
+#include <console_synth/audio/delay_effects.h>
+#include <cmath>
+
+
+static constexpr auto sampleRate = 48'000.0;
+static constexpr auto blockSize = 256;
+
+
+static PlayHead createPlayHead (const TempoMap& tempoMap)
+{
+    auto playHead = PlayHead {};
+    playHead.setSampleRate (sampleRate);
+    playHead.setBlockSizeSamples (blockSize);
+    playHead.setTempoMap (&tempoMap, 1);
+    playHead.setPositionInTicks (0);
+    return playHead;
+}
+
+
+// processes the (mono) input in blocks through the effect, while the play head plays the tempo map
+static std::vector<float> process (AudioProcessorBase& effect, PlayHead& playHead, const std::vector<float>& input)
+{
+    auto output = std::vector<float> (input.size());
+    auto buffer = juce::AudioBuffer<float> (1, blockSize);
+    auto midi = juce::MidiBuffer {};
+
+    effect.prepareToPlay (sampleRate, blockSize);
+
+    for (auto start = size_t { 0 }; start < input.size(); start += blockSize)
+    {
+        buffer.clear();
+        const auto numSamples = std::min (input.size() - start, (size_t) blockSize);
+        std::copy_n (input.begin() + (long) start, numSamples, buffer.getWritePointer (0));
+
+        effect.processBlock (buffer, midi);
+        playHead.advanceDeviceBuffer();
+
+        std::copy_n (buffer.getReadPointer (0), numSamples, output.begin() + (long) start);
+    }
+
+    return output;
+}
+
+
+static std::vector<float> createImpulses (size_t numSamples, size_t spacing)
+{
+    auto impulses = std::vector<float> (numSamples, 0.0f);
+
+    for (auto i = size_t { 0 }; i < numSamples; i += spacing)
+        impulses[i] = 1.0f;
+
+    return impulses;
+}
+
+
+static size_t findPeak (const std::vector<float>& samples, size_t start, size_t end)
+{
+    auto peak = std::max_element (samples.begin() + (long) start, samples.begin() + (long) end, [] (auto a, auto b) {
+        return std::abs (a) < std::abs (b);
+    });
+
+    return (size_t) std::distance (samples.begin(), peak);
+}
+
+
+template <typename EffectType>
+static void checkDelayStaysWithinDepth()
+{
+    auto tempoMap = TempoMap { 120.0, sampleRate, 48 };
+    auto playHead = createPlayHead (tempoMap);
+
+    // only the wet signal and no feedback, so every impulse comes out once, delayed by the delay at that moment
+    auto params = EffectType::defaultParameters;
+    params.feedback = 0.0f;
+    params.dryLevel = 0.0f;
+    params.wetLevel = 1.0f;
+    auto effect = EffectType { playHead, params };
+
+    const auto minDelay = (params.centreDelayMs - params.depthMs) * sampleRate / 1000.0;
+    const auto maxDelay = (params.centreDelayMs + params.depthMs) * sampleRate / 1000.0;
+    const auto spacing = (size_t) maxDelay + 100;
+
+    // two cycles of the lfo (a beat takes half a second)
+    const auto numSamples = (size_t) (2 * params.lfoPeriodBeats * 0.5 * sampleRate);
+    const auto output = process (effect, playHead, createImpulses (numSamples, spacing));
+
+    auto shortestDelay = maxDelay;
+    auto longestDelay = minDelay;
+
+    for (auto impulse = size_t { 0 }; impulse + spacing <= numSamples; impulse += spacing)
+    {
+        // the interpolation spreads the impulse over the samples around the delay
+        for (auto i = impulse; i < impulse + spacing; ++i)
+        {
+            if (std::abs (output[i]) > 1.0e-4f)
+            {
+                CHECK ((double) (i - impulse) > minDelay - 2.0);
+                CHECK ((double) (i - impulse) < maxDelay + 2.0);
+            }
+        }
+
+        auto delay = (double) (findPeak (output, impulse, impulse + spacing) - impulse);
+        shortestDelay = std::min (shortestDelay, delay);
+        longestDelay = std::max (longestDelay, delay);
+    }
+
+    // the lfo sweeps (almost) the whole depth
+    CHECK (shortestDelay < minDelay + 2.0);
+    CHECK (longestDelay > maxDelay - 2.0);
+}
+
+
+TEST_CASE ("the delay of a modulated delay stays within the depth around the centre delay")
+{
+    SECTION ("chorus") { checkDelayStaysWithinDepth<Chorus>(); }
+    SECTION ("flanger") { checkDelayStaysWithinDepth<Flanger>(); }
+}
+
+
+template <typename EffectType>
+static void checkDryAndWetLevels()
+{
+    auto tempoMap = TempoMap { 120.0, sampleRate, 48 };
+    auto wetPlayHead = createPlayHead (tempoMap);
+    auto mixedPlayHead = createPlayHead (tempoMap);
+
+    auto input = std::vector<float> (48'000);
+
+    for (auto i = size_t { 0 }; i < input.size(); ++i)
+        input[i] = 0.5f * std::sin ((float) i * 0.031f) + 0.3f * std::sin ((float) i * 0.0077f);
+
+    auto wetParams = EffectType::defaultParameters;
+    wetParams.dryLevel = 0.0f;
+    wetParams.wetLevel = 1.0f;
+    auto wetEffect = EffectType { wetPlayHead, wetParams };
+
+    auto mixedParams = EffectType::defaultParameters;
+    mixedParams.dryLevel = 0.7f;
+    mixedParams.wetLevel = 0.4f;
+    auto mixedEffect = EffectType { mixedPlayHead, mixedParams };
+
+    const auto wet = process (wetEffect, wetPlayHead, input);
+    const auto mixed = process (mixedEffect, mixedPlayHead, input);
+
+    for (auto i = size_t { 0 }; i < input.size(); ++i)
+        REQUIRE_THAT (mixed[i], Catch::Matchers::WithinAbs (0.7f * input[i] + 0.4f * wet[i], 1.0e-5));
+}
+
+
+TEST_CASE ("a modulated delay mixes the dry and wet signal by their levels")
+{
+    SECTION ("chorus") { checkDryAndWetLevels<Chorus>(); }
+    SECTION ("flanger") { checkDryAndWetLevels<Flanger>(); }
+}
+
+
+TEST_CASE ("the tempo synced delay follows the tempo changes of the tempo map")
+{
+    // a bar of 4/4 at 120 bpm (2 seconds), after that 60 bpm
+    auto tempoMap = TempoMap { { { 0, 120.0 }, { 192, 60.0 } }, sampleRate, 48 };
+    auto playHead = createPlayHead (tempoMap);
+
+    auto params = TempoSyncedDelay::Parameters {};
+    params.delayBeats = 0.75;
+    params.feedback = 0.0f;
+    params.dryLevel = 0.0f;
+    params.wetLevel = 1.0f;
+    auto delay = TempoSyncedDelay { playHead, params };
+
+    // one impulse at the start and one a second after the tempo change, when the smoothed delay time has settled
+    auto input = std::vector<float> (240'000, 0.0f);
+    input[0] = 1.0f;
+    input[144'000] = 1.0f;
+
+    const auto output = process (delay, playHead, input);
+
+    CHECK (findPeak (output, 0, 96'000) == 18'000);
+    CHECK (findPeak (output, 144'000, output.size()) == 144'000 + 36'000);
+}
@@ -0,0 +1,95 @@
+// Written by Wouter Ensink
+
+#include <catch2/catch_all.hpp>
+#include <console_synth/audio/delay_line.h>
+
+
+TEST_CASE ("delay line integer delays")
+{
+    auto delayLine = DelayLine<float> {};
+    delayLine.setMaximumDelaySamples (10);
+
+    for (auto i = 1; i <= 20; ++i)
+        delayLine.write ((float) i);
+
+    CHECK (delayLine.read (0) == 20.0f);
+    CHECK (delayLine.read (1) == 19.0f);
+    CHECK (delayLine.read (10) == 10.0f);
+}
+
+
+TEST_CASE ("delay line fractional reads")
+{
+    auto delayLine = DelayLine<float> {};
+    delayLine.setMaximumDelaySamples (16);
+
+    // a cubic, which the 3rd order lagrange interpolation should reconstruct exactly
+    auto cubic = [] (float x) { return 0.01f * x * x * x - 0.2f * x * x + x; };
+
+    for (auto i = 0; i < 30; ++i)
+        delayLine.write (cubic ((float) i));
+
+    auto newest = 29.0f;
+
+    SECTION ("linear")
+    {
+        // halfway between two samples is the average of the two
+        auto expected = (delayLine.read (4) + delayLine.read (5)) / 2.0f;
+        CHECK_THAT (delayLine.readLinear (4.5f), Catch::Matchers::WithinAbs (expected, 1.0e-6));
+    }
+
+    SECTION ("lagrange")
+    {
+        for (auto delay : { 1.0f, 2.25f, 5.5f, 7.8f })
+            CHECK_THAT (delayLine.readLagrange (delay), Catch::Matchers::WithinAbs (cubic (newest - delay), 1.0e-3));
+    }
+}
+
+
+TEST_CASE ("delay line block reads match per sample reads")
+{
+    auto blockSize = 64;
+    auto perSample = DelayLine<float> {};
+    auto perBlock = DelayLine<float> {};
+    perSample.setMaximumDelaySamples (32, blockSize);
+    perBlock.setMaximumDelaySamples (32, blockSize);
+
+    auto input = std::vector<float> ((size_t) blockSize);
+    auto delays = std::vector<float> ((size_t) blockSize);
+    auto output = std::vector<float> ((size_t) blockSize);
+
+    for (auto block = 0; block < 4; ++block)
+    {
+        for (auto i = 0; i < blockSize; ++i)
+        {
+            input[(size_t) i] = std::sin ((float) (block * blockSize + i) * 0.1f);
+            delays[(size_t) i] = 10.0f + 8.0f * std::sin ((float) i * 0.05f);
+        }
+
+        perBlock.writeBlock (input.data(), blockSize);
+        perBlock.readLagrangeBlock (delays.data(), output.data(), blockSize);
+
+        for (auto i = 0; i < blockSize; ++i)
+        {
+            perSample.write (input[(size_t) i]);
+            CHECK_THAT (output[(size_t) i], Catch::Matchers::WithinAbs (perSample.readLagrange (delays[(size_t) i]), 1.0e-6));
+        }
+    }
+}
+
+
+TEST_CASE ("delay line allpass interpolation passes dc")
+{
+    auto delayLine = DelayLine<float> {};
+    delayLine.setMaximumDelaySamples (16);
+    auto state = DelayLine<float>::AllpassState {};
+    auto output = 0.0f;
+
+    for (auto i = 0; i < 200; ++i)
+    {
+        delayLine.write (1.0f);
+        output = delayLine.readAllpass (3.3f, state);
+    }
+
+    CHECK_THAT (output, Catch::Matchers::WithinAbs (1.0, 1.0e-4));
+}
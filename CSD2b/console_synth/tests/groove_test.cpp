@@ -0,0 +1,212 @@
+// Written by Wouter Ensink
+
+#include <catch2/catch_all.hpp>
+#include <console_synth/sequencer/groove.h>
+#include <bitset>
+#include "test_play_head.h"
+
+
+struct TestEvent
+{
+    uint64_t sample;
+    bool isNoteOn;
+    int note;
+    int velocity;
+
+    bool operator== (const TestEvent& other) const
+    {
+        return sample == other.sample && isNoteOn == other.isNoteOn && note == other.note && velocity == other.velocity;
+    }
+};
+
+
+// plays the events (at the samples of their ticks, see test_play_head.h) through a transform chain.
+// the settings can be changed from the given block on
+static std::vector<TestEvent> play (const std::vector<TestEvent>& events,
+                                    const GrooveSettings& settings,
+                                    int blockSize,
+                                    int numBlocks,
+                                    const GrooveSettings& laterSettings = {},
+                                    int changeBlock = -1)
+{
+    auto playHead = createTestPlayHead (blockSize);
+    auto chain = MidiTransformChain {};
+    auto buffer = juce::MidiBuffer {};
+    auto output = std::vector<TestEvent> {};
+
+    playBlocks (playHead, numBlocks, [&] (int block) {
+        const auto blockStart = (uint64_t) (block * blockSize);
+        buffer.clear();
+
+        for (const auto& event : events)
+        {
+            if (event.sample < blockStart || event.sample >= blockStart + (uint64_t) blockSize)
+                continue;
+
+            auto message = event.isNoteOn ? juce::MidiMessage::noteOn (1, event.note, (juce::uint8) event.velocity)
+                                          : juce::MidiMessage::noteOff (1, event.note);
+            buffer.addEvent (message, (int) (event.sample - blockStart));
+        }
+
+        chain.process (changeBlock >= 0 && block >= changeBlock ? laterSettings : settings, playHead, buffer, blockSize);
+
+        for (auto&& metadata : buffer)
+        {
+            auto message = metadata.getMessage();
+            output.push_back ({ blockStart + (uint64_t) metadata.samplePosition, message.isNoteOn(), message.getNoteNumber(), message.isNoteOn() ? message.getVelocity() : 0 });
+        }
+    });
+
+    return output;
+}
+
+
+static std::vector<TestEvent> createNotes (std::initializer_list<uint64_t> ticks, uint64_t lengthTicks = 4)
+{
+    auto events = std::vector<TestEvent> {};
+
+    for (auto tick : ticks)
+    {
+        events.push_back ({ tick * 500, true, 60, 100 });
+        events.push_back ({ (tick + lengthTicks) * 500, false, 60, 0 });
+    }
+
+    return events;
+}
+
+
+TEST_CASE ("swing moves every second step later and the note offs along with it")
+{
+    auto settings = GrooveSettings {};
+    settings.swing = 0.5;
+    settings.swingGridTicks = 12;
+
+    // the second step moves half a step (6 ticks), the third step stays where it is
+    CHECK (play (createNotes ({ 0, 12, 24 }), settings, 1000, 20) == std::vector<TestEvent> {
+               { 0, true, 60, 100 }, { 2000, false, 60, 0 }, { 9000, true, 60, 100 }, { 11000, false, 60, 0 }, { 12000, true, 60, 100 }, { 14000, false, 60, 0 } });
+
+    // without settings, nothing changes
+    CHECK (play (createNotes ({ 0, 12, 24 }), {}, 1000, 20) == createNotes ({ 0, 12, 24 }));
+}
+
+
+TEST_CASE ("groove template quantizes notes to its steps and scales their velocity")
+{
+    auto settings = GrooveSettings {};
+    settings.numGrooveSteps = 2;
+    settings.grooveGridTicks = 12;
+    settings.grooveOffsetTicks = { 0.0, 3.0, 0.0, 3.0 };
+    settings.grooveVelocities = { 1.0, 0.5, 1.0, 0.5 };
+
+    // the note at tick 10 is quantized to the step at tick 12, plus the offset of that step
+    auto output = play ({ { 5000, true, 60, 100 }, { 6000, false, 60, 0 } }, settings, 1000, 20);
+
+    CHECK (output == std::vector<TestEvent> { { 7500, true, 60, 50 }, { 8500, false, 60, 0 } });
+}
+
+
+TEST_CASE ("humanize is the same for every block size and changes with the seed")
+{
+    auto settings = GrooveSettings {};
+    settings.humanizeTicks = 3.0;
+    settings.humanizeVelocity = 20;
+    settings.seed = 1234;
+
+    const auto notes = createNotes ({ 0, 12, 24, 36, 48, 60, 72, 84 }, 6);
+    const auto output = play (notes, settings, 1000, 100);
+
+    CHECK (output.size() == notes.size());
+    CHECK (output == play (notes, settings, 700, 150));
+    CHECK (output != notes);
+
+    for (size_t i = 0; i < output.size(); i += 2)
+    {
+        // every note off is moved as much as its note on
+        CHECK (output[i].sample >= notes[i].sample);
+        CHECK (output[i].sample <= notes[i].sample + 1500);
+        CHECK (output[i + 1].sample - output[i].sample == 3000);
+        CHECK (std::abs (output[i].velocity - 100) <= 20);
+    }
+
+    settings.seed = 4321;
+    CHECK (output != play (notes, settings, 1000, 100));
+}
+
+
+TEST_CASE ("transposing while a note plays still stops that note")
+{
+    auto settings = GrooveSettings {};
+    settings.transpose = 12;
+    auto laterSettings = GrooveSettings {};
+    laterSettings.transpose = -3;
+
+    auto output = play (createNotes ({ 0, 12 }), settings, 1000, 20, laterSettings, 1);
+
+    CHECK (output == std::vector<TestEvent> { { 0, true, 72, 100 }, { 2000, false, 72, 0 }, { 6000, true, 57, 100 }, { 8000, false, 57, 0 } });
+}
+
+
+// the notes that are still sounding at the end of the output
+static std::bitset<128> getSoundingNotes (const std::vector<TestEvent>& output)
+{
+    auto soundingNotes = std::bitset<128> { 0 };
+
+    for (const auto& event : output)
+        soundingNotes.set ((size_t) event.note, event.isNoteOn);
+
+    return soundingNotes;
+}
+
+
+TEST_CASE ("a block with more events than fit keeps its note offs")
+{
+    auto events = std::vector<TestEvent> {};
+
+    SECTION ("more note ons")
+    {
+        for (auto i = 0; i < 600; ++i)
+            events.push_back ({ (uint64_t) i, true, i % 128, 100 });
+
+        for (auto note = 0; note < 128; ++note)
+            events.push_back ({ 999, false, note, 0 });
+    }
+
+    SECTION ("more note offs")
+    {
+        for (auto note = 0; note < 128; ++note)
+            events.push_back ({ 0, true, note, 100 });
+
+        // the note offs of all notes come after more note offs than fit in the block
+        for (auto i = 0; i < 600; ++i)
+            events.push_back ({ 1'000 + (uint64_t) i, false, 0, 0 });
+
+        for (auto note = 0; note < 128; ++note)
+            events.push_back ({ 1'999, false, note, 0 });
+    }
+
+    auto settings = GrooveSettings {};
+    settings.transpose = -10;
+
+    CHECK (getSoundingNotes (play (events, settings, 1000, 3)).none());
+}
+
+
+TEST_CASE ("a full list of waiting notes never plays a note off before its note on")
+{
+    // every note number plays twice on the swung step, which fills the list, then their note offs have to wait as well
+    auto events = std::vector<TestEvent> {};
+
+    for (auto note = 0; note < 128; ++note)
+    {
+        events.push_back ({ 12 * 500, true, note, 100 });
+        events.push_back ({ 13 * 500, true, note, 100 });
+        events.push_back ({ 14 * 500, false, note, 0 });
+    }
+
+    std::stable_sort (events.begin(), events.end(), [] (auto& a, auto& b) { return a.sample < b.sample; });
+
+    auto settings = GrooveSettings {};
+    settings.swing = 0.9;
+
+    CHECK (getSoundingNotes (play (events, settings, 1000, 40)).none());
+}
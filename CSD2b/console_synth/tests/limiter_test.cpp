@@ -0,0 +1,70 @@
+// Written by Wouter Ensink
+
+#include <catch2/catch_all.hpp>
+#include <console_synth/audio/limiter.h>
+
+
+TEST_CASE ("sliding window max")
+{
+    auto window = SlidingWindowMax {};
+    window.setWindowSize (3);
+
+    auto input = std::vector<float> { 1, 3, 2, 0, 0, 5, 1, 1, 1 };
+    auto expected = std::vector<float> { 1, 3, 3, 3, 2, 5, 5, 5, 1 };
+
+    for (auto i = 0; i < input.size(); ++i)
+        CHECK (window.push (input[i]) == expected[i]);
+}
+
+
+TEST_CASE ("limiter keeps output under the ceiling")
+{
+    auto sampleRate = 44100.0;
+    auto blockSize = 256;
+    auto ceilingDecibels = -1.0f;
+    auto ceiling = juce::Decibels::decibelsToGain (ceilingDecibels);
+
+    auto limiter = Limiter { 2.0, ceilingDecibels };
+    limiter.prepareToPlay (sampleRate, blockSize);
+
+    auto buffer = juce::AudioBuffer<float> (2, blockSize);
+    auto midi = juce::MidiBuffer {};
+    auto phase = 0.0;
+
+    for (auto block = 0; block < 100; ++block)
+    {
+        // a sine with an amplitude of 4 (+12 dB)
+        for (auto i = 0; i < blockSize; ++i)
+        {
+            auto sample = (float) (4.0 * std::sin (phase));
+            buffer.setSample (0, i, sample);
+            buffer.setSample (1, i, sample);
+            phase += juce::MathConstants<double>::twoPi * 440.0 / sampleRate;
+        }
+
+        limiter.processBlock (buffer, midi);
+
+        CHECK (buffer.getMagnitude (0, blockSize) <= ceiling + 1.0e-4f);
+    }
+}
+
+
+TEST_CASE ("limiter latency")
+{
+    auto limiter = Limiter { 1.0 };
+    limiter.prepareToPlay (48000.0, 128);
+
+    // 1 ms at 48 kHz
+    REQUIRE (limiter.getLatencySamples() == 48);
+
+    // an impulse under the ceiling should come out unchanged, exactly latency samples later
+    auto buffer = juce::AudioBuffer<float> (2, 128);
+    auto midi = juce::MidiBuffer {};
+    buffer.clear();
+    buffer.setSample (0, 10, 0.5f);
+
+    limiter.processBlock (buffer, midi);
+
+    CHECK_THAT (buffer.getSample (0, 10 + 48), Catch::Matchers::WithinAbs (0.5, 1.0e-6));
+    CHECK_THAT (buffer.getSample (0, 10), Catch::Matchers::WithinAbs (0.0, 1.0e-6));
+}
@@ -8,4 +8,59 @@
 TEST_CASE ("basic setup")
 {
     REQUIRE (true);
-}
\ No newline at end of file
+}
+
+static bool areEqual (const std::vector<MelodyGenerator::Note>& a, const std::vector<MelodyGenerator::Note>& b)
+{
+    return std::equal (a.begin(), a.end(), b.begin(), b.end(), [] (const auto& x, const auto& y) {
+        return x.number == y.number && x.start == y.start && x.length == y.length && x.velocity == y.velocity;
+    });
+}
+
+
+TEST_CASE ("melody generator gives the same melody for the same seed")
+{
+    const auto meterMap = MeterMap { 48, 7, 8 };
+
+    auto notes = MelodyGenerator { 42 }.generateNotes (meterMap, 2);
+    REQUIRE (notes.size() == 28);
+    CHECK (areEqual (notes, MelodyGenerator { 42 }.generateNotes (meterMap, 2)));
+    CHECK (! areEqual (notes, MelodyGenerator { 43 }.generateNotes (meterMap, 2)));
+
+    // sixteenth notes, one after another
+    for (auto i = size_t { 0 }; i < notes.size(); ++i)
+    {
+        CHECK (notes[i].start == (int) i * 12);
+        CHECK (notes[i].length == 12);
+        CHECK ((notes[i].number >= 60 && notes[i].number < 80 + 12));
+    }
+
+    // the value tree has the same notes
+    auto melody = MelodyGenerator { 42 }.generateMelody (meterMap, 2);
+    REQUIRE (melody.getNumChildren() == 28);
+    CHECK ((int) melody.getChild (5).getProperty (IDs::midiNoteNumber) == notes[5].number);
+    CHECK ((int) melody.getChild (5).getProperty (IDs::startTimeTicks) == notes[5].start);
+}
+
+
+TEST_CASE ("melody batches are the same for every number of threads")
+{
+    const auto meterMap = MeterMap { 48, 4, 4 };
+    const auto seed = juce::int64 { 1234 };
+
+    const auto melodies = MelodyGenerator::generateMelodies (meterMap, 4, 200, seed, 1);
+    REQUIRE (melodies.size() == 200);
+
+    for (auto numThreads : { 2, 3, 8 })
+    {
+        const auto parallelMelodies = MelodyGenerator::generateMelodies (meterMap, 4, 200, seed, numThreads);
+        REQUIRE (parallelMelodies.size() == melodies.size());
+
+        for (auto i = size_t { 0 }; i < melodies.size(); ++i)
+            REQUIRE (areEqual (melodies[i], parallelMelodies[i]));
+    }
+
+    // a melody of a batch can be generated on its own
+    CHECK (areEqual (melodies[17], MelodyGenerator { MelodyGenerator::getSeedOfMelody (seed, 17) }.generateNotes (meterMap, 4)));
+    CHECK (! areEqual (melodies[17], melodies[18]));
+}
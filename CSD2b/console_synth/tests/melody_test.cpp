@@ -0,0 +1,143 @@
+// Written by Wouter Ensink
+
+#include <catch2/catch_all.hpp>
+#include <console_synth/sequencer/melody.h>
+#include <console_synth/sequencer/melody_generator.h>
+
+
+std::vector<Event> getEvents (const Melody& melody)
+{
+    auto events = std::vector<Event> {};
+    melody.forEachEvent ([&] (const Event& e) { events.push_back (e); });
+    return events;
+}
+
+
+bool isSorted (const std::vector<Event>& events)
+{
+    for (auto i = 1; i < events.size(); ++i)
+    {
+        auto& previous = events[i - 1];
+        auto& current = events[i];
+
+        if (previous.timeStampTicks > current.timeStampTicks)
+            return false;
+
+        // note offs should come before note ons at the same tick
+        if (previous.timeStampTicks == current.timeStampTicks && previous.isNoteOn && ! current.isNoteOn)
+            return false;
+    }
+
+    return true;
+}
+
+
+TEST_CASE ("melody keeps events sorted when adding and removing notes")
+{
+    auto root = juce::ValueTree { IDs::track };
+    auto melody = Melody { root };
+    auto melodyTree = root.getChildWithName (IDs::melody);
+
+    MelodyGenerator::addNoteToTree (melodyTree, { 60, 48, 12, 100 });
+    MelodyGenerator::addNoteToTree (melodyTree, { 62, 0, 48, 100 });
+    MelodyGenerator::addNoteToTree (melodyTree, { 64, 24, 24, 100 });
+
+    auto events = getEvents (melody);
+    REQUIRE (events.size() == 6);
+    CHECK (isSorted (events));
+    CHECK (events[0].timeStampTicks == 0);
+    CHECK (events[0].midiNote == 62);
+
+    // the note off of 62 and the note on of 60 are both at tick 48, the note off should come first
+    CHECK (events[3].timeStampTicks == 48);
+    CHECK_FALSE (events[3].isNoteOn);
+    CHECK (events[4].isNoteOn);
+
+    melodyTree.removeChild (1, nullptr);
+
+    events = getEvents (melody);
+    REQUIRE (events.size() == 4);
+    CHECK (isSorted (events));
+    CHECK (events[0].midiNote == 64);
+}
+
+
+TEST_CASE ("melody edit batch updates the events once at the end")
+{
+    auto root = juce::ValueTree { IDs::track };
+    auto melody = Melody { root };
+    auto melodyTree = root.getChildWithName (IDs::melody);
+    auto random = juce::Random { 42 };
+    auto numNotes = 10'000;
+
+    {
+        auto batch = ScopedMelodyEditBatch { melodyTree };
+
+        for (auto i = 0; i < numNotes; ++i)
+            MelodyGenerator::addNoteToTree (melodyTree, { random.nextInt ({ 40, 90 }), random.nextInt (100'000), 1 + random.nextInt (200), 100 });
+
+        // nothing is published during the batch
+        CHECK (getEvents (melody).empty());
+    }
+
+    auto events = getEvents (melody);
+    CHECK (events.size() == numNotes * 2);
+    CHECK (isSorted (events));
+
+    {
+        auto batch = ScopedMelodyEditBatch { melodyTree };
+        melodyTree.removeAllChildren (nullptr);
+    }
+
+    CHECK (getEvents (melody).empty());
+}
+
+
+TEST_CASE ("melody range lookup")
+{
+    auto root = juce::ValueTree { IDs::track };
+    auto melody = Melody { root };
+    auto melodyTree = root.getChildWithName (IDs::melody);
+
+    for (auto i = 0; i < 8; ++i)
+        MelodyGenerator::addNoteToTree (melodyTree, { 60 + i, i * 10, 5, 100 });
+
+    auto cursor = Melody::Cursor {};
+    auto ticks = std::vector<int> {};
+    auto collect = [&] (const Event& e) { ticks.push_back (e.timeStampTicks); };
+
+    melody.forEachEventInRange (cursor, 0, 20, collect);
+    CHECK (ticks == std::vector<int> { 0, 5, 10, 15 });
+
+    // continues from the cursor
+    ticks.clear();
+    melody.forEachEventInRange (cursor, 20, 31, collect);
+    CHECK (ticks == std::vector<int> { 20, 25, 30 });
+
+    // jumps back (e.g. a loop), so it has to search again
+    ticks.clear();
+    melody.forEachEventInRange (cursor, 5, 11, collect);
+    CHECK (ticks == std::vector<int> { 5, 10 });
+}
+
+
+TEST_CASE ("melody deletes the event lists that were read during an edit when collecting garbage")
+{
+    auto root = juce::ValueTree { IDs::track };
+    auto melody = Melody { root };
+    auto melodyTree = root.getChildWithName (IDs::melody);
+    MelodyGenerator::addNoteToTree (melodyTree, { 60, 0, 48, 100 });
+
+    // the list that is being read can't be deleted when the edit publishes a new one
+    auto isEdited = false;
+
+    melody.forEachEvent ([&] (const Event&) {
+        if (! std::exchange (isEdited, true))
+            MelodyGenerator::addNoteToTree (melodyTree, { 62, 48, 48, 100 });
+    });
+
+    CHECK (melody.getNumRetiredEventLists() == 1);
+    melody.collectGarbage();
+    CHECK (melody.getNumRetiredEventLists() == 0);
+    CHECK (getEvents (melody).size() == 4);
+}
@@ -0,0 +1,69 @@
+// Written by Wouter Ensink
+
+#include <catch2/catch_all.hpp>
+#include <console_synth/sequencer/meter_map.h>
+
+
+static_assert (MusicalTime { 1, 0, 0 } > MusicalTime { 0, 6, 47 });
+static_assert (MusicalTime { 2, 3, 1 } == MusicalTime { 2, 3, 1 });
+static_assert (MusicalTime { 0, 1, 0 } <= MusicalTime { 0, 1, 0 });
+
+
+TEST_CASE ("meter map with a single time signature")
+{
+    auto map = MeterMap { 48 };
+
+    CHECK (map.getTickOfBar (0) == 0);
+    CHECK (map.getTickOfBar (3) == 3 * 192);
+    CHECK (map.toTicks ({ 2, 1, 5 }) == 2 * 192 + 48 + 5);
+    CHECK (map.toMusicalTime (2 * 192 + 48 + 5) == MusicalTime { 2, 1, 5 });
+}
+
+
+TEST_CASE ("meter map with changes from 4/4 to 7/8 to 3/4")
+{
+    // 48 ticks per quarter note: a bar of 4/4 is 192 ticks, 7/8 is 168 ticks and 3/4 is 144 ticks
+    auto map = MeterMap { { { 0, 4, 4 }, { 2, 7, 8 }, { 5, 3, 4 } }, 48 };
+
+    CHECK (map.getTickOfBar (1) == 192);
+    CHECK (map.getTickOfBar (2) == 384);
+    CHECK (map.getTickOfBar (3) == 384 + 168);
+    CHECK (map.getTickOfBar (5) == 384 + 3 * 168);
+    CHECK (map.getTickOfBar (7) == 384 + 3 * 168 + 2 * 144);
+
+    CHECK (map.getTimeSignatureAtBar (1).getNumerator() == 4);
+    CHECK (map.getTimeSignatureAtBar (4).getDenominator() == 8);
+    CHECK (map.getTimeSignatureAtTick (384 + 3 * 168).getNumerator() == 3);
+
+    // a beat of 7/8 is an eighth note (24 ticks)
+    CHECK (map.toTicks ({ 3, 6, 23 }) == 384 + 168 + 6 * 24 + 23);
+    CHECK (map.toMusicalTime (384 + 168 + 6 * 24 + 23) == MusicalTime { 3, 6, 23 });
+    CHECK (map.toMusicalTime (384 + 2 * 168) == MusicalTime { 4, 0, 0 });
+    CHECK (map.toMusicalTime (384 + 3 * 168 - 1) == MusicalTime { 4, 6, 23 });
+
+    // every tick survives the round trip and the musical times only go up
+    auto previous = map.toMusicalTime (0);
+
+    for (auto tick = uint64_t { 0 }; tick < 2000; ++tick)
+    {
+        auto time = map.toMusicalTime (tick);
+        CHECK (map.toTicks (time) == tick);
+
+        if (tick > 0)
+            CHECK (previous < time);
+
+        previous = time;
+    }
+}
+
+
+TEST_CASE ("meter map sorts the changes and uses the last one at a bar")
+{
+    auto map = MeterMap { { { 4, 3, 4 }, { 1, 5, 4 }, { 1, 6, 8 } }, 48 };
+
+    CHECK (map.getTimeSignatureAtBar (0).getNumerator() == 5);
+    CHECK (map.getTimeSignatureAtBar (1).getNumerator() == 6);
+    CHECK (map.getTimeSignatureAtBar (1).getDenominator() == 8);
+    CHECK (map.getTickOfBar (4) == 240 + 3 * 144);
+    CHECK (map.getTimeSignatureAtBar (4).getNumerator() == 3);
+}
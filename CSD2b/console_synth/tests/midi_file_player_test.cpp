@@ -0,0 +1,162 @@
+// Written by Wouter Ensink
+
+#include <catch2/catch_all.hpp>
+#include <console_synth/midi/midi_file_player.h>
+#include "test_play_head.h"
+
+
+// the file has 96 ticks per quarter note, the sequencer 48, so two ticks of the file are one of the sequencer
+static juce::MemoryBlock createFileWithNotes (int numNotes, int ticksBetweenNotes)
+{
+    auto sequence = juce::MidiMessageSequence {};
+    sequence.addEvent (juce::MidiMessage::tempoMetaEvent (500'000), 0.0);
+
+    for (auto i = 0; i < numNotes; ++i)
+    {
+        const auto tick = (double) (i * ticksBetweenNotes);
+        sequence.addEvent (juce::MidiMessage::noteOn (1, 40 + i % 40, (juce::uint8) 100), tick);
+        sequence.addEvent (juce::MidiMessage::noteOff (1, 40 + i % 40), tick + ticksBetweenNotes / 2);
+    }
+
+    auto file = juce::MidiFile {};
+    file.setTicksPerQuarterNote (96);
+    file.addTrack (sequence);
+
+    auto stream = juce::MemoryOutputStream {};
+    file.writeTo (stream);
+    return stream.getMemoryBlock();
+}
+
+
+TEST_CASE ("mapped midi file decodes running status and skips meta and sysex events")
+{
+    // format 0, one track, 96 ticks per quarter note
+    const auto bytes = std::vector<uint8_t> {
+        'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0, 96,
+        'M', 'T', 'r', 'k', 0, 0, 0, 26,
+        0x00, 0xff, 0x03, 0x02, 'h', 'i', // track name
+        0x00, 0x90, 60, 100, // note on
+        0x10, 62, 90, // note on with running status
+        0x81, 0x00, 0xf0, 0x02, 0x7e, 0xf7, // sysex at 0x80 ticks later
+        0x00, 60, 0, // a note on without velocity, the running status is kept after the sysex
+        0x00, 0xff, 0x2f, 0x00 // end of track
+    };
+
+    auto file = MappedMidiFile { bytes.data(), bytes.size(), 48 };
+    REQUIRE (file.getNumTracks() == 1);
+
+    auto cursor = file.seek (0, 0);
+    auto events = std::vector<MappedMidiFile::Event> {};
+
+    for (; ! cursor.isAtEnd; file.advance (0, cursor))
+        events.push_back (cursor.event);
+
+    REQUIRE (events.size() == 5);
+
+    CHECK (events[0].numBytes == 0);
+    CHECK ((events[1].tick == 0 && events[1].data[1] == 60 && events[1].data[2] == 100));
+    CHECK ((events[2].tick == 16 && events[2].data[0] == 0x90 && events[2].data[1] == 62));
+    CHECK ((events[3].tick == 144 && events[3].numBytes == 0));
+    CHECK ((events[4].tick == 144 && events[4].data[1] == 60 && events[4].data[2] == 0));
+
+    CHECK (file.toSequencerTick (144) == 72);
+    CHECK (file.toFileTick (72) == 143);
+}
+
+
+TEST_CASE ("mapped midi file seeks through a bounded index")
+{
+    const auto numNotes = 200'000;
+    const auto block = createFileWithNotes (numNotes, 10);
+    auto file = MappedMidiFile { block.getData(), block.getSize(), 48 };
+
+    REQUIRE (file.getNumTracks() == 1);
+    CHECK (file.getIndexSize (0) <= MappedMidiFile::maxIndexSize);
+
+    auto random = juce::Random { 42 };
+
+    for (auto i = 0; i < 100; ++i)
+    {
+        // the note ons are at multiples of 10, the note offs 5 ticks later
+        const auto tick = (uint64_t) random.nextInt (numNotes * 10);
+        const auto expectedTick = (tick + 4) / 5 * 5;
+
+        auto cursor = file.seek (0, tick);
+        REQUIRE (! cursor.isAtEnd);
+        CHECK (cursor.event.tick == expectedTick);
+
+        const auto isNoteOn = expectedTick % 10 == 0;
+        CHECK (cursor.event.data[0] == (isNoteOn ? 0x90 : 0x80));
+        CHECK (cursor.event.data[1] == 40 + (expectedTick / 10) % 40);
+    }
+
+    CHECK (file.seek (0, (uint64_t) numNotes * 10).isAtEnd);
+}
+
+
+TEST_CASE ("midi file player plays the notes of every block and stops them when the play head jumps")
+{
+    // a block is two ticks
+    auto playHead = createTestPlayHead();
+
+    // a note every 5 sequencer ticks, which lasts 2.5 ticks (so its note off is rounded to the next tick)
+    const auto block = createFileWithNotes (100, 10);
+    auto file = MappedMidiFile { block.getData(), block.getSize(), 48 };
+
+    auto player = MidiFilePlayerMidiSource {};
+    player.setFile (&file);
+
+    auto buffer = juce::MidiBuffer {};
+    auto numNoteOns = 0;
+    auto numNoteOffs = 0;
+
+    playBlocks (playHead, 50, [&] (int) {
+        buffer.clear();
+        player.fillNextMidiBuffer (playHead, buffer, testBlockSize);
+
+        for (auto&& metadata : buffer)
+        {
+            auto message = metadata.getMessage();
+            auto tick = getTickOfSample (playHead, metadata.samplePosition);
+
+            if (message.isNoteOn())
+            {
+                CHECK (tick % 5 == 0);
+                CHECK (metadata.samplePosition % testSamplesPerTick == 0);
+                ++numNoteOns;
+            }
+            else if (message.isNoteOff())
+            {
+                CHECK (tick % 5 == 3);
+                ++numNoteOffs;
+            }
+        }
+    });
+
+    // 100 ticks have been played
+    CHECK (numNoteOns == 20);
+    CHECK (numNoteOffs == 20);
+
+    // the note at tick 100 is still sounding when the play head jumps back, so it stops before the first note plays again
+    playHead.setPositionInTicks (100);
+    buffer.clear();
+    player.fillNextMidiBuffer (playHead, buffer, testBlockSize);
+    playHead.setPositionInTicks (0);
+    buffer.clear();
+    player.fillNextMidiBuffer (playHead, buffer, testBlockSize);
+
+    REQUIRE (buffer.getNumEvents() == 2);
+    auto it = buffer.begin();
+    CHECK ((*it).getMessage().isNoteOff());
+    CHECK ((*++it).getMessage().isNoteOn());
+}
+
+
+TEST_CASE ("mapped midi file refuses files it can't play")
+{
+    const auto garbage = std::string { "not a midi file at all" };
+    CHECK_THROWS_AS ((MappedMidiFile { garbage.data(), garbage.size(), 48 }), MappedMidiFile::LoadError);
+
+    const auto smpte = std::vector<uint8_t> { 'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0xe7, 40 };
+    CHECK_THROWS_AS ((MappedMidiFile { smpte.data(), smpte.size(), 48 }), MappedMidiFile::LoadError);
+}
@@ -0,0 +1,220 @@
+// Written by Wouter Ensink
+
+#include <catch2/catch_all.hpp>
+#include <console_synth/midi/midi_input_router.h>
+
+
+// the devices can't be opened in a test, so their nodes are added like the router adds them when it opens a device
+static void addInput (MidiInputRouter& router, const juce::String& name, int source)
+{
+    auto input = juce::ValueTree { IDs::midiInput };
+    input.setProperty (IDs::name, name, nullptr);
+    input.setProperty (IDs::source, source, nullptr);
+    router.getState().appendChild (input, nullptr);
+}
+
+
+static std::vector<std::pair<int, juce::MidiMessage>> getEvents (const juce::MidiBuffer& buffer)
+{
+    auto events = std::vector<std::pair<int, juce::MidiMessage>> {};
+
+    for (auto&& metadata : buffer)
+        events.emplace_back (metadata.samplePosition, metadata.getMessage());
+
+    return events;
+}
+
+
+struct RouterTestSetup
+{
+    static constexpr auto sampleRate = 48'000.0;
+    static constexpr auto blockSize = 480;
+    static constexpr auto blockDuration = blockSize / sampleRate;
+
+    juce::ValueTree parent { "parent" };
+    MidiInputRouter router { parent };
+    int numBlocks = 0;
+
+    RouterTestSetup()
+    {
+        router.prepareToPlay (sampleRate, blockSize);
+        addInput (router, "keys", 0);
+        addInput (router, "pads", 1);
+
+        // the first block only starts the clock
+        router.processNextBlock (blockSize, 1.0);
+    }
+
+    // the callbacks come in right on time here, so the midi comes out exactly one block (the latency) after it came in
+    void playBlock()
+    {
+        router.processNextBlock (blockSize, 1.0 + ++numBlocks * blockDuration);
+    }
+};
+
+
+TEST_CASE ("midi inputs are routed per channel")
+{
+    auto setup = RouterTestSetup {};
+    auto& router = setup.router;
+
+    REQUIRE (router.setRoute ("keys", 0, 1));
+    REQUIRE (router.setRoute ("keys", 10, 2));
+    REQUIRE (router.setRoute ("pads", 0, 3));
+    REQUIRE_FALSE (router.setRoute ("drums", 0, 0));
+
+    router.addMessage (0, juce::MidiMessage::noteOn (1, 60, (uint8_t) 100).withTimeStamp (1.001));
+    router.addMessage (0, juce::MidiMessage::noteOn (10, 36, (uint8_t) 100).withTimeStamp (1.002));
+    router.addMessage (1, juce::MidiMessage::noteOn (5, 48, (uint8_t) 100).withTimeStamp (1.003));
+
+    // nothing is routed from this source, so it's ignored
+    router.addMessage (2, juce::MidiMessage::noteOn (1, 72, (uint8_t) 100).withTimeStamp (1.004));
+
+    setup.playBlock();
+
+    auto track1 = getEvents (router.getMidiForTrack (1));
+    auto track2 = getEvents (router.getMidiForTrack (2));
+    auto track3 = getEvents (router.getMidiForTrack (3));
+
+    REQUIRE (track1.size() == 1);
+    REQUIRE (track2.size() == 1);
+    REQUIRE (track3.size() == 1);
+    CHECK (track1[0].second.getNoteNumber() == 60);
+    CHECK (track2[0].second.getNoteNumber() == 36);
+    CHECK (track3[0].second.getNoteNumber() == 48);
+    CHECK (router.getMidiForTrack (0).isEmpty());
+    CHECK (router.getMidiForTrack (-1).isEmpty());
+    CHECK (router.getMidiForTrack (MidiInputRouter::maxNumTracks).isEmpty());
+
+    SECTION ("a new route replaces the old one")
+    {
+        REQUIRE (router.setRoute ("keys", 0, 4));
+        router.addMessage (0, juce::MidiMessage::noteOn (1, 60, (uint8_t) 100).withTimeStamp (1.001));
+        setup.playBlock();
+
+        CHECK (router.getMidiForTrack (1).isEmpty());
+        CHECK (getEvents (router.getMidiForTrack (4)).size() == 1);
+    }
+
+    SECTION ("removing the input removes its routes")
+    {
+        router.getState().removeAllChildren (nullptr);
+        router.addMessage (0, juce::MidiMessage::noteOn (1, 60, (uint8_t) 100).withTimeStamp (1.001));
+        setup.playBlock();
+
+        CHECK (router.getMidiForTrack (1).isEmpty());
+    }
+}
+
+
+TEST_CASE ("midi of multiple inputs is merged in time stamp order")
+{
+    auto setup = RouterTestSetup {};
+    auto& router = setup.router;
+    router.setRoute ("keys", 0, 0);
+    router.setRoute ("pads", 0, 0);
+
+    // each input in order, but the inputs mixed up, like two devices calling back at the same time
+    router.addMessage (0, juce::MidiMessage::noteOn (1, 1, (uint8_t) 100).withTimeStamp (1.0));
+    router.addMessage (0, juce::MidiMessage::noteOn (1, 3, (uint8_t) 100).withTimeStamp (1.004));
+    router.addMessage (1, juce::MidiMessage::noteOn (1, 2, (uint8_t) 100).withTimeStamp (1.002));
+    router.addMessage (0, juce::MidiMessage::noteOn (1, 5, (uint8_t) 100).withTimeStamp (1.008));
+    router.addMessage (1, juce::MidiMessage::noteOn (1, 4, (uint8_t) 100).withTimeStamp (1.006));
+
+    setup.playBlock();
+
+    auto events = getEvents (router.getMidiForTrack (0));
+    REQUIRE (events.size() == 5);
+
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+        CHECK (events[i].second.getNoteNumber() == (int) i + 1);
+
+        // one block later than it came in
+        CHECK (std::abs (events[i].first - (int) i * 96) <= 1);
+    }
+}
+
+
+TEST_CASE ("midi inputs drop what doesn't fit")
+{
+    auto setup = RouterTestSetup {};
+    auto& router = setup.router;
+    router.setRoute ("keys", 0, 0);
+
+    SECTION ("sysex")
+    {
+        const uint8_t sysexData[] = { 1, 2, 3, 4 };
+        CHECK_FALSE (router.addMessage (0, juce::MidiMessage::createSysExMessage (sysexData, 4)));
+        CHECK (router.getNumDropped() == 1);
+
+        setup.playBlock();
+        CHECK (router.getMidiForTrack (0).isEmpty());
+    }
+
+    SECTION ("a full queue")
+    {
+        const auto noteOn = juce::MidiMessage::noteOn (1, 60, (uint8_t) 100).withTimeStamp (1.001);
+
+        for (auto i = size_t { 0 }; i < MidiInputRouter::maxNumEventsPerBlock; ++i)
+            REQUIRE (router.addMessage (0, noteOn));
+
+        CHECK_FALSE (router.addMessage (0, noteOn));
+        CHECK (router.getNumDropped() == 1);
+
+        // what did fit all goes to the one track in the same block
+        setup.playBlock();
+        CHECK (getEvents (router.getMidiForTrack (0)).size() == MidiInputRouter::maxNumEventsPerBlock);
+    }
+}
+
+
+TEST_CASE ("live midi has a fixed latency, however late the callbacks are")
+{
+    static constexpr auto sampleRate = 48'000.0;
+    static constexpr auto blockSize = 480;
+    static constexpr auto blockDuration = blockSize / sampleRate;
+
+    auto parent = juce::ValueTree { "parent" };
+    auto router = MidiInputRouter { parent };
+    router.prepareToPlay (sampleRate, blockSize);
+    addInput (router, "keys", 0);
+    router.setRoute ("keys", 0, 0);
+
+    // the audio thread mostly wakes up a little late, but sometimes up to 80% of a block
+    auto random = juce::Random { 42 };
+
+    auto getCallbackTime = [&random] (int block) {
+        auto lateness = random.nextDouble() < 0.05 ? 0.8 : 0.1;
+        return 1.0 + block * blockDuration + random.nextDouble() * lateness * blockDuration;
+    };
+
+    // an event somewhere in every block, the distance between where it was played and its time stamp should be the same
+    auto latencies = std::vector<double> {};
+
+    for (auto block = 0; block < 2000; ++block)
+    {
+        const auto callbackTime = getCallbackTime (block);
+        router.processNextBlock (blockSize, callbackTime);
+
+        for (auto&& metadata : router.getMidiForTrack (0))
+        {
+            const auto eventBlock = block - (block - metadata.getMessage().getNoteNumber()) % 100;
+            const auto timeStamp = 1.0 + eventBlock * blockDuration + 0.37 * blockDuration;
+            const auto playedAt = 1.0 + block * blockDuration + metadata.samplePosition / sampleRate;
+
+            if (block > 1000)
+                latencies.push_back ((playedAt - timeStamp) * sampleRate);
+        }
+
+        // the event happens after this callback, the note number is the block it's in (modulo 100, to fit in midi)
+        const auto timeStamp = 1.0 + block * blockDuration + 0.37 * blockDuration;
+        router.addMessage (0, juce::MidiMessage::noteOn (1, block % 100, (uint8_t) 100).withTimeStamp (timeStamp));
+    }
+
+    REQUIRE (latencies.size() > 900);
+
+    // one block, with a few samples of jitter instead of most of a block
+    for (auto latency : latencies)
+        CHECK (std::abs (latency - blockSize) < 8.0);
+}
@@ -0,0 +1,221 @@
+// Written by Wouter Ensink
+
+#include <catch2/catch_all.hpp>
+#include <console_synth/midi/midi_processors.h>
+#include "test_play_head.h"
+
+
+struct TestNote
+{
+    uint64_t tick;
+    bool isNoteOn;
+    int note;
+
+    bool operator== (const TestNote& other) const
+    {
+        return tick == other.tick && isNoteOn == other.isNoteOn && note == other.note;
+    }
+};
+
+
+// plays the notes (at the samples of their ticks, see test_play_head.h) through the processor, a block is 2 ticks.
+// when it's not playing, the play head stays where it is
+static std::vector<TestNote> play (MidiProcessor& processor, const std::vector<TestNote>& notes, int numBlocks, bool isPlaying = true)
+{
+    auto playHead = createTestPlayHead();
+    auto buffer = juce::MidiBuffer {};
+    auto output = std::vector<TestNote> {};
+
+    for (auto block = 0; block < numBlocks; ++block)
+    {
+        const auto firstTick = (uint64_t) block * 2;
+        buffer.clear();
+
+        for (const auto& note : notes)
+            if (note.tick >= firstTick && note.tick < firstTick + 2)
+                buffer.addEvent (note.isNoteOn ? juce::MidiMessage::noteOn (1, note.note, (juce::uint8) 100) : juce::MidiMessage::noteOff (1, note.note),
+                                 (int) (note.tick - firstTick) * testSamplesPerTick);
+
+        processor.processMidi (playHead, isPlaying, buffer, testBlockSize);
+
+        for (auto&& metadata : buffer)
+        {
+            auto message = metadata.getMessage();
+            output.push_back ({ firstTick + (uint64_t) (metadata.samplePosition / testSamplesPerTick), message.isNoteOn(), message.getNoteNumber() });
+        }
+
+        if (isPlaying)
+            playHead.advanceDeviceBuffer();
+    }
+
+    return output;
+}
+
+
+TEST_CASE ("chord memory plays a chord for every note and keeps shared notes until the last chord stops")
+{
+    auto settings = MidiProcessorSettings {};
+    settings.numChordNotes = 3;
+    settings.chordIntervals = { 0, 4, 7 };
+
+    auto chordMemory = ChordMemoryProcessor {};
+    chordMemory.setSettings (&settings);
+
+    const auto output = play (chordMemory, { { 0, true, 60 }, { 2, true, 53 }, { 4, false, 60 }, { 6, false, 53 } }, 5);
+
+    CHECK (output == std::vector<TestNote> {
+               { 0, true, 60 }, { 0, true, 64 }, { 0, true, 67 },
+               { 2, true, 53 }, { 2, true, 57 }, // 60 is already playing
+               { 4, false, 64 }, { 4, false, 67 },
+               { 6, false, 53 }, { 6, false, 57 }, { 6, false, 60 } });
+}
+
+
+TEST_CASE ("arpeggiator plays the held notes on the grid of the play head, also when the sequencer is stopped")
+{
+    auto settings = MidiProcessorSettings {};
+    settings.arpeggiatorMode = ArpeggiatorMode::up;
+    settings.arpeggiatorRateTicks = 12;
+    settings.arpeggiatorGate = 0.5;
+    settings.arpeggiatorOctaves = 2;
+
+    // the notes are held from tick 1, so the first step is at tick 12, the last note stops when the notes are released
+    const auto notes = std::vector<TestNote> { { 1, true, 64 }, { 1, true, 60 }, { 55, false, 60 }, { 55, false, 64 } };
+
+    for (auto isPlaying : { true, false })
+    {
+        auto arpeggiator = ArpeggiatorProcessor {};
+        arpeggiator.setSettings (&settings);
+
+        CHECK (play (arpeggiator, notes, 30, isPlaying) == std::vector<TestNote> {
+                   { 12, true, 60 }, { 18, false, 60 },
+                   { 24, true, 64 }, { 30, false, 64 },
+                   { 36, true, 72 }, { 42, false, 72 },
+                   { 48, true, 76 }, { 54, false, 76 } });
+    }
+
+    settings.arpeggiatorMode = ArpeggiatorMode::upDown;
+    settings.arpeggiatorOctaves = 1;
+    settings.arpeggiatorGate = 1.0;
+
+    auto arpeggiator = ArpeggiatorProcessor {};
+    arpeggiator.setSettings (&settings);
+    auto output = play (arpeggiator, { { 0, true, 60 }, { 0, true, 64 }, { 0, true, 67 } }, 40);
+
+    auto played = std::vector<int> {};
+
+    for (const auto& note : output)
+        if (note.isNoteOn)
+            played.push_back (note.note);
+
+    CHECK (played == std::vector<int> { 60, 64, 67, 64, 60, 64, 67 });
+}
+
+
+TEST_CASE ("note repeat plays a note right away and repeats it on the grid while it's held")
+{
+    auto settings = MidiProcessorSettings {};
+    settings.repeatRateTicks = 12;
+    settings.repeatGate = 0.5;
+
+    auto noteRepeat = NoteRepeatProcessor {};
+    noteRepeat.setSettings (&settings);
+
+    const auto output = play (noteRepeat, { { 0, true, 60 }, { 27, false, 60 }, { 30, false, 62 } }, 30);
+
+    // the note off of a note that wasn't held goes through
+    CHECK (output == std::vector<TestNote> {
+               { 0, true, 60 }, { 6, false, 60 },
+               { 12, true, 60 }, { 18, false, 60 },
+               { 24, true, 60 }, { 27, false, 60 },
+               { 30, false, 62 } });
+}
+
+
+TEST_CASE ("midi processors pass the midi through without settings")
+{
+    const auto notes = std::vector<TestNote> { { 0, true, 60 }, { 3, false, 60 } };
+    auto settings = MidiProcessorSettings {};
+
+    auto chordMemory = ChordMemoryProcessor {};
+    auto arpeggiator = ArpeggiatorProcessor {};
+    auto noteRepeat = NoteRepeatProcessor {};
+    chordMemory.setSettings (&settings);
+    arpeggiator.setSettings (&settings);
+    noteRepeat.setSettings (&settings);
+
+    CHECK (play (chordMemory, notes, 4) == notes);
+    CHECK (play (arpeggiator, notes, 4) == notes);
+    CHECK (play (noteRepeat, notes, 4) == notes);
+}
+
+
+// plays the note ons, then the note offs of all notes in the next block, and checks that every note stops
+// and that the processor never leaves more events in the buffer than it may
+static void checkEveryNoteStops (MidiProcessor& processor, int numNoteOns)
+{
+    auto playHead = createTestPlayHead();
+    auto buffer = juce::MidiBuffer {};
+    auto soundingNotes = std::bitset<128> { 0 };
+
+    auto processBlock = [&] {
+        processor.processMidi (playHead, true, buffer, testBlockSize);
+        CHECK ((size_t) buffer.getNumEvents() <= MidiProcessor::maxNumOutputEventsPerBlock);
+
+        for (auto&& metadata : buffer)
+        {
+            auto message = metadata.getMessage();
+            soundingNotes.set ((size_t) message.getNoteNumber(), message.isNoteOn());
+        }
+
+        playHead.advanceDeviceBuffer();
+    };
+
+    for (auto i = 0; i < numNoteOns; ++i)
+        buffer.addEvent (juce::MidiMessage::noteOn (1, 20 + i % 100, (juce::uint8) 100), i % testBlockSize);
+
+    // the first notes stop in the same block, after all note ons
+    for (auto note = 20; note < 40; ++note)
+        buffer.addEvent (juce::MidiMessage::noteOff (1, note), testBlockSize - 1);
+
+    processBlock();
+    buffer.clear();
+
+    for (auto note = 40; note < 120; ++note)
+        buffer.addEvent (juce::MidiMessage::noteOff (1, note), 0);
+
+    processBlock();
+    CHECK (soundingNotes.none());
+}
+
+
+TEST_CASE ("midi processors drop note ons before note offs when a block has more events than they take")
+{
+    auto settings = MidiProcessorSettings {};
+
+    SECTION ("without settings")
+    {
+        auto chordMemory = ChordMemoryProcessor {};
+        chordMemory.setSettings (&settings);
+        checkEveryNoteStops (chordMemory, 600);
+    }
+
+    SECTION ("chord memory playing a chord of 8 notes for every note")
+    {
+        settings.numChordNotes = 8;
+        settings.chordIntervals = { 0, 2, 4, 5, 7, 9, 11, 12 };
+
+        auto chordMemory = ChordMemoryProcessor {};
+        chordMemory.setSettings (&settings);
+        checkEveryNoteStops (chordMemory, 500);
+    }
+
+    SECTION ("note repeat")
+    {
+        settings.repeatRateTicks = 1;
+
+        auto noteRepeat = NoteRepeatProcessor {};
+        noteRepeat.setSettings (&settings);
+        checkEveryNoteStops (noteRepeat, 600);
+    }
+}
@@ -3,6 +3,8 @@
 
 #include <catch2/catch_all.hpp>
 #include <console_synth/midi/midi_message_queue.h>
+#include <console_synth/utility/spsc_queue.h>
+#include <thread>
 
 
 TEST_CASE ("single midi message")
@@ -98,4 +100,118 @@ TEST_CASE ("multiple pushes, multiple times")
         // the number of handled messages must be equal to the number of messages added to the queue
         REQUIRE (callbackNumber == messages.size());
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE ("midi events are plain data")
+{
+    auto event = MidiEvent {};
+    REQUIRE (MidiEvent::fromMessage (juce::MidiMessage::noteOn (2, 64, (uint8_t) 90).withTimeStamp (1.5), event, 3));
+
+    auto message = event.toMessage();
+    CHECK (message.isNoteOn());
+    CHECK (message.getChannel() == 2);
+    CHECK (message.getNoteNumber() == 64);
+    CHECK (message.getVelocity() == 90);
+    CHECK (message.getTimeStamp() == 1.5);
+    CHECK (event.source == 3);
+
+    auto sysexData = std::array<uint8_t, 4> { 1, 2, 3, 4 };
+    CHECK_FALSE (MidiEvent::fromMessage (juce::MidiMessage::createSysExMessage (sysexData.data(), (int) sysexData.size()), event));
+}
+
+
+TEST_CASE ("full queues drop and count messages")
+{
+    auto queue = MidiMessageQueue (4);
+
+    for (auto i = 0; i < 6; ++i)
+        queue.addMessage (juce::MidiMessage::noteOn (1, i, (uint8_t) 100));
+
+    auto numbers = std::vector<int> {};
+    queue.handleAllPendingMessages ([&numbers] (auto message) { numbers.push_back (message.getNoteNumber()); });
+
+    CHECK (numbers == std::vector<int> { 0, 1, 2, 3 });
+    CHECK (queue.getNumDropped() == 2);
+
+    auto spsc = SpscQueue<MidiEvent> (2);
+    CHECK (spsc.push ({}));
+    CHECK (spsc.push ({}));
+    CHECK_FALSE (spsc.push ({}));
+    CHECK (spsc.getNumDropped() == 1);
+}
+
+
+// every producer sends its own numbers in order, so the consumer can check that every message
+// of a producer arrives exactly once and in order (or was counted as dropped)
+template <typename Queue>
+void runContentionStressTest (Queue& queue, int numProducers, int numMessagesPerProducer)
+{
+    auto startSignal = std::atomic<bool> { false };
+    auto producers = std::vector<std::thread> {};
+    auto numRejected = std::atomic<int> { 0 };
+
+    for (auto producer = 0; producer < numProducers; ++producer)
+    {
+        producers.emplace_back ([&, producer] {
+            while (! startSignal.load())
+                std::this_thread::yield();
+
+            for (auto i = 0; i < numMessagesPerProducer; ++i)
+            {
+                auto event = MidiEvent { (double) i, { 0x90, (uint8_t) (i & 0x7f), 100 }, 3, (uint8_t) producer };
+
+                if (! queue.push (event))
+                    numRejected.fetch_add (1);
+
+                if (i % 64 == 0)
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    auto lastReceived = std::vector<double> ((size_t) numProducers, -1.0);
+    auto numReceived = 0;
+    auto batch = std::array<MidiEvent, 32> {};
+
+    startSignal.store (true);
+
+    auto areProducersDone = false;
+
+    while (! areProducersDone || numReceived + numRejected.load() < numProducers * numMessagesPerProducer)
+    {
+        auto numEvents = queue.popBatch (batch.data(), batch.size());
+
+        for (size_t i = 0; i < numEvents; ++i)
+        {
+            auto& event = batch[i];
+            REQUIRE (event.timeStamp > lastReceived[event.source]);
+            REQUIRE (event.data[1] == ((int) event.timeStamp & 0x7f));
+            lastReceived[event.source] = event.timeStamp;
+        }
+
+        numReceived += (int) numEvents;
+
+        if (! areProducersDone && numReceived + numRejected.load() == numProducers * numMessagesPerProducer)
+            areProducersDone = true;
+    }
+
+    for (auto& producer : producers)
+        producer.join();
+
+    CHECK (numReceived + (int) queue.getNumDropped() == numProducers * numMessagesPerProducer);
+    CHECK ((int) queue.getNumDropped() == numRejected.load());
+}
+
+
+TEST_CASE ("mpsc queue under contention")
+{
+    auto queue = MpscQueue<MidiEvent> (256);
+    runContentionStressTest (queue, 4, 200'000);
+}
+
+
+TEST_CASE ("spsc queue under contention")
+{
+    auto queue = SpscQueue<MidiEvent> (256);
+    runContentionStressTest (queue, 1, 500'000);
+}
@@ -0,0 +1,174 @@
+// Written by Wouter Ensink
+
+#include <catch2/catch_all.hpp>
+#include <console_synth/sequencer/melody.h>
+#include <console_synth/sequencer/midi_recorder.h>
+
+
+struct RecorderTestSetup
+{
+    // at 120 bpm, a tick takes exactly 500 samples, which is one block
+    static constexpr auto sampleRate = 48'000.0;
+    static constexpr auto blockSize = 500;
+    static constexpr auto loopEnd = uint64_t { 48 * 4 };
+
+    juce::ValueTree trackState { IDs::track };
+    Melody melody { trackState };
+    MidiRecorder recorder { trackState.getChildWithName (IDs::melody) };
+    TempoMap tempoMap { 120.0, sampleRate, 48 };
+    PlayHead playHead;
+    juce::MidiBuffer midi;
+
+    RecorderTestSetup()
+    {
+        playHead.setSampleRate (sampleRate);
+        playHead.setBlockSizeSamples (blockSize);
+        playHead.setTempoMap (&tempoMap, 1);
+        playHead.setLooping (0, loopEnd);
+        playHead.setPositionInTicks (0);
+    }
+
+    // records the block at the tick, with a note on (or off) at the sample
+    void playNote (uint64_t tick, int sample, int noteNumber, bool isNoteOn)
+    {
+        playHead.setPositionInTicks (tick);
+        midi.clear();
+
+        if (isNoteOn)
+            midi.addEvent (juce::MidiMessage::noteOn (1, noteNumber, (uint8_t) 100), sample);
+        else
+            midi.addEvent (juce::MidiMessage::noteOff (1, noteNumber), sample);
+
+        recorder.recordBlock (midi, playHead);
+    }
+
+    [[nodiscard]] juce::ValueTree getMelodyState() const { return trackState.getChildWithName (IDs::melody); }
+};
+
+
+TEST_CASE ("play head knows the tick of every sample")
+{
+    auto setup = RecorderTestSetup {};
+
+    setup.playHead.setPositionInTicks (10);
+    CHECK_THAT (setup.playHead.getTickAtSample (0), Catch::Matchers::WithinAbs (10.0, 1.0e-6));
+    CHECK_THAT (setup.playHead.getTickAtSample (250), Catch::Matchers::WithinAbs (10.5, 1.0e-6));
+
+    // half way through the last tick of the loop, the second half of the block is after the loop wrapped
+    setup.playHead.setTimelinePositionSubSamples (setup.tempoMap.getPositionOfTick (191.5));
+    CHECK_THAT (setup.playHead.getTickAtSample (100), Catch::Matchers::WithinAbs (191.7, 1.0e-6));
+    CHECK_THAT (setup.playHead.getTickAtSample (300), Catch::Matchers::WithinAbs (0.1, 1.0e-6));
+}
+
+
+TEST_CASE ("recorded notes end up in the melody")
+{
+    auto setup = RecorderTestSetup {};
+    auto undoManager = juce::UndoManager {};
+
+    setup.playNote (10, 250, 60, true);
+
+    // the note isn't finished yet, so nothing is added
+    CHECK (setup.recorder.commitRecordedNotes (&undoManager) == 0);
+
+    setup.playNote (20, 0, 60, false);
+    setup.playNote (30, 0, 64, true);
+    setup.playNote (34, 0, 64, false);
+
+    undoManager.beginNewTransaction();
+    REQUIRE (setup.recorder.commitRecordedNotes (&undoManager) == 2);
+
+    auto melodyState = setup.getMelodyState();
+    REQUIRE (melodyState.getNumChildren() == 2);
+
+    auto first = melodyState.getChild (0);
+    CHECK ((int) first.getProperty (IDs::midiNoteNumber) == 60);
+    CHECK ((int) first.getProperty (IDs::startTimeTicks) == 10);
+    CHECK ((int) first.getProperty (IDs::lengthTicks) == 10);
+    CHECK ((int) first.getProperty (IDs::velocity) == 100);
+
+    auto second = melodyState.getChild (1);
+    CHECK ((int) second.getProperty (IDs::startTimeTicks) == 30);
+    CHECK ((int) second.getProperty (IDs::lengthTicks) == 4);
+
+    // the melody plays what was recorded
+    auto numEvents = 0;
+    setup.melody.forEachEvent ([&numEvents] (auto&) { ++numEvents; });
+    CHECK (numEvents == 4);
+
+    // the notes of one commit are undone in one go
+    undoManager.undo();
+    CHECK (melodyState.getNumChildren() == 0);
+}
+
+
+TEST_CASE ("recorded notes don't go past the loop end")
+{
+    auto setup = RecorderTestSetup {};
+
+    setup.playNote (190, 0, 60, true);
+    setup.playNote (3, 0, 60, false);
+
+    REQUIRE (setup.recorder.commitRecordedNotes (nullptr) == 1);
+    CHECK ((int) setup.getMelodyState().getChild (0).getProperty (IDs::lengthTicks) == 2);
+}
+
+
+TEST_CASE ("held notes end when the recording stops")
+{
+    auto setup = RecorderTestSetup {};
+
+    setup.playNote (10, 0, 60, true);
+    setup.playNote (11, 0, 62, true);
+
+    setup.playHead.setPositionInTicks (15);
+    setup.recorder.endHeldNotes (setup.playHead);
+
+    REQUIRE (setup.recorder.commitRecordedNotes (nullptr) == 2);
+    CHECK ((int) setup.getMelodyState().getChild (0).getProperty (IDs::lengthTicks) == 5);
+    CHECK ((int) setup.getMelodyState().getChild (1).getProperty (IDs::lengthTicks) == 4);
+
+    // nothing is held anymore
+    setup.recorder.endHeldNotes (setup.playHead);
+    CHECK (setup.recorder.commitRecordedNotes (nullptr) == 0);
+}
+
+
+TEST_CASE ("recording drops note ons before it runs out of room for note offs")
+{
+    auto setup = RecorderTestSetup {};
+
+    SECTION ("a single note")
+    {
+        for (auto i = 0; i < (int) MidiRecorder::queueSize; ++i)
+            setup.playNote (10, 0, 60, i % 2 == 0);
+
+        CHECK (setup.recorder.getNumDropped() == 0);
+        setup.playNote (10, 0, 60, false);
+        CHECK (setup.recorder.getNumDropped() == 1);
+    }
+
+    SECTION ("the held notes all keep room for their note off")
+    {
+        for (auto note = 60; note < 63; ++note)
+            setup.playNote (10, 0, note, true);
+
+        // note offs of a note that isn't held, until there's room for the three note offs and one more note
+        for (auto i = 0; i < (int) MidiRecorder::queueSize - 3 - 5; ++i)
+            setup.playNote (10, 0, 70, false);
+
+        // the new note needs room for itself and four note offs
+        setup.playNote (11, 0, 63, true);
+        CHECK (setup.recorder.getNumDropped() == 0);
+
+        // only the note offs fit now, also a note on of a note that is already held, since it takes a place itself
+        setup.playNote (11, 0, 64, true);
+        setup.playNote (11, 0, 60, true);
+        CHECK (setup.recorder.getNumDropped() == 2);
+
+        setup.playHead.setPositionInTicks (20);
+        setup.recorder.endHeldNotes (setup.playHead);
+        CHECK (setup.recorder.getNumDropped() == 2);
+        CHECK (setup.recorder.commitRecordedNotes (nullptr) == 4);
+    }
+}
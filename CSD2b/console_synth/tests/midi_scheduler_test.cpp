@@ -0,0 +1,345 @@
+// Written by Wouter Ensink
+
+#include <catch2/catch_all.hpp>
+#include <console_synth/sequencer/midi_scheduler.h>
+#include <console_synth/sequencer/track.h>
+#include <thread>
+
+
+struct SchedulerTestSetup
+{
+    static constexpr auto sampleRate = 48'000.0;
+    static constexpr auto blockSize = 256;
+
+    juce::ValueTree sequencerState { IDs::sequencer };
+    juce::ValueTree patternsState { IDs::patterns };
+    TrackList tracks { sequencerState };
+    PatternList patterns { patternsState };
+    AtomicSnapshot<VersionedTempoMap> tempoMap { std::make_unique<const VersionedTempoMap> (
+        VersionedTempoMap { TempoMap { 120.0, sampleRate, 48 }, 1 }) };
+    MidiScheduler scheduler { tracks, patterns, tempoMap };
+    PlayHead playHead;
+
+    SchedulerTestSetup()
+    {
+        playHead.setSampleRate (sampleRate);
+        playHead.setBlockSizeSamples (blockSize);
+        playHead.setLooping (0, 48 * 4);
+        playHead.setPositionInTicks (0);
+    }
+
+    // plays a block like the sequencer does and returns whether it was scheduled
+    bool playBlock()
+    {
+        auto currentTempoMap = tempoMap.read();
+        playHead.setTempoMap (&currentTempoMap->map, currentTempoMap->version);
+
+        auto isScheduled = scheduler.beginBlock (playHead);
+        playHead.advanceDeviceBuffer();
+        return isScheduled;
+    }
+
+    // plays blocks (giving the scheduler time in between) until one was scheduled
+    bool waitUntilScheduled()
+    {
+        for (auto i = 0; i < 1000; ++i)
+        {
+            if (playBlock())
+                return true;
+
+            std::this_thread::sleep_for (std::chrono::milliseconds (2));
+        }
+
+        return false;
+    }
+};
+
+
+TEST_CASE ("midi scheduler catches up with the audio thread")
+{
+    auto setup = SchedulerTestSetup {};
+    setup.scheduler.setLookaheadBlocks (4);
+
+    // nothing can be scheduled before the audio thread played its first block
+    CHECK_FALSE (setup.playBlock());
+    REQUIRE (setup.waitUntilScheduled());
+
+    // the play head wraps around the loop a few times, the scheduler follows it
+    for (auto block = 0; block < 200; ++block)
+    {
+        std::this_thread::sleep_for (std::chrono::milliseconds (2));
+        CHECK (setup.playBlock());
+    }
+}
+
+
+TEST_CASE ("midi scheduler starts over when the play head changes")
+{
+    auto setup = SchedulerTestSetup {};
+    setup.scheduler.setLookaheadBlocks (4);
+    setup.playBlock();
+    REQUIRE (setup.waitUntilScheduled());
+
+    SECTION ("loop")
+    {
+        setup.playHead.setLooping (0, 48 * 3);
+    }
+
+    SECTION ("tempo")
+    {
+        setup.tempoMap.publish (std::make_unique<const VersionedTempoMap> (VersionedTempoMap { TempoMap { 90.0, SchedulerTestSetup::sampleRate, 48 }, 2 }));
+    }
+
+    SECTION ("block size")
+    {
+        setup.playHead.setBlockSizeSamples (128);
+    }
+
+    // the blocks were scheduled for the old state, so they can't be used
+    std::this_thread::sleep_for (std::chrono::milliseconds (10));
+    CHECK_FALSE (setup.playBlock());
+    CHECK (setup.waitUntilScheduled());
+}
+
+
+TEST_CASE ("midi scheduler does nothing without lookahead")
+{
+    auto setup = SchedulerTestSetup {};
+    setup.scheduler.setLookaheadBlocks (0);
+
+    for (auto block = 0; block < 20; ++block)
+    {
+        std::this_thread::sleep_for (std::chrono::milliseconds (2));
+        CHECK_FALSE (setup.playBlock());
+    }
+}
+
+
+TEST_CASE ("midi scheduler schedules nothing while suspended and starts over when resumed")
+{
+    auto setup = SchedulerTestSetup {};
+    setup.scheduler.setLookaheadBlocks (4);
+    setup.playBlock();
+    REQUIRE (setup.waitUntilScheduled());
+
+    // also the blocks that were scheduled before the suspension aren't used
+    setup.scheduler.setSuspended (true);
+
+    for (auto block = 0; block < 20; ++block)
+    {
+        std::this_thread::sleep_for (std::chrono::milliseconds (2));
+        CHECK_FALSE (setup.playBlock());
+    }
+
+    setup.scheduler.setSuspended (false);
+    CHECK (setup.waitUntilScheduled());
+}
+
+
+TEST_CASE ("a track schedules no more events per block than it made room for")
+{
+    auto track = Track { juce::ValueTree { IDs::track } };
+    auto melodyTree = track.getState().getChildWithName (IDs::melody);
+
+    {
+        // every note number starts on each of the first 5 ticks and is held until the loop end: the groove passes
+        // the first 512 note ons and the loop end adds a note off for every note number on top of those
+        auto batch = ScopedMelodyEditBatch { melodyTree };
+
+        for (auto tick = 0; tick < 5; ++tick)
+        {
+            for (auto number = 0; number < 128; ++number)
+            {
+                auto note = juce::ValueTree { IDs::note };
+                note.setProperty (IDs::midiNoteNumber, number, nullptr);
+                note.setProperty (IDs::startTimeTicks, tick, nullptr);
+                note.setProperty (IDs::lengthTicks, 8 - tick, nullptr);
+                note.setProperty (IDs::velocity, 100, nullptr);
+                melodyTree.appendChild (note, nullptr);
+            }
+        }
+    }
+
+    // at 120 bpm and 48 ticks per quarter note a tick takes 500 samples, so every block plays the whole loop
+    auto tempoMap = TempoMap { 120.0, 48'000.0, 48 };
+    auto playHead = PlayHead {};
+    playHead.setSampleRate (48'000.0);
+    playHead.setBlockSizeSamples (4'000);
+    playHead.setTempoMap (&tempoMap, 1);
+    playHead.setLooping (0, 8);
+    playHead.setPositionInTicks (0);
+
+    auto patternsState = juce::ValueTree { IDs::patterns };
+    auto patterns = PatternList { patternsState };
+    auto currentPatterns = patterns.read();
+    auto scratchBuffer = juce::MidiBuffer {};
+
+    // the blocks have more events than the track made room for, so they aren't scheduled and the queue keeps its room
+    for (auto block = uint64_t { 0 }; block < 9; ++block)
+    {
+        REQUIRE (track.canScheduleBlock());
+        track.scheduleBlock (playHead, *currentPatterns, ScheduledBlock::fromPlayHead (playHead, 1, block * 4'000), scratchBuffer);
+        playHead.advanceDeviceBuffer();
+    }
+
+    CHECK (track.canScheduleBlock());
+}
+
+
+// renders a track like the sequencer does, with the midi of a block scheduled ahead of time or generated by the track itself
+struct TrackRenderer
+{
+    static constexpr auto sampleRate = 48'000.0;
+
+    Track& track;
+    TempoMap tempoMap { 120.0, sampleRate, 48 };
+    PlayHead playHead;
+    juce::ValueTree patternsState { IDs::patterns };
+    PatternList patterns { patternsState };
+    juce::ValueTree sequencerState { IDs::sequencer };
+    MidiInputRouter midiInputs { sequencerState };
+    MeterMap meterMap { 48 };
+    std::vector<std::unique_ptr<Bus>> busses;
+    juce::AudioBuffer<float> audioBuffer;
+    juce::MidiBuffer scratchBuffer;
+    uint64_t samplePosition = 0;
+
+    // at 120 bpm and 48 ticks per quarter note a tick takes 500 samples
+    TrackRenderer (Track& track, int blockSize, uint64_t loopEnd) : track { track }, audioBuffer { 2, blockSize }
+    {
+        playHead.setSampleRate (sampleRate);
+        playHead.setBlockSizeSamples (blockSize);
+        playHead.setTempoMap (&tempoMap, 1);
+        playHead.setLooping (0, loopEnd);
+        playHead.setPositionInTicks (0);
+        track.prepareToPlay (sampleRate, blockSize);
+    }
+
+    void renderBlock (bool isScheduled)
+    {
+        auto currentPatterns = patterns.read();
+        auto block = ScheduledBlock::fromPlayHead (playHead, 1, samplePosition);
+
+        if (isScheduled)
+            track.scheduleBlock (playHead, *currentPatterns, block, scratchBuffer);
+
+        auto renderContext = RenderContext {
+            audioBuffer, midiInputs, playHead, PlayState::playing, sampleRate, {}, meterMap, *currentPatterns, busses, block, isScheduled
+        };
+
+        audioBuffer.clear();
+        track.renderNextBlock (renderContext, -1);
+        playHead.advanceDeviceBuffer();
+        samplePosition += (uint64_t) audioBuffer.getNumSamples();
+    }
+};
+
+
+TEST_CASE ("every note on of a block that's too dense to schedule gets its note off")
+{
+    auto track = Track { juce::ValueTree { IDs::track } };
+    auto melodyTree = track.getState().getChildWithName (IDs::melody);
+
+    {
+        // every note number starts on each of the first 5 ticks and is held until the loop end,
+        // so the note offs at the loop end don't fit in the block anymore
+        auto batch = ScopedMelodyEditBatch { melodyTree };
+
+        for (auto tick = 0; tick < 5; ++tick)
+        {
+            for (auto number = 0; number < 128; ++number)
+            {
+                auto note = juce::ValueTree { IDs::note };
+                note.setProperty (IDs::midiNoteNumber, number, nullptr);
+                note.setProperty (IDs::startTimeTicks, tick, nullptr);
+                note.setProperty (IDs::lengthTicks, 8 - tick, nullptr);
+                note.setProperty (IDs::velocity, 100, nullptr);
+                melodyTree.appendChild (note, nullptr);
+            }
+        }
+    }
+
+    // every block plays the whole loop
+    auto renderer = TrackRenderer { track, 4'000, 8 };
+
+    for (auto block = 0; block < 4; ++block)
+    {
+        renderer.renderBlock (true);
+        CHECK (track.getNumActiveMidiNotes() == 0);
+    }
+}
+
+
+static void checkSequencedNotesStopWhenSwitching (bool startScheduled)
+{
+    auto track = Track { juce::ValueTree { IDs::track } };
+    auto note = juce::ValueTree { IDs::note };
+    note.setProperty (IDs::midiNoteNumber, 60, nullptr);
+    note.setProperty (IDs::startTimeTicks, 2, nullptr);
+    note.setProperty (IDs::lengthTicks, 6, nullptr);
+    note.setProperty (IDs::velocity, 100, nullptr);
+    track.getState().getChildWithName (IDs::melody).appendChild (note, nullptr);
+
+    // blocks of 2 ticks, the note ends at the loop end, where only the set of sources that started it stops it
+    auto renderer = TrackRenderer { track, 1'000, 8 };
+
+    renderer.renderBlock (startScheduled);
+    renderer.renderBlock (startScheduled);
+    CHECK (track.getNumActiveMidiNotes() == 1);
+
+    renderer.renderBlock (! startScheduled);
+    CHECK (track.getNumActiveMidiNotes() == 0);
+
+    // the other set doesn't start the note halfway, and when the loop starts over it plays it again
+    renderer.renderBlock (! startScheduled);
+    CHECK (track.getNumActiveMidiNotes() == 0);
+    renderer.renderBlock (! startScheduled);
+    renderer.renderBlock (! startScheduled);
+    CHECK (track.getNumActiveMidiNotes() == 1);
+}
+
+
+TEST_CASE ("a track stops the sequenced notes when its midi switches between scheduled and generated")
+{
+    SECTION ("from scheduled to generated") { checkSequencedNotesStopWhenSwitching (true); }
+    SECTION ("from generated to scheduled") { checkSequencedNotesStopWhenSwitching (false); }
+}
+
+
+TEST_CASE ("a note that ends at the loop end is stopped right before the loop starts over")
+{
+    auto track = Track { juce::ValueTree { IDs::track } };
+    auto note = juce::ValueTree { IDs::note };
+    note.setProperty (IDs::midiNoteNumber, 60, nullptr);
+    note.setProperty (IDs::startTimeTicks, 2, nullptr);
+    note.setProperty (IDs::lengthTicks, 6, nullptr);
+    note.setProperty (IDs::velocity, 100, nullptr);
+    track.getState().getChildWithName (IDs::melody).appendChild (note, nullptr);
+
+    // the block is 1.5 times the loop of 8 ticks (500 samples each), so the loop wraps at sample 4000
+    auto tempoMap = TempoMap { 120.0, 48'000.0, 48 };
+    auto playHead = PlayHead {};
+    playHead.setSampleRate (48'000.0);
+    playHead.setBlockSizeSamples (6'000);
+    playHead.setTempoMap (&tempoMap, 1);
+    playHead.setLooping (0, 8);
+    playHead.setPositionInTicks (0);
+
+    auto patternsState = juce::ValueTree { IDs::patterns };
+    auto patterns = PatternList { patternsState };
+    auto currentPatterns = patterns.read();
+    auto scratchBuffer = juce::MidiBuffer {};
+
+    track.scheduleBlock (playHead, *currentPatterns, ScheduledBlock::fromPlayHead (playHead, 1, 0), scratchBuffer);
+
+    auto events = std::vector<std::pair<int, bool>> {};
+
+    for (auto&& metadata : scratchBuffer)
+        events.emplace_back (metadata.samplePosition, metadata.getMessage().isNoteOn());
+
+    // the note plays for its full length, then again from the start of the next loop
+    REQUIRE (events.size() == 3);
+    CHECK (events[0] == std::pair { 1'000, true });
+    CHECK (events[1] == std::pair { 3'999, false });
+    CHECK (events[2] == std::pair { 5'000, true });
+}
@@ -0,0 +1,157 @@
+// Written by Wouter Ensink
+
+#include <catch2/catch_all.hpp>
+#include <console_synth/offline_renderer.h>
+#include <console_synth/sequencer/melody_generator.h>
+
+
+static std::unique_ptr<juce::AudioFormatReader> createReader (juce::AudioFormat& format, const juce::File& file)
+{
+    auto reader = std::unique_ptr<juce::AudioFormatReader> (format.createReaderFor (file.createInputStream().release(), true));
+    REQUIRE (reader != nullptr);
+    return reader;
+}
+
+
+static juce::AudioBuffer<float> readSamples (juce::AudioFormatReader& reader)
+{
+    auto buffer = juce::AudioBuffer<float> ((int) reader.numChannels, (int) reader.lengthInSamples);
+    reader.read (&buffer, 0, (int) reader.lengthInSamples, 0, true, true);
+    return buffer;
+}
+
+
+static float getPeakLevel (juce::AudioFormatReader& reader)
+{
+    auto buffer = readSamples (reader);
+    return buffer.getMagnitude (0, buffer.getNumSamples());
+}
+
+
+static void addNoteToFirstTrack (juce::ValueTree& engineState, const MelodyGenerator::Note& note)
+{
+    auto track = engineState.getChildWithName (IDs::sequencer).getChildWithName (IDs::track);
+    auto melody = track.getChildWithName (IDs::melody);
+    REQUIRE (melody.isValid());
+    MelodyGenerator::addNoteToTree (melody, note);
+}
+
+
+TEST_CASE ("offline renderer writes the length of the loops to a wav file")
+{
+    auto engineState = juce::ValueTree { IDs::engine };
+    auto sequencer = Sequencer { engineState };
+    auto renderer = OfflineRenderer { sequencer };
+    auto file = juce::TemporaryFile { ".wav" };
+
+    auto settings = OfflineRenderSettings {};
+    settings.sampleRate = 44'100.0;
+
+    auto result = renderer.renderLoops (file.getFile(), 2, settings);
+
+    // the default loop is a bar of 4/4 at 100 bpm, the loops follow each other without a gap
+    const auto samplesPerTick = 44'100.0 * 60.0 / (100.0 * Sequencer::ticksPerQuarterNote);
+    const auto ticksPerLoop = sequencer.getMeterMap().getTickOfBar (1);
+    CHECK (ticksPerLoop == Sequencer::ticksPerQuarterNote * 4);
+    CHECK (result.numSamples == (uint64_t) std::ceil (2 * (double) ticksPerLoop * samplesPerTick));
+    CHECK (result.numSamples == sequencer.getLengthOfLoopsSamples (2));
+    CHECK (result.getRealtimeFactor() > 0.0);
+    CHECK_FALSE (sequencer.isExporting());
+
+    auto format = juce::WavAudioFormat {};
+    auto reader = createReader (format, file.getFile());
+    CHECK (reader->numChannels == 2);
+    CHECK (reader->sampleRate == 44'100.0);
+    CHECK ((uint64_t) reader->lengthInSamples == result.numSamples);
+}
+
+
+TEST_CASE ("offline renderer renders bars with a tail to a flac file")
+{
+    auto engineState = juce::ValueTree { IDs::engine };
+    auto sequencer = Sequencer { engineState };
+    auto renderer = OfflineRenderer { sequencer };
+    auto file = juce::TemporaryFile { ".flac" };
+
+    auto settings = OfflineRenderSettings {};
+    settings.tailSeconds = 0.5;
+    settings.blockSize = 300;
+
+    auto result = renderer.renderBars (file.getFile(), 3, settings);
+    CHECK (result.numSamples == sequencer.getLengthOfBarsSamples (3) + 24'000);
+
+    auto format = juce::FlacAudioFormat {};
+    auto reader = createReader (format, file.getFile());
+    CHECK ((uint64_t) reader->lengthInSamples == result.numSamples);
+}
+
+
+TEST_CASE ("offline renderer plays the song from the start every time")
+{
+    auto engineState = juce::ValueTree { IDs::engine };
+    auto sequencer = Sequencer { engineState };
+    auto renderer = OfflineRenderer { sequencer };
+    auto format = juce::WavAudioFormat {};
+
+    SECTION ("an empty song is silent")
+    {
+        auto file = juce::TemporaryFile { ".wav" };
+        renderer.renderLoops (file.getFile(), 1);
+        CHECK (getPeakLevel (*createReader (format, file.getFile())) == 0.0f);
+    }
+
+    SECTION ("the notes of the melody are rendered, also when rendering again")
+    {
+        addNoteToFirstTrack (engineState, { 60, 0, 48, 100 });
+
+        for (auto i = 0; i < 2; ++i)
+        {
+            auto file = juce::TemporaryFile { ".wav" };
+            renderer.renderLoops (file.getFile(), 1);
+            CHECK (getPeakLevel (*createReader (format, file.getFile())) > 0.0f);
+        }
+    }
+}
+
+
+TEST_CASE ("offline renderer gives the same samples every time, however far the midi scheduler got")
+{
+    auto engineState = juce::ValueTree { IDs::engine };
+    auto sequencer = Sequencer { engineState };
+    auto renderer = OfflineRenderer { sequencer };
+    auto format = juce::WavAudioFormat {};
+
+    for (auto i = 0; i < 8; ++i)
+        addNoteToFirstTrack (engineState, { 60 + i, i * 24, 20, 100 });
+
+    // small blocks, so the render loop is many blocks ahead of (or behind) the scheduler thread
+    auto settings = OfflineRenderSettings {};
+    settings.blockSize = 64;
+
+    auto render = [&] {
+        auto file = juce::TemporaryFile { ".wav" };
+        renderer.renderLoops (file.getFile(), 2, settings);
+        return readSamples (*createReader (format, file.getFile()));
+    };
+
+    const auto first = render();
+    const auto second = render();
+
+    REQUIRE (first.getNumSamples() == second.getNumSamples());
+    CHECK (first.getMagnitude (0, first.getNumSamples()) > 0.0f);
+
+    for (auto channel = 0; channel < first.getNumChannels(); ++channel)
+        for (auto i = 0; i < first.getNumSamples(); ++i)
+            REQUIRE (first.getSample (channel, i) == second.getSample (channel, i));
+}
+
+
+TEST_CASE ("offline renderer throws when the file can't be written")
+{
+    auto engineState = juce::ValueTree { IDs::engine };
+    auto sequencer = Sequencer { engineState };
+    auto renderer = OfflineRenderer { sequencer };
+
+    auto file = juce::File::getSpecialLocation (juce::File::tempDirectory).getChildFile ("no_such_folder/render.wav");
+    CHECK_THROWS_AS (renderer.renderLoops (file, 1), OfflineRenderer::RenderError);
+}
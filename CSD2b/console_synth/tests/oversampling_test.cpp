@@ -0,0 +1,145 @@
+// Written by Wouter Ensink
+
+#include <catch2/catch_all.hpp>
+#include <console_synth/audio/oversampling.h>
+#include <console_synth/audio/saturator.h>
+
+
+// renders a sine through the processor and returns the first channel of the output
+template <typename ProcessorType>
+std::vector<float> renderSine (ProcessorType& processor, double frequency, double sampleRate, int numBlocks, int blockSize = 512)
+{
+    processor.prepareToPlay (sampleRate, blockSize);
+
+    auto buffer = juce::AudioBuffer<float> (2, blockSize);
+    auto midi = juce::MidiBuffer {};
+    auto output = std::vector<float> {};
+    auto phaseIncrement = juce::MathConstants<double>::twoPi * frequency / sampleRate;
+    auto phase = 0.0;
+
+    for (auto block = 0; block < numBlocks; ++block)
+    {
+        for (auto i = 0; i < blockSize; ++i)
+        {
+            auto sample = (float) std::sin (phase);
+            buffer.setSample (0, i, sample);
+            buffer.setSample (1, i, sample);
+            phase += phaseIncrement;
+        }
+
+        processor.processBlock (buffer, midi);
+        output.insert (output.end(), buffer.getReadPointer (0), buffer.getReadPointer (0) + blockSize);
+    }
+
+    return output;
+}
+
+
+// magnitude of a single frequency component of the signal
+double magnitudeAt (const std::vector<float>& signal, double frequency, double sampleRate)
+{
+    auto real = 0.0;
+    auto imaginary = 0.0;
+
+    for (auto i = 0; i < signal.size(); ++i)
+    {
+        auto phase = juce::MathConstants<double>::twoPi * frequency * i / sampleRate;
+        real += signal[i] * std::cos (phase);
+        imaginary += signal[i] * std::sin (phase);
+    }
+
+    return 2.0 * std::sqrt (real * real + imaginary * imaginary) / (double) signal.size();
+}
+
+
+TEST_CASE ("oversampling a linear processor only delays the signal")
+{
+    auto sampleRate = 44100.0;
+    auto frequency = 1000.0;
+    auto oversampled = Oversampled<AudioProcessorBase, 4> {};
+    auto latency = oversampled.getLatencySamples();
+
+    CHECK (latency == 96);
+
+    auto output = renderSine (oversampled, frequency, sampleRate, 4);
+
+    for (auto i = 512; i < output.size(); ++i)
+    {
+        auto expected = std::sin (juce::MathConstants<double>::twoPi * frequency * (i - latency) / sampleRate);
+        CHECK_THAT (output[i], Catch::Matchers::WithinAbs (expected, 1.0e-3));
+    }
+}
+
+
+TEST_CASE ("oversampling reduces aliasing of the saturator")
+{
+    auto sampleRate = 44100.0;
+    auto frequency = 15000.0;
+
+    // the 3rd harmonic (45 kHz) folds back to 900 Hz
+    auto aliasFrequency = 3 * frequency - sampleRate;
+
+    auto saturator = Saturator { 18.0f };
+    auto oversampledSaturator = OversampledSaturator { 18.0f };
+
+    // 86 blocks of 512 is about a second, so both frequencies fit (almost) exactly
+    auto plain = renderSine (saturator, frequency, sampleRate, 86);
+    auto oversampled = renderSine (oversampledSaturator, frequency, sampleRate, 86);
+
+    auto plainAlias = magnitudeAt (plain, aliasFrequency, sampleRate);
+    auto oversampledAlias = magnitudeAt (oversampled, aliasFrequency, sampleRate);
+
+    CHECK (plainAlias > 0.05);
+    CHECK (oversampledAlias < plainAlias * 0.01);
+}
+
+
+TEST_CASE ("oversampling keeps the audible band flat")
+{
+    auto sampleRate = 44100.0;
+    auto oversampled = Oversampled<AudioProcessorBase, 4> {};
+
+    // about a second, so the frequencies fit (almost) exactly. the first block is left out (the filters fill up)
+    for (auto frequency : { 1000.0, 18000.0, 20000.0 })
+    {
+        auto output = renderSine (oversampled, frequency, sampleRate, 87);
+        output.erase (output.begin(), output.begin() + 512);
+        CHECK (juce::Decibels::gainToDecibels (magnitudeAt (output, frequency, sampleRate)) > -0.2);
+    }
+}
+
+
+TEST_CASE ("a bypassed oversampler only delays the signal, bit for bit")
+{
+    auto sampleRate = 44100.0;
+    auto oversampledSaturator = OversampledSaturator { 18.0f };
+    auto latency = oversampledSaturator.getLatencySamples();
+
+    oversampledSaturator.prepareToPlay (sampleRate, 512);
+    oversampledSaturator.setBypassed (true);
+
+    auto random = juce::Random { 7 };
+    auto input = std::vector<float> (4 * 512);
+
+    for (auto& sample : input)
+        sample = random.nextFloat() * 2.0f - 1.0f;
+
+    auto buffer = juce::AudioBuffer<float> (2, 512);
+    auto midi = juce::MidiBuffer {};
+
+    for (auto block = 0; block < 4; ++block)
+    {
+        for (auto channel = 0; channel < 2; ++channel)
+            buffer.copyFrom (channel, 0, input.data() + block * 512, 512);
+
+        oversampledSaturator.processBlock (buffer, midi);
+
+        for (auto i = 0; i < 512; ++i)
+        {
+            auto index = block * 512 + i;
+            auto expected = index >= latency ? input[(size_t) (index - latency)] : 0.0f;
+            REQUIRE (buffer.getSample (0, i) == expected);
+            REQUIRE (buffer.getSample (1, i) == expected);
+        }
+    }
+}
@@ -3,6 +3,7 @@
 
 #include <catch2/catch_all.hpp>
 #include <console_synth/sequencer/play_head.h>
+#include <cmath>
 
 
 TEST_CASE ("play head start from 0")
@@ -226,4 +227,147 @@ TEST_CASE ("play head realistic scenario")
     CHECK (tickTimeStamps.size() == 101);
     CHECK (tickNumbers.size() == 101);
     CHECK (bufferCount == 108);
-}
\ No newline at end of file
+}
+
+TEST_CASE ("tick ranges cover the same ticks as forEachTick")
+{
+    auto playHead = PlayHead();
+    playHead.setTickTimeMs (1.0);
+    playHead.setDeviceCallbackDurationMs (100.0);
+    playHead.setPositionInTicks (0);
+
+    // loop from tick 5 to 49 (including), so the buffer wraps around the loop twice
+    playHead.setLooping (5, 50);
+
+    auto ticks = std::vector<uint64_t>();
+    auto timeStampsIntoBufferMs = std::vector<double>();
+
+    forEachTick (playHead, [&] (uint64_t tick, double timeIntoBufferMs) {
+        ticks.push_back (tick);
+        timeStampsIntoBufferMs.push_back (timeIntoBufferMs);
+    });
+
+    auto ranges = std::vector<TickRange>();
+    forEachTickRange (playHead, [&] (const TickRange& range) { ranges.push_back (range); });
+
+    REQUIRE (ranges.size() == 3);
+    CHECK (ranges[0].startTick == 5);
+    CHECK (ranges[0].endTick == 50);
+    CHECK (ranges[1].startTick == 5);
+    CHECK (ranges[1].endTick == 50);
+    CHECK (ranges[2].startTick == 5);
+    CHECK (ranges[2].endTick == 15);
+
+    auto index = 0;
+
+    for (auto& range : ranges)
+    {
+        for (auto tick = range.startTick; tick < range.endTick; ++tick, ++index)
+        {
+            CHECK (tick == ticks[index]);
+            CHECK_THAT (range.getTimeOfTickMs (tick), Catch::Matchers::WithinAbs (timeStampsIntoBufferMs[index], 0.001));
+        }
+    }
+
+    CHECK (index == ticks.size());
+}
+
+
+TEST_CASE ("sample accurate play head loops like the millisecond play head")
+{
+    // 1ms ticks and 100ms blocks at 48kHz: 48 samples per tick, 4800 samples per block
+    auto playHead = PlayHead();
+    playHead.setSampleRate (48'000.0);
+    playHead.setTickTimeMs (1.0);
+    playHead.setBlockSizeSamples (4800);
+    playHead.setPositionInTicks (0);
+    playHead.setLooping (5, 50);
+
+    auto ticks = std::vector<uint64_t>();
+    auto samples = std::vector<int>();
+
+    forEachTickRange (playHead, [&] (const TickRange& range) {
+        for (auto tick = range.startTick; tick < range.endTick; ++tick)
+        {
+            ticks.push_back (tick);
+            samples.push_back (range.getSampleOfTick (tick, 4800));
+        }
+    });
+
+    REQUIRE (ticks.size() == 100);
+    CHECK (ticks[0] == 5);
+    CHECK (ticks[44] == 49);
+    CHECK (ticks[45] == 5);
+    CHECK (ticks.back() == 14);
+
+    for (auto i = 0; i < (int) samples.size(); ++i)
+        CHECK (samples[i] == i * 48);
+
+    playHead.advanceDeviceBuffer();
+    CHECK (playHead.getCurrentTick() == 15);
+
+    playHead.advanceDeviceBuffer();
+    CHECK (playHead.getCurrentTick() == 25);
+}
+
+
+TEST_CASE ("sample accurate play head doesn't drift")
+{
+    // 100 bpm with 48 ticks per quarter note at 44.1kHz gives ticks of exactly 551.25 samples
+    const auto sampleRate = 44'100.0;
+    const auto blockSize = 512;
+    const auto tickLengthSamples = 551.25;
+
+    auto playHead = PlayHead();
+    playHead.setSampleRate (sampleRate);
+    playHead.setTickTimeMs (60'000.0 / (100 * 48));
+    playHead.setBlockSizeSamples (blockSize);
+    playHead.setPositionInTicks (0);
+
+    // play three hours worth of blocks, checking the ticks in the last block
+    const auto numBlocks = (uint64_t) (3 * 60 * 60 * sampleRate) / blockSize;
+
+    for (auto block = uint64_t { 0 }; block < numBlocks; ++block)
+        playHead.advanceDeviceBuffer();
+
+    const auto blockStart = numBlocks * blockSize;
+    CHECK (playHead.getSamplePosition() == blockStart);
+
+    // the first tick at or after the start of the block
+    const auto expectedTick = (uint64_t) std::ceil ((double) blockStart / tickLengthSamples);
+    CHECK (playHead.getCurrentTick() == expectedTick);
+
+    forEachTickRange (playHead, [&] (const TickRange& range) {
+        for (auto tick = range.startTick; tick < range.endTick; ++tick)
+        {
+            auto expectedSample = (int) std::floor ((double) tick * tickLengthSamples - (double) blockStart);
+            CHECK (range.getSampleOfTick (tick, blockSize) == expectedSample);
+        }
+    });
+}
+
+
+TEST_CASE ("play head ignores empty loops")
+{
+    auto playHead = PlayHead();
+    playHead.setSampleRate (48'000.0);
+    playHead.setTickTimeMs (10.0);
+    playHead.setBlockSizeSamples (1000);
+    playHead.setPositionInTicks (0);
+    playHead.setLooping (0, 8);
+
+    playHead.setLooping (5, 5);
+    playHead.setLooping (6, 2);
+    CHECK (playHead.getLoopingStart() == 0u);
+    CHECK (playHead.getLoopingEnd() == 8u);
+
+    // a block is two ticks and a bit, the loop keeps wrapping around at tick 8
+    for (auto block = 0; block < 10; ++block)
+    {
+        auto numTicks = uint64_t { 0 };
+        forEachTickRange (playHead, [&] (const TickRange& range) { numTicks += range.endTick - range.startTick; });
+        CHECK ((numTicks == 2 || numTicks == 3));
+        CHECK (playHead.getCurrentTick() < 8);
+        playHead.advanceDeviceBuffer();
+    }
+}
@@ -0,0 +1,82 @@
+// Written by Wouter Ensink
+
+#include <catch2/catch_all.hpp>
+#include <console_synth/audio/processor_chain.h>
+
+
+struct CountingInstrument : public AudioProcessorBase
+{
+    void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages) override
+    {
+        ++numBlocksProcessed;
+    }
+
+    [[nodiscard]] bool isIdle() const override { return idle; }
+
+    bool idle = true;
+    int numBlocksProcessed = 0;
+};
+
+
+struct CountingEffect : public AudioProcessorBase
+{
+    explicit CountingEffect (double tailSeconds) : tailSeconds { tailSeconds } {}
+
+    void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages) override
+    {
+        ++numBlocksProcessed;
+    }
+
+    [[nodiscard]] double getTailLengthSeconds() const override { return tailSeconds; }
+
+    double tailSeconds;
+    int numBlocksProcessed = 0;
+};
+
+
+TEST_CASE ("processor chain silence tracking")
+{
+    // sample rate of 1000, so a block of 100 samples is 0.1 seconds
+    auto instrument = CountingInstrument {};
+    auto chain = ProcessorChain { instrument };
+    auto effect = std::make_unique<CountingEffect> (0.25);
+    auto& effectRef = *effect;
+    chain.addEffectToChain (std::move (effect));
+    chain.prepareToPlay (1000.0, 100);
+
+    auto buffer = juce::AudioBuffer<float> (2, 100);
+    auto midi = juce::MidiBuffer {};
+
+    SECTION ("idle instrument without midi doesn't render anything")
+    {
+        chain.processBlock (buffer, midi);
+        CHECK (chain.isIdle());
+        CHECK (instrument.numBlocksProcessed == 0);
+        CHECK (effectRef.numBlocksProcessed == 0);
+    }
+
+    SECTION ("incoming midi wakes up the chain")
+    {
+        midi.addEvent (juce::MidiMessage::noteOn (1, 60, (uint8_t) 100), 0);
+        chain.processBlock (buffer, midi);
+        CHECK (instrument.numBlocksProcessed == 1);
+        CHECK (effectRef.numBlocksProcessed == 1);
+    }
+
+    SECTION ("effects keep processing until their tail has decayed")
+    {
+        instrument.idle = false;
+        chain.processBlock (buffer, midi);
+        CHECK (! chain.isIdle());
+
+        instrument.idle = true;
+
+        // 0.25 seconds of tail is 250 samples, so 3 more blocks of 100 samples
+        for (auto i = 0; i < 10; ++i)
+            chain.processBlock (buffer, midi);
+
+        CHECK (instrument.numBlocksProcessed == 1);
+        CHECK (effectRef.numBlocksProcessed == 4);
+        CHECK (chain.isIdle());
+    }
+}
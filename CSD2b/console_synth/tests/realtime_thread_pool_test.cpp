@@ -0,0 +1,53 @@
+// Written by Wouter Ensink
+
+#include <catch2/catch_all.hpp>
+#include <console_synth/utility/realtime_thread_pool.h>
+#include <array>
+
+
+TEST_CASE ("realtime thread pool does every job exactly once")
+{
+    auto pool = RealtimeThreadPool { 3 };
+    auto counts = std::array<std::atomic<int>, 16> {};
+
+    auto job = [&counts] (int index) { counts[(size_t) index].fetch_add (1); };
+
+    for (auto round = 0; round < 1000; ++round)
+        pool.run ((int) counts.size(), job);
+
+    for (auto& count : counts)
+        CHECK (count.load() == 1000);
+}
+
+
+TEST_CASE ("realtime thread pool handles a different number of jobs every round")
+{
+    auto pool = RealtimeThreadPool { 4 };
+    auto results = std::vector<int> (32, 0);
+
+    for (auto round = 1; round <= 500; ++round)
+    {
+        auto numJobs = round % 32 + 1;
+        std::fill (results.begin(), results.end(), 0);
+
+        // every job only writes its own element, like tracks rendering into their own buffers
+        auto job = [&results, round] (int index) { results[(size_t) index] = round + index; };
+        pool.run (numJobs, job);
+
+        for (auto i = 0; i < (int) results.size(); ++i)
+            CHECK (results[(size_t) i] == (i < numJobs ? round + i : 0));
+    }
+}
+
+
+TEST_CASE ("realtime thread pool without workers runs the jobs on the calling thread")
+{
+    auto pool = RealtimeThreadPool { 0 };
+    auto order = std::vector<int> {};
+
+    auto job = [&order] (int index) { order.push_back (index); };
+    pool.run (4, job);
+
+    CHECK (pool.getNumWorkers() == 0);
+    CHECK (order == std::vector<int> { 0, 1, 2, 3 });
+}
@@ -0,0 +1,205 @@
+// Written by Wouter Ensink
+
+#include <catch2/catch_all.hpp>
+#include <console_synth/midi/standard_midi_file.h>
+
+
+static juce::MemoryBlock writeToMemory (const juce::MidiFile& file)
+{
+    auto stream = juce::MemoryOutputStream {};
+    REQUIRE (file.writeTo (stream));
+    return stream.getMemoryBlock();
+}
+
+
+static std::vector<StandardMidiFile::Note> readFromMemory (const juce::MemoryBlock& block, uint32_t ticksPerQuarterNote)
+{
+    auto stream = juce::MemoryInputStream { block, false };
+    return StandardMidiFile::readNotes (stream, ticksPerQuarterNote);
+}
+
+
+static bool isSameNote (const StandardMidiFile::Note& a, const StandardMidiFile::Note& b)
+{
+    return a.number == b.number && a.start == b.start && a.length == b.length && a.velocity == b.velocity;
+}
+
+
+TEST_CASE ("midi files are rescaled to the ticks of the sequencer")
+{
+    // 960 ticks per quarter note in the file is 20 file ticks per sequencer tick
+    auto first = juce::MidiMessageSequence {};
+    first.addEvent (juce::MidiMessage::noteOn (1, 60, (juce::uint8) 100), 0.0);
+    first.addEvent (juce::MidiMessage::noteOff (1, 60), 960.0);
+    first.addEvent (juce::MidiMessage::noteOn (1, 62, (juce::uint8) 80), 1925.0);
+
+    // a note on without velocity ends the note, a second note on for the same note too
+    first.addEvent (juce::MidiMessage::noteOn (1, 62, (juce::uint8) 0), 2880.0);
+    first.addEvent (juce::MidiMessage::noteOn (1, 64, (juce::uint8) 90), 3840.0);
+    first.addEvent (juce::MidiMessage::noteOn (1, 64, (juce::uint8) 91), 4800.0);
+    first.addEvent (juce::MidiMessage::noteOff (1, 64), 5760.0);
+
+    // the same note on another channel is another note, a note without a note off ends with the track
+    auto second = juce::MidiMessageSequence {};
+    second.addEvent (juce::MidiMessage::noteOn (2, 60, (juce::uint8) 70), 480.0);
+    second.addEvent (juce::MidiMessage::noteOn (3, 60, (juce::uint8) 71), 480.0);
+    second.addEvent (juce::MidiMessage::noteOff (2, 60), 1440.0);
+    second.addEvent (juce::MidiMessage::controllerEvent (3, 1, 64), 9600.0);
+
+    auto file = juce::MidiFile {};
+    file.setTicksPerQuarterNote (960);
+    file.addTrack (first);
+    file.addTrack (second);
+
+    auto notes = readFromMemory (writeToMemory (file), 48);
+
+    auto expected = std::vector<StandardMidiFile::Note> {
+        { 60, 0, 48, 100 },
+        { 60, 24, 48, 70 },
+        { 60, 24, 456, 71 },
+        { 62, 96, 48, 80 },
+        { 64, 192, 48, 90 },
+        { 64, 240, 48, 91 },
+    };
+
+    REQUIRE (notes.size() == expected.size());
+
+    for (auto i = size_t { 0 }; i < notes.size(); ++i)
+        CHECK (isSameNote (notes[i], expected[i]));
+}
+
+
+TEST_CASE ("exported melodies import as the same notes")
+{
+    auto root = juce::ValueTree { IDs::track };
+    auto melody = Melody { root };
+    auto melodyTree = root.getChildWithName (IDs::melody);
+
+    auto notes = std::vector<StandardMidiFile::Note> {};
+
+    // every note number is only used once at a time, otherwise the note offs can't be told apart
+    for (auto i = 0; i < 500; ++i)
+        notes.push_back ({ 30 + i % 60, i * 7, 1 + i % 300, 1 + i % 127 });
+
+    StandardMidiFile::replaceNotes (melodyTree, notes);
+
+    auto meterMap = MeterMap { { { 0, 4, 4 }, { 2, 7, 8 } }, 48 };
+    auto tempoMap = TempoMap { 120.0, 48'000.0, 48 };
+    auto block = writeToMemory (StandardMidiFile::createMidiFile (melody, meterMap, tempoMap));
+
+    // the file is at the same resolution, so nothing is rounded
+    auto imported = readFromMemory (block, 48);
+
+    REQUIRE (imported.size() == notes.size());
+
+    for (auto i = size_t { 0 }; i < notes.size(); ++i)
+        CHECK (isSameNote (imported[i], notes[i]));
+}
+
+
+TEST_CASE ("exported tempo changes play the notes at the same time as the tempo map")
+{
+    auto root = juce::ValueTree { IDs::track };
+    auto melody = Melody { root };
+
+    // a note every sixteenth note, for 4 bars of 4/4
+    auto notes = std::vector<StandardMidiFile::Note> {};
+
+    for (auto tick = 0; tick < 48 * 16; tick += 12)
+        notes.push_back ({ 60, tick, 12, 100 });
+
+    StandardMidiFile::replaceNotes (root.getChildWithName (IDs::melody), notes);
+
+    // the tempo steps down at the second bar and ramps up from there, over two bars
+    auto meterMap = MeterMap { 48 };
+    auto tempoMap = TempoMap { { { 0, 120.0 }, { 192, 90.0, TempoMap::Curve::ramp }, { 576, 150.0 } }, 48'000.0, 48 };
+    auto block = writeToMemory (StandardMidiFile::createMidiFile (melody, meterMap, tempoMap));
+
+    auto file = juce::MidiFile {};
+    auto stream = juce::MemoryInputStream { block, false };
+    REQUIRE (file.readFrom (stream));
+
+    auto fileInSeconds = file;
+    fileInSeconds.convertTimestampTicksToSeconds();
+
+    const auto& track = *file.getTrack (0);
+    const auto& trackInSeconds = *fileInSeconds.getTrack (0);
+    auto numTempoEvents = 0;
+    auto numNotes = 0;
+
+    for (auto i = 0; i < track.getNumEvents(); ++i)
+    {
+        const auto& message = track.getEventPointer (i)->message;
+
+        if (message.isTempoMetaEvent())
+            ++numTempoEvents;
+
+        if (! message.isNoteOn())
+            continue;
+
+        // the ramp is written in steps, but they start at the same time as in the ramp, like the notes on them
+        const auto tick = (uint64_t) message.getTimeStamp();
+        const auto expectedSeconds = (double) tempoMap.getPositionOfTick (tick) / (double) TempoMap::subSamplesPerSample / 48'000.0;
+        CHECK_THAT (trackInSeconds.getEventPointer (i)->message.getTimeStamp(), Catch::Matchers::WithinAbs (expectedSeconds, 1.0e-4));
+        ++numNotes;
+    }
+
+    CHECK (numNotes == (int) notes.size());
+
+    // the start, a step every sixteenth note of the ramp (starting with the step down) and the end of the ramp
+    CHECK (numTempoEvents == 2 + (576 - 192) / 12);
+}
+
+
+TEST_CASE ("importing replaces the melody in one go")
+{
+    auto root = juce::ValueTree { IDs::track };
+    auto melody = Melody { root };
+    auto melodyTree = root.getChildWithName (IDs::melody);
+
+    MelodyGenerator::addNoteToTree (melodyTree, { 60, 0, 10, 100 });
+
+    auto notes = std::vector<StandardMidiFile::Note> {};
+    auto random = juce::Random { 42 };
+
+    for (auto i = 0; i < 50'000; ++i)
+        notes.push_back ({ random.nextInt ({ 20, 100 }), random.nextInt (1'000'000), 1 + random.nextInt (500), 100 });
+
+    StandardMidiFile::replaceNotes (melodyTree, notes);
+
+    CHECK (melodyTree.getNumChildren() == (int) notes.size());
+
+    auto numEvents = size_t { 0 };
+    auto previousTick = 0;
+    auto isSorted = true;
+
+    melody.forEachEvent ([&] (const Event& event) {
+        isSorted = isSorted && event.timeStampTicks >= previousTick;
+        previousTick = event.timeStampTicks;
+        ++numEvents;
+    });
+
+    CHECK (numEvents == notes.size() * 2);
+    CHECK (isSorted);
+
+    // notes removed after the import still find their events
+    melodyTree.removeChild (0, nullptr);
+
+    numEvents = 0;
+    melody.forEachEvent ([&numEvents] (const Event&) { ++numEvents; });
+    CHECK (numEvents == (notes.size() - 1) * 2);
+}
+
+
+TEST_CASE ("midi files that can't be imported throw")
+{
+    auto file = juce::MidiFile {};
+    file.setSmpteTimeFormat (25, 40);
+    file.addTrack (juce::MidiMessageSequence {});
+
+    CHECK_THROWS_AS (readFromMemory (writeToMemory (file), 48), StandardMidiFile::ReadError);
+
+    auto garbage = juce::MemoryBlock {};
+    garbage.append ("not a midi file", 15);
+    CHECK_THROWS_AS (readFromMemory (garbage, 48), StandardMidiFile::ReadError);
+}
@@ -0,0 +1,104 @@
+// Written by Wouter Ensink
+
+#include <catch2/catch_all.hpp>
+#include <console_synth/sequencer/step_sequence.h>
+#include "test_play_head.h"
+
+
+static std::vector<int> getHits (const StepPattern& pattern)
+{
+    auto hits = std::vector<int> {};
+
+    for (auto step = 0; step < pattern.numSteps; ++step)
+        hits.push_back (pattern.isHit ((uint64_t) step) ? 1 : 0);
+
+    return hits;
+}
+
+
+static juce::ValueTree createStepSequence (int numHits, int numSteps, int rotation = 0)
+{
+    auto state = juce::ValueTree { IDs::stepSequence };
+    state.setProperty (IDs::numHits, numHits, nullptr);
+    state.setProperty (IDs::numSteps, numSteps, nullptr);
+    state.setProperty (IDs::rotation, rotation, nullptr);
+    return state;
+}
+
+
+TEST_CASE ("step patterns spread the hits like the bresenham algorithm")
+{
+    CHECK (getHits (StepPattern::fromState (createStepSequence (4, 16))) == std::vector<int> { 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0 });
+    CHECK (getHits (StepPattern::fromState (createStepSequence (5, 16))) == std::vector<int> { 1, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0 });
+    CHECK (getHits (StepPattern::fromState (createStepSequence (6, 16))) == std::vector<int> { 1, 0, 0, 1, 0, 0, 1, 0, 1, 0, 0, 1, 0, 0, 1, 0 });
+    CHECK (getHits (StepPattern::fromState (createStepSequence (3, 8, 2))) == std::vector<int> { 1, 0, 1, 0, 0, 1, 0, 0 });
+    CHECK (getHits (StepPattern::fromState (createStepSequence (3, 8, -1))) == getHits (StepPattern::fromState (createStepSequence (3, 8, 7))));
+
+    // a velocity of 0 is a rest
+    auto state = createStepSequence (4, 4);
+    state.setProperty (IDs::velocities, juce::Array<juce::var> { 100, 0 }, nullptr);
+    CHECK (getHits (StepPattern::fromState (state)) == std::vector<int> { 1, 0, 1, 0 });
+
+    // the pattern repeats over the timeline
+    auto pattern = StepPattern::fromState (createStepSequence (5, 16));
+    CHECK (pattern.isHit (16 * 1000 + 4));
+    CHECK (! pattern.isHit (16 * 1000 + 5));
+}
+
+
+TEST_CASE ("step sequence plays its hits with the gate and applies changes from the next block")
+{
+    // a block is two ticks
+    auto playHead = createTestPlayHead();
+
+    // 4 hits in 16 sixteenths of 12 ticks: a note every 48 ticks, which lasts 6 ticks
+    auto trackState = juce::ValueTree { IDs::track };
+    auto stepSequence = StepSequence { trackState };
+    auto state = trackState.getChildWithName (IDs::stepSequence);
+    state.setProperty (IDs::numHits, 4, nullptr);
+    state.setProperty (IDs::notes, juce::Array<juce::var> { 36, 38 }, nullptr);
+
+    auto source = StepSequenceMidiSource { &stepSequence };
+    auto buffer = juce::MidiBuffer {};
+    auto noteOns = std::vector<std::pair<uint64_t, int>> {};
+    auto noteOffs = std::vector<std::pair<uint64_t, int>> {};
+
+    const auto playBlock = [&] (int) {
+        buffer.clear();
+        source.fillNextMidiBuffer (playHead, buffer, testBlockSize);
+
+        for (auto&& metadata : buffer)
+        {
+            auto message = metadata.getMessage();
+            auto tick = getTickOfSample (playHead, metadata.samplePosition);
+
+            if (message.isNoteOn())
+                noteOns.emplace_back (tick, message.getNoteNumber());
+            else if (message.isNoteOff())
+                noteOffs.emplace_back (tick, message.getNoteNumber());
+        }
+    };
+
+    // 100 ticks
+    playBlocks (playHead, 50, playBlock);
+
+    CHECK (noteOns == std::vector<std::pair<uint64_t, int>> { { 0, 36 }, { 48, 36 }, { 96, 36 } });
+    CHECK (noteOffs == std::vector<std::pair<uint64_t, int>> { { 6, 36 }, { 54, 36 } });
+
+    // the note at tick 96 is stopped by the change, the new pattern plays from the next step
+    noteOns.clear();
+    noteOffs.clear();
+    state.setProperty (IDs::numHits, 16, nullptr);
+    playBlocks (playHead, 2, playBlock);
+
+    CHECK (noteOffs == std::vector<std::pair<uint64_t, int>> { { 100, 36 } });
+    CHECK (noteOns.empty());
+
+    playBlocks (playHead, 10, playBlock);
+
+    // step 9 of the pattern is at tick 108, the notes alternate
+    CHECK (noteOns == std::vector<std::pair<uint64_t, int>> { { 108, 38 }, { 120, 36 } });
+    CHECK (noteOffs == std::vector<std::pair<uint64_t, int>> { { 100, 36 }, { 114, 38 } });
+
+    stepSequence.collectGarbage();
+}
@@ -0,0 +1,137 @@
+// Written by Wouter Ensink
+
+#include <catch2/catch_all.hpp>
+#include <console_synth/sequencer/play_head.h>
+#include <console_synth/sequencer/tempo_map.h>
+
+
+constexpr auto toSamples (uint64_t subSamples)
+{
+    return (double) subSamples / (double) TempoMap::subSamplesPerSample;
+}
+
+
+TEST_CASE ("tempo map with a constant tempo")
+{
+    // 100 bpm, 48 ticks per quarter note at 44.1kHz: 551.25 samples per tick
+    auto map = TempoMap { 100.0, 44'100.0, 48 };
+
+    CHECK (map.getPositionOfTick (uint64_t { 0 }) == 0);
+    CHECK_THAT (toSamples (map.getPositionOfTick (uint64_t { 4 })), Catch::Matchers::WithinAbs (2205.0, 1e-9));
+    CHECK_THAT (toSamples (map.getPositionOfTick (uint64_t { 1'000'000 })), Catch::Matchers::WithinAbs (551'250'000.0, 1e-6));
+
+    CHECK_THAT (map.getTickAtPosition (map.getPositionOfTick (uint64_t { 123 })), Catch::Matchers::WithinAbs (123.0, 1e-9));
+    CHECK (map.getFirstTickAtOrAfter (map.getPositionOfTick (uint64_t { 10 })) == 10);
+    CHECK (map.getFirstTickAtOrAfter (map.getPositionOfTick (uint64_t { 10 }) + 1) == 11);
+}
+
+
+TEST_CASE ("tempo map with a step")
+{
+    // 120 bpm at 48kHz with 1 tick per quarter note: 24000 samples per tick, twice as fast after tick 4
+    auto map = TempoMap { { { 0, 120.0 }, { 4, 240.0 } }, 48'000.0, 1 };
+
+    CHECK_THAT (toSamples (map.getPositionOfTick (uint64_t { 4 })), Catch::Matchers::WithinAbs (96'000.0, 1e-9));
+    CHECK_THAT (toSamples (map.getPositionOfTick (uint64_t { 6 })), Catch::Matchers::WithinAbs (120'000.0, 1e-9));
+    CHECK_THAT (map.getTickAtPosition (map.getPositionOfTick (5.5)), Catch::Matchers::WithinAbs (5.5, 1e-9));
+    CHECK (map.getTempoAtTick (3.9) == 120.0);
+    CHECK (map.getTempoAtTick (4.0) == 240.0);
+}
+
+
+TEST_CASE ("tempo map with a ramp")
+{
+    const auto sampleRate = 48'000.0;
+    const auto ticksPerQuarterNote = 96u;
+
+    // ramp from 80 to 160 bpm over 4 bars, then stay there
+    auto map = TempoMap { { { 0, 80.0, TempoMap::Curve::ramp }, { 1536, 160.0 } }, sampleRate, ticksPerQuarterNote };
+
+    CHECK_THAT (map.getTempoAtTick (768.0), Catch::Matchers::WithinAbs (120.0, 1e-9));
+
+    // add up the length of every tick (at the tempo in the middle of the tick) to check the closed form solution
+    auto expectedPosition = 0.0;
+
+    for (auto tick = uint64_t { 0 }; tick < 1536; ++tick)
+    {
+        CHECK_THAT (toSamples (map.getPositionOfTick (tick)), Catch::Matchers::WithinAbs (expectedPosition, 0.01));
+        expectedPosition += sampleRate * 60.0 / (map.getTempoAtTick ((double) tick + 0.5) * ticksPerQuarterNote);
+    }
+
+    // after the ramp, every tick has the length of a tick at 160 bpm
+    auto tickLength = map.getPositionOfTick (uint64_t { 1601 }) - map.getPositionOfTick (uint64_t { 1600 });
+    CHECK_THAT (toSamples (tickLength), Catch::Matchers::WithinAbs (sampleRate * 60.0 / (160.0 * ticksPerQuarterNote), 1e-6));
+
+    // converting back finds the same ticks
+    for (auto tick = uint64_t { 0 }; tick < 2000; tick += 7)
+    {
+        auto position = map.getPositionOfTick (tick);
+        CHECK_THAT (map.getTickAtPosition (position), Catch::Matchers::WithinAbs ((double) tick, 1e-6));
+        CHECK (map.getFirstTickAtOrAfter (position) == tick);
+        CHECK (map.getFirstTickAtOrAfter (position + 1) == tick + 1);
+    }
+}
+
+
+TEST_CASE ("play head follows the tempo map within a block")
+{
+    const auto blockSize = 512;
+
+    auto map = TempoMap { { { 0, 100.0, TempoMap::Curve::ramp }, { 200, 180.0 }, { 400, 60.0 } }, 44'100.0, 48 };
+
+    auto playHead = PlayHead();
+    playHead.setSampleRate (44'100.0);
+    playHead.setBlockSizeSamples (blockSize);
+    playHead.setTempoMap (&map, 1);
+    playHead.setPositionInTicks (0);
+
+    auto nextExpectedTick = uint64_t { 0 };
+
+    for (auto block = 0; block < 400; ++block)
+    {
+        const auto blockStart = playHead.getTimelinePositionSubSamples();
+
+        forEachTickRange (playHead, [&] (const TickRange& range) {
+            for (auto tick = range.startTick; tick < range.endTick; ++tick)
+            {
+                // every tick shows up exactly once, in order, at the sample its position falls on
+                CHECK (tick == nextExpectedTick++);
+
+                auto expectedSample = (int) ((map.getPositionOfTick (tick) - blockStart) >> TempoMap::subSampleBits);
+                auto sample = range.getSampleOfTick (tick, blockSize);
+                CHECK (sample == expectedSample);
+                CHECK (sample < blockSize);
+            }
+        });
+
+        playHead.advanceDeviceBuffer();
+    }
+
+    CHECK (nextExpectedTick == playHead.getCurrentTick());
+    CHECK (nextExpectedTick > 400);
+}
+
+
+TEST_CASE ("play head keeps its musical position when the tempo map changes")
+{
+    auto slow = TempoMap { 60.0, 48'000.0, 1 };
+    auto fast = TempoMap { 120.0, 48'000.0, 1 };
+
+    auto playHead = PlayHead();
+    playHead.setSampleRate (48'000.0);
+    playHead.setBlockSizeSamples (12'000);
+    playHead.setTempoMap (&slow, 1);
+    playHead.setPositionInTicks (0);
+
+    // one tick per second, so after 6 blocks of a quarter second it's halfway into tick 1
+    for (auto block = 0; block < 6; ++block)
+        playHead.advanceDeviceBuffer();
+
+    CHECK (playHead.getCurrentTick() == 2);
+
+    playHead.setTempoMap (&fast, 2);
+
+    // still halfway into tick 1, which is at 0.75 seconds with 2 ticks per second
+    CHECK (playHead.getCurrentTick() == 2);
+    CHECK_THAT (toSamples (playHead.getTimelinePositionSubSamples()), Catch::Matchers::WithinAbs (36'000.0, 1e-6));
+}
@@ -0,0 +1,45 @@
+// Written by Wouter Ensink
+
+#pragma once
+
+#include <console_synth/sequencer/play_head.h>
+
+/* The play head the midi tests play their blocks with: at 120 bpm and 48 ticks per quarter note (at 48 kHz),
+ * a tick takes 500 samples, so a block of 1000 samples is two ticks and the tick of an event is easy to find back.
+ * */
+
+static constexpr auto testSamplesPerTick = 500;
+static constexpr auto testBlockSize = 1000;
+
+
+inline PlayHead createTestPlayHead (int blockSize = testBlockSize)
+{
+    // the play head only points at the tempo map, so the map stays alive for all tests
+    static const auto tempoMap = TempoMap { 120.0, 48'000.0, 48 };
+
+    auto playHead = PlayHead {};
+    playHead.setSampleRate (48'000.0);
+    playHead.setBlockSizeSamples (blockSize);
+    playHead.setTempoMap (&tempoMap, 1);
+    playHead.setPositionInTicks (0);
+    return playHead;
+}
+
+
+// the tick of an event at the given sample of the current block
+inline uint64_t getTickOfSample (const PlayHead& playHead, int samplePosition)
+{
+    return playHead.getCurrentTick() + (uint64_t) (samplePosition / testSamplesPerTick);
+}
+
+
+// calls the function for every block (with the index of the block), the play head moves on after every block
+template <typename PlayBlockFunction>
+void playBlocks (PlayHead& playHead, int numBlocks, PlayBlockFunction&& playBlock)
+{
+    for (auto block = 0; block < numBlocks; ++block)
+    {
+        playBlock (block);
+        playHead.advanceDeviceBuffer();
+    }
+}